@@ -0,0 +1,552 @@
+#include "AabbTree.h"
+#include <algorithm>
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Same transform as FrustumCuller::Set - the matrix is stored
+// transposed, so each row is one world axis, and the new half
+// extents are the rows' absolute values times the old ones
+// --------------------------------------------------------
+Aabb Aabb::FromBounds(const MeshBounds & bounds, const XMFLOAT4X4 & worldMatrix)
+{
+	const XMFLOAT4X4& m = worldMatrix;
+	XMFLOAT3 c(
+		(bounds.min.x + bounds.max.x) * 0.5f,
+		(bounds.min.y + bounds.max.y) * 0.5f,
+		(bounds.min.z + bounds.max.z) * 0.5f);
+	XMFLOAT3 e(
+		(bounds.max.x - bounds.min.x) * 0.5f,
+		(bounds.max.y - bounds.min.y) * 0.5f,
+		(bounds.max.z - bounds.min.z) * 0.5f);
+
+	XMFLOAT3 center(
+		m._11 * c.x + m._12 * c.y + m._13 * c.z + m._14,
+		m._21 * c.x + m._22 * c.y + m._23 * c.z + m._24,
+		m._31 * c.x + m._32 * c.y + m._33 * c.z + m._34);
+	XMFLOAT3 extents(
+		fabsf(m._11) * e.x + fabsf(m._12) * e.y + fabsf(m._13) * e.z,
+		fabsf(m._21) * e.x + fabsf(m._22) * e.y + fabsf(m._23) * e.z,
+		fabsf(m._31) * e.x + fabsf(m._32) * e.y + fabsf(m._33) * e.z);
+
+	Aabb result;
+	result.min = XMFLOAT3(center.x - extents.x, center.y - extents.y, center.z - extents.z);
+	result.max = XMFLOAT3(center.x + extents.x, center.y + extents.y, center.z + extents.z);
+	return result;
+}
+
+Aabb Aabb::FromSphere(const XMFLOAT3 & center, float radius)
+{
+	Aabb result;
+	result.min = XMFLOAT3(center.x - radius, center.y - radius, center.z - radius);
+	result.max = XMFLOAT3(center.x + radius, center.y + radius, center.z + radius);
+	return result;
+}
+
+Aabb Aabb::Union(const Aabb & a, const Aabb & b)
+{
+	Aabb result;
+	result.min = XMFLOAT3(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z));
+	result.max = XMFLOAT3(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z));
+	return result;
+}
+
+bool Aabb::Contains(const Aabb & other) const
+{
+	return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+		max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+}
+
+bool Aabb::Overlaps(const Aabb & other) const
+{
+	return min.x <= other.max.x && min.y <= other.max.y && min.z <= other.max.z &&
+		max.x >= other.min.x && max.y >= other.min.y && max.z >= other.min.z;
+}
+
+float Aabb::SurfaceArea() const
+{
+	float x = max.x - min.x;
+	float y = max.y - min.y;
+	float z = max.z - min.z;
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+// --------------------------------------------------------
+// Slab test - a zero direction component gives infinities
+// (or NaN right on a face), and the min/max argument order
+// here keeps those from spoiling the range
+// --------------------------------------------------------
+bool Aabb::IntersectRay(const XMFLOAT3 & origin, const XMFLOAT3 & inverseDirection, float maxDistance, float & distance) const
+{
+	float nearest = 0.0f;
+	float farthest = maxDistance;
+
+	float t1 = (min.x - origin.x) * inverseDirection.x;
+	float t2 = (max.x - origin.x) * inverseDirection.x;
+	nearest = std::max(nearest, std::min(t1, t2));
+	farthest = std::min(farthest, std::max(t1, t2));
+
+	t1 = (min.y - origin.y) * inverseDirection.y;
+	t2 = (max.y - origin.y) * inverseDirection.y;
+	nearest = std::max(nearest, std::min(t1, t2));
+	farthest = std::min(farthest, std::max(t1, t2));
+
+	t1 = (min.z - origin.z) * inverseDirection.z;
+	t2 = (max.z - origin.z) * inverseDirection.z;
+	nearest = std::max(nearest, std::min(t1, t2));
+	farthest = std::min(farthest, std::max(t1, t2));
+
+	distance = nearest;
+	return nearest <= farthest;
+}
+
+
+AabbTree::AabbTree(float margin)
+{
+	this->margin = margin;
+	root = NullNode;
+	freeList = NullNode;
+	leafCount = 0;
+}
+
+// Forgets every leaf, but keeps the memory
+void AabbTree::Clear()
+{
+	nodes.clear();
+	root = NullNode;
+	freeList = NullNode;
+	leafCount = 0;
+}
+
+// A tree of n leaves has n - 1 nodes above them
+void AabbTree::Reserve(unsigned int reserveCount)
+{
+	nodes.reserve(reserveCount * 2);
+	stack.reserve(64);
+}
+
+unsigned int AabbTree::Insert(const Aabb & bounds, unsigned int id)
+{
+	unsigned int leaf = AllocateNode();
+	Node& node = nodes[leaf];
+	node.bounds = bounds;
+	Fatten(node.bounds);
+	node.id = id;
+	node.height = 0;
+
+	InsertLeaf(leaf);
+	leafCount++;
+	return leaf;
+}
+
+void AabbTree::Remove(unsigned int leaf)
+{
+	RemoveLeaf(leaf);
+	FreeNode(leaf);
+	leafCount--;
+}
+
+// --------------------------------------------------------
+// A box that has left its fat box gets a new one - if that
+// still fits in the parent, nothing above needs to change,
+// otherwise the leaf is taken out and put back where it now
+// fits best
+// --------------------------------------------------------
+bool AabbTree::Move(unsigned int leaf, const Aabb & bounds)
+{
+	if (nodes[leaf].bounds.Contains(bounds))
+		return false;
+
+	Aabb fat = bounds;
+	Fatten(fat);
+
+	unsigned int parent = nodes[leaf].parent;
+	if (parent != NullNode && nodes[parent].bounds.Contains(fat))
+	{
+		nodes[leaf].bounds = fat;
+		return true;
+	}
+
+	RemoveLeaf(leaf);
+	nodes[leaf].bounds = fat;
+	InsertLeaf(leaf);
+	return true;
+}
+
+float AabbTree::GetAreaRatio()
+{
+	if (root == NullNode)
+		return 0.0f;
+
+	float total = 0.0f;
+	for (const Node& node : nodes)
+	{
+		if (node.height > 0)
+			total += node.bounds.SurfaceArea();
+	}
+	float rootArea = nodes[root].bounds.SurfaceArea();
+	return rootArea > 0.0f ? total / rootArea : 0.0f;
+}
+
+bool AabbTree::Validate()
+{
+	if (root == NullNode)
+		return leafCount == 0;
+	if (nodes[root].parent != NullNode)
+		return false;
+
+	unsigned int leaves = 0;
+	stack.clear();
+	stack.push_back(StackEntry{ root, 0 });
+	while (!stack.empty())
+	{
+		unsigned int index = stack.back().node;
+		stack.pop_back();
+		const Node& node = nodes[index];
+
+		if (node.IsLeaf())
+		{
+			if (node.height != 0 || node.child2 != NullNode)
+				return false;
+			leaves++;
+			continue;
+		}
+
+		const Node& child1 = nodes[node.child1];
+		const Node& child2 = nodes[node.child2];
+		if (child1.parent != index || child2.parent != index)
+			return false;
+		if (node.height != 1 + std::max(child1.height, child2.height))
+			return false;
+		if (!node.bounds.Contains(child1.bounds) || !node.bounds.Contains(child2.bounds))
+			return false;
+
+		stack.push_back(StackEntry{ node.child1, 0 });
+		stack.push_back(StackEntry{ node.child2, 0 });
+	}
+	return leaves == leafCount;
+}
+
+// --------------------------------------------------------
+// Each node carries the planes its parent was cut by - a node
+// completely inside a plane drops it, so once it's inside all
+// six its whole subtree is taken without another test
+// --------------------------------------------------------
+unsigned int AabbTree::QueryFrustum(const Frustum & frustum, std::vector<unsigned int>& results)
+{
+	results.clear();
+	if (root == NullNode)
+		return 0;
+
+	stack.clear();
+	stack.push_back(StackEntry{ root, 0x3F });
+	while (!stack.empty())
+	{
+		StackEntry entry = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[entry.node];
+
+		if (entry.planeMask != 0)
+		{
+			const Aabb& b = node.bounds;
+			XMFLOAT3 center((b.min.x + b.max.x) * 0.5f, (b.min.y + b.max.y) * 0.5f, (b.min.z + b.max.z) * 0.5f);
+			XMFLOAT3 extents((b.max.x - b.min.x) * 0.5f, (b.max.y - b.min.y) * 0.5f, (b.max.z - b.min.z) * 0.5f);
+
+			bool outside = false;
+			for (int p = 0; p < 6; p++)
+			{
+				if ((entry.planeMask & (1 << p)) == 0)
+					continue;
+
+				const XMFLOAT4& plane = frustum.planes[p];
+				float d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+				float reach = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+				if (d + reach < 0.0f)
+				{
+					outside = true;
+					break;
+				}
+				if (d - reach >= 0.0f)
+					entry.planeMask &= ~(1u << p);
+			}
+			if (outside)
+				continue;
+		}
+
+		if (node.IsLeaf())
+			results.push_back(node.id);
+		else
+		{
+			stack.push_back(StackEntry{ node.child1, entry.planeMask });
+			stack.push_back(StackEntry{ node.child2, entry.planeMask });
+		}
+	}
+	return (unsigned int)results.size();
+}
+
+unsigned int AabbTree::QueryAabb(const Aabb & bounds, std::vector<unsigned int>& results)
+{
+	results.clear();
+	if (root == NullNode)
+		return 0;
+
+	stack.clear();
+	stack.push_back(StackEntry{ root, 0 });
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back().node];
+		stack.pop_back();
+		if (!node.bounds.Overlaps(bounds))
+			continue;
+
+		if (node.IsLeaf())
+			results.push_back(node.id);
+		else
+		{
+			stack.push_back(StackEntry{ node.child1, 0 });
+			stack.push_back(StackEntry{ node.child2, 0 });
+		}
+	}
+	return (unsigned int)results.size();
+}
+
+// Boxes whose closest point to the center is within the radius
+unsigned int AabbTree::QuerySphere(const XMFLOAT3 & center, float radius, std::vector<unsigned int>& results)
+{
+	results.clear();
+	if (root == NullNode)
+		return 0;
+
+	float radiusSquared = radius * radius;
+	stack.clear();
+	stack.push_back(StackEntry{ root, 0 });
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back().node];
+		stack.pop_back();
+
+		const Aabb& b = node.bounds;
+		float dx = std::max(std::max(b.min.x - center.x, center.x - b.max.x), 0.0f);
+		float dy = std::max(std::max(b.min.y - center.y, center.y - b.max.y), 0.0f);
+		float dz = std::max(std::max(b.min.z - center.z, center.z - b.max.z), 0.0f);
+		if (dx * dx + dy * dy + dz * dz > radiusSquared)
+			continue;
+
+		if (node.IsLeaf())
+			results.push_back(node.id);
+		else
+		{
+			stack.push_back(StackEntry{ node.child1, 0 });
+			stack.push_back(StackEntry{ node.child2, 0 });
+		}
+	}
+	return (unsigned int)results.size();
+}
+
+// Takes a node off the free list, or grows the array by one
+unsigned int AabbTree::AllocateNode()
+{
+	unsigned int index;
+	if (freeList != NullNode)
+	{
+		index = freeList;
+		freeList = nodes[index].parent;
+	}
+	else
+	{
+		index = (unsigned int)nodes.size();
+		nodes.push_back(Node());
+	}
+
+	Node& node = nodes[index];
+	node.parent = NullNode;
+	node.child1 = NullNode;
+	node.child2 = NullNode;
+	node.height = 0;
+	node.id = 0;
+	return index;
+}
+
+void AabbTree::FreeNode(unsigned int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+// --------------------------------------------------------
+// Walks down from the root towards the cheapest sibling for
+// the new leaf - pairing with a node costs the area of the
+// two together, and every node above it grows too, so going
+// further down is only worth it while a child is cheaper
+// --------------------------------------------------------
+void AabbTree::InsertLeaf(unsigned int leaf)
+{
+	if (root == NullNode)
+	{
+		root = leaf;
+		nodes[leaf].parent = NullNode;
+		return;
+	}
+
+	Aabb leafBounds = nodes[leaf].bounds;
+	unsigned int index = root;
+	while (!nodes[index].IsLeaf())
+	{
+		const Node& node = nodes[index];
+		float area = node.bounds.SurfaceArea();
+		float combinedArea = Aabb::Union(node.bounds, leafBounds).SurfaceArea();
+
+		// Pairing with this node makes a new parent, and everything
+		// below it inherits the growth
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		unsigned int children[2] = { node.child1, node.child2 };
+		for (int c = 0; c < 2; c++)
+		{
+			const Node& child = nodes[children[c]];
+			float childArea = Aabb::Union(child.bounds, leafBounds).SurfaceArea();
+			if (!child.IsLeaf())
+				childArea -= child.bounds.SurfaceArea();
+			childCosts[c] = childArea + inheritanceCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+		index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+
+	// Put a new parent where the sibling was
+	unsigned int sibling = index;
+	unsigned int oldParent = nodes[sibling].parent;
+	unsigned int newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].bounds = Aabb::Union(leafBounds, nodes[sibling].bounds);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == NullNode)
+		root = newParent;
+	else if (nodes[oldParent].child1 == sibling)
+		nodes[oldParent].child1 = newParent;
+	else
+		nodes[oldParent].child2 = newParent;
+
+	Refit(newParent);
+}
+
+// Replaces the leaf's parent with its sibling
+void AabbTree::RemoveLeaf(unsigned int leaf)
+{
+	if (leaf == root)
+	{
+		root = NullNode;
+		return;
+	}
+
+	unsigned int parent = nodes[leaf].parent;
+	unsigned int grandParent = nodes[parent].parent;
+	unsigned int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	nodes[sibling].parent = grandParent;
+	FreeNode(parent);
+	nodes[leaf].parent = NullNode;
+
+	if (grandParent == NullNode)
+	{
+		root = sibling;
+		return;
+	}
+
+	if (nodes[grandParent].child1 == parent)
+		nodes[grandParent].child1 = sibling;
+	else
+		nodes[grandParent].child2 = sibling;
+	Refit(grandParent);
+}
+
+// Rebalances, then refits bounds and heights from a node up to the root
+void AabbTree::Refit(unsigned int index)
+{
+	while (index != NullNode)
+	{
+		index = Balance(index);
+
+		Node& node = nodes[index];
+		const Node& child1 = nodes[node.child1];
+		const Node& child2 = nodes[node.child2];
+		node.height = 1 + std::max(child1.height, child2.height);
+		node.bounds = Aabb::Union(child1.bounds, child2.bounds);
+
+		index = node.parent;
+	}
+}
+
+// --------------------------------------------------------
+// If one side of a node is two or more levels taller, its
+// taller child is rotated up into the node's place, and the
+// node keeps the shorter of that child's children - returns
+// whichever node is now where this one was
+// --------------------------------------------------------
+unsigned int AabbTree::Balance(unsigned int a)
+{
+	Node& nodeA = nodes[a];
+	if (nodeA.IsLeaf() || nodeA.height < 2)
+		return a;
+
+	unsigned int b = nodeA.child1;
+	unsigned int c = nodeA.child2;
+	int balance = nodes[c].height - nodes[b].height;
+	if (balance >= -1 && balance <= 1)
+		return a;
+
+	// up is the taller child, which takes a's place; stay is the
+	// other one, which a keeps
+	bool rotateC = balance > 1;
+	unsigned int up = rotateC ? c : b;
+	unsigned int stay = rotateC ? b : c;
+	Node& nodeUp = nodes[up];
+
+	unsigned int f = nodeUp.child1;
+	unsigned int g = nodeUp.child2;
+
+	nodeUp.child1 = a;
+	nodeUp.parent = nodeA.parent;
+	nodeA.parent = up;
+
+	if (nodeUp.parent == NullNode)
+		root = up;
+	else if (nodes[nodeUp.parent].child1 == a)
+		nodes[nodeUp.parent].child1 = up;
+	else
+		nodes[nodeUp.parent].child2 = up;
+
+	// The taller grandchild stays with up, the shorter moves to a
+	unsigned int keep = nodes[f].height > nodes[g].height ? f : g;
+	unsigned int give = keep == f ? g : f;
+	nodeUp.child2 = keep;
+	if (rotateC)
+		nodeA.child2 = give;
+	else
+		nodeA.child1 = give;
+	nodes[give].parent = a;
+
+	nodeA.bounds = Aabb::Union(nodes[stay].bounds, nodes[give].bounds);
+	nodeA.height = 1 + std::max(nodes[stay].height, nodes[give].height);
+	nodeUp.bounds = Aabb::Union(nodeA.bounds, nodes[keep].bounds);
+	nodeUp.height = 1 + std::max(nodeA.height, nodes[keep].height);
+	return up;
+}
+
+void AabbTree::Fatten(Aabb & bounds)
+{
+	bounds.min = XMFLOAT3(bounds.min.x - margin, bounds.min.y - margin, bounds.min.z - margin);
+	bounds.max = XMFLOAT3(bounds.max.x + margin, bounds.max.y + margin, bounds.max.z + margin);
+}
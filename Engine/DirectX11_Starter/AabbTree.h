@@ -0,0 +1,183 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Frustum.h"
+#include "MeshData.h"
+
+// --------------------------------------------------------
+// Axis aligned box, as its corners
+// --------------------------------------------------------
+struct Aabb
+{
+	DirectX::XMFLOAT3 min;
+	DirectX::XMFLOAT3 max;
+
+	// A mesh's bounds moved into world space by its (transposed,
+	// as stored for HLSL) world matrix
+	static Aabb FromBounds(const MeshBounds& bounds, const DirectX::XMFLOAT4X4& worldMatrix);
+	static Aabb FromSphere(const DirectX::XMFLOAT3& center, float radius);
+	static Aabb Union(const Aabb& a, const Aabb& b);
+
+	bool Contains(const Aabb& other) const;
+	bool Overlaps(const Aabb& other) const;
+	float SurfaceArea() const;
+
+	// distance is where the ray enters the box (0 if it starts
+	// inside) - false if it misses, or gets there past maxDistance
+	bool IntersectRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverseDirection, float maxDistance,
+		float& distance) const;
+};
+
+// --------------------------------------------------------
+// Bounding volume hierarchy over many boxes that move around,
+// for finding the few that a frustum, box, sphere or ray
+// touches without looking at all of them
+// - Each leaf keeps a "fat" box, a margin bigger than what was
+//   asked for - small moves stay inside it and change nothing
+// - New leaves go where they grow the tree's surface area the
+//   least, and rotations on the way back up keep both sides of
+//   every node within one level of each other
+// - Nodes live in one array with a free list, and queries use
+//   a stack kept between calls, so once it has warmed up
+//   nothing here touches the heap
+// - Queries give back every leaf whose fat box is touched - a
+//   broad phase, callers test the real shapes if they need to
+// --------------------------------------------------------
+class AabbTree
+{
+public:
+	static const unsigned int NullNode = 0xFFFFFFFF;
+
+	AabbTree(float margin = 0.1f);
+
+	void Clear();
+	void Reserve(unsigned int leafCount);
+
+	// Returns the leaf's handle - id is what queries give back for it
+	unsigned int Insert(const Aabb& bounds, unsigned int id);
+	void Remove(unsigned int leaf);
+
+	// Updates a leaf's box - returns false if it was still inside
+	// its fat box, so nothing changed
+	bool Move(unsigned int leaf, const Aabb& bounds);
+
+	unsigned int GetId(unsigned int leaf) { return nodes[leaf].id; }
+	const Aabb& GetFatBounds(unsigned int leaf) { return nodes[leaf].bounds; }
+	unsigned int GetLeafCount() { return leafCount; }
+
+	// Longest path from the root to a leaf (0 for a single leaf)
+	int GetHeight() { return root == NullNode ? 0 : nodes[root].height; }
+
+	// Total surface area of every node over the root's - lower
+	// means queries visit fewer nodes
+	float GetAreaRatio();
+
+	// Checks links, heights and that every node holds its children
+	// - for tests and benchmarks, it walks the whole tree
+	bool Validate();
+
+	// Each one replaces results with the ids of the leaves found,
+	// and returns how many there are
+	unsigned int QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results);
+	unsigned int QueryAabb(const Aabb& bounds, std::vector<unsigned int>& results);
+	unsigned int QuerySphere(const DirectX::XMFLOAT3& center, float radius, std::vector<unsigned int>& results);
+
+	// --------------------------------------------------------
+	// Walks the leaves whose boxes a ray hits, roughly nearest
+	// first, calling function(id, distance) with where the ray
+	// enters each box
+	// - function returns how far the ray still needs to go: a
+	//   closer hit returns its distance so farther boxes are
+	//   skipped, 0 stops, maxDistance carries on as before
+	// - direction doesn't need to be normalized; distances are
+	//   in multiples of it
+	// --------------------------------------------------------
+	template <typename Function>
+	void QueryRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, Function function)
+	{
+		if (root == NullNode)
+			return;
+
+		DirectX::XMFLOAT3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		float distance;
+		if (!nodes[root].bounds.IntersectRay(origin, inverse, maxDistance, distance))
+			return;
+
+		stack.clear();
+		stack.push_back(StackEntry{ root, 0 });
+		while (!stack.empty())
+		{
+			StackEntry entry = stack.back();
+			stack.pop_back();
+
+			// Boxes were hit when pushed, but the ray may have been
+			// shortened since
+			const Node& node = nodes[entry.node];
+			if (!node.bounds.IntersectRay(origin, inverse, maxDistance, distance))
+				continue;
+
+			if (node.IsLeaf())
+			{
+				maxDistance = function(node.id, distance);
+				if (maxDistance <= 0.0f)
+					return;
+				continue;
+			}
+
+			// Nearer child goes on top, so it's looked at first
+			float distance1, distance2;
+			bool hit1 = nodes[node.child1].bounds.IntersectRay(origin, inverse, maxDistance, distance1);
+			bool hit2 = nodes[node.child2].bounds.IntersectRay(origin, inverse, maxDistance, distance2);
+			if (hit1 && hit2 && distance1 < distance2)
+			{
+				stack.push_back(StackEntry{ node.child2, 0 });
+				stack.push_back(StackEntry{ node.child1, 0 });
+			}
+			else
+			{
+				if (hit1)
+					stack.push_back(StackEntry{ node.child1, 0 });
+				if (hit2)
+					stack.push_back(StackEntry{ node.child2, 0 });
+			}
+		}
+	}
+
+private:
+	// Leaves have no children; free nodes have a height of -1 and
+	// parent is the next free one
+	struct Node
+	{
+		Aabb bounds;
+		unsigned int parent;
+		unsigned int child1;
+		unsigned int child2;
+		int height;
+		unsigned int id;
+
+		bool IsLeaf() const { return child1 == NullNode; }
+	};
+
+	// planeMask is which frustum planes the node still straddles
+	struct StackEntry
+	{
+		unsigned int node;
+		unsigned int planeMask;
+	};
+
+	unsigned int AllocateNode();
+	void FreeNode(unsigned int node);
+	void InsertLeaf(unsigned int leaf);
+	void RemoveLeaf(unsigned int leaf);
+	void Refit(unsigned int node);
+	unsigned int Balance(unsigned int node);
+	void Fatten(Aabb& bounds);
+
+	std::vector<Node> nodes;
+	std::vector<StackEntry> stack;
+	unsigned int root;
+	unsigned int freeList;
+	unsigned int leafCount;
+	float margin;
+};
@@ -0,0 +1,222 @@
+#include "Archetype.h"
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+{
+	// Enough for SIMD types - components can't ask for more
+	const unsigned int ChunkAlignment = 64;
+
+	unsigned int AlignUp(unsigned int value, unsigned int alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	std::mutex registryMutex;
+
+	// Most components are a few floats - known sizes become plain
+	// loads and stores instead of a call into memcpy
+	inline void CopyComponent(void* destination, const void* source, unsigned int size)
+	{
+		switch (size)
+		{
+		case 4: memcpy(destination, source, 4); break;
+		case 8: memcpy(destination, source, 8); break;
+		case 12: memcpy(destination, source, 12); break;
+		case 16: memcpy(destination, source, 16); break;
+		default: memcpy(destination, source, size); break;
+		}
+	}
+}
+
+std::vector<ComponentInfo>& ComponentRegistry::GetInfos()
+{
+	static std::vector<ComponentInfo> infos;
+	return infos;
+}
+
+// Ids are handed out once per type, from whichever thread gets there first
+ComponentTypeId ComponentRegistry::Register(const ComponentInfo & info)
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	std::vector<ComponentInfo>& infos = GetInfos();
+	if (infos.empty())
+		infos.reserve(MaxComponentTypes);   // Never moves, so GetInfo() needs no lock
+	if (infos.size() >= MaxComponentTypes || info.alignment > ChunkAlignment)
+		throw std::length_error("Too many component types, or one aligned too strictly");
+
+	infos.push_back(info);
+	return (ComponentTypeId)infos.size() - 1;
+}
+
+
+// --------------------------------------------------------
+// Works out how many rows fit in a chunk, and where each
+// array starts - ids first, then components by type id
+// --------------------------------------------------------
+Archetype::Archetype(ComponentMask mask)
+{
+	this->mask = mask;
+	chunkCount = 0;
+	entityCount = 0;
+	memset(offsets, 0, sizeof(offsets));
+	memset(sizes, 0, sizeof(sizes));
+	trivial = true;
+	for (unsigned int i = 0; i < MaxComponentTypes; i++)
+		addEdges[i] = removeEdges[i] = -1;
+
+	unsigned int rowSize = sizeof(EntityId);
+	for (ComponentTypeId type = 0; type < MaxComponentTypes; type++)
+	{
+		if (mask & (1ull << type))
+		{
+			Column column;
+			column.type = type;
+			column.info = ComponentRegistry::GetInfo(type);
+			column.offset = 0;
+			columns.push_back(column);
+			sizes[type] = column.info.size;
+			trivial = trivial && column.info.trivial;
+			rowSize += column.info.size;
+		}
+	}
+
+	// Alignment padding can push the last array out - drop rows
+	// until it all fits. Even a single row has to be laid out, and
+	// one that can't fit at all is an error rather than a chunk
+	// whose arrays overlap
+	capacity = ChunkSize / rowSize;
+	for (; capacity > 0; capacity--)
+	{
+		unsigned int offset = sizeof(EntityId) * capacity;
+		for (auto& column : columns)
+		{
+			offset = AlignUp(offset, column.info.alignment);
+			column.offset = offsets[column.type] = offset;
+			offset += column.info.size * capacity;
+		}
+		if (offset <= ChunkSize)
+			break;
+	}
+	if (capacity == 0)
+		throw std::length_error("Components too large to fit one entity in a chunk");
+}
+
+Archetype::~Archetype()
+{
+	Clear();
+	for (auto& chunk : chunks)
+		delete[] chunk.allocation;
+}
+
+void Archetype::Allocate(EntityId id, unsigned int & chunk, unsigned int & row)
+{
+	if (chunkCount == 0 || chunks[chunkCount - 1].count == capacity)
+	{
+		if (chunkCount == chunks.size())
+		{
+			Chunk newChunk;
+			newChunk.allocation = new unsigned char[ChunkSize + ChunkAlignment];
+			newChunk.memory = newChunk.allocation + (ChunkAlignment - (size_t)newChunk.allocation % ChunkAlignment) % ChunkAlignment;
+			newChunk.count = 0;
+			chunks.push_back(newChunk);
+		}
+		chunkCount++;
+	}
+
+	chunk = chunkCount - 1;
+	row = chunks[chunk].count++;
+	GetIds(chunk)[row] = id;
+	entityCount++;
+}
+
+void Archetype::MoveRow(unsigned int chunk, unsigned int row, Archetype & target, unsigned int targetChunk, unsigned int targetRow)
+{
+	unsigned char* memory = chunks[chunk].memory;
+	unsigned char* targetMemory = target.chunks[targetChunk].memory;
+	for (auto& column : columns)
+	{
+		void* source = memory + column.offset + row * column.info.size;
+		if (!target.Has(column.type))
+		{
+			if (!column.info.trivial)
+				column.info.destroy(source);
+			continue;
+		}
+
+		void* destination = targetMemory + target.offsets[column.type] + targetRow * column.info.size;
+		if (column.info.trivial)
+			CopyComponent(destination, source, column.info.size);
+		else
+			column.info.moveConstruct(destination, source);
+	}
+}
+
+EntityId Archetype::Release(unsigned int chunk, unsigned int row)
+{
+	unsigned int lastChunk = chunkCount - 1;
+	unsigned int lastRow = chunks[lastChunk].count - 1;
+	EntityId moved = GetIds(lastChunk)[lastRow];
+
+	if (chunk != lastChunk || row != lastRow)
+	{
+		GetIds(chunk)[row] = moved;
+		unsigned char* memory = chunks[chunk].memory;
+		unsigned char* lastMemory = chunks[lastChunk].memory;
+		for (auto& column : columns)
+		{
+			void* destination = memory + column.offset + row * column.info.size;
+			void* source = lastMemory + column.offset + lastRow * column.info.size;
+			if (column.info.trivial)
+				CopyComponent(destination, source, column.info.size);
+			else
+				column.info.moveConstruct(destination, source);
+		}
+	}
+
+	// An emptied chunk stays where it is as a spare
+	if (--chunks[lastChunk].count == 0)
+		chunkCount--;
+	entityCount--;
+	return moved;
+}
+
+EntityId Archetype::Destroy(unsigned int chunk, unsigned int row)
+{
+	if (!trivial)
+		DestroyRow(chunk, row);
+	return Release(chunk, row);
+}
+
+void Archetype::Clear()
+{
+	for (unsigned int c = 0; c < chunkCount; c++)
+	{
+		if (!trivial)
+		{
+			for (unsigned int row = 0; row < chunks[c].count; row++)
+				DestroyRow(c, row);
+		}
+		chunks[c].count = 0;
+	}
+	chunkCount = 0;
+	entityCount = 0;
+}
+
+void Archetype::Trim()
+{
+	for (unsigned int c = chunkCount; c < chunks.size(); c++)
+		delete[] chunks[c].allocation;
+	chunks.resize(chunkCount);
+	chunks.shrink_to_fit();
+}
+
+void Archetype::DestroyRow(unsigned int chunk, unsigned int row)
+{
+	for (auto& column : columns)
+	{
+		if (!column.info.trivial)
+			column.info.destroy(chunks[chunk].memory + column.offset + row * column.info.size);
+	}
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Handle to an entity in its World - a slot index and that
+// slot's generation, see World.h
+typedef unsigned int EntityId;
+
+// Which component types something has, one bit per type
+typedef unsigned long long ComponentMask;
+typedef unsigned int ComponentTypeId;
+const unsigned int MaxComponentTypes = 64;
+
+// --------------------------------------------------------
+// How to handle one component type without knowing it -
+// archetypes only ever see these
+// --------------------------------------------------------
+struct ComponentInfo
+{
+	unsigned int size;
+	unsigned int alignment;
+	void(*moveConstruct)(void* destination, void* source);   // Also destroys source
+	void(*destroy)(void* component);
+	bool trivial;   // Plain memcpy to move, nothing to destroy
+};
+
+// --------------------------------------------------------
+// Gives every component type a small id the first time it's
+// used - ids are the same for every World in the program
+// --------------------------------------------------------
+class ComponentRegistry
+{
+public:
+	template <typename T>
+	static ComponentTypeId GetId()
+	{
+		static const ComponentTypeId id = Register(MakeInfo<T>());
+		return id;
+	}
+
+	static const ComponentInfo& GetInfo(ComponentTypeId id) { return GetInfos()[id]; }
+
+private:
+	template <typename T>
+	static void MoveConstruct(void* destination, void* source)
+	{
+		T* from = static_cast<T*>(source);
+		new (destination) T(std::move(*from));
+		from->~T();
+	}
+
+	template <typename T>
+	static void Destroy(void* component)
+	{
+		static_cast<T*>(component)->~T();
+	}
+
+	template <typename T>
+	static ComponentInfo MakeInfo()
+	{
+		ComponentInfo info;
+		info.size = sizeof(T);
+		info.alignment = alignof(T);
+		info.moveConstruct = &MoveConstruct<T>;
+		info.destroy = &Destroy<T>;
+		info.trivial = std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value;
+		return info;
+	}
+
+	static ComponentTypeId Register(const ComponentInfo& info);
+	static std::vector<ComponentInfo>& GetInfos();
+};
+
+// --------------------------------------------------------
+// Every entity with exactly the same set of components, stored
+// in fixed size chunks
+// - Each chunk holds an array per component (and one of entity
+//   ids), so a query walks memory in a straight line
+// - Rows are packed: removing one moves the very last row into
+//   the hole, so every chunk but the last is full and there are
+//   never gaps to skip
+// - Emptied chunks are kept for reuse, so entities coming and
+//   going doesn't touch the heap once it's warmed up
+// --------------------------------------------------------
+class Archetype
+{
+public:
+	static const unsigned int ChunkSize = 16 * 1024;
+
+	Archetype(ComponentMask mask);
+	~Archetype();
+
+	// Not copyable - the object owns the chunks
+	Archetype(Archetype const&) = delete;
+	void operator=(Archetype const&) = delete;
+
+	struct Chunk
+	{
+		unsigned char* memory;     // ChunkSize bytes, aligned for any component
+		unsigned char* allocation;
+		unsigned int count;
+	};
+
+	ComponentMask GetMask() { return mask; }
+	bool Has(ComponentTypeId type) { return (mask & (1ull << type)) != 0; }
+
+	unsigned int GetChunkCount() { return chunkCount; }
+	unsigned int GetChunkCapacity() { return capacity; }
+	unsigned int GetEntityCount() { return entityCount; }
+	Chunk& GetChunk(unsigned int chunk) { return chunks[chunk]; }
+
+	// The id array and component arrays of a chunk - components
+	// must be part of this archetype
+	EntityId* GetIds(unsigned int chunk) { return reinterpret_cast<EntityId*>(chunks[chunk].memory); }
+	void* GetComponents(unsigned int chunk, ComponentTypeId type) { return chunks[chunk].memory + offsets[type]; }
+	void* GetComponent(unsigned int chunk, unsigned int row, ComponentTypeId type)
+	{
+		return chunks[chunk].memory + offsets[type] + row * sizes[type];
+	}
+
+	// Adds a row at the end, with its components left unconstructed
+	// - the caller constructs them (or moves them in with MoveRow)
+	void Allocate(EntityId id, unsigned int& chunk, unsigned int& row);
+
+	// Moves a row's components into a row of another archetype -
+	// ones the other doesn't have are destroyed, and ones only it
+	// has are left for the caller to construct
+	void MoveRow(unsigned int chunk, unsigned int row, Archetype& target, unsigned int targetChunk, unsigned int targetRow);
+
+	// Frees a row whose components were moved out or destroyed, by
+	// moving the last row into it - returns the id of the entity
+	// that moved there, or the freed one if it was the last row
+	EntityId Release(unsigned int chunk, unsigned int row);
+
+	// Destroys a row's components, then releases it
+	EntityId Destroy(unsigned int chunk, unsigned int row);
+
+	// Destroys every row at once, keeping the chunks as spares
+	void Clear();
+
+	// Frees the spare chunks
+	void Trim();
+
+	// Archetypes one component away, found the first time and
+	// remembered - -1 until then
+	int addEdges[MaxComponentTypes];
+	int removeEdges[MaxComponentTypes];
+
+private:
+	// What each component type in here needs, copied out of the
+	// registry so moving rows doesn't go looking for it
+	struct Column
+	{
+		ComponentTypeId type;
+		ComponentInfo info;
+		unsigned int offset;
+	};
+
+	void DestroyRow(unsigned int chunk, unsigned int row);
+
+	ComponentMask mask;
+	std::vector<Column> columns;
+	unsigned int offsets[MaxComponentTypes];
+	unsigned int sizes[MaxComponentTypes];
+	unsigned int capacity;
+	bool trivial;   // Every column is - destroying a row is a no-op
+
+	// Chunks in use come first; the rest are empty spares
+	std::vector<Chunk> chunks;
+	unsigned int chunkCount;
+	unsigned int entityCount;
+};
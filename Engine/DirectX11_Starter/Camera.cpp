@@ -1,4 +1,5 @@
 #include "Camera.h"
+#include <cstring>
 
 
 
@@ -12,6 +13,9 @@ Camera::Camera()
 	forward = XMFLOAT3(0.0f, 0.0f, 1.0f);
 	pitch = 0.0f; 
 	yaw = 0.0f; 
+	nearPlane = 0.1f;
+	farPlane = 100.0f;
+	frustumDirty = true;
 	XMMATRIX rotMat = XMLoadFloat4x4(&rotationMatrix); 
 	rotMat = XMMatrixIdentity(); 
 	XMStoreFloat4x4(&rotationMatrix, rotMat); 
@@ -38,9 +42,10 @@ void Camera::onResize(float aspectRatio)
 	XMMATRIX P = XMMatrixPerspectiveFovLH(
 		0.25f * 3.1415926535f,	// Field of View Angle
 		aspectRatio,		  	// Aspect ratio
-		0.1f,				  	// Near clip plane distance
-		100.0f);			  	// Far clip plane distance
+		nearPlane,			  	// Near clip plane distance
+		farPlane);			  	// Far clip plane distance
 	XMStoreFloat4x4(&projectionMatrix, XMMatrixTranspose(P)); // Transpose for HLSL!
+	frustumDirty = true;
 }
 
 void Camera::update(float deltaTime)
@@ -55,7 +60,15 @@ void Camera::update(float deltaTime)
 	XMVECTOR camPos = XMLoadFloat3(&position);
 	XMMATRIX viewMat = XMLoadFloat4x4(&viewMatrix);
 	viewMat = XMMatrixLookToLH(camPos, camForward, camUp); 
-	XMStoreFloat4x4(&viewMatrix, XMMatrixTranspose(viewMat)); 
+
+	// A camera that didn't move keeps its frustum
+	XMFLOAT4X4 newView;
+	XMStoreFloat4x4(&newView, XMMatrixTranspose(viewMat)); 
+	if (memcmp(&newView, &viewMatrix, sizeof(newView)) != 0)
+	{
+		viewMatrix = newView;
+		frustumDirty = true;
+	}
 
 
 }
@@ -189,14 +202,41 @@ XMFLOAT3 Camera::getPosition()
 	return position;
 }
 
+// --------------------------------------------------------
+// View * projection - both are stored transposed for HLSL,
+// so they're transposed back first
+// --------------------------------------------------------
+XMFLOAT4X4 Camera::getViewProjectionMatrix()
+{
+	XMMATRIX viewProjection =
+		XMMatrixTranspose(XMLoadFloat4x4(&viewMatrix)) *
+		XMMatrixTranspose(XMLoadFloat4x4(&projectionMatrix));
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, viewProjection);
+	return result;
+}
+
+const Frustum& Camera::getFrustum()
+{
+	if (frustumDirty)
+	{
+		frustum = Frustum::FromMatrix(getViewProjectionMatrix());
+		frustumDirty = false;
+	}
+	return frustum;
+}
+
 void Camera::setProjectionMatrix(XMFLOAT4X4 newMat)
 {
 	projectionMatrix = newMat; 
+	frustumDirty = true;
 }
 
 void Camera::setViewMatrix(XMFLOAT4X4 newMat)
 {
 	viewMatrix = newMat; 
+	frustumDirty = true;
 }
 
 void Camera::setPitch(float newPitch)
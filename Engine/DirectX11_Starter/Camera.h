@@ -3,6 +3,7 @@
 #include <DirectXMath.h>
 #include "Vertex.h"
 #include "DirectXGameCore.h"
+#include "Frustum.h"
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <d3d11.h>
@@ -38,6 +39,10 @@ public:
 	XMFLOAT3 getLeft(); 
 	XMFLOAT3 getDirection(); 
 	XMFLOAT3 getPosition(); 
+	float getNearPlane() { return nearPlane; }
+	float getFarPlane() { return farPlane; }
+	XMFLOAT4X4 getViewProjectionMatrix();   // Not transposed - what Frustum::FromMatrix takes
+	const Frustum& getFrustum();   // World space, rebuilt only after the view or projection changed
 	void setProjectionMatrix(XMFLOAT4X4 newMat); 
 	void setViewMatrix(XMFLOAT4X4 newMat); 
 	void setPitch(float newPitch); 
@@ -55,6 +60,10 @@ private:
 	XMFLOAT3 direction; 
 	float pitch; 
 	float yaw; 
+	float nearPlane;
+	float farPlane;
+	Frustum frustum;
+	bool frustumDirty;
 	
 };
 
@@ -0,0 +1,62 @@
+#pragma once
+#include "MeshCache.h"
+#include "Material.h"
+#include "MeshletBuilder.h"
+#include "OcclusionCuller.h"
+#include "TransformStore.h"
+
+// --------------------------------------------------------
+// The engine's own components - see World.h
+// --------------------------------------------------------
+
+// --------------------------------------------------------
+// An entity's slot in a TransformStore - it owns the slot, so
+// destroying the entity (or removing this) gives it back
+// --------------------------------------------------------
+struct TransformComponent
+{
+	TransformStore* store;
+	unsigned int index;
+
+	TransformComponent() : store(nullptr), index(0) {}
+	explicit TransformComponent(TransformStore* store) : store(store), index(store->Add()) {}
+	~TransformComponent()
+	{
+		if (store)
+			store->Remove(index);
+	}
+
+	// Moves hand the slot over; copies would free it twice
+	TransformComponent(TransformComponent&& other) : store(other.store), index(other.index) { other.store = nullptr; }
+	TransformComponent& operator=(TransformComponent&& other)
+	{
+		std::swap(store, other.store);
+		std::swap(index, other.index);
+		return *this;
+	}
+	TransformComponent(TransformComponent const&) = delete;
+	void operator=(TransformComponent const&) = delete;
+};
+
+// What an entity is drawn with
+struct RenderComponent
+{
+	MeshHandle mesh;      // Shared - entities using the same file share one Mesh
+	Material* material;
+	int lod;
+	bool tooSmall;        // LodSelector dropped it last frame - kept for its hysteresis
+	MeshletCullStats cullStats;
+
+	RenderComponent() : material(nullptr), lod(0), tooSmall(false), cullStats() {}
+	RenderComponent(MeshHandle mesh, Material* material) : mesh(mesh), material(material), lod(0), tooSmall(false), cullStats() {}
+};
+
+// Something other things hide behind - drawn into the
+// OcclusionCuller's depth buffer with the entity's transform
+struct OccluderComponent
+{
+	std::shared_ptr<const OccluderMesh> mesh;
+
+	OccluderComponent() {}
+	explicit OccluderComponent(std::shared_ptr<const OccluderMesh> mesh) : mesh(mesh) {}
+};
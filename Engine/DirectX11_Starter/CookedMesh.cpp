@@ -0,0 +1,321 @@
+#include "CookedMesh.h"
+#include "MeshBuilder.h"
+#include <fstream>
+
+namespace
+{
+	inline unsigned int AlignUp(unsigned int value)
+	{
+		return (value + CookedMeshAlignment - 1) & ~(CookedMeshAlignment - 1);
+	}
+
+	// Writes zeros up to the next aligned offset
+	void Pad(std::ofstream& out, unsigned int& offset)
+	{
+		static const char zeros[CookedMeshAlignment] = {};
+		unsigned int aligned = AlignUp(offset);
+		out.write(zeros, aligned - offset);
+		offset = aligned;
+	}
+}
+
+
+CookedMesh::CookedMesh()
+{
+	header = nullptr;
+	sections = nullptr;
+	vertices = nullptr;
+	indices = nullptr;
+	lods = nullptr;
+	lodCount = 0;
+	meshlets = nullptr;
+	meshletCount = 0;
+}
+
+
+CookedMesh::~CookedMesh()
+{
+	Close();
+}
+
+// --------------------------------------------------------
+// Writes the header, the section table, and then every
+// section on its own aligned boundary
+// --------------------------------------------------------
+bool CookedMesh::Write(const char * filename, const MeshData & data)
+{
+	if (data.vertices.empty() || data.indices.empty())
+		return false;
+
+	const unsigned int sectionCount = 2 + (data.lods.empty() ? 0 : 1) + (data.meshlets.empty() ? 0 : 1);
+
+	CookedMeshHeader fileHeader = {};
+	fileHeader.magic = CookedMeshMagic;
+	fileHeader.version = CookedMeshVersion;
+	fileHeader.headerSize = sizeof(CookedMeshHeader);
+	fileHeader.sectionCount = sectionCount;
+	fileHeader.vertexStride = sizeof(Vertex);
+	fileHeader.vertexCount = (unsigned int)data.vertices.size();
+	fileHeader.indexCount = (unsigned int)data.indices.size();
+	fileHeader.indexStride = VertexCompressor::CanUse16BitIndices(data.vertices.size()) ? sizeof(unsigned short) : sizeof(unsigned int);
+	fileHeader.bounds = MeshBuilder::ComputeBounds(&data.vertices[0], data.vertices.size());
+
+	// Lay out the sections
+	CookedMeshSection table[4];
+	unsigned int tableSize = sizeof(CookedMeshSection) * sectionCount;
+	unsigned int offset = AlignUp(sizeof(CookedMeshHeader) + tableSize);
+
+	table[0].type = COOKED_SECTION_VERTICES;
+	table[0].count = fileHeader.vertexCount;
+	table[0].offset = offset;
+	table[0].size = sizeof(Vertex) * fileHeader.vertexCount;
+	offset = AlignUp(offset + table[0].size);
+
+	table[1].type = COOKED_SECTION_INDICES;
+	table[1].count = fileHeader.indexCount;
+	table[1].offset = offset;
+	table[1].size = fileHeader.indexStride * fileHeader.indexCount;
+	offset = AlignUp(offset + table[1].size);
+
+	unsigned int optional = 2;
+	if (!data.lods.empty())
+	{
+		table[optional].type = COOKED_SECTION_LODS;
+		table[optional].count = (unsigned int)data.lods.size();
+		table[optional].offset = offset;
+		table[optional].size = sizeof(MeshLod) * table[optional].count;
+		offset = AlignUp(offset + table[optional].size);
+		optional++;
+	}
+
+	if (!data.meshlets.empty())
+	{
+		table[optional].type = COOKED_SECTION_MESHLETS;
+		table[optional].count = (unsigned int)data.meshlets.size();
+		table[optional].offset = offset;
+		table[optional].size = sizeof(Meshlet) * table[optional].count;
+	}
+
+	std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+
+	unsigned int written = 0;
+	out.write((const char*)&fileHeader, sizeof(fileHeader));
+	out.write((const char*)table, tableSize);
+	written += sizeof(fileHeader) + tableSize;
+	Pad(out, written);
+
+	out.write((const char*)&data.vertices[0], table[0].size);
+	written += table[0].size;
+	Pad(out, written);
+
+	if (fileHeader.indexStride == sizeof(unsigned short))
+	{
+		std::vector<unsigned short> shortIndices(data.indices.begin(), data.indices.end());
+		out.write((const char*)&shortIndices[0], table[1].size);
+	}
+	else
+	{
+		out.write((const char*)&data.indices[0], table[1].size);
+	}
+	written += table[1].size;
+
+	optional = 2;
+	if (!data.lods.empty())
+	{
+		Pad(out, written);
+		out.write((const char*)&data.lods[0], table[optional].size);
+		written += table[optional].size;
+		optional++;
+	}
+
+	if (!data.meshlets.empty())
+	{
+		Pad(out, written);
+		out.write((const char*)&data.meshlets[0], table[optional].size);
+	}
+
+	return out.good();
+}
+
+// --------------------------------------------------------
+// Maps the file and checks that everything it claims to hold
+// actually fits inside it
+// - Every index is checked against the vertex count too, since
+//   the CPU reads vertices through them (Mesh's triangle BVH),
+//   so a corrupt or stale file can't read past the buffer
+// --------------------------------------------------------
+bool CookedMesh::Open(const char * filename)
+{
+	Close();
+
+	if (!file.Open(filename))
+		return false;
+
+	const char* base = file.GetData();
+	size_t size = file.GetSize();
+
+	// Check the header
+	if (size < sizeof(CookedMeshHeader))
+	{
+		Close();
+		return false;
+	}
+
+	const CookedMeshHeader* fileHeader = (const CookedMeshHeader*)base;
+	if (fileHeader->magic != CookedMeshMagic ||
+		fileHeader->version != CookedMeshVersion ||
+		fileHeader->headerSize != sizeof(CookedMeshHeader) ||
+		fileHeader->vertexStride != sizeof(Vertex) ||
+		(fileHeader->indexStride != sizeof(unsigned short) && fileHeader->indexStride != sizeof(unsigned int)))
+	{
+		Close();
+		return false;
+	}
+
+	// Check the section table
+	size_t tableEnd = sizeof(CookedMeshHeader) + (size_t)fileHeader->sectionCount * sizeof(CookedMeshSection);
+	if (tableEnd > size)
+	{
+		Close();
+		return false;
+	}
+
+	header = fileHeader;
+	sections = (const CookedMeshSection*)(base + sizeof(CookedMeshHeader));
+
+	for (unsigned int i = 0; i < header->sectionCount; i++)
+	{
+		const CookedMeshSection& section = sections[i];
+		if (section.offset % CookedMeshAlignment != 0 ||
+			(size_t)section.offset + section.size > size)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	// The vertex and index sections are required
+	const CookedMeshSection* vertexSection = FindSection(COOKED_SECTION_VERTICES);
+	const CookedMeshSection* indexSection = FindSection(COOKED_SECTION_INDICES);
+	if (!vertexSection || !indexSection ||
+		header->indexCount % 3 != 0 ||
+		vertexSection->count != header->vertexCount ||
+		vertexSection->size != header->vertexCount * sizeof(Vertex) ||
+		indexSection->count != header->indexCount ||
+		indexSection->size != header->indexCount * header->indexStride)
+	{
+		Close();
+		return false;
+	}
+
+	vertices = (const Vertex*)(base + vertexSection->offset);
+	indices = base + indexSection->offset;
+
+	unsigned int largest = 0;
+	if (header->indexStride == sizeof(unsigned short))
+	{
+		const unsigned short* shortIndices = (const unsigned short*)indices;
+		for (unsigned int i = 0; i < header->indexCount; i++)
+			largest = shortIndices[i] > largest ? shortIndices[i] : largest;
+	}
+	else
+	{
+		const unsigned int* longIndices = (const unsigned int*)indices;
+		for (unsigned int i = 0; i < header->indexCount; i++)
+			largest = longIndices[i] > largest ? longIndices[i] : largest;
+	}
+	if (header->indexCount > 0 && largest >= header->vertexCount)
+	{
+		Close();
+		return false;
+	}
+
+	// Levels of detail are optional, but must stay in the index buffer
+	const CookedMeshSection* lodSection = FindSection(COOKED_SECTION_LODS);
+	if (lodSection)
+	{
+		if (lodSection->size != lodSection->count * sizeof(MeshLod))
+		{
+			Close();
+			return false;
+		}
+
+		lods = (const MeshLod*)(base + lodSection->offset);
+		lodCount = lodSection->count;
+		for (unsigned int i = 0; i < lodCount; i++)
+		{
+			if ((unsigned long long)lods[i].indexStart + lods[i].indexCount > header->indexCount ||
+				lods[i].indexStart % 3 != 0 || lods[i].indexCount % 3 != 0)
+			{
+				Close();
+				return false;
+			}
+		}
+	}
+
+	// Same for meshlets, which only ever cover level 0
+	const CookedMeshSection* meshletSection = FindSection(COOKED_SECTION_MESHLETS);
+	if (meshletSection)
+	{
+		unsigned long long levelEnd = lodCount > 0 ? (unsigned long long)lods[0].indexStart + lods[0].indexCount : header->indexCount;
+
+		if (meshletSection->size != meshletSection->count * sizeof(Meshlet))
+		{
+			Close();
+			return false;
+		}
+
+		meshlets = (const Meshlet*)(base + meshletSection->offset);
+		meshletCount = meshletSection->count;
+		for (unsigned int i = 0; i < meshletCount; i++)
+		{
+			if ((unsigned long long)meshlets[i].indexStart + meshlets[i].indexCount > levelEnd ||
+				meshlets[i].indexStart % 3 != 0 || meshlets[i].indexCount % 3 != 0)
+			{
+				Close();
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void CookedMesh::Close()
+{
+	file.Close();
+	header = nullptr;
+	sections = nullptr;
+	vertices = nullptr;
+	indices = nullptr;
+	lods = nullptr;
+	lodCount = 0;
+	meshlets = nullptr;
+	meshletCount = 0;
+}
+
+void CookedMesh::CopyIndices(std::vector<unsigned int>& out)
+{
+	unsigned int count = GetIndexCount();
+	if (GetIndexStride() == sizeof(unsigned short))
+		out.assign((const unsigned short*)indices, (const unsigned short*)indices + count);
+	else if (count > 0)
+		out.assign((const unsigned int*)indices, (const unsigned int*)indices + count);
+	else
+		out.clear();
+}
+
+const CookedMeshSection * CookedMesh::FindSection(unsigned int type)
+{
+	if (!header)
+		return nullptr;
+
+	for (unsigned int i = 0; i < header->sectionCount; i++)
+	{
+		if (sections[i].type == type)
+			return &sections[i];
+	}
+	return nullptr;
+}
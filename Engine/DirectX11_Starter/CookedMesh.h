@@ -0,0 +1,105 @@
+#pragma once
+
+#include "MeshData.h"
+#include "MappedFile.h"
+
+// --------------------------------------------------------
+// Cooked (binary) mesh files - ".cmesh"
+//
+// Layout:
+//   CookedMeshHeader
+//   CookedMeshSection[sectionCount]
+//   section data, each section starting on a
+//   CookedMeshAlignment byte boundary
+//
+// The file is memory mapped and the sections are handed to
+// CreateBuffer as-is, so there is no parsing and no copying
+// into intermediate vectors at load time. Indices are written
+// 16-bit whenever the vertex count allows, which is what the
+// GPU gets anyway.
+// --------------------------------------------------------
+const unsigned int CookedMeshMagic = 0x48534D43;  // "CMSH"
+const unsigned int CookedMeshVersion = 3;        // Bumped whenever sections are added or change
+const unsigned int CookedMeshAlignment = 64;
+
+enum CookedMeshSectionType
+{
+	COOKED_SECTION_VERTICES = 1,   // Vertex[vertexCount]
+	COOKED_SECTION_INDICES = 2,    // indexCount indices, indexStride bytes each
+	COOKED_SECTION_LODS = 3,       // MeshLod[count], optional
+	COOKED_SECTION_MESHLETS = 4    // Meshlet[count], optional
+};
+
+struct CookedMeshHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int headerSize;       // sizeof(CookedMeshHeader)
+	unsigned int sectionCount;
+	unsigned int vertexStride;     // sizeof(Vertex) when cooked
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int indexStride;      // 2 under 65536 vertices, otherwise 4
+	MeshBounds bounds;
+};
+
+struct CookedMeshSection
+{
+	unsigned int type;             // CookedMeshSectionType
+	unsigned int count;            // Number of elements
+	unsigned int offset;           // Bytes from the start of the file
+	unsigned int size;             // Bytes
+};
+
+// --------------------------------------------------------
+// Reads and writes cooked mesh files
+// --------------------------------------------------------
+class CookedMesh
+{
+public:
+	CookedMesh();
+	~CookedMesh();
+
+	// Writes mesh data (already welded/optimized) to disk
+	static bool Write(const char* filename, const MeshData& data);
+
+	// Maps and validates a cooked file - pointers returned by
+	// the getters stay valid until Close() or destruction
+	bool Open(const char* filename);
+	void Close();
+	bool IsOpen() { return header != nullptr; }
+
+	const CookedMeshHeader* GetHeader() { return header; }
+	const Vertex* GetVertices() { return vertices; }
+	const void* GetIndices() { return indices; }
+	unsigned int GetIndexStride() { return header ? header->indexStride : 0; }
+	unsigned int GetVertexCount() { return header ? header->vertexCount : 0; }
+	unsigned int GetIndexCount() { return header ? header->indexCount : 0; }
+
+	// Widens the indices to 32-bit, for code that wants MeshData
+	void CopyIndices(std::vector<unsigned int>& out);
+	MeshBounds GetBounds() { return header->bounds; }
+
+	// Detail levels - files without a LOD section have none, in
+	// which case the whole index buffer is a single level
+	const MeshLod* GetLods() { return lods; }
+	unsigned int GetLodCount() { return lodCount; }
+
+	// Meshlets (covering level 0), if the file was cooked with them
+	const Meshlet* GetMeshlets() { return meshlets; }
+	unsigned int GetMeshletCount() { return meshletCount; }
+
+	// Finds a section by type, or nullptr if the file has none
+	const CookedMeshSection* FindSection(unsigned int type);
+
+private:
+	MappedFile file;
+	const CookedMeshHeader* header;
+	const CookedMeshSection* sections;
+	const Vertex* vertices;
+	const void* indices;
+	const MeshLod* lods;
+	unsigned int lodCount;
+	const Meshlet* meshlets;
+	unsigned int meshletCount;
+};
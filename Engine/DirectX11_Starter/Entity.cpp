@@ -1,74 +1,166 @@
 #include "Entity.h"
 
-Entity::~Entity()
+namespace
 {
+	// Visible meshlet ranges of whatever is being drawn - shared,
+	// so entities don't each carry a vector around
+	std::vector<IndexRange> visibleRanges;
 }
 
-Entity::Entity(Mesh * inputMesh, Material* inputMaterial)
+Entity Entity::Create(World* world, TransformStore* transforms, MeshHandle mesh, Material* material)
 {
-	mesh = inputMesh; 
-	material = inputMaterial; 
-	XMStoreFloat4x4(&worldMatrix, XMMatrixIdentity());
-	position = XMFLOAT3(0, 0, 0);
-	rotation = XMFLOAT3(0, 0, 0);
-	scale = XMFLOAT3(1, 1, 1);
+	return Entity(world, world->Create(TransformComponent(transforms), RenderComponent(mesh, material)));
 }
 
+// Its transform slot goes back to the store along with it
+void Entity::Destroy()
+{
+	world->Destroy(id);
+	world = nullptr;
+}
+
+// --------------------------------------------------------
+// Rebuilds just this entity's world matrix - when many have
+// moved, TransformStore::UpdateWorldMatrices() does them all
+// several at a time
+// --------------------------------------------------------
 void Entity::updateScene()
 {
-	//mtx.lock();
-	//update mesh if at all
-	//Update world matrix by multiplying matrices 
-	XMMATRIX trans = XMMatrixTranslation(position.x, position.y, position.z);
-	XMMATRIX rotX = XMMatrixRotationX(rotation.x);
-	XMMATRIX rotY = XMMatrixRotationY(rotation.y);
-	XMMATRIX rotZ = XMMatrixRotationZ(rotation.z);
-	XMMATRIX sc = XMMatrixScaling(scale.x, scale.y, scale.z);
-
-	XMMATRIX total = sc * rotZ * rotY * rotX * trans;
-	XMStoreFloat4x4(&worldMatrix, XMMatrixTranspose(total));
-	//mtx.unlock();
+	Transform().store->UpdateWorldMatrix(Transform().index);
+}
+
+// Its transform becomes relative to the parent's from now on
+bool Entity::SetParent(Entity parent)
+{
+	TransformComponent& transform = Transform();
+	return transform.store->SetParent(transform.index, parent.world ? parent.Transform().index : TransformStore::NoParent);
+}
+
+void Entity::Move(float x, float y, float z)
+{
+	XMFLOAT3 position = GetPosition();
+	SetPosition(position.x + x, position.y + y, position.z + z);
+}
+
+void Entity::Rotate(float x, float y, float z)
+{
+	SetRotation(TransformStore::QuaternionMultiply(TransformStore::QuaternionFromEuler(x, y, z), GetRotation()));
+}
+
+void Entity::Scale(float x, float y, float z)
+{
+	XMFLOAT3 scale = GetScale();
+	SetScale(scale.x + x, scale.y + y, scale.z + z);
 }
 
 void Entity::drawScene(ID3D11DeviceContext * deviceContext)
 {
-	UINT stride = sizeof(Vertex);
+	RenderComponent& render = Render();
+
+	// The mesh may still be loading
+	if (render.mesh == nullptr)
+		return;
+
+	UINT stride = render.mesh->GetVertexStride();
 	UINT offset = 0;
 
-	ID3D11Buffer* tempBuffer = this->mesh->GetVertexBuffer();
+	ID3D11Buffer* tempBuffer = render.mesh->GetVertexBuffer();
 
 	deviceContext->IASetVertexBuffers(0, 1, &tempBuffer, &stride, &offset);
-	deviceContext->IASetIndexBuffer(this->mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
+	deviceContext->IASetIndexBuffer(render.mesh->GetIndexBuffer(), render.mesh->GetIndexFormat(), 0);
 
 	// Finally do the actual drawing
 	//  - Do this ONCE PER OBJECT you intend to draw
 	//  - This will use all of the currently set DirectX "stuff" (shaders, buffers, etc)
 	//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 	//     vertices in the currently set VERTEX BUFFER
+	//  - Every level of detail is a range of the same index buffer
+	MeshLod level = render.mesh->GetLod(render.lod);
 	deviceContext->DrawIndexed(
-		this->mesh->GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
-		0,     // Offset to the first index we want to use
+		level.indexCount,     // The number of indices to use (we could draw a subset if we wanted)
+		level.indexStart,     // Offset to the first index we want to use
 		0);    // Offset to add to each index when looking up vertices
 }
 
+// --------------------------------------------------------
+// Same as above, but meshes with meshlets only draw the
+// clusters the camera can actually see
+// - Only level 0 has meshlets; other levels draw as usual
+// --------------------------------------------------------
+void Entity::drawScene(ID3D11DeviceContext * deviceContext, Camera * camera)
+{
+	RenderComponent& render = Render();
+
+	if (render.mesh == nullptr)
+		return;
+
+	if (render.lod != 0 || render.mesh->GetMeshletCount() == 0)
+	{
+		drawScene(deviceContext);
+		return;
+	}
+
+	// Cull in object space - the planes of world * view * projection
+	// and the camera moved by the inverse world matrix (the stored
+	// matrices are transposed for HLSL, so undo that first)
+	XMFLOAT4X4 view = camera->getViewMatrix();
+	XMFLOAT4X4 projection = camera->getProjectionMatrix();
+	XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(GetWorldMatrix()));
+	XMMATRIX worldViewProjection = world *
+		XMMatrixTranspose(XMLoadFloat4x4(&view)) *
+		XMMatrixTranspose(XMLoadFloat4x4(&projection));
+
+	XMFLOAT4X4 cullMatrix;
+	XMStoreFloat4x4(&cullMatrix, worldViewProjection);
+	Frustum frustum = Frustum::FromMatrix(cullMatrix);
+
+	XMFLOAT3 cameraPosition = camera->getPosition();
+	XMFLOAT3 localCamera;
+	XMStoreFloat3(&localCamera, XMVector3TransformCoord(XMLoadFloat3(&cameraPosition), XMMatrixInverse(nullptr, world)));
+
+	MeshletBuilder::Cull(render.mesh->GetMeshlets(), render.mesh->GetMeshletCount(), frustum, localCamera, visibleRanges, &render.cullStats);
+	if (visibleRanges.empty())
+		return;
+
+	UINT stride = render.mesh->GetVertexStride();
+	UINT offset = 0;
+
+	ID3D11Buffer* tempBuffer = render.mesh->GetVertexBuffer();
+
+	deviceContext->IASetVertexBuffers(0, 1, &tempBuffer, &stride, &offset);
+	deviceContext->IASetIndexBuffer(render.mesh->GetIndexBuffer(), render.mesh->GetIndexFormat(), 0);
+
+	// Neighboring visible meshlets were merged, so this is one
+	// draw per run of visible clusters
+	for (auto& range : visibleRanges)
+		deviceContext->DrawIndexed(range.indexCount, range.indexStart, 0);
+}
+
 void Entity::drawDeferred(ID3D11DeviceContext * deferredContext, ID3D11CommandList* commandList)
 {
-	UINT stride = sizeof(Vertex);
+	RenderComponent& render = Render();
+
+	if (render.mesh == nullptr)
+		return;
+
+	UINT stride = render.mesh->GetVertexStride();
 	UINT offset = 0;
 
-	ID3D11Buffer* tempBuffer = this->mesh->GetVertexBuffer();
+	ID3D11Buffer* tempBuffer = render.mesh->GetVertexBuffer();
 
 	deferredContext->IASetVertexBuffers(0, 1, &tempBuffer, &stride, &offset);
-	deferredContext->IASetIndexBuffer(this->mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
+	deferredContext->IASetIndexBuffer(render.mesh->GetIndexBuffer(), render.mesh->GetIndexFormat(), 0);
 
 	// Finally do the actual drawing
 	//  - Do this ONCE PER OBJECT you intend to draw
 	//  - This will use all of the currently set DirectX "stuff" (shaders, buffers, etc)
 	//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 	//     vertices in the currently set VERTEX BUFFER
+	//  - Every level of detail is a range of the same index buffer
+	MeshLod level = render.mesh->GetLod(render.lod);
 	deferredContext->DrawIndexed(
-		this->mesh->GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
-		0,     // Offset to the first index we want to use
+		level.indexCount,     // The number of indices to use (we could draw a subset if we wanted)
+		level.indexStart,     // Offset to the first index we want to use
 		0);    // Offset to add to each index when looking up vertices
 
 	// Add rendering code to command list 
@@ -80,11 +172,31 @@ void Entity::drawDeferred(ID3D11DeviceContext * deferredContext, ID3D11CommandLi
 
 void Entity::prepareMaterial(XMFLOAT4X4 view, XMFLOAT4X4 proj)
 {
+	prepareMaterial(view, proj, Render().material->vertexShader);
+}
+
+// --------------------------------------------------------
+// Same, but with a different vertex shader and the material's
+// pixel shader - packed meshes need one that decodes them
+// --------------------------------------------------------
+void Entity::prepareMaterial(XMFLOAT4X4 view, XMFLOAT4X4 proj, SimpleVertexShader * vertexShader)
+{
+	RenderComponent& render = Render();
+	Material* material = render.material;
+
 	//Prepares material object for reuse 
-	material->vertexShader->SetMatrix4x4("world", worldMatrix); 
-	material->vertexShader->SetMatrix4x4("view", view); 
-	material->vertexShader->SetMatrix4x4("projection", proj); 
-	material->vertexShader->SetShader(true); 
+	vertexShader->SetMatrix4x4("world", *GetWorldMatrix()); 
+	vertexShader->SetMatrix4x4("view", view); 
+	vertexShader->SetMatrix4x4("projection", proj); 
+
+	// Packed positions are relative to the mesh's bounding box
+	if (render.mesh != nullptr && render.mesh->GetVertexFormat() == VERTEX_FORMAT_PACKED)
+	{
+		PackedPositionScale scale = render.mesh->GetPositionScale();
+		vertexShader->SetFloat3("positionOffset", scale.offset);
+		vertexShader->SetFloat3("positionScale", scale.scale);
+	}
+	vertexShader->SetShader(true); 
 	material->pixelShader->SetShader(true); 
 }
 
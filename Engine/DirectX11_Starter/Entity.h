@@ -1,44 +1,73 @@
 #pragma once
 #include "Mesh.h"
-#include "Material.h"
+#include "Camera.h"
+#include "Components.h"
+#include "World.h"
 
 using namespace DirectX; 
 
+// --------------------------------------------------------
+// A drawable object - just a World and an id, so it's cheap to
+// copy around; its components live in the World's chunks and
+// its transform in a TransformStore
+// - Copies all refer to the same entity, and Destroy() ends it
+//   for every one of them - IsAlive() tells the others
+// --------------------------------------------------------
 class Entity
 {
 public:
-	~Entity();
-	Entity(Mesh* inputMeshm, Material* inputMaterial); 
-	//attributes 
-	Mesh* mesh;
-	Material* material; 
+	Entity() : world(nullptr), id(0) {}
+	Entity(World* world, EntityId id) : world(world), id(id) {}
+
+	// A new entity with a transform and something to draw
+	static Entity Create(World* world, TransformStore* transforms, MeshHandle mesh, Material* material);
+	void Destroy();
+
+	World* GetWorld() { return world; }
+	EntityId GetId() { return id; }
+	bool IsAlive() { return world != nullptr && world->IsAlive(id); }
 
 	//getters and setters
-	XMFLOAT3 GetPosition() { return position; }
-	XMFLOAT3 GetRotation() { return rotation;  }
-	XMFLOAT3 GetScale() { return this->scale; }
-	XMFLOAT4X4* GetWorldMatrix() { return &worldMatrix;  }
+	XMFLOAT3 GetPosition() { return Transform().store->GetPosition(Transform().index); }
+	XMFLOAT4 GetRotation() { return Transform().store->GetRotation(Transform().index); }   // Quaternion
+	XMFLOAT3 GetScale() { return Transform().store->GetScale(Transform().index); }
+	XMFLOAT4X4* GetWorldMatrix() { return Transform().store->GetWorldMatrix(Transform().index); }
+	unsigned int GetTransformIndex() { return Transform().index; }
+	MeshHandle GetMesh() { return Render().mesh; }
+	int GetLod() { return Render().lod; }
+	MeshletCullStats GetCullStats() { return Render().cullStats; }
 
 
-	void SetWorldMatrix(XMFLOAT4X4 newWorldMatrix) { worldMatrix = newWorldMatrix; }
-	void SetPosition(float x, float y, float z) { position = XMFLOAT3(x, y, z); }
-	void SetRotation(float x, float y, float z) { rotation = XMFLOAT3(x, y, z); }
-	void SetScale(float x, float y, float z) { scale = XMFLOAT3(x, y, z); }
+	void SetWorldMatrix(XMFLOAT4X4 newWorldMatrix) { *GetWorldMatrix() = newWorldMatrix; }
+	void SetPosition(float x, float y, float z) { Transform().store->SetPosition(Transform().index, XMFLOAT3(x, y, z)); }
+	void SetRotation(float x, float y, float z) { Transform().store->SetRotation(Transform().index, TransformStore::QuaternionFromEuler(x, y, z)); }
+	void SetRotation(const XMFLOAT4& quaternion) { Transform().store->SetRotation(Transform().index, quaternion); }
+	void SetScale(float x, float y, float z) { Transform().store->SetScale(Transform().index, XMFLOAT3(x, y, z)); }
+	void SetMesh(MeshHandle mesh) { Render().mesh = mesh; }
+	void SetLod(int level) { Render().lod = level; }
+	void SetOccluder(std::shared_ptr<const OccluderMesh> mesh)   // Null stops it occluding
+	{
+		if (mesh)
+			world->Add(id, OccluderComponent(mesh));
+		else
+			world->Remove<OccluderComponent>(id);
+	}
 
 	//Class Specific functions 
 	void updateScene(); 
 	void drawScene(ID3D11DeviceContext* deviceContext);
+	void drawScene(ID3D11DeviceContext* deviceContext, Camera* camera);
 	void drawDeferred(ID3D11DeviceContext* deferredContext, ID3D11CommandList* commandList);
-	void Move(float x, float y, float z) { position.x += x;	position.y += y;	position.z += z; }
-	void Rotate(float x, float y, float z) { rotation.x += x;	rotation.y += y;	rotation.z += z; }
-	void Scale(float x, float y, float z) { scale.x += x;	scale.y += y;	scale.z += z; }
+	void Move(float x, float y, float z);
+	void Rotate(float x, float y, float z);     // Around the entity's own axes
+	void Scale(float x, float y, float z);
+	bool SetParent(Entity parent);   // An empty Entity() detaches - false if it would make a cycle
 	void prepareMaterial(XMFLOAT4X4 view, XMFLOAT4X4 proj); 
+	void prepareMaterial(XMFLOAT4X4 view, XMFLOAT4X4 proj, SimpleVertexShader* vertexShader);   // In place of the material's
 private:
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT3 rotation;
-	DirectX::XMFLOAT3 scale;
-	XMFLOAT4X4 worldMatrix;
-	
+	TransformComponent& Transform() { return *world->Get<TransformComponent>(id); }
+	RenderComponent& Render() { return *world->Get<RenderComponent>(id); }
 
+	World* world;
+	EntityId id;
 };
-
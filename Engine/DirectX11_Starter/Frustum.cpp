@@ -0,0 +1,88 @@
+#include "Frustum.h"
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+	inline XMFLOAT3 Normalize(const XMFLOAT3& v)
+	{
+		float length = sqrtf(Dot(v, v));
+		return length > 0.0f ? XMFLOAT3(v.x / length, v.y / length, v.z / length) : v;
+	}
+
+	// Scales a plane so its normal is unit length, which makes
+	// the plane equation return real distances
+	XMFLOAT4 NormalizePlane(float a, float b, float c, float d)
+	{
+		float length = sqrtf(a * a + b * b + c * c);
+		if (length > 0.0f)
+			return XMFLOAT4(a / length, b / length, c / length, d / length);
+		return XMFLOAT4(a, b, c, d);
+	}
+
+	// Plane through "point" with the given (unit) inward normal
+	XMFLOAT4 PlaneFromPoint(const XMFLOAT3& normal, const XMFLOAT3& point)
+	{
+		return XMFLOAT4(normal.x, normal.y, normal.z, -Dot(normal, point));
+	}
+}
+
+
+// --------------------------------------------------------
+// DirectXMath matrices transform row vectors (clip = p * M),
+// so each plane is a sum/difference of the matrix's columns
+// - D3D clip space z runs from 0 to w, so the near plane is
+//   just the third column
+// --------------------------------------------------------
+Frustum Frustum::FromMatrix(const XMFLOAT4X4& m)
+{
+	Frustum frustum;
+	frustum.planes[0] = NormalizePlane(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41);
+	frustum.planes[1] = NormalizePlane(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41);
+	frustum.planes[2] = NormalizePlane(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42);
+	frustum.planes[3] = NormalizePlane(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42);
+	frustum.planes[4] = NormalizePlane(m._13, m._23, m._33, m._43);
+	frustum.planes[5] = NormalizePlane(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43);
+	return frustum;
+}
+
+Frustum Frustum::FromPerspective(const XMFLOAT3& eye, const XMFLOAT3& forward, const XMFLOAT3& up,
+	float fovY, float aspectRatio, float nearZ, float farZ)
+{
+	// Same basis as XMMatrixLookToLH
+	XMFLOAT3 f = Normalize(forward);
+	XMFLOAT3 r = Normalize(Cross(up, f));
+	XMFLOAT3 u = Cross(f, r);
+
+	float tanY = tanf(fovY * 0.5f);
+	float tanX = tanY * aspectRatio;
+
+	// A view space point is inside the left plane when x >= -z * tanX,
+	// so that plane's normal is (1, 0, tanX) - the rest follow suit
+	Frustum frustum;
+	frustum.planes[0] = PlaneFromPoint(Normalize(XMFLOAT3(r.x + f.x * tanX, r.y + f.y * tanX, r.z + f.z * tanX)), eye);
+	frustum.planes[1] = PlaneFromPoint(Normalize(XMFLOAT3(-r.x + f.x * tanX, -r.y + f.y * tanX, -r.z + f.z * tanX)), eye);
+	frustum.planes[2] = PlaneFromPoint(Normalize(XMFLOAT3(u.x + f.x * tanY, u.y + f.y * tanY, u.z + f.z * tanY)), eye);
+	frustum.planes[3] = PlaneFromPoint(Normalize(XMFLOAT3(-u.x + f.x * tanY, -u.y + f.y * tanY, -u.z + f.z * tanY)), eye);
+	frustum.planes[4] = PlaneFromPoint(f, XMFLOAT3(eye.x + f.x * nearZ, eye.y + f.y * nearZ, eye.z + f.z * nearZ));
+	frustum.planes[5] = PlaneFromPoint(XMFLOAT3(-f.x, -f.y, -f.z), XMFLOAT3(eye.x + f.x * farZ, eye.y + f.y * farZ, eye.z + f.z * farZ));
+	return frustum;
+}
+
+bool Frustum::IntersectsSphere(const XMFLOAT3& center, float radius) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const XMFLOAT4& p = planes[i];
+		if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// View frustum as six planes (xyz = normal, w = distance),
+// with normals pointing inward
+// - A point p is inside a plane when dot(normal, p) + w >= 0
+// - Plane order is left, right, bottom, top, near, far
+// --------------------------------------------------------
+struct Frustum
+{
+	DirectX::XMFLOAT4 planes[6];
+
+	// Extracts the planes from a (non-transposed) view * projection
+	// matrix, Gribb/Hartmann style - pass world * view * projection
+	// to get the planes in that object's space instead
+	static Frustum FromMatrix(const DirectX::XMFLOAT4X4& viewProjection);
+
+	// Builds the planes directly from a left handed perspective
+	// camera, the same way XMMatrixPerspectiveFovLH sets one up
+	static Frustum FromPerspective(const DirectX::XMFLOAT3& eye, const DirectX::XMFLOAT3& forward, const DirectX::XMFLOAT3& up,
+		float fovY, float aspectRatio, float nearZ, float farZ);
+
+	// False only when the sphere is completely outside a plane
+	bool IntersectsSphere(const DirectX::XMFLOAT3& center, float radius) const;
+};
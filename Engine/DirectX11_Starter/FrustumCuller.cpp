@@ -0,0 +1,590 @@
+#include "FrustumCuller.h"
+#include "TransformStore.h"
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// Same as in TransformStore.cpp - GCC and Clang need AVX
+// enabled per function
+#if defined(__GNUC__)
+#define CULL_TARGET_AVX __attribute__((target("avx")))
+#else
+#define CULL_TARGET_AVX
+#endif
+
+namespace
+{
+	// Padding bounds - so far inside out that every plane rejects them
+	const float Culled = -1e30f;
+
+	// An object no plane rejected - see CullCoherent()
+	const unsigned char NoPlane = 6;
+
+	// Index of the lowest set bit, which has to be there
+	unsigned int LowestBit(unsigned int bits)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, bits);
+		return index;
+#else
+		return __builtin_ctz(bits);
+#endif
+	}
+
+	struct CullArrays
+	{
+		const float* centerX;
+		const float* centerY;
+		const float* centerZ;
+		const float* extentX;
+		const float* extentY;
+		const float* extentZ;
+		const float* radius;
+		const unsigned int* ids;
+	};
+
+	// --------------------------------------------------------
+	// The reference version of the kernels below
+	// - d is the center's distance in front of the plane; the
+	//   box reaches |n| . extents further, the sphere radius
+	//   further - whichever is less is how far in it reaches
+	// --------------------------------------------------------
+	unsigned int CullScalar(const Frustum& frustum, const CullArrays& a, unsigned int count, unsigned int* visible)
+	{
+		unsigned int visibleCount = 0;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			bool inside = true;
+			for (int p = 0; p < 6 && inside; p++)
+			{
+				const XMFLOAT4& plane = frustum.planes[p];
+				float d = plane.x * a.centerX[i] + plane.y * a.centerY[i] + plane.z * a.centerZ[i] + plane.w;
+				float reach = fabsf(plane.x) * a.extentX[i] + fabsf(plane.y) * a.extentY[i] + fabsf(plane.z) * a.extentZ[i];
+				inside = d + std::min(reach, a.radius[i]) >= 0.0f;
+			}
+			visible[visibleCount] = a.ids[i];
+			visibleCount += inside ? 1 : 0;
+		}
+		return visibleCount;
+	}
+
+	// 4 objects per iteration - every plane is tested, since a
+	// branch per plane costs more than it saves
+	unsigned int CullSSE(const Frustum& frustum, const CullArrays& a, unsigned int paddedCount, unsigned int* visible)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 planes[6][7];
+		for (int p = 0; p < 6; p++)
+		{
+			const XMFLOAT4& plane = frustum.planes[p];
+			planes[p][0] = _mm_set1_ps(plane.x);
+			planes[p][1] = _mm_set1_ps(plane.y);
+			planes[p][2] = _mm_set1_ps(plane.z);
+			planes[p][3] = _mm_set1_ps(plane.w);
+			planes[p][4] = _mm_andnot_ps(signMask, planes[p][0]);
+			planes[p][5] = _mm_andnot_ps(signMask, planes[p][1]);
+			planes[p][6] = _mm_andnot_ps(signMask, planes[p][2]);
+		}
+
+		unsigned int visibleCount = 0;
+		for (unsigned int i = 0; i < paddedCount; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(a.centerX + i);
+			__m128 cy = _mm_loadu_ps(a.centerY + i);
+			__m128 cz = _mm_loadu_ps(a.centerZ + i);
+			__m128 ex = _mm_loadu_ps(a.extentX + i);
+			__m128 ey = _mm_loadu_ps(a.extentY + i);
+			__m128 ez = _mm_loadu_ps(a.extentZ + i);
+			__m128 r = _mm_loadu_ps(a.radius + i);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], cx), _mm_mul_ps(planes[p][1], cy)),
+					_mm_add_ps(_mm_mul_ps(planes[p][2], cz), planes[p][3]));
+				__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][4], ex), _mm_mul_ps(planes[p][5], ey)),
+					_mm_mul_ps(planes[p][6], ez));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, _mm_min_ps(reach, r)), _mm_setzero_ps()));
+			}
+
+			// Write every id, but only step past the visible ones
+			int bits = _mm_movemask_ps(inside);
+			for (int k = 0; k < 4; k++)
+			{
+				visible[visibleCount] = a.ids[i + k];
+				visibleCount += (bits >> k) & 1;
+			}
+		}
+		return visibleCount;
+	}
+
+	CULL_TARGET_AVX
+	unsigned int CullAVX(const Frustum& frustum, const CullArrays& a, unsigned int paddedCount, unsigned int* visible)
+	{
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+		__m256 planes[6][7];
+		for (int p = 0; p < 6; p++)
+		{
+			const XMFLOAT4& plane = frustum.planes[p];
+			planes[p][0] = _mm256_set1_ps(plane.x);
+			planes[p][1] = _mm256_set1_ps(plane.y);
+			planes[p][2] = _mm256_set1_ps(plane.z);
+			planes[p][3] = _mm256_set1_ps(plane.w);
+			planes[p][4] = _mm256_andnot_ps(signMask, planes[p][0]);
+			planes[p][5] = _mm256_andnot_ps(signMask, planes[p][1]);
+			planes[p][6] = _mm256_andnot_ps(signMask, planes[p][2]);
+		}
+
+		unsigned int visibleCount = 0;
+		for (unsigned int i = 0; i < paddedCount; i += 8)
+		{
+			__m256 cx = _mm256_loadu_ps(a.centerX + i);
+			__m256 cy = _mm256_loadu_ps(a.centerY + i);
+			__m256 cz = _mm256_loadu_ps(a.centerZ + i);
+			__m256 ex = _mm256_loadu_ps(a.extentX + i);
+			__m256 ey = _mm256_loadu_ps(a.extentY + i);
+			__m256 ez = _mm256_loadu_ps(a.extentZ + i);
+			__m256 r = _mm256_loadu_ps(a.radius + i);
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], cx), _mm256_mul_ps(planes[p][1], cy)),
+					_mm256_add_ps(_mm256_mul_ps(planes[p][2], cz), planes[p][3]));
+				__m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][4], ex), _mm256_mul_ps(planes[p][5], ey)),
+					_mm256_mul_ps(planes[p][6], ez));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, _mm256_min_ps(reach, r)), _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+
+			int bits = _mm256_movemask_ps(inside);
+			for (int k = 0; k < 8; k++)
+			{
+				visible[visibleCount] = a.ids[i + k];
+				visibleCount += (bits >> k) & 1;
+			}
+		}
+		return visibleCount;
+	}
+
+	unsigned int RoundUp(unsigned int value, unsigned int multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+}
+
+
+FrustumCuller::FrustumCuller()
+{
+	count = 0;
+	cachedCount = 0;
+	hasCachedFrustum = false;
+	cacheThreshold = 0.5f;
+	cacheStats = CullCacheStats();
+}
+
+void FrustumCuller::Clear()
+{
+	Resize(0);
+}
+
+void FrustumCuller::Reserve(unsigned int reserveCount)
+{
+	unsigned int padded = RoundUp(reserveCount, 8);
+	centerX.reserve(padded);
+	centerY.reserve(padded);
+	centerZ.reserve(padded);
+	extentX.reserve(padded);
+	extentY.reserve(padded);
+	extentZ.reserve(padded);
+	radius.reserve(padded);
+	ids.reserve(padded);
+}
+
+unsigned int FrustumCuller::Add(unsigned int id, const MeshBounds & bounds, const XMFLOAT4X4 & worldMatrix)
+{
+	unsigned int index = Grow();
+	Set(index, id, bounds, worldMatrix);
+	return index;
+}
+
+// --------------------------------------------------------
+// The matrix is stored transposed, so each row is one world
+// axis - the box's new half extents are the rows' absolute
+// values times the old ones, and the sphere grows by the
+// largest scale along any of the mesh's own axes
+// --------------------------------------------------------
+void FrustumCuller::Set(unsigned int index, unsigned int id, const MeshBounds & bounds, const XMFLOAT4X4 & worldMatrix)
+{
+	const XMFLOAT4X4& m = worldMatrix;
+	XMFLOAT3 c = bounds.center;
+	XMFLOAT3 e(
+		(bounds.max.x - bounds.min.x) * 0.5f,
+		(bounds.max.y - bounds.min.y) * 0.5f,
+		(bounds.max.z - bounds.min.z) * 0.5f);
+
+	XMFLOAT3 center(
+		m._11 * c.x + m._12 * c.y + m._13 * c.z + m._14,
+		m._21 * c.x + m._22 * c.y + m._23 * c.z + m._24,
+		m._31 * c.x + m._32 * c.y + m._33 * c.z + m._34);
+	XMFLOAT3 extents(
+		fabsf(m._11) * e.x + fabsf(m._12) * e.y + fabsf(m._13) * e.z,
+		fabsf(m._21) * e.x + fabsf(m._22) * e.y + fabsf(m._23) * e.z,
+		fabsf(m._31) * e.x + fabsf(m._32) * e.y + fabsf(m._33) * e.z);
+
+	float scaleX = m._11 * m._11 + m._21 * m._21 + m._31 * m._31;
+	float scaleY = m._12 * m._12 + m._22 * m._22 + m._32 * m._32;
+	float scaleZ = m._13 * m._13 + m._23 * m._23 + m._33 * m._33;
+	float scale = sqrtf(std::max(scaleX, std::max(scaleY, scaleZ)));
+
+	Set(index, id, center, extents, bounds.radius * scale);
+}
+
+unsigned int FrustumCuller::Add(unsigned int id, const XMFLOAT3 & center, const XMFLOAT3 & extents, float sphereRadius)
+{
+	unsigned int index = Grow();
+	Set(index, id, center, extents, sphereRadius);
+	return index;
+}
+
+void FrustumCuller::Set(unsigned int index, unsigned int id, const XMFLOAT3 & center, const XMFLOAT3 & extents, float sphereRadius)
+{
+	centerX[index] = center.x;
+	centerY[index] = center.y;
+	centerZ[index] = center.z;
+	extentX[index] = extents.x;
+	extentY[index] = extents.y;
+	extentZ[index] = extents.z;
+	radius[index] = sphereRadius;
+	ids[index] = id;
+
+	// A different object, or one that's moved or grown more than
+	// half the threshold since CullCoherent() last saw it, means
+	// its block has to be tested again
+	if (index < cachedCount && cleanBlocks[index / CacheBlockSize])
+	{
+		float dx = center.x - cachedX[index];
+		float dy = center.y - cachedY[index];
+		float dz = center.z - cachedZ[index];
+		float ex = std::max(extents.x - cachedExtentX[index], 0.0f);
+		float ey = std::max(extents.y - cachedExtentY[index], 0.0f);
+		float ez = std::max(extents.z - cachedExtentZ[index], 0.0f);
+		float grown = std::max(sqrtf(ex * ex + ey * ey + ez * ez), sphereRadius - cachedRadius[index]);
+		float half = cacheThreshold * 0.5f;
+		if (id != cachedIds[index] || sqrtf(dx * dx + dy * dy + dz * dz) + grown > half)
+			cleanBlocks[index / CacheBlockSize] = 0;
+	}
+}
+
+// --------------------------------------------------------
+// The kernels write an id for every object and only advance
+// past visible ones, so visible needs room for a whole block
+// more than ends up in it
+// --------------------------------------------------------
+unsigned int FrustumCuller::Cull(const Frustum & frustum, std::vector<unsigned int>& visible, CullKernel kernel)
+{
+	unsigned int padded = RoundUp(count, 8);
+	visible.resize(padded + 1);
+	if (count == 0)
+	{
+		visible.clear();
+		return 0;
+	}
+
+	CullArrays arrays;
+	arrays.centerX = &centerX[0];
+	arrays.centerY = &centerY[0];
+	arrays.centerZ = &centerZ[0];
+	arrays.extentX = &extentX[0];
+	arrays.extentY = &extentY[0];
+	arrays.extentZ = &extentZ[0];
+	arrays.radius = &radius[0];
+	arrays.ids = &ids[0];
+
+	if (kernel == CULL_KERNEL_BEST)
+		kernel = IsKernelSupported(CULL_KERNEL_AVX) ? CULL_KERNEL_AVX : CULL_KERNEL_SSE;
+
+	unsigned int visibleCount;
+	switch (kernel)
+	{
+	case CULL_KERNEL_AVX:
+		visibleCount = CullAVX(frustum, arrays, padded, &visible[0]);
+		break;
+	case CULL_KERNEL_SSE:
+		visibleCount = CullSSE(frustum, arrays, padded, &visible[0]);
+		break;
+	default:
+		visibleCount = CullScalar(frustum, arrays, count, &visible[0]);
+		break;
+	}
+
+	visible.resize(visibleCount);
+	return visibleCount;
+}
+
+// --------------------------------------------------------
+// While a plane keeps its normal, moving it by dw moves every
+// point's distance to it by exactly dw - so as long as the
+// camera has only moved, and less than half the threshold, and
+// an object has moved less than the other half, an object that
+// was a threshold outside a plane is still outside it
+// - Turning the camera changes the normals, and then every
+//   object is tested, by Cull()
+// - Blocks tested while the camera is still are measured from
+//   the frustum being reused, so they need that much more room
+// - Tested blocks go 4 objects at a time: each one's old plane
+//   is looked up and the four transposed into one plane per
+//   component, and only if that doesn't reject all four are
+//   they tested against every plane, as CullSSE does
+// --------------------------------------------------------
+unsigned int FrustumCuller::CullCoherent(const Frustum & frustum, std::vector<unsigned int>& visible)
+{
+	cacheStats = CullCacheStats();
+	cacheStats.objects = count;
+	visible.resize(RoundUp(count, 8));
+	if (count == 0)
+		return 0;
+
+	ResizeCache(count);
+
+	bool still = hasCachedFrustum;
+	float drift = 0.0f;
+	for (int p = 0; p < 6 && still; p++)
+	{
+		const XMFLOAT4& now = frustum.planes[p];
+		const XMFLOAT4& then = cachedFrustum.planes[p];
+		still = now.x == then.x && now.y == then.y && now.z == then.z;
+		drift = std::max(drift, fabsf(now.w - then.w));
+	}
+
+	// Turning - nothing carries over, and the plain kernels are
+	// faster than keeping the cache up to date. The cache starts
+	// again from the first frame the camera holds its direction
+	if (hasCachedFrustum && !still)
+	{
+		std::fill(cleanBlocks.begin(), cleanBlocks.end(), (unsigned char)0);
+		cachedFrustum = frustum;
+		cacheStats.fullTests = count;
+		return Cull(frustum, visible);
+	}
+	if (!still || drift > cacheThreshold * 0.5f)
+	{
+		still = false;
+		drift = 0.0f;
+		cachedFrustum = frustum;
+		hasCachedFrustum = true;
+	}
+
+	// The planes to look each object's old one up in - the last
+	// one is for objects nothing rejected, and rejects nothing
+	float planeTable[NoPlane + 1][4];
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 planes[6][7];
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4& plane = frustum.planes[p];
+		planeTable[p][0] = plane.x;
+		planeTable[p][1] = plane.y;
+		planeTable[p][2] = plane.z;
+		planeTable[p][3] = plane.w;
+		planes[p][0] = _mm_set1_ps(plane.x);
+		planes[p][1] = _mm_set1_ps(plane.y);
+		planes[p][2] = _mm_set1_ps(plane.z);
+		planes[p][3] = _mm_set1_ps(plane.w);
+		planes[p][4] = _mm_andnot_ps(signMask, planes[p][0]);
+		planes[p][5] = _mm_andnot_ps(signMask, planes[p][1]);
+		planes[p][6] = _mm_andnot_ps(signMask, planes[p][2]);
+	}
+	planeTable[NoPlane][0] = planeTable[NoPlane][1] = planeTable[NoPlane][2] = 0.0f;
+	planeTable[NoPlane][3] = 1.0f;
+	const __m128 margin = _mm_set1_ps(-(cacheThreshold + drift));
+	const __m128 zero = _mm_setzero_ps();
+
+	unsigned int visibleCount = 0;
+	unsigned int blockCount = (count + CacheBlockSize - 1) / CacheBlockSize;
+	for (unsigned int b = 0; b < blockCount; b++)
+	{
+		unsigned int begin = b * CacheBlockSize;
+		unsigned int end = std::min(begin + CacheBlockSize, count);
+		if (still && cleanBlocks[b])
+		{
+			for (int half = 0; half < 2; half++)
+			{
+				unsigned int bits = visibleBits[b * 2 + half];
+				while (bits != 0)
+				{
+					visible[visibleCount++] = ids[begin + half * 32 + LowestBit(bits)];
+					bits &= bits - 1;
+				}
+			}
+			cacheStats.reused += end - begin;
+			cacheStats.blocksSkipped++;
+			continue;
+		}
+
+		bool clean = true;
+		unsigned int blockBits[2] = {};
+		for (unsigned int i = begin; i < end; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(&centerX[i]);
+			__m128 cy = _mm_loadu_ps(&centerY[i]);
+			__m128 cz = _mm_loadu_ps(&centerZ[i]);
+			__m128 ex = _mm_loadu_ps(&extentX[i]);
+			__m128 ey = _mm_loadu_ps(&extentY[i]);
+			__m128 ez = _mm_loadu_ps(&extentZ[i]);
+			__m128 r = _mm_loadu_ps(&radius[i]);
+			unsigned int real = std::min(end - i, 4u);
+
+			__m128 px = _mm_loadu_ps(planeTable[cachedPlanes[i]]);
+			__m128 py = _mm_loadu_ps(planeTable[cachedPlanes[i + 1]]);
+			__m128 pz = _mm_loadu_ps(planeTable[cachedPlanes[i + 2]]);
+			__m128 pw = _mm_loadu_ps(planeTable[cachedPlanes[i + 3]]);
+			_MM_TRANSPOSE4_PS(px, py, pz, pw);
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)), _mm_add_ps(_mm_mul_ps(pz, cz), pw));
+			__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, px), ex), _mm_mul_ps(_mm_andnot_ps(signMask, py), ey)),
+				_mm_mul_ps(_mm_andnot_ps(signMask, pz), ez));
+			__m128 distance = _mm_add_ps(d, _mm_min_ps(reach, r));
+
+			if (_mm_movemask_ps(_mm_cmplt_ps(distance, zero)) == 0xF)
+			{
+				// Still outside their old planes - no need to look further
+				clean = clean && _mm_movemask_ps(_mm_cmplt_ps(distance, margin)) == 0xF;
+				cacheStats.planeHits += real;
+			}
+			else
+			{
+				// The first plane that rejects each one, and whether any
+				// rejects it by the margin
+				__m128i rejectedBy = _mm_set1_epi32(NoPlane);
+				__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+				__m128 deep = zero;
+				for (int p = 5; p >= 0; p--)
+				{
+					d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], cx), _mm_mul_ps(planes[p][1], cy)),
+						_mm_add_ps(_mm_mul_ps(planes[p][2], cz), planes[p][3]));
+					reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][4], ex), _mm_mul_ps(planes[p][5], ey)),
+						_mm_mul_ps(planes[p][6], ez));
+					distance = _mm_add_ps(d, _mm_min_ps(reach, r));
+					__m128 outside = _mm_cmplt_ps(distance, zero);
+					inside = _mm_andnot_ps(outside, inside);
+					deep = _mm_or_ps(deep, _mm_cmplt_ps(distance, margin));
+					__m128i mask = _mm_castps_si128(outside);
+					rejectedBy = _mm_or_si128(_mm_and_si128(mask, _mm_set1_epi32(p)), _mm_andnot_si128(mask, rejectedBy));
+				}
+
+				int insideBits = _mm_movemask_ps(inside);
+				clean = clean && _mm_movemask_ps(_mm_or_ps(inside, deep)) == 0xF;
+				blockBits[(i - begin) / 32] |= (unsigned int)insideBits << ((i - begin) % 32);
+				for (int k = 0; k < 4; k++)
+				{
+					visible[visibleCount] = ids[i + k];
+					visibleCount += (insideBits >> k) & 1;
+				}
+
+				alignas(16) int planeIndices[4];
+				_mm_store_si128((__m128i*)planeIndices, rejectedBy);
+				for (int k = 0; k < 4; k++)
+					cachedPlanes[i + k] = (unsigned char)planeIndices[k];
+				cacheStats.fullTests += real;
+			}
+
+			_mm_storeu_ps(&cachedX[i], cx);
+			_mm_storeu_ps(&cachedY[i], cy);
+			_mm_storeu_ps(&cachedZ[i], cz);
+			_mm_storeu_ps(&cachedExtentX[i], ex);
+			_mm_storeu_ps(&cachedExtentY[i], ey);
+			_mm_storeu_ps(&cachedExtentZ[i], ez);
+			_mm_storeu_ps(&cachedRadius[i], r);
+			_mm_storeu_si128((__m128i*)&cachedIds[i], _mm_loadu_si128((const __m128i*)&ids[i]));
+		}
+		visibleBits[b * 2] = blockBits[0];
+		visibleBits[b * 2 + 1] = blockBits[1];
+		cleanBlocks[b] = clean ? 1 : 0;
+		cacheStats.blocksTested++;
+	}
+
+	visible.resize(visibleCount);
+	return visibleCount;
+}
+
+void FrustumCuller::InvalidateCache()
+{
+	std::fill(cleanBlocks.begin(), cleanBlocks.end(), (unsigned char)0);
+	std::fill(cachedPlanes.begin(), cachedPlanes.end(), NoPlane);
+	hasCachedFrustum = false;
+}
+
+bool FrustumCuller::IsKernelSupported(CullKernel kernel)
+{
+	return kernel != CULL_KERNEL_AVX || TransformStore::IsKernelSupported(TRANSFORM_KERNEL_AVX);
+}
+
+// Adds one slot - the arrays only need to grow every 8th time,
+// the rest of the time it's already there as padding
+unsigned int FrustumCuller::Grow()
+{
+	if (count == centerX.size())
+		Resize(count + 1);
+	else
+		count++;
+	return count - 1;
+}
+
+// New slots, and the padding after the last one, are culled
+// until they're set
+void FrustumCuller::Resize(unsigned int newCount)
+{
+	unsigned int padded = RoundUp(newCount, 8);
+	centerX.resize(padded, 0.0f);
+	centerY.resize(padded, 0.0f);
+	centerZ.resize(padded, 0.0f);
+	extentX.resize(padded, Culled);
+	extentY.resize(padded, Culled);
+	extentZ.resize(padded, Culled);
+	radius.resize(padded, Culled);
+	ids.resize(padded, 0);
+
+	// Shrinking leaves old objects in what's now padding
+	for (unsigned int i = newCount; i < std::min(count, padded); i++)
+	{
+		extentX[i] = extentY[i] = extentZ[i] = radius[i] = Culled;
+		centerX[i] = centerY[i] = centerZ[i] = 0.0f;
+	}
+	count = newCount;
+}
+
+// New objects start out untested, in blocks that aren't clean -
+// nor is the block a count that's changed now ends partway into
+// - The arrays cover whole blocks, so CullCoherent() can read
+//   and write 4 objects at a time up to the padding
+void FrustumCuller::ResizeCache(unsigned int newCount)
+{
+	if (newCount == cachedCount)
+		return;
+
+	unsigned int blocks = (newCount + CacheBlockSize - 1) / CacheBlockSize;
+	unsigned int size = blocks * CacheBlockSize;
+	cachedPlanes.resize(size, NoPlane);
+	cachedX.resize(size);
+	cachedY.resize(size);
+	cachedZ.resize(size);
+	cachedExtentX.resize(size);
+	cachedExtentY.resize(size);
+	cachedExtentZ.resize(size);
+	cachedRadius.resize(size);
+	cachedIds.resize(size);
+	cleanBlocks.resize(blocks, 0);
+	visibleBits.resize(blocks * 2, 0);
+
+	unsigned int boundary = std::min(cachedCount, newCount);
+	if (boundary % CacheBlockSize != 0)
+		cleanBlocks[boundary / CacheBlockSize] = 0;
+	cachedCount = newCount;
+}
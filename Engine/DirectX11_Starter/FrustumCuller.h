@@ -0,0 +1,129 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Frustum.h"
+#include "MeshData.h"
+
+// --------------------------------------------------------
+// Which test loop FrustumCuller::Cull() runs
+// --------------------------------------------------------
+enum CullKernel
+{
+	CULL_KERNEL_SCALAR = 0,   // One object at a time
+	CULL_KERNEL_SSE = 1,      // 4 at a time
+	CULL_KERNEL_AVX = 2,      // 8 at a time, if the CPU has it
+	CULL_KERNEL_BEST = 3      // Widest one the CPU supports
+};
+
+// --------------------------------------------------------
+// How much work FrustumCuller::CullCoherent() got to skip last
+// time - objects are counted once, by whichever way they were
+// decided
+// --------------------------------------------------------
+struct CullCacheStats
+{
+	unsigned int objects;
+	unsigned int reused;            // In blocks skipped whole, with last frame's result
+	unsigned int planeHits;         // Still outside the plane that rejected them last time
+	unsigned int fullTests;         // Tested against every plane
+	unsigned int blocksSkipped;
+	unsigned int blocksTested;
+};
+
+// --------------------------------------------------------
+// World space bounds of many objects, and a frustum test that
+// goes through them several at a time
+// - Each object has a box (center and half extents) and a
+//   sphere around the same center; it's culled when either
+//   one is completely outside a plane
+// - Bounds are stored as structure-of-arrays, padded with
+//   objects that are always culled, so the SIMD loops never
+//   need a scalar tail
+// - CullCoherent() remembers each object's result between
+//   frames (see there) - objects are matched up by index, so
+//   it pays off when they're added in the same order each time
+// --------------------------------------------------------
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	void Clear();
+	void Reserve(unsigned int count);
+
+	// Adds an object's mesh bounds, moved into world space by its
+	// (transposed, as stored for HLSL) world matrix - id is what
+	// Cull() writes out for it
+	unsigned int Add(unsigned int id, const MeshBounds& bounds, const DirectX::XMFLOAT4X4& worldMatrix);
+	void Set(unsigned int index, unsigned int id, const MeshBounds& bounds, const DirectX::XMFLOAT4X4& worldMatrix);
+
+	// Same, for bounds that are already in world space
+	unsigned int Add(unsigned int id, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents, float radius);
+	void Set(unsigned int index, unsigned int id, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents, float radius);
+
+	unsigned int GetCount() { return count; }
+
+	// Replaces visible with the ids of every object at least partly
+	// inside the frustum, in the order they were added - returns
+	// how many there are
+	unsigned int Cull(const Frustum& frustum, std::vector<unsigned int>& visible, CullKernel kernel = CULL_KERNEL_BEST);
+
+	// --------------------------------------------------------
+	// Same result as Cull(), give or take objects near the edge,
+	// using what's known from the last call
+	// - Objects remember the plane that rejected them, and are
+	//   tested against that one first
+	// - While the camera is turning this is just Cull()
+	// - Objects are grouped in blocks of CacheBlockSize; while
+	//   the camera has only moved (not turned) less than half the
+	//   threshold, a block nothing in has moved half the threshold
+	//   just reuses its last result. Only blocks whose rejected
+	//   objects were all a threshold or more outside count, so
+	//   nothing that should be drawn is skipped - objects that
+	//   were visible stay that way until their block is tested
+	// --------------------------------------------------------
+	unsigned int CullCoherent(const Frustum& frustum, std::vector<unsigned int>& visible);
+
+	// In world units - bigger skips more blocks, but draws more
+	// objects that have just left the frustum
+	void SetCacheThreshold(float threshold) { cacheThreshold = threshold; InvalidateCache(); }
+	float GetCacheThreshold() { return cacheThreshold; }
+
+	// Forgets every remembered result - the next CullCoherent()
+	// tests everything
+	void InvalidateCache();
+	CullCacheStats GetCacheStats() { return cacheStats; }
+
+	static bool IsKernelSupported(CullKernel kernel);
+
+	static const unsigned int CacheBlockSize = 64;
+
+private:
+	unsigned int Grow();
+	void Resize(unsigned int newCount);
+	void ResizeCache(unsigned int newCount);
+
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<float> radius;
+	std::vector<unsigned int> ids;
+	unsigned int count;
+
+	// What CullCoherent() last saw of each object - the plane that
+	// rejected it (or none), and the bounds it was tested with -
+	// and whether each block can be skipped. Set() clears a block
+	// when an object in it moves too far
+	std::vector<unsigned char> cachedPlanes;
+	std::vector<float> cachedX, cachedY, cachedZ;
+	std::vector<float> cachedExtentX, cachedExtentY, cachedExtentZ;
+	std::vector<float> cachedRadius;
+	std::vector<unsigned int> cachedIds;
+	std::vector<unsigned char> cleanBlocks;
+	std::vector<unsigned int> visibleBits;   // Two words per block, which objects were visible
+	unsigned int cachedCount;
+	Frustum cachedFrustum;
+	bool hasCachedFrustum;
+	float cacheThreshold;
+	CullCacheStats cacheStats;
+};
@@ -0,0 +1,39 @@
+#include "InstanceBatcher.h"
+#include <algorithm>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+void InstanceBatcher::Clear()
+{
+	batches.clear();
+	instances.clear();
+}
+
+void InstanceBatcher::Reserve(unsigned int count)
+{
+	instances.reserve(count);
+}
+
+void InstanceBatcher::Add(unsigned int material, unsigned int mesh, int lod, unsigned int id, const XMFLOAT4X4 & worldMatrix)
+{
+	if (batches.empty() || batches.back().material != material || batches.back().mesh != mesh || batches.back().lod != lod)
+	{
+		InstanceBatch batch = { material, mesh, lod, id, (unsigned int)instances.size(), 0 };
+		batches.push_back(batch);
+	}
+	batches.back().instanceCount++;
+	instances.push_back(worldMatrix);
+}
+
+InstanceBatchStats InstanceBatcher::GetStats()
+{
+	InstanceBatchStats stats = InstanceBatchStats();
+	stats.instances = (unsigned int)instances.size();
+	stats.batches = (unsigned int)batches.size();
+	for (const InstanceBatch& batch : batches)
+		stats.largestBatch = std::max(stats.largestBatch, batch.instanceCount);
+	stats.bytes = stats.instances * InstanceBytes + stats.batches * BatchConstantBytes;
+	stats.unbatchedBytes = stats.instances * DrawConstantBytes;
+	return stats;
+}
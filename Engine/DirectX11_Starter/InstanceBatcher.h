@@ -0,0 +1,69 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Instances that go out in one DrawIndexedInstanced() - their
+// world matrices are instanceCount in a row, from firstInstance
+// --------------------------------------------------------
+struct InstanceBatch
+{
+	unsigned int material;
+	unsigned int mesh;
+	int lod;
+	unsigned int id;               // The first instance's - to find what to draw them all with
+	unsigned int firstInstance;
+	unsigned int instanceCount;
+};
+
+// --------------------------------------------------------
+// What the batches would cost to submit, against drawing the
+// same instances one at a time
+// --------------------------------------------------------
+struct InstanceBatchStats
+{
+	unsigned int instances;
+	unsigned int batches;          // Draw calls - one per batch
+	unsigned int largestBatch;
+	unsigned int bytes;            // World matrices, plus view and projection once per batch
+	unsigned int unbatchedBytes;   // World, view and projection for every instance
+};
+
+// --------------------------------------------------------
+// Gathers draws into instanced batches of the same material,
+// mesh and level of detail
+// - Only neighbors are merged - draws should come in a
+//   RenderQueue's order, which already has equal materials and
+//   meshes together (and levels of detail mostly, since they're
+//   front to back)
+// - World matrices go into one array for all the batches, so
+//   the instance buffer is filled with a single copy and each
+//   batch draws its own range of it
+// --------------------------------------------------------
+class InstanceBatcher
+{
+public:
+	// Per draw constants as the shaders have them - matrices are
+	// 64 bytes
+	static const unsigned int InstanceBytes = sizeof(DirectX::XMFLOAT4X4);
+	static const unsigned int BatchConstantBytes = 2 * InstanceBytes;    // View and projection
+	static const unsigned int DrawConstantBytes = 3 * InstanceBytes;     // World too
+
+	void Clear();
+	void Reserve(unsigned int count);
+
+	// Joins the last batch if it has the same material, mesh and
+	// level of detail, or starts a new one
+	void Add(unsigned int material, unsigned int mesh, int lod, unsigned int id, const DirectX::XMFLOAT4X4& worldMatrix);
+
+	unsigned int GetBatchCount() { return (unsigned int)batches.size(); }
+	const InstanceBatch& GetBatch(unsigned int index) { return batches[index]; }
+	unsigned int GetInstanceCount() { return (unsigned int)instances.size(); }
+	const DirectX::XMFLOAT4X4* GetInstances() { return instances.empty() ? nullptr : &instances[0]; }
+	InstanceBatchStats GetStats();
+
+private:
+	std::vector<InstanceBatch> batches;
+	std::vector<DirectX::XMFLOAT4X4> instances;
+};
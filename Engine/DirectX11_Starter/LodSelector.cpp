@@ -0,0 +1,119 @@
+#include "LodSelector.h"
+#include <algorithm>
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	// Each level starts at half the size of the one before
+	const float DefaultThresholds[] = { 320.0f, 160.0f, 80.0f, 40.0f, 20.0f, 10.0f, 5.0f };
+}
+
+LodSelector::LodSelector()
+{
+	eye = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	pixelScaleSq = 0.0f;
+	hysteresis = 0.15f;
+	cullSize = 2.0f;
+	SetThresholds(DefaultThresholds, sizeof(DefaultThresholds) / sizeof(DefaultThresholds[0]));
+	BeginFrame(eye);
+}
+
+// --------------------------------------------------------
+// A sphere of radius r at distance d is r * _22 / d of the
+// viewport's half height tall - so 2r * _22 / d times half the
+// height is its diameter in pixels
+// --------------------------------------------------------
+void LodSelector::SetProjection(const XMFLOAT4X4 & projection, float viewportHeight)
+{
+	float pixelScale = projection._22 * viewportHeight;
+	pixelScaleSq = pixelScale * pixelScale;
+}
+
+void LodSelector::SetThresholds(const float * sizes, unsigned int newCount)
+{
+	thresholdCount = std::min(newCount, (unsigned int)LodStats::MaxLevels - 1);
+	for (unsigned int t = 0; t < thresholdCount; t++)
+		thresholds[t] = sizes[t];
+}
+
+// --------------------------------------------------------
+// The band is applied to the thresholds here, once a frame,
+// so Select() only compares
+// --------------------------------------------------------
+void LodSelector::BeginFrame(const XMFLOAT3 & frameEye)
+{
+	eye = frameEye;
+	for (unsigned int t = 0; t < thresholdCount; t++)
+	{
+		float coarser = thresholds[t] * (1.0f - hysteresis);
+		float finer = thresholds[t] * (1.0f + hysteresis);
+		coarserSq[t] = coarser * coarser;
+		finerSq[t] = finer * finer;
+	}
+	float cull = cullSize * (1.0f - hysteresis);
+	float uncull = cullSize * (1.0f + hysteresis);
+	cullSq = cull * cull;
+	uncullSq = uncull * uncull;
+	stats = LodStats();
+}
+
+// --------------------------------------------------------
+// The sphere grows by the largest scale along any of the
+// mesh's own axes, as in FrustumCuller
+// --------------------------------------------------------
+int LodSelector::Select(const MeshBounds & bounds, const XMFLOAT4X4 & worldMatrix, int currentLevel, int levelCount)
+{
+	const XMFLOAT4X4& m = worldMatrix;
+	XMFLOAT3 c = bounds.center;
+	XMFLOAT3 center(
+		m._11 * c.x + m._12 * c.y + m._13 * c.z + m._14,
+		m._21 * c.x + m._22 * c.y + m._23 * c.z + m._24,
+		m._31 * c.x + m._32 * c.y + m._33 * c.z + m._34);
+
+	float scaleX = m._11 * m._11 + m._21 * m._21 + m._31 * m._31;
+	float scaleY = m._12 * m._12 + m._22 * m._22 + m._32 * m._32;
+	float scaleZ = m._13 * m._13 + m._23 * m._23 + m._33 * m._33;
+	float scale = sqrtf(std::max(scaleX, std::max(scaleY, scaleZ)));
+
+	return Select(center, bounds.radius * scale, currentLevel, levelCount);
+}
+
+// --------------------------------------------------------
+// Sizes are compared squared, as (r * scale)^2 / d^2 against
+// each threshold squared - no square root, and an eye inside
+// a sphere just makes it big
+// - Levels step from the one the object had, so one that stays
+//   put - nearly all of them, frame to frame - costs a compare
+//   each way
+// - Culled objects come back on their mesh's last level, and
+//   only once they're the band over the cull size
+// --------------------------------------------------------
+int LodSelector::Select(const XMFLOAT3 & center, float radius, int currentLevel, int levelCount)
+{
+	float dx = center.x - eye.x;
+	float dy = center.y - eye.y;
+	float dz = center.z - eye.z;
+	float sizeSq = radius * radius * pixelScaleSq / (dx * dx + dy * dy + dz * dz);
+
+	stats.objects++;
+	if (sizeSq < cullSq || (currentLevel < 0 && sizeSq < uncullSq))
+	{
+		stats.culled++;
+		stats.changed += currentLevel != Culled ? 1 : 0;
+		return Culled;
+	}
+
+	int lastLevel = std::min(std::max(levelCount - 1, 0), LodStats::MaxLevels - 1);
+	int level = currentLevel < 0 ? lastLevel : std::min(currentLevel, lastLevel);
+	while (level < lastLevel && level < (int)thresholdCount && sizeSq < coarserSq[level])
+		level++;
+	while (level > 0 && sizeSq >= finerSq[level - 1])
+		level--;
+
+	stats.levels[level]++;
+	stats.changed += level != currentLevel ? 1 : 0;
+	return level;
+}
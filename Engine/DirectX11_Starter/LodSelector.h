@@ -0,0 +1,81 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "MeshData.h"
+
+// --------------------------------------------------------
+// What LodSelector picked since the last BeginFrame(), for
+// tuning the thresholds - objects are counted once each
+// --------------------------------------------------------
+struct LodStats
+{
+	static const int MaxLevels = 8;
+
+	unsigned int objects;
+	unsigned int culled;               // Too small on screen to draw at all
+	unsigned int changed;              // On a different level than they were given (or culled, or back)
+	unsigned int levels[MaxLevels];    // How many ended up on each level
+};
+
+// --------------------------------------------------------
+// Picks each object's level of detail from how big its bounding
+// sphere is on screen
+// - Size is the sphere's diameter in pixels, from the distance
+//   to its center - turning the camera doesn't change it
+// - Level k + 1 starts below the k'th threshold; each mesh's
+//   levels stop at its own last one
+// - An object only moves to another level once it's past that
+//   threshold by the hysteresis band, so one sitting right on
+//   it doesn't flicker between the two. It needs to be given
+//   the level it had last frame for that
+// - Anything smaller than the cull size is dropped - it would
+//   only cover a pixel or two anyway
+// --------------------------------------------------------
+class LodSelector
+{
+public:
+	static const int Culled = -1;
+
+	LodSelector();
+
+	// A (transposed, as stored for HLSL) perspective projection
+	// and the viewport's height in pixels - has to be set before
+	// BeginFrame()
+	void SetProjection(const DirectX::XMFLOAT4X4& projection, float viewportHeight);
+
+	// Pixel sizes where each coarser level starts, largest first -
+	// up to LodStats::MaxLevels - 1 of them
+	void SetThresholds(const float* sizes, unsigned int count);
+
+	// A fraction of each threshold - 0.15 means moving to a coarser
+	// level at 85% of it, and back at 115%
+	void SetHysteresis(float band) { hysteresis = band; }
+	void SetCullSize(float pixels) { cullSize = pixels; }
+
+	// Starts a frame seen from eye, and clears the stats
+	void BeginFrame(const DirectX::XMFLOAT3& eye);
+
+	// Picks a level for an object's mesh bounds, moved into world
+	// space by its (transposed) world matrix - or Culled.
+	// currentLevel is what it had last frame, or Culled, and
+	// levelCount how many its mesh has
+	int Select(const MeshBounds& bounds, const DirectX::XMFLOAT4X4& worldMatrix, int currentLevel, int levelCount);
+
+	// Same, for a sphere that's already in world space
+	int Select(const DirectX::XMFLOAT3& center, float radius, int currentLevel, int levelCount);
+
+	LodStats GetStats() { return stats; }
+
+private:
+	DirectX::XMFLOAT3 eye;
+	float pixelScaleSq;                  // Squared diameter in pixels of a unit radius sphere at distance 1
+	float thresholds[LodStats::MaxLevels - 1];
+	float coarserSq[LodStats::MaxLevels - 1];    // Squared thresholds moved down and up by the band
+	float finerSq[LodStats::MaxLevels - 1];
+	unsigned int thresholdCount;
+	float hysteresis;
+	float cullSize;
+	float cullSq;                        // Squared cull size moved down, and up for coming back
+	float uncullSq;
+	LodStats stats;
+};
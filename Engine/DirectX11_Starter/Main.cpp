@@ -74,9 +74,18 @@ Main::Main(HINSTANCE hInstance)
 	windowHeight = 600;
 
 	//initialize
-	meshOne = nullptr;
+	meshCache = nullptr;
+	meshLoader = nullptr;
+	packedVertexShader = nullptr;
+	instancedVertexShader = nullptr;
+	instanceBuffer = nullptr;
+	instanceCapacity = 0;
+	selectedHit = PickHit();
 
 	cam = new Camera(); 
+	transforms = new TransformStore();
+	world = new World();
+	threadPool = new ThreadPool();
 
 	leftmouseHeld = false; 
 	middlemouseHeld = false; 
@@ -93,19 +102,27 @@ Main::~Main()
 	// Release any D3D stuff that's still hanging out
 	ReleaseMacro(vertexBuffer);
 	ReleaseMacro(indexBuffer);
+	ReleaseMacro(instanceBuffer);
 
 	// Delete our simple shaders
 	delete vertexShader;
+	delete packedVertexShader;
+	delete instancedVertexShader;
 	delete pixelShader;
 
-	// Delete Meshes
-	delete meshOne;
+	// Stop loading before the meshes go away
+	delete meshLoader;
+	delete meshCache;
+
+	// Release our handle - the mesh goes once the entities' do too
+	meshOne.reset();
 
 	//Delete Entities
-	for (int i = 0; i < MAX_ENTITIES; i++)
-	{
-		delete entities[i]; 
-	}
+	delete world;
+
+	// After the entities, which give their slots back on the way out
+	delete transforms;
+	delete threadPool;
 	
 	//Delete Material
 	delete material;
@@ -135,6 +152,18 @@ bool Main::Init()
 	//  - For your own projects, feel free to expand/replace these.
 
 	LoadShaders();
+
+	// Meshes are shared by content, and processed results are kept
+	// on disk so unchanged files skip parsing on the next run
+	meshCache = new MeshCache([this](MeshData& data, const MeshImportOptions& options)
+	{
+		return MeshHandle(new Mesh(data, device, options.vertexFormat));
+	}, "MeshCache");
+
+	// Meshes are read and processed on worker threads; only the
+	// final buffer creation happens here, in UpdateScene()
+	meshLoader = new MeshLoader(meshCache);
+
 	//CreateGeometry();
 	CreateMatrices();
 
@@ -202,6 +231,30 @@ void Main::LoadShaders()
 	vertexShader = new SimpleVertexShader(device, deviceContext);
 	vertexShader->LoadShaderFile(L"VertexShader.cso");
 
+	// Reflection would guess 32-bit floats for every input, so the
+	// packed shader gets its input layout built by hand
+	ID3DBlob* packedBlob = nullptr;
+	if (SUCCEEDED(D3DReadFileToBlob(L"PackedVertexShader.cso", &packedBlob)))
+	{
+		ID3D11InputLayout* packedLayout = Mesh::CreatePackedInputLayout(device, packedBlob->GetBufferPointer(), packedBlob->GetBufferSize());
+		packedBlob->Release();
+
+		packedVertexShader = new SimpleVertexShader(device, deviceContext, packedLayout);
+		packedVertexShader->LoadShaderFile(L"PackedVertexShader.cso");
+	}
+
+	// Same for the instanced one - reflection can't tell which
+	// inputs step per instance
+	ID3DBlob* instancedBlob = nullptr;
+	if (SUCCEEDED(D3DReadFileToBlob(L"InstancedVertexShader.cso", &instancedBlob)))
+	{
+		ID3D11InputLayout* instancedLayout = Mesh::CreateInstancedInputLayout(device, instancedBlob->GetBufferPointer(), instancedBlob->GetBufferSize());
+		instancedBlob->Release();
+
+		instancedVertexShader = new SimpleVertexShader(device, deviceContext, instancedLayout);
+		instancedVertexShader->LoadShaderFile(L"InstancedVertexShader.cso");
+	}
+
 	pixelShader = new SimplePixelShader(device, deviceContext);
 	pixelShader->LoadShaderFile(L"PixelShader.cso");
 }
@@ -224,7 +277,16 @@ void Main::CreateGeometry()
 
 
 	//meshOne = new Mesh(vertices, (int)sizeof(vertices), indices, sizeof(indices), device);
-	meshOne = new Mesh("Models/cube.obj", device); 
+	// Load in the background - entities start without a mesh and
+	// get it as soon as it's ready
+	meshLoader->Load("Models/cube.obj", 0, MeshImportOptions(), [this](MeshHandle mesh)
+	{
+		meshOne = mesh;
+		world->ForEach<RenderComponent>([&mesh](EntityId, RenderComponent& render)
+		{
+			render.mesh = mesh;
+		});
+	});
 
 	//Create Material 
 	material = new Material(vertexShader, pixelShader); 
@@ -234,27 +296,26 @@ void Main::CreateGeometry()
 	//Entity* e3 = new Entity(meshTwo, material);
 
 	
-	// Organize fixed amount of entities in array 
-	for (int i = 0; i < MAX_ENTITIES; ++i)
-	{
-		entities[i] = new Entity(meshOne, material);
-		// make entities tiny
-		entities[i]->SetScale(0.25f, 0.25f, 0.25f);
-	}
+	// Lay out a grid of entities, 5 to a row 
+	const int entityCount = 100;
 	float xPos = 0.0f; 
 	float yPos = 0.0f; 
-	for (int i = 0; i < MAX_ENTITIES; ++i)
+	for (int i = 0; i < entityCount; ++i)
 	{
+		Entity entity = Entity::Create(world, transforms, meshOne, material);
+		// make entities tiny
+		entity.SetScale(0.25f, 0.25f, 0.25f);
+
 		if (i % 5 == 0)
 		{
 			xPos = 0.0f; 
 			yPos -= 0.75f; 
-			entities[i]->Move(xPos, yPos, 0);
+			entity.Move(xPos, yPos, 0);
 		}
 		else
 		{
 			xPos += 0.75f;
-			entities[i]->Move(xPos, yPos , 0);	
+			entity.Move(xPos, yPos , 0);	
 		}
 		
 	}
@@ -335,24 +396,38 @@ void Main::UpdateScene(float deltaTime, float totalTime)
 	float buffer = 1.5f; 
 	
 	// Manipulate matrices
-	for (auto& i : entities)
+	world->ForEach<TransformComponent>([&](EntityId id, TransformComponent& transform)
 	{
-		//i->Rotate(0, rotation, 0);
-	}
+		//Entity(world, id).Rotate(0, rotation, 0);
+	});
 
 
 	// Input
-	//if (leftmouseHeld) { entities[0]->Move(speed, 0, 0); }
-	//if (middlemouseHeld) { entities[1]->Move(speed, 0, 0); }
-	//if (rightmouseHeld) { entities[2]->Move(speed, 0, 0); }
+	//if (leftmouseHeld) { Entity(world, 0).Move(speed, 0, 0); }
+	//if (middlemouseHeld) { Entity(world, 1).Move(speed, 0, 0); }
+	//if (rightmouseHeld) { Entity(world, 2).Move(speed, 0, 0); }
 
 
-	//update all entities 
-	for (auto& i : entities)
+	// Anything SceneGenerator made move goes where its motion
+	// says it is by now
+	world->ForEach<TransformComponent, MotionComponent>([totalTime](EntityId id, TransformComponent& transform, MotionComponent& motion)
 	{
-		//i->updateScene(); 
-	}
+		XMFLOAT3 position;
+		XMFLOAT4 rotation;
+		SceneGenerator::Animate(motion, totalTime, position, rotation);
+		transform.store->SetPosition(transform.index, position);
+		transform.store->SetRotation(transform.index, rotation);
+	});
+
+	// Rebuild the world matrices of whatever moved (and whatever is
+	// attached to it) - several at a time, straight out of the
+	// transform arrays - static scenery costs nothing
+	transforms->UpdateDirtyWorldMatrices(threadPool);
 	
+	// Create GPU buffers for meshes that finished loading - a couple
+	// per frame at most, so a burst of loads can't cause a hitch
+	meshLoader->Update(2);
+
 	//update Camera and it's input
 	cam->cameraInput(deltaTime); 
 	cam->update(deltaTime);
@@ -389,19 +464,134 @@ void Main::DrawScene(float deltaTime, float totalTime)
 	vertexShader->SetShader(true);
 	pixelShader->SetShader(true);
 
-	for (auto& i : entities)
+	// Only what the camera can see - the world space bounds of
+	// everything with a mesh, tested several at a time. Adding
+	// them in the same order each frame lets the culler reuse
+	// last frame's answer for whatever hasn't moved
+	culler.Clear();
+	world->ForEach<TransformComponent, RenderComponent>([this](EntityId id, TransformComponent& transform, RenderComponent& render)
+	{
+		if (render.mesh != nullptr)
+			culler.Add(id, render.mesh->GetBounds(), *transform.store->GetWorldMatrix(transform.index));
+	});
+	culler.CullCoherent(cam->getFrustum(), visibleEntities);
+
+	// Then, if anything is marked as an occluder, drop what's
+	// hidden behind it - occluders are drawn into a small CPU
+	// depth buffer and the survivors' boxes tested against it
+	if (world->Count<OccluderComponent>() > 0)
+	{
+		occlusionCuller.BeginFrame(cam->getViewProjectionMatrix());
+		world->ForEach<TransformComponent, OccluderComponent>([this](EntityId id, TransformComponent& transform, OccluderComponent& occluder)
+		{
+			if (occluder.mesh != nullptr)
+				occlusionCuller.AddOccluder(*occluder.mesh, *transform.store->GetWorldMatrix(transform.index));
+		});
+		occlusionCuller.RenderOccluders(threadPool);
+
+		visibleBounds.resize(visibleEntities.size());
+		for (size_t i = 0; i < visibleEntities.size(); i++)
+		{
+			Entity entity(world, visibleEntities[i]);
+			visibleBounds[i] = Aabb::FromBounds(entity.GetMesh()->GetBounds(), *entity.GetWorldMatrix());
+		}
+		if (!visibleEntities.empty())
+			occlusionCuller.Cull(&visibleBounds[0], &visibleEntities[0], (unsigned int)visibleEntities.size(), unoccludedEntities, threadPool);
+		else
+			unoccludedEntities.clear();
+		visibleEntities.swap(unoccludedEntities);
+	}
+
+	// Pick each one's level of detail from how big it is on
+	// screen - anything only a pixel or two across isn't drawn
+	lodSelector.SetProjection(cam->getProjectionMatrix(), (float)windowHeight);
+	lodSelector.BeginFrame(cam->getPosition());
+	size_t keptCount = 0;
+	for (EntityId id : visibleEntities)
+	{
+		TransformComponent* transform = world->Get<TransformComponent>(id);
+		RenderComponent* render = world->Get<RenderComponent>(id);
+		int level = lodSelector.Select(render->mesh->GetBounds(), *transform->store->GetWorldMatrix(transform->index),
+			render->tooSmall ? LodSelector::Culled : render->lod, render->mesh->GetLodCount());
+		render->tooSmall = level == LodSelector::Culled;
+		if (level == LodSelector::Culled)
+			continue;
+		render->lod = level;
+		visibleEntities[keptCount++] = id;
+	}
+	visibleEntities.resize(keptCount);
+
+	// Queue what's left and draw it in the queue's order - by
+	// material and mesh, so state changes as seldom as possible,
+	// and front to back within each so nearer things hide what's
+	// behind them before it's shaded. Depth is along the view
+	// direction, over the camera's near and far planes
+	XMFLOAT3 eye = cam->getPosition();
+	XMFLOAT3 forward = cam->getForward();
+	renderQueue.SetDepthRange(cam->getNearPlane(), cam->getFarPlane());
+	renderQueue.Clear();
+	for (EntityId id : visibleEntities)
+	{
+		TransformComponent* transform = world->Get<TransformComponent>(id);
+		RenderComponent* render = world->Get<RenderComponent>(id);
+		const XMFLOAT4X4& matrix = *transform->store->GetWorldMatrix(transform->index);
+		float depth = (matrix._14 - eye.x) * forward.x + (matrix._24 - eye.y) * forward.y + (matrix._34 - eye.z) * forward.z;
+		renderQueue.Add(RENDER_PASS_OPAQUE, render->material != nullptr ? render->material->id : Material::NoId, render->mesh->GetId(), depth, id);
+	}
+	renderQueue.Sort();
+
+	// Neighbors in the queue that share a material, mesh and level
+	// of detail go out as one instanced draw. Packed meshes don't
+	// match the instanced input layout, so they're left to the
+	// loop after, one draw each with the packed vertex shader.
+	// Nothing without a material is drawn by either
+	auto instanced = [this](RenderComponent* render)
+	{
+		return instancedVertexShader != nullptr && render->material != nullptr &&
+			render->mesh->GetVertexFormat() == VERTEX_FORMAT_FULL;
+	};
+	instanceBatcher.Clear();
+	for (unsigned int q = 0; q < renderQueue.GetCount(); q++)
+	{
+		EntityId id = renderQueue.GetPayload(q);
+		RenderComponent* render = world->Get<RenderComponent>(id);
+		if (!instanced(render))
+			continue;
+		TransformComponent* transform = world->Get<TransformComponent>(id);
+		instanceBatcher.Add(render->material != nullptr ? render->material->id : Material::NoId, render->mesh->GetId(), render->lod, id,
+			*transform->store->GetWorldMatrix(transform->index));
+	}
+	DrawInstanced();
+
+	XMFLOAT4X4 view = cam->getViewMatrix();
+	XMFLOAT4X4 projection = cam->getProjectionMatrix();
+	for (unsigned int q = 0; q < renderQueue.GetCount(); q++)
 	{ 
+		RenderComponent* render = world->Get<RenderComponent>(renderQueue.GetPayload(q));
+		if (instanced(render) || render->material == nullptr)
+			continue;
+		Entity i(world, renderQueue.GetPayload(q));
+
+		// Packed vertices can't go through the material's shader
+		SimpleVertexShader* shader = render->material->vertexShader;
+		if (render->mesh->GetVertexFormat() == VERTEX_FORMAT_PACKED)
+		{
+			if (packedVertexShader == nullptr)
+				continue;
+			shader = packedVertexShader;
+		}
+
 		// Send data to shader variables
 		//  - Do this ONCE PER OBJECT you're drawing
 		//  - This is actually a complex process of copying data to a local buffer
 		//    and then copying that entire buffer to the GPU.  
 		//  - The "SimpleShader" class handles all of that for you.
-		//i->prepareMaterial(cam->getViewMatrix(), cam->getProjectionMatrix());
+		i.prepareMaterial(view, projection, shader);
 		//draw here 
-		//i->drawScene(deviceContext);
+		i.drawScene(deviceContext, cam);
 
 
-		//i->drawDeferred(deferredContext, commandList);
+		//i.drawDeferred(deferredContext, commandList);
 
 		// Wait for completion of command list
 		//deferredContext->FinishCommandList(FALSE, &commandList);
@@ -410,6 +600,7 @@ void Main::DrawScene(float deltaTime, float totalTime)
 		//deviceContext->ExecuteCommandList(commandList, FALSE);
 	}
 
+
 	//Execute deferred commands
 	//deviceContext->ExecuteCommandList(commandList, FALSE);
 	
@@ -424,6 +615,65 @@ void Main::DrawScene(float deltaTime, float totalTime)
 
 
 
+// --------------------------------------------------------
+// Copies every batch's world matrices into the instance buffer
+// at once - growing it first if there are more than it holds -
+// then draws each batch from its own range of it
+// --------------------------------------------------------
+void Main::DrawInstanced()
+{
+	unsigned int count = instanceBatcher.GetInstanceCount();
+	if (count == 0)
+		return;
+
+	if (count > instanceCapacity)
+	{
+		ReleaseMacro(instanceBuffer);
+		instanceCapacity = count > instanceCapacity * 2 ? count : instanceCapacity * 2;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = instanceCapacity * InstanceBatcher::InstanceBytes;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		HR(device->CreateBuffer(&desc, nullptr, &instanceBuffer));
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	HR(deviceContext->Map(instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	memcpy(mapped.pData, instanceBatcher.GetInstances(), count * InstanceBatcher::InstanceBytes);
+	deviceContext->Unmap(instanceBuffer, 0);
+
+	// The camera's the same for every batch
+	instancedVertexShader->SetMatrix4x4("view", cam->getViewMatrix());
+	instancedVertexShader->SetMatrix4x4("projection", cam->getProjectionMatrix());
+	instancedVertexShader->SetShader(true);
+
+	Material* boundMaterial = nullptr;
+	for (unsigned int b = 0; b < instanceBatcher.GetBatchCount(); b++)
+	{
+		const InstanceBatch& batch = instanceBatcher.GetBatch(b);
+		RenderComponent* render = world->Get<RenderComponent>(batch.id);
+		if (render->material == nullptr)
+			continue;
+		if (render->material != boundMaterial)
+		{
+			render->material->pixelShader->SetShader(true);
+			boundMaterial = render->material;
+		}
+
+		Mesh* mesh = render->mesh.get();
+		ID3D11Buffer* buffers[2] = { mesh->GetVertexBuffer(), instanceBuffer };
+		UINT strides[2] = { mesh->GetVertexStride(), InstanceBatcher::InstanceBytes };
+		UINT offsets[2] = { 0, 0 };
+		deviceContext->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+		deviceContext->IASetIndexBuffer(mesh->GetIndexBuffer(), mesh->GetIndexFormat(), 0);
+
+		MeshLod level = mesh->GetLod(batch.lod);
+		deviceContext->DrawIndexedInstanced(level.indexCount, batch.instanceCount, level.indexStart, 0, batch.firstInstance);
+	}
+}
+
 #pragma endregion
 
 #pragma region Mouse Input
@@ -446,6 +696,8 @@ void Main::OnMouseDown(WPARAM btnState, int x, int y)
 	if (btnState & 0x0002) { /* Right button is down */ rightmouseHeld = true; } else { rightmouseHeld = false; }
 	if (btnState & 0x0010) { /* Middle button is down */ middlemouseHeld = true; } else { middlemouseHeld = false; }
 	
+	if (leftmouseHeld)
+		PickEntity(x, y);
 
 
 	// Caputure the mouse so we keep getting mouse move
@@ -454,6 +706,25 @@ void Main::OnMouseDown(WPARAM btnState, int x, int y)
 	SetCapture(hMainWnd);
 }
 
+// --------------------------------------------------------
+// Selects the entity under the cursor, if there is one - its
+// bounds first, then the exact triangles of its mesh
+// --------------------------------------------------------
+void Main::PickEntity(int x, int y)
+{
+	picker.Clear();
+	world->ForEach<TransformComponent, RenderComponent>([this](EntityId id, TransformComponent& transform, RenderComponent& render)
+	{
+		if (render.mesh != nullptr)
+			picker.Add(id, render.mesh->GetBounds(), *transform.store->GetWorldMatrix(transform.index), render.mesh->GetTriangleBvh());
+	});
+
+	XMFLOAT3 origin, direction;
+	Picker::ScreenRay((float)x, (float)y, (float)windowWidth, (float)windowHeight, cam->getViewProjectionMatrix(), origin, direction);
+
+	selectedEntity = picker.Pick(origin, direction, selectedHit) ? Entity(world, selectedHit.id) : Entity();
+}
+
 // --------------------------------------------------------
 // Helper method for mouse release
 //
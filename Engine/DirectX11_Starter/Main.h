@@ -6,8 +6,16 @@
 #include "DirectXGameCore.h"
 #include "SimpleShader.h"
 #include "Mesh.h"
+#include "MeshLoader.h"
 #include "Entity.h"
 #include "Camera.h"
+#include "FrustumCuller.h"
+#include "InstanceBatcher.h"
+#include "LodSelector.h"
+#include "OcclusionCuller.h"
+#include "Picker.h"
+#include "RenderQueue.h"
+#include "SceneGenerator.h"
 #include "Lights.h"
 #include "InputManager.h";
 #include "vld.h"
@@ -40,6 +48,11 @@ public:
 	void OnMouseUp(WPARAM btnState, int x, int y);
 	void OnMouseMove(WPARAM btnState, int x, int y);
 
+	// What the last left click landed on - an empty Entity and a
+	// hit with hit == false if it missed
+	Entity GetSelectedEntity() { return selectedEntity; }
+	const PickHit& GetSelectedHit() { return selectedHit; }
+
 private:
 	// Initialization for our "game" demo - Feel free to
 	// expand, alter, rename or remove these once you
@@ -47,17 +60,42 @@ private:
 	void LoadShaders(); 
 	void CreateGeometry();
 	void CreateMatrices();
+	void PickEntity(int x, int y);
+	void DrawInstanced();
 
 	//Meshes
-	Mesh* meshOne;
+	MeshHandle meshOne;
+	MeshCache* meshCache;
+	MeshLoader* meshLoader;
 
 	//Entities 
-	int MAX_ENTITIES = 100; 
-	Entity* entities[100]; 
+	World* world;
+	TransformStore* transforms;
+	ThreadPool* threadPool;
 
 	//Camera
 	Camera* cam; 
 
+	//Culling - reused every frame
+	FrustumCuller culler;
+	OcclusionCuller occlusionCuller;
+	std::vector<unsigned int> visibleEntities;
+	std::vector<unsigned int> unoccludedEntities;
+	std::vector<Aabb> visibleBounds;
+	LodSelector lodSelector;
+
+	//Drawing - visible entities in the order they're drawn, and
+	//runs of them that share a mesh and material as instances
+	RenderQueue renderQueue;
+	InstanceBatcher instanceBatcher;
+	ID3D11Buffer* instanceBuffer;
+	unsigned int instanceCapacity;
+
+	//Picking - what the last left click landed on
+	Picker picker;
+	Entity selectedEntity;
+	PickHit selectedHit;
+
 	//Material 
 	Material* material; 
 
@@ -82,6 +120,8 @@ private:
 
 	// Wrappers for DirectX shaders to provide simplified functionality
 	SimpleVertexShader* vertexShader;
+	SimpleVertexShader* packedVertexShader;   // For VERTEX_FORMAT_PACKED meshes
+	SimpleVertexShader* instancedVertexShader;   // For instanceBatcher's batches
 	SimplePixelShader* pixelShader;
 
 	// The matrices to go from model space to screen space
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// Read-only memory mapping of a whole file
+// - Uses CreateFileMapping on Windows and mmap elsewhere, so the
+//   CPU-side loaders can also be built and profiled on Linux
+// - The mapping lives as long as the object does
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Not copyable - the object owns the OS handles
+	MappedFile(MappedFile const&) = delete;
+	void operator=(MappedFile const&) = delete;
+
+	bool Open(const char* filename);
+	void Close();
+
+	bool IsOpen() { return data != nullptr; }
+	const char* GetData() { return data; }
+	size_t GetSize() { return size; }
+
+private:
+	const char* data;
+	size_t size;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+};
@@ -1,17 +1,25 @@
 #include "Material.h"
+#include <atomic>
 
+namespace
+{
+	// Starts past NoId, so no real material ever gets it
+	std::atomic<unsigned int> nextId(Material::NoId + 1);
+}
 
 
 Material::Material()
 {
 	vertexShader = nullptr; 
 	pixelShader = nullptr; 
+	id = nextId++;
 }
 
 Material::Material(SimpleVertexShader * vShader, SimplePixelShader* pShader)
 {
 	vertexShader = vShader; 
 	pixelShader = pShader; 
+	id = nextId++;
 }
 
 
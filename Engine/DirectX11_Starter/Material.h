@@ -9,5 +9,12 @@ public:
 	
 	SimpleVertexShader* vertexShader; 
 	SimplePixelShader* pixelShader; 
+
+	// Small and different for every material - what the render
+	// queue groups draws by
+	unsigned int id;
+
+	// What stands in for the id of an entity with no material
+	static const unsigned int NoId = 0;
 };
 
@@ -1,191 +1,181 @@
 #include "Mesh.h"
+#include <atomic>
 // For the DirectX Math library
 using namespace DirectX;
 
+namespace
+{
+	// Meshes can be made from more than one thread
+	std::atomic<unsigned int> nextId(0);
+}
+
 
 Mesh::Mesh()
 {
+	vertexBuffer = nullptr;
+	indexBuffer = nullptr;
+	indexCount = 0;
+	vertexCount = 0;
+	importStats = {};
+	bounds = MeshBuilder::ComputeBounds(nullptr, 0);
+	vertexFormat = VERTEX_FORMAT_FULL;
+	vertexStride = sizeof(Vertex);
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	positionScale = VertexCompressor::ComputeScale(bounds);
+	compressionStats = {};
+	id = nextId++;
 }
 
 
 Mesh::~Mesh()
 {
-	vertexBuffer->Release(); 
-	indexBuffer->Release(); 
+	ReleaseMacro(vertexBuffer);
+	ReleaseMacro(indexBuffer);
 }
 
 Mesh::Mesh(Vertex vertices[], int numVerts, unsigned int indices[], int numIndices, ID3D11Device * device)
 {
-	
-	// Create the VERTEX BUFFER description -----------------------------------
-	// - The description is created on the stack because we only need
-	//    it to create the buffer.  The description is then useless.
-	D3D11_BUFFER_DESC vbd;
-	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * 3;       // 3 = number of vertices in the buffer
-	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
-	vbd.CPUAccessFlags = 0;
-	vbd.MiscFlags = 0;
-	vbd.StructureByteStride = 0;
+	vertexBuffer = nullptr;
+	indexBuffer = nullptr;
+	importStats = {};
+	compressionStats = {};
+	id = nextId++;
+	importStats.weld.inputVertices = numVerts;
+	importStats.weld.outputVertices = numVerts;
+	CreateBuffers(vertices, numVerts, indices, sizeof(unsigned int), numIndices, device);
+	BuildTriangleBvh(vertices, indices, sizeof(unsigned int));
+}
 
-	// Create the proper struct to hold the initial vertex data
-	// - This is how we put the initial data into the buffer
-	D3D11_SUBRESOURCE_DATA initialVertexData;
-	initialVertexData.pSysMem = vertices;
+Mesh::Mesh(char * filename, ID3D11Device * device, const MeshImportOptions& options)
+{
+	vertexBuffer = nullptr;
+	indexBuffer = nullptr;
+	indexCount = 0;
+	vertexCount = 0;
+	importStats = {};
+	bounds = MeshBuilder::ComputeBounds(nullptr, 0);
+	vertexFormat = VERTEX_FORMAT_FULL;
+	vertexStride = sizeof(Vertex);
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	positionScale = VertexCompressor::ComputeScale(bounds);
+	compressionStats = {};
+	id = nextId++;
+
+	// Memory map and parse the whole file up front
+	// - See ObjParser for the details (threads, n-gons, etc.)
+	MeshData data;
+	if (!MeshBuilder::LoadObj(filename, data))
+		return;
 
-	// Actually create the buffer with the initial data
-	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	HR(device->CreateBuffer(&vbd, &initialVertexData, &vertexBuffer));
+	// The parser emits one vertex per triangle corner, so weld the
+	// shared ones into a real index buffer and then optimize it
+	importStats = MeshBuilder::Process(data, options);
 
-	// Create the INDEX BUFFER description ------------------------------------
-	// - The description is created on the stack because we only need
-	//    it to create the buffer.  The description is then useless.
-	D3D11_BUFFER_DESC ibd;
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(int) * 3;         // 3 = number of indices in the buffer
-	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER; // Tells DirectX this is an index buffer
-	ibd.CPUAccessFlags = 0;
-	ibd.MiscFlags = 0;
-	ibd.StructureByteStride = 0;
+	CreateBuffers(&data.vertices[0], (int)data.vertices.size(), &data.indices[0], sizeof(unsigned int), (int)data.indices.size(), device, options.vertexFormat);
+	SetLods(data.lods.empty() ? nullptr : &data.lods[0], (unsigned int)data.lods.size());
+	SetMeshlets(data.meshlets.empty() ? nullptr : &data.meshlets[0], (unsigned int)data.meshlets.size());
+	BuildTriangleBvh(&data.vertices[0], &data.indices[0], sizeof(unsigned int));
+}
 
-	// Create the proper struct to hold the initial index data
-	// - This is how we put the initial data into the buffer
-	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = indices;
-	indexCount = numIndices;
+Mesh::Mesh(MeshData & data, ID3D11Device * device, MeshVertexFormat format)
+{
+	vertexBuffer = nullptr;
+	indexBuffer = nullptr;
+	indexCount = 0;
+	vertexCount = 0;
+	importStats = {};
+	bounds = MeshBuilder::ComputeBounds(nullptr, 0);
+	vertexFormat = VERTEX_FORMAT_FULL;
+	vertexStride = sizeof(Vertex);
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	positionScale = VertexCompressor::ComputeScale(bounds);
+	compressionStats = {};
+	id = nextId++;
+	importStats.weld.inputVertices = (unsigned int)data.vertices.size();
+	importStats.weld.outputVertices = (unsigned int)data.vertices.size();
+
+	if (data.vertices.empty() || data.indices.empty())
+		return;
 
-	// Actually create the buffer with the initial data
-	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	HR(device->CreateBuffer(&ibd, &initialIndexData, &indexBuffer));
+	CreateBuffers(&data.vertices[0], (int)data.vertices.size(), &data.indices[0], sizeof(unsigned int), (int)data.indices.size(), device, format);
+	SetLods(data.lods.empty() ? nullptr : &data.lods[0], (unsigned int)data.lods.size());
+	SetMeshlets(data.meshlets.empty() ? nullptr : &data.meshlets[0], (unsigned int)data.meshlets.size());
+	BuildTriangleBvh(&data.vertices[0], &data.indices[0], sizeof(unsigned int));
 }
 
-Mesh::Mesh(char * filename, ID3D11Device * device)
+Mesh::Mesh(CookedMesh & cooked, ID3D11Device * device, MeshVertexFormat format)
 {
-	// File input object
-	std::ifstream obj(filename); // <-- Replace filename with your parameter
-
-								 // Check for successful open
-	if (!obj.is_open())
+	vertexBuffer = nullptr;
+	indexBuffer = nullptr;
+	indexCount = 0;
+	vertexCount = 0;
+	importStats = {};
+	bounds = MeshBuilder::ComputeBounds(nullptr, 0);
+	vertexFormat = VERTEX_FORMAT_FULL;
+	vertexStride = sizeof(Vertex);
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	positionScale = VertexCompressor::ComputeScale(bounds);
+	compressionStats = {};
+	id = nextId++;
+
+	if (!cooked.IsOpen())
 		return;
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;     // Positions from the file
-	std::vector<XMFLOAT3> normals;       // Normals from the file
-	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
-	unsigned int vertCounter = 0;        // Count of vertices/indices
-	char chars[100];                     // String for line reading
-
-										 // Still good?
-	while (obj.good())
+	importStats.weld.inputVertices = cooked.GetVertexCount();
+	importStats.weld.outputVertices = cooked.GetVertexCount();
+
+	// The mapped sections go straight to CreateBuffer - indices
+	// were already cooked 16-bit where they fit, so the only copy
+	// is for packing the vertices
+	CreateBuffers(cooked.GetVertices(), cooked.GetVertexCount(), cooked.GetIndices(), cooked.GetIndexStride(), cooked.GetIndexCount(),
+		device, format);
+	bounds = cooked.GetBounds();
+	SetLods(cooked.GetLods(), cooked.GetLodCount());
+	SetMeshlets(cooked.GetMeshlets(), cooked.GetMeshletCount());
+	BuildTriangleBvh(cooked.GetVertices(), cooked.GetIndices(), cooked.GetIndexStride());
+}
+
+void Mesh::CreateBuffers(const Vertex vertices[], int numVerts, const void* indices, unsigned int indexStride, int numIndices,
+	ID3D11Device * device, MeshVertexFormat format)
+{
+	// Object space bounds, for culling and the like
+	bounds = MeshBuilder::ComputeBounds(vertices, numVerts);
+	positionScale = VertexCompressor::ComputeScale(bounds);
+	vertexFormat = format;
+	vertexStride = format == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+
+	// Packed vertices are encoded into a temporary copy, and the
+	// error that introduces is kept around for reporting
+	std::vector<PackedVertex> packed;
+	const void* vertexData = vertices;
+	if (format == VERTEX_FORMAT_PACKED)
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
-
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Read the 9 face indices into an array
-			unsigned int i[9];
-			sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8]);
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Add the verts to the vector
-			verts.push_back(v1);
-			verts.push_back(v2);
-			verts.push_back(v3);
-
-			// Add three more indices
-			indices.push_back(vertCounter++);
-			indices.push_back(vertCounter++);
-			indices.push_back(vertCounter++);
-		}
+		packed.resize(numVerts);
+		VertexCompressor::Encode(vertices, numVerts, positionScale, &packed[0]);
+		vertexData = &packed[0];
+		compressionStats = VertexCompressor::Measure(vertices, numVerts, numIndices);
 	}
 
-	// Close
-	obj.close();
-
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the first int
-	//
-	// - "vertCounter" is BOTH the number of vertices and the number of indices
-
+	// Anything under 65536 vertices can use 16-bit indices - cooked
+	// meshes already come that way, others are narrowed here
+	std::vector<unsigned short> shortIndices;
+	const void* indexData = indices;
+	unsigned int indexSize = indexStride;
+	if (indexStride == sizeof(unsigned int) && VertexCompressor::CanUse16BitIndices(numVerts))
+	{
+		const unsigned int* longIndices = (const unsigned int*)indices;
+		shortIndices.assign(longIndices, longIndices + numIndices);
+		indexData = &shortIndices[0];
+		indexSize = sizeof(unsigned short);
+	}
+	indexFormat = indexSize == sizeof(unsigned short) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 
 	// Create the VERTEX BUFFER description -----------------------------------
 	// - The description is created on the stack because we only need
 	//    it to create the buffer.  The description is then useless.
-	
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * verts.size();       // 3 = number of vertices in the buffer
+	vbd.ByteWidth = vertexStride * numVerts;   // Size of all of the vertices in the buffer
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -194,7 +184,8 @@ Mesh::Mesh(char * filename, ID3D11Device * device)
 	// Create the proper struct to hold the initial vertex data
 	// - This is how we put the initial data into the buffer
 	D3D11_SUBRESOURCE_DATA initialVertexData;
-	initialVertexData.pSysMem = &verts[0];
+	initialVertexData.pSysMem = vertexData;
+	vertexCount = numVerts;
 
 	// Actually create the buffer with the initial data
 	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
@@ -205,7 +196,7 @@ Mesh::Mesh(char * filename, ID3D11Device * device)
 	//    it to create the buffer.  The description is then useless.
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(int) * indices.size();         // 3 = number of indices in the buffer
+	ibd.ByteWidth = indexSize * numIndices;   // Size of all of the indices in the buffer
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER; // Tells DirectX this is an index buffer
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
@@ -214,8 +205,15 @@ Mesh::Mesh(char * filename, ID3D11Device * device)
 	// Create the proper struct to hold the initial index data
 	// - This is how we put the initial data into the buffer
 	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = &indices[0];
-	indexCount = indices.size();
+	initialIndexData.pSysMem = indexData;
+	indexCount = numIndices;
+
+	// Until told otherwise, the whole buffer is one level of detail
+	MeshLod full;
+	full.indexStart = 0;
+	full.indexCount = numIndices;
+	full.error = 0.0f;
+	lods.assign(1, full);
 
 	// Actually create the buffer with the initial data
 	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
@@ -224,8 +222,6 @@ Mesh::Mesh(char * filename, ID3D11Device * device)
 
 
 
-
-
 ID3D11Buffer * Mesh::GetVertexBuffer()
 {
 	return vertexBuffer;
@@ -240,3 +236,161 @@ int Mesh::GetIndexCount()
 {
 	return indexCount;
 }
+
+int Mesh::GetVertexCount()
+{
+	return vertexCount;
+}
+
+// --------------------------------------------------------
+// Replaces the single full-detail level with a LOD chain
+// - Level 0 is what GetIndexCount() reports from then on
+// --------------------------------------------------------
+void Mesh::SetLods(const MeshLod * newLods, unsigned int count)
+{
+	if (newLods == nullptr || count == 0)
+		return;
+
+	lods.assign(newLods, newLods + count);
+	indexCount = lods[0].indexCount;
+}
+
+int Mesh::GetLodCount()
+{
+	return (int)lods.size();
+}
+
+// --------------------------------------------------------
+// Out of range levels are clamped to the closest one we have
+// --------------------------------------------------------
+MeshLod Mesh::GetLod(int level)
+{
+	if (lods.empty())
+	{
+		MeshLod empty = {};
+		return empty;
+	}
+
+	if (level < 0)
+		level = 0;
+	if (level >= (int)lods.size())
+		level = (int)lods.size() - 1;
+	return lods[level];
+}
+
+// --------------------------------------------------------
+// Meshlets are small enough to keep a CPU copy of, since
+// they're tested every frame
+// --------------------------------------------------------
+void Mesh::SetMeshlets(const Meshlet * newMeshlets, unsigned int count)
+{
+	if (newMeshlets == nullptr || count == 0)
+	{
+		meshlets.clear();
+		return;
+	}
+
+	meshlets.assign(newMeshlets, newMeshlets + count);
+}
+
+// --------------------------------------------------------
+// Only level 0 - the other levels are further along the same
+// index buffer, and picking wants the real shape anyway
+// --------------------------------------------------------
+void Mesh::BuildTriangleBvh(const Vertex vertices[], const void* indices, unsigned int indexStride)
+{
+	MeshLod level = GetLod(0);
+	const char* first = (const char*)indices + (size_t)level.indexStart * indexStride;
+	triangleBvh.Build(&vertices[0].Position, sizeof(Vertex), first, indexStride, level.indexCount);
+}
+
+const TriangleBvh * Mesh::GetTriangleBvh()
+{
+	return &triangleBvh;
+}
+
+const Meshlet * Mesh::GetMeshlets()
+{
+	return meshlets.empty() ? nullptr : &meshlets[0];
+}
+
+int Mesh::GetMeshletCount()
+{
+	return (int)meshlets.size();
+}
+
+MeshBounds Mesh::GetBounds()
+{
+	return bounds;
+}
+
+MeshImportStats Mesh::GetImportStats()
+{
+	return importStats;
+}
+
+MeshVertexFormat Mesh::GetVertexFormat()
+{
+	return vertexFormat;
+}
+
+unsigned int Mesh::GetVertexStride()
+{
+	return vertexStride;
+}
+
+DXGI_FORMAT Mesh::GetIndexFormat()
+{
+	return indexFormat;
+}
+
+PackedPositionScale Mesh::GetPositionScale()
+{
+	return positionScale;
+}
+
+VertexCompressionStats Mesh::GetCompressionStats()
+{
+	return compressionStats;
+}
+
+// --------------------------------------------------------
+// Describes PackedVertex to the input assembler - the GPU
+// does the UNORM/SNORM/half to float conversion for free
+// --------------------------------------------------------
+ID3D11InputLayout * Mesh::CreatePackedInputLayout(ID3D11Device * device, const void * shaderBytecode, SIZE_T bytecodeLength)
+{
+	D3D11_INPUT_ELEMENT_DESC elements[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+
+	ID3D11InputLayout* layout = nullptr;
+	HR(device->CreateInputLayout(elements, ARRAYSIZE(elements), shaderBytecode, bytecodeLength, &layout));
+	return layout;
+}
+
+// --------------------------------------------------------
+// The matrix's four rows step once per instance rather than per
+// vertex - D3D11_APPEND_ALIGNED_ELEMENT packs them one after
+// the other
+// --------------------------------------------------------
+ID3D11InputLayout * Mesh::CreateInstancedInputLayout(ID3D11Device * device, const void * shaderBytecode, SIZE_T bytecodeLength)
+{
+	D3D11_INPUT_ELEMENT_DESC elements[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	};
+
+	ID3D11InputLayout* layout = nullptr;
+	HR(device->CreateInputLayout(elements, ARRAYSIZE(elements), shaderBytecode, bytecodeLength, &layout));
+	return layout;
+}
@@ -2,6 +2,10 @@
 
 #include <DirectXMath.h>
 #include "Vertex.h"
+#include "MeshData.h"
+#include "MeshBuilder.h"
+#include "CookedMesh.h"
+#include "TriangleBvh.h"
 #include "DirectXGameCore.h"
 #include <d3d11.h>
 #include <iostream>
@@ -21,16 +25,66 @@ public:
 	Mesh();
 	~Mesh();
 	Mesh(Vertex vertices[], int numVerts, unsigned int tempIndices[], int numIndices, ID3D11Device* device);
-	Mesh(char* filename, ID3D11Device* device);
+	Mesh(char* filename, ID3D11Device* device, const MeshImportOptions& options = MeshImportOptions());
+	Mesh(MeshData& data, ID3D11Device* device, MeshVertexFormat format = VERTEX_FORMAT_FULL);
+	Mesh(CookedMesh& cooked, ID3D11Device* device, MeshVertexFormat format = VERTEX_FORMAT_FULL);
 	ID3D11Buffer* GetVertexBuffer();
 	ID3D11Buffer* GetIndexBuffer();
 	int GetIndexCount();
+	int GetVertexCount();
+	int GetLodCount();
+	MeshLod GetLod(int level);
+	const Meshlet* GetMeshlets();
+	int GetMeshletCount();
+	MeshBounds GetBounds();
+
+	// Small and different for every mesh - what the render queue
+	// groups draws by
+	unsigned int GetId() { return id; }
+	MeshImportStats GetImportStats();
+
+	// Level 0's triangles, for picking - built with the mesh and
+	// shared by everything drawing it
+	const TriangleBvh* GetTriangleBvh();
+
+	// What's actually in the GPU buffers - index buffers are 16-bit
+	// whenever the vertex count allows it
+	MeshVertexFormat GetVertexFormat();
+	unsigned int GetVertexStride();
+	DXGI_FORMAT GetIndexFormat();
+	PackedPositionScale GetPositionScale();
+	VertexCompressionStats GetCompressionStats();
+
+	// Input layout matching PackedVertex, for PackedVertexShader
+	static ID3D11InputLayout* CreatePackedInputLayout(ID3D11Device* device, const void* shaderBytecode, SIZE_T bytecodeLength);
+
+	// Input layout with Vertex in slot 0 and a world matrix per
+	// instance in slot 1, for InstancedVertexShader
+	static ID3D11InputLayout* CreateInstancedInputLayout(ID3D11Device* device, const void* shaderBytecode, SIZE_T bytecodeLength);
 
 
 private: 
+	void CreateBuffers(const Vertex vertices[], int numVerts, const void* indices, unsigned int indexStride, int numIndices,
+		ID3D11Device* device, MeshVertexFormat format = VERTEX_FORMAT_FULL);
+	void SetLods(const MeshLod* newLods, unsigned int count);
+	void SetMeshlets(const Meshlet* newMeshlets, unsigned int count);
+	void BuildTriangleBvh(const Vertex vertices[], const void* indices, unsigned int indexStride);
+
 	ID3D11Buffer* vertexBuffer; 
 	ID3D11Buffer* indexBuffer;
 	int indexCount; 
+	int vertexCount;
+	MeshImportStats importStats;
+	MeshBounds bounds;
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+	TriangleBvh triangleBvh;
+	MeshVertexFormat vertexFormat;
+	unsigned int vertexStride;
+	DXGI_FORMAT indexFormat;
+	PackedPositionScale positionScale;
+	VertexCompressionStats compressionStats;
+	unsigned int id;
 	
 
 };
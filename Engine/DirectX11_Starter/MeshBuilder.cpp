@@ -0,0 +1,300 @@
+#include "MeshBuilder.h"
+#include <cmath>
+#include <cstring>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	// Number of 32-bit words in a weld key (3 pos + 3 normal + 2 uv)
+	const int KeySize = 8;
+
+	// Marks an empty slot in the weld hash table
+	const unsigned int EmptySlot = 0xFFFFFFFF;
+
+	// --------------------------------------------------------
+	// Flat normal of a triangle, used when the file has none
+	// --------------------------------------------------------
+	XMFLOAT3 FaceNormal(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+	{
+		float ux = b.x - a.x, uy = b.y - a.y, uz = b.z - a.z;
+		float vx = c.x - a.x, vy = c.y - a.y, vz = c.z - a.z;
+		XMFLOAT3 n(uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx);
+		float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+		if (length > 0.0f)
+		{
+			n.x /= length;
+			n.y /= length;
+			n.z /= length;
+		}
+		return n;
+	}
+
+	// --------------------------------------------------------
+	// Converts one float into a key word
+	// - Exact mode uses the bit pattern (with -0 folded into +0)
+	// - Epsilon mode uses the index of the grid cell it falls in
+	// --------------------------------------------------------
+	inline unsigned int KeyWord(float value, float inverseEpsilon)
+	{
+		if (inverseEpsilon > 0.0f)
+			return (unsigned int)(int)floorf(value * inverseEpsilon + 0.5f);
+
+		if (value == 0.0f)
+			value = 0.0f;
+		unsigned int bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	void MakeKey(const Vertex& v, float inverseEpsilon, unsigned int* key)
+	{
+		key[0] = KeyWord(v.Position.x, inverseEpsilon);
+		key[1] = KeyWord(v.Position.y, inverseEpsilon);
+		key[2] = KeyWord(v.Position.z, inverseEpsilon);
+		key[3] = KeyWord(v.Normal.x, inverseEpsilon);
+		key[4] = KeyWord(v.Normal.y, inverseEpsilon);
+		key[5] = KeyWord(v.Normal.z, inverseEpsilon);
+		key[6] = KeyWord(v.UV.x, inverseEpsilon);
+		key[7] = KeyWord(v.UV.y, inverseEpsilon);
+	}
+
+	// FNV-1a style mix over the key words
+	inline unsigned int HashKey(const unsigned int* key)
+	{
+		unsigned int hash = 2166136261u;
+		for (int i = 0; i < KeySize; i++)
+		{
+			hash ^= key[i];
+			hash *= 16777619u;
+			hash ^= hash >> 15;
+		}
+		return hash;
+	}
+}
+
+
+bool MeshBuilder::LoadObj(const char * filename, MeshData & out, unsigned int threadCount)
+{
+	ObjData obj;
+	if (!ObjParser::ParseFile(filename, obj, threadCount) || obj.corners.empty())
+		return false;
+
+	FromObj(obj, out);
+	return true;
+}
+
+// --------------------------------------------------------
+// Creates the verts by looking up corresponding data from
+// the parsed arrays - one vertex for every triangle corner
+// --------------------------------------------------------
+void MeshBuilder::FromObj(const ObjData & obj, MeshData & out)
+{
+	out.vertices.clear();
+	out.indices.clear();
+	out.vertices.reserve(obj.corners.size());
+	out.indices.reserve(obj.corners.size());
+
+	for (size_t i = 0; i + 2 < obj.corners.size(); i += 3)
+	{
+		Vertex v[3];
+		bool missingNormal = false;
+		for (int c = 0; c < 3; c++)
+		{
+			const ObjCorner& corner = obj.corners[i + c];
+			v[c].Position = obj.positions[corner.position];
+			v[c].UV = corner.uv >= 0 ? obj.uvs[corner.uv] : XMFLOAT2(0, 1);
+			v[c].Normal = corner.normal >= 0 ? obj.normals[corner.normal] : XMFLOAT3(0, 0, 0);
+			missingNormal |= corner.normal < 0;
+
+			// Flip the UV's since they're probably "upside down"
+			v[c].UV.y = 1.0f - v[c].UV.y;
+		}
+
+		// Files without normals get a flat face normal
+		if (missingNormal)
+		{
+			XMFLOAT3 faceNormal = FaceNormal(v[0].Position, v[1].Position, v[2].Position);
+			for (int c = 0; c < 3; c++)
+			{
+				if (obj.corners[i + c].normal < 0)
+					v[c].Normal = faceNormal;
+			}
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			out.indices.push_back((unsigned int)out.vertices.size());
+			out.vertices.push_back(v[c]);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Hash-based vertex welding
+// - Open addressing table sized to at least twice the vertex
+//   count, so probes stay short
+// - The first occurrence of each unique vertex is kept, which
+//   keeps the output deterministic and in first-use order
+// --------------------------------------------------------
+WeldStats MeshBuilder::Weld(MeshData & data, float epsilon)
+{
+	WeldStats stats;
+	stats.inputVertices = (unsigned int)data.vertices.size();
+	stats.outputVertices = stats.inputVertices;
+
+	if (data.vertices.empty())
+		return stats;
+
+	float inverseEpsilon = epsilon > 0.0f ? 1.0f / epsilon : 0.0f;
+
+	// Keys for every input vertex, computed once
+	size_t vertexCount = data.vertices.size();
+	std::vector<unsigned int> keys(vertexCount * KeySize);
+	for (size_t i = 0; i < vertexCount; i++)
+		MakeKey(data.vertices[i], inverseEpsilon, &keys[i * KeySize]);
+
+	size_t tableSize = 1;
+	while (tableSize < vertexCount * 2)
+		tableSize <<= 1;
+	std::vector<unsigned int> table(tableSize, EmptySlot);
+
+	// remap[old] = new index
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<Vertex> welded;
+	welded.reserve(vertexCount);
+	std::vector<unsigned int> firstSource;
+	firstSource.reserve(vertexCount);
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const unsigned int* key = &keys[i * KeySize];
+		size_t slot = HashKey(key) & (tableSize - 1);
+
+		while (true)
+		{
+			unsigned int existing = table[slot];
+			if (existing == EmptySlot)
+			{
+				table[slot] = (unsigned int)welded.size();
+				remap[i] = (unsigned int)welded.size();
+				firstSource.push_back((unsigned int)i);
+				welded.push_back(data.vertices[i]);
+				break;
+			}
+
+			const unsigned int* otherKey = &keys[firstSource[existing] * KeySize];
+			if (memcmp(key, otherKey, sizeof(unsigned int) * KeySize) == 0)
+			{
+				remap[i] = existing;
+				break;
+			}
+
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+
+	for (auto& index : data.indices)
+		index = remap[index];
+	data.vertices.swap(welded);
+
+	stats.outputVertices = (unsigned int)data.vertices.size();
+	return stats;
+}
+
+// --------------------------------------------------------
+// Box from the min/max of every vertex, sphere centered on
+// the box and just big enough to hold every vertex
+// --------------------------------------------------------
+MeshBounds MeshBuilder::ComputeBounds(const Vertex * vertices, size_t vertexCount)
+{
+	MeshBounds bounds;
+	bounds.min = XMFLOAT3(0, 0, 0);
+	bounds.max = XMFLOAT3(0, 0, 0);
+	bounds.center = XMFLOAT3(0, 0, 0);
+	bounds.radius = 0.0f;
+
+	if (vertexCount == 0)
+		return bounds;
+
+	bounds.min = vertices[0].Position;
+	bounds.max = vertices[0].Position;
+	for (size_t i = 1; i < vertexCount; i++)
+	{
+		const XMFLOAT3& p = vertices[i].Position;
+		if (p.x < bounds.min.x) bounds.min.x = p.x;
+		if (p.y < bounds.min.y) bounds.min.y = p.y;
+		if (p.z < bounds.min.z) bounds.min.z = p.z;
+		if (p.x > bounds.max.x) bounds.max.x = p.x;
+		if (p.y > bounds.max.y) bounds.max.y = p.y;
+		if (p.z > bounds.max.z) bounds.max.z = p.z;
+	}
+
+	bounds.center = XMFLOAT3(
+		(bounds.min.x + bounds.max.x) * 0.5f,
+		(bounds.min.y + bounds.max.y) * 0.5f,
+		(bounds.min.z + bounds.max.z) * 0.5f);
+
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const XMFLOAT3& p = vertices[i].Position;
+		float dx = p.x - bounds.center.x;
+		float dy = p.y - bounds.center.y;
+		float dz = p.z - bounds.center.z;
+		float d = dx * dx + dy * dy + dz * dz;
+		if (d > radiusSquared) radiusSquared = d;
+	}
+	bounds.radius = sqrtf(radiusSquared);
+	return bounds;
+}
+
+// --------------------------------------------------------
+// The import pipeline:
+//   weld -> vertex cache order -> overdraw order -> fetch order
+//   -> meshlets -> levels of detail
+// --------------------------------------------------------
+MeshImportStats MeshBuilder::Process(MeshData & data, const MeshImportOptions & options)
+{
+	MeshImportStats stats = {};
+
+	stats.weld = Weld(data, options.weldEpsilon);
+
+	unsigned int vertexCount = (unsigned int)data.vertices.size();
+	stats.cacheBefore = VertexCacheOptimizer::Analyze(data.indices, vertexCount);
+	if (options.measureOverdraw)
+		stats.overdrawBefore = OverdrawOptimizer::Analyze(data.indices, data.vertices);
+
+	if (options.optimizeVertexCache)
+		VertexCacheOptimizer::Optimize(data.indices, vertexCount);
+
+	if (options.optimizeOverdraw)
+	{
+		OverdrawOptimizer::Optimize(data.indices, data.vertices, options.overdrawThreshold);
+		OverdrawOptimizer::OptimizeVertexFetch(data);
+	}
+
+	stats.cacheAfter = VertexCacheOptimizer::Analyze(data.indices, (unsigned int)data.vertices.size());
+	if (options.measureOverdraw)
+		stats.overdrawAfter = OverdrawOptimizer::Analyze(data.indices, data.vertices);
+
+	// Meshlets regroup level 0's triangles, so fetch order is
+	// redone afterwards (the meshlets only store index ranges)
+	if (options.buildMeshlets)
+	{
+		MeshletBuilder::Build(data);
+		OverdrawOptimizer::OptimizeVertexFetch(data);
+	}
+
+	// Extra levels share the vertex buffer and are appended to the
+	// index buffer, so this has to come last
+	if (options.lodCount > 1)
+	{
+		SimplifyOptions simplify;
+		simplify.maxError = options.lodMaxError;
+		MeshSimplifier::BuildLods(data, options.lodCount, options.lodRatio, simplify);
+	}
+
+	return stats;
+}
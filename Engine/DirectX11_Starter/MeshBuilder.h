@@ -0,0 +1,87 @@
+#pragma once
+
+#include "MeshData.h"
+#include "ObjParser.h"
+#include "VertexCacheOptimizer.h"
+#include "OverdrawOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "VertexCompressor.h"
+
+// --------------------------------------------------------
+// Vertex counts before and after welding, so memory
+// savings can be tracked per asset
+// --------------------------------------------------------
+struct WeldStats
+{
+	unsigned int inputVertices;
+	unsigned int outputVertices;
+};
+
+// --------------------------------------------------------
+// Per mesh switches for the import pipeline
+// --------------------------------------------------------
+struct MeshImportOptions
+{
+	float weldEpsilon;          // 0 = only weld identical vertices
+	bool optimizeVertexCache;   // Forsyth triangle reordering
+	bool optimizeOverdraw;      // Cluster sort + vertex fetch reordering
+	float overdrawThreshold;    // Allowed ACMR loss for the cluster sort
+	bool measureOverdraw;       // Run the (slow) software overdraw simulation
+	unsigned int lodCount;      // Detail levels to build, including the original (1 = none, the cooker builds more)
+	float lodRatio;             // Triangles kept from one level to the next
+	float lodMaxError;          // Largest total error of any level, relative to the bounding radius
+	bool buildMeshlets;         // Split level 0 into cullable clusters
+	MeshVertexFormat vertexFormat;  // Layout of the GPU vertex buffer
+
+	MeshImportOptions()
+	{
+		weldEpsilon = 0.0f;
+		optimizeVertexCache = true;
+		optimizeOverdraw = true;
+		overdrawThreshold = 1.05f;
+		measureOverdraw = false;
+		lodCount = 1;
+		lodRatio = 0.5f;
+		lodMaxError = SimplifyOptions().maxError;
+		buildMeshlets = false;
+		vertexFormat = VERTEX_FORMAT_FULL;
+	}
+};
+
+// --------------------------------------------------------
+// Everything the import pipeline measured along the way
+// - Overdraw numbers are only filled in if measureOverdraw is set
+// --------------------------------------------------------
+struct MeshImportStats
+{
+	WeldStats weld;
+	VertexCacheStats cacheBefore;
+	VertexCacheStats cacheAfter;
+	OverdrawStats overdrawBefore;
+	OverdrawStats overdrawAfter;
+};
+
+// --------------------------------------------------------
+// Turns raw file data into an indexed MeshData
+// --------------------------------------------------------
+class MeshBuilder
+{
+public:
+	// Parses an OBJ file and assembles one vertex per triangle
+	// corner (3 per face, indices 0..N-1)
+	// - threadCount is passed on to ObjParser (0 = one per core)
+	static bool LoadObj(const char* filename, MeshData& out, unsigned int threadCount = 0);
+	static void FromObj(const ObjData& obj, MeshData& out);
+
+	// Merges identical vertices and rewrites the index buffer
+	// - epsilon of 0 welds only bit-identical vertices
+	// - A positive epsilon snaps every attribute to a grid of
+	//   that size before comparing
+	static WeldStats Weld(MeshData& data, float epsilon = 0.0f);
+
+	static MeshBounds ComputeBounds(const Vertex* vertices, size_t vertexCount);
+
+	// Runs welding and every enabled optimization, in order
+	static MeshImportStats Process(MeshData& data, const MeshImportOptions& options = MeshImportOptions());
+};
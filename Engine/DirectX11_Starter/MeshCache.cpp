@@ -0,0 +1,384 @@
+#include "MeshCache.h"
+#include "CookedMesh.h"
+#include "MappedFile.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	double SecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// MurmurHash3's finalizer - spreads every input bit over the output
+	inline unsigned long long Mix(unsigned long long h)
+	{
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	inline unsigned long long Combine(unsigned long long seed, unsigned long long value)
+	{
+		return Mix(seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2)));
+	}
+
+	inline unsigned long long FloatBits(float value)
+	{
+		unsigned int bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	// Everything in the options that changes the processed MeshData
+	// - measureOverdraw only fills in stats, so it's left out
+	unsigned long long HashDataOptions(const MeshImportOptions& options)
+	{
+		unsigned long long h = 0x4D455348ull;   // "MESH"
+		h = Combine(h, CookedMeshVersion);
+		h = Combine(h, FloatBits(options.weldEpsilon));
+		h = Combine(h, options.optimizeVertexCache ? 1 : 0);
+		h = Combine(h, options.optimizeOverdraw ? 1 : 0);
+		h = Combine(h, FloatBits(options.overdrawThreshold));
+		h = Combine(h, options.lodCount);
+		h = Combine(h, FloatBits(options.lodRatio));
+		h = Combine(h, FloatBits(options.lodMaxError));
+		h = Combine(h, options.buildMeshlets ? 1 : 0);
+		return h;
+	}
+
+	bool IsCookedFile(const std::string& filename)
+	{
+		const std::string extension = ".cmesh";
+		return filename.size() >= extension.size() &&
+			filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+	}
+
+	bool ReadCooked(const std::string& filename, MeshData& out)
+	{
+		CookedMesh cooked;
+		if (!cooked.Open(filename.c_str()))
+			return false;
+
+		out.vertices.assign(cooked.GetVertices(), cooked.GetVertices() + cooked.GetVertexCount());
+		cooked.CopyIndices(out.indices);
+		out.lods.assign(cooked.GetLods(), cooked.GetLods() + cooked.GetLodCount());
+		out.meshlets.assign(cooked.GetMeshlets(), cooked.GetMeshlets() + cooked.GetMeshletCount());
+		return true;
+	}
+
+	// Size and last write time, without opening the file
+	bool StatFile(const std::string& path, unsigned long long& size, unsigned long long& modifiedTime)
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes))
+			return false;
+		size = ((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+		modifiedTime = ((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+		struct stat status;
+		if (stat(path.c_str(), &status) != 0)
+			return false;
+		size = (unsigned long long)status.st_size;
+		modifiedTime = (unsigned long long)status.st_mtim.tv_sec * 1000000000ull + (unsigned long long)status.st_mtim.tv_nsec;
+#endif
+		return true;
+	}
+
+	void KeyFromContent(unsigned long long contentHash, const MeshImportOptions& options, MeshCacheKey& key)
+	{
+		key.contentHash = contentHash;
+		key.dataKey = Combine(contentHash, HashDataOptions(options));
+		key.meshKey = Combine(key.dataKey, (unsigned long long)options.vertexFormat);
+	}
+
+	void CreateDirectoryIfMissing(const std::string& directory)
+	{
+#ifdef _WIN32
+		CreateDirectoryA(directory.c_str(), nullptr);
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+}
+
+
+MeshCache::MeshCache(MeshCacheFactory factory, const std::string & diskCacheDirectory)
+{
+	this->factory = factory;
+	this->diskCacheDirectory = diskCacheDirectory;
+	stats = {};
+
+	if (!diskCacheDirectory.empty())
+		CreateDirectoryIfMissing(diskCacheDirectory);
+}
+
+MeshHandle MeshCache::Get(const std::string & path, const MeshImportOptions & options)
+{
+	MeshCacheKey key;
+	if (!MakeKey(path, options, key))
+		return MeshHandle();
+
+	MeshHandle mesh = Find(key);
+	if (mesh)
+		return mesh;
+
+	MeshData data;
+	if (!LoadData(path, options, key, data))
+		return MeshHandle();
+
+	return Create(path, options, key, data);
+}
+
+// --------------------------------------------------------
+// Only hashes files it hasn't seen, or whose size or modified
+// time changed since - the stamp is taken before hashing, so
+// an edit made while hashing is caught next time. Times the
+// hashing, and counts unreadable files as failures
+// --------------------------------------------------------
+bool MeshCache::MakeKey(const std::string & path, const MeshImportOptions & options, MeshCacheKey & key)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	FileStamp stamp;
+	if (!StatFile(path, stamp.size, stamp.modifiedTime))
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.failures++;
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto found = stamps.find(path);
+		if (found != stamps.end() && found->second.size == stamp.size && found->second.modifiedTime == stamp.modifiedTime)
+		{
+			KeyFromContent(found->second.contentHash, options, key);
+			stats.hashesSkipped++;
+			return true;
+		}
+	}
+
+	MappedFile file;
+	bool hashed = file.Open(path.c_str());
+	if (hashed)
+	{
+		stamp.contentHash = HashBytes(file.GetData(), file.GetSize());
+		KeyFromContent(stamp.contentHash, options, key);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.hashSeconds += SecondsSince(start);
+	if (hashed)
+		stamps[path] = stamp;
+	else
+		stats.failures++;
+	return hashed;
+}
+
+MeshHandle MeshCache::Find(const MeshCacheKey & key)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = entries.find(key.meshKey);
+	if (found == entries.end())
+		return MeshHandle();
+
+	MeshHandle mesh = found->second.mesh.lock();
+	if (mesh)
+		stats.memoryHits++;
+	return mesh;
+}
+
+// --------------------------------------------------------
+// Makes the GPU mesh and remembers it
+// - The lock isn't held while loading, so two requests for the
+//   same new file can both get this far - the first one wins
+//   and the other's mesh is thrown away
+// --------------------------------------------------------
+MeshHandle MeshCache::Create(const std::string & path, const MeshImportOptions & options, const MeshCacheKey & key, MeshData & data)
+{
+	MeshHandle mesh = factory(data, options);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!mesh)
+	{
+		stats.failures++;
+		return MeshHandle();
+	}
+
+	Entry& entry = entries[key.meshKey];
+	MeshHandle existing = entry.mesh.lock();
+	if (existing)
+		return existing;
+
+	entry.path = path;
+	entry.mesh = mesh;
+	return mesh;
+}
+
+// --------------------------------------------------------
+// Hashes the whole file through a mapping, so nothing is
+// copied - keys change whenever the bytes do
+// --------------------------------------------------------
+bool MeshCache::ComputeKey(const std::string & path, const MeshImportOptions & options, MeshCacheKey & key)
+{
+	MappedFile file;
+	if (!file.Open(path.c_str()))
+		return false;
+
+	KeyFromContent(HashBytes(file.GetData(), file.GetSize()), options, key);
+	return true;
+}
+
+// --------------------------------------------------------
+// Four independent 64-bit lanes, so the multiplies overlap
+// - Not cryptographic, just fast and well mixed
+// --------------------------------------------------------
+unsigned long long MeshCache::HashBytes(const void * data, size_t size, unsigned long long seed)
+{
+	const unsigned long long prime1 = 0x9E3779B185EBCA87ull;
+	const unsigned long long prime2 = 0xC2B2AE3D27D4EB4Full;
+
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned long long lanes[4] = { seed + prime1, seed + prime2, seed, seed - prime1 };
+
+	size_t blocks = size / 32;
+	for (size_t i = 0; i < blocks; i++)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			unsigned long long word;
+			memcpy(&word, bytes + i * 32 + lane * 8, sizeof(word));
+			lanes[lane] += word * prime2;
+			lanes[lane] = (lanes[lane] << 31) | (lanes[lane] >> 33);
+			lanes[lane] *= prime1;
+		}
+	}
+
+	unsigned long long h = Combine(Combine(lanes[0], lanes[1]), Combine(lanes[2], lanes[3]));
+	h = Combine(h, (unsigned long long)size);
+
+	// Whatever is left over, 8 bytes at a time and then zero padded
+	for (size_t offset = blocks * 32; offset < size; offset += 8)
+	{
+		unsigned long long word = 0;
+		memcpy(&word, bytes + offset, size - offset < 8 ? size - offset : 8);
+		h = Combine(h, word);
+	}
+
+	return Mix(h);
+}
+
+unsigned int MeshCache::Trim()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	unsigned int removed = 0;
+	for (auto entry = entries.begin(); entry != entries.end();)
+	{
+		if (entry->second.mesh.expired())
+		{
+			entry = entries.erase(entry);
+			removed++;
+		}
+		else
+		{
+			++entry;
+		}
+	}
+	return removed;
+}
+
+MeshCacheStats MeshCache::GetStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.liveMeshes = 0;
+	for (auto& entry : entries)
+	{
+		if (!entry.second.mesh.expired())
+			stats.liveMeshes++;
+	}
+	return stats;
+}
+
+// --------------------------------------------------------
+// The CPU side - no D3D calls in here, and no lock held
+// while reading or processing
+// --------------------------------------------------------
+bool MeshCache::LoadData(const std::string & path, const MeshImportOptions & options, const MeshCacheKey & key, MeshData & out, unsigned int threadCount)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Cooked files are already processed - nothing to cache
+	if (IsCookedFile(path))
+	{
+		bool loaded = ReadCooked(path, out) && !out.indices.empty();
+		std::lock_guard<std::mutex> lock(mutex);
+		if (loaded)
+			stats.misses++;
+		else
+			stats.failures++;
+		stats.loadSeconds += SecondsSince(start);
+		return loaded;
+	}
+
+	std::string cachePath = DiskCachePath(key.dataKey);
+	if (!cachePath.empty() && ReadCooked(cachePath, out) && !out.indices.empty())
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.diskHits++;
+		stats.loadSeconds += SecondsSince(start);
+		return true;
+	}
+
+	bool loaded = MeshBuilder::LoadObj(path.c_str(), out, threadCount) && !out.indices.empty();
+	if (loaded)
+		MeshBuilder::Process(out, options);
+
+	// Write under a temporary name first, so another thread (or a
+	// crash) never sees half a file under the real one
+	bool written = false;
+	if (loaded && !cachePath.empty())
+	{
+		char suffix[32];
+		snprintf(suffix, sizeof(suffix), ".%p.tmp", (void*)&out);
+		std::string temporaryPath = cachePath + suffix;
+		if (CookedMesh::Write(temporaryPath.c_str(), out))
+		{
+			remove(cachePath.c_str());
+			written = rename(temporaryPath.c_str(), cachePath.c_str()) == 0;
+			if (!written)
+				remove(temporaryPath.c_str());
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (loaded)
+		stats.misses++;
+	else
+		stats.failures++;
+	if (written)
+		stats.diskWrites++;
+	stats.loadSeconds += SecondsSince(start);
+	return loaded;
+}
+
+std::string MeshCache::DiskCachePath(unsigned long long dataKey)
+{
+	if (diskCacheDirectory.empty())
+		return std::string();
+
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.cmesh", dataKey);
+	return diskCacheDirectory + name;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "MeshBuilder.h"
+
+class Mesh;
+
+// --------------------------------------------------------
+// Shared, reference counted mesh - the Mesh (and its GPU
+// buffers) goes away when the last handle does
+// --------------------------------------------------------
+typedef std::shared_ptr<Mesh> MeshHandle;
+
+// Creates the GPU side of a mesh - see MeshFactory in MeshLoader.h
+// for why this is a function rather than a device
+typedef std::function<MeshHandle(MeshData& data, const MeshImportOptions& options)> MeshCacheFactory;
+
+// --------------------------------------------------------
+// Identifies one processed mesh
+// - dataKey covers the file's contents and every option that
+//   changes the processed MeshData (also the disk cache name)
+// - meshKey adds the options that only change the GPU upload
+// - The path isn't part of either, so two identical files at
+//   different paths share one entry (and one Mesh)
+// --------------------------------------------------------
+struct MeshCacheKey
+{
+	unsigned long long contentHash;
+	unsigned long long dataKey;
+	unsigned long long meshKey;
+};
+
+// --------------------------------------------------------
+// Where Get() requests were served from
+// --------------------------------------------------------
+struct MeshCacheStats
+{
+	unsigned int memoryHits;    // A live Mesh already existed
+	unsigned int diskHits;      // Processed data came from the disk cache
+	unsigned int misses;        // Had to parse and process the file
+	unsigned int failures;      // Unreadable file, or the factory failed
+	unsigned int hashesSkipped; // Unchanged since its path was last hashed
+	unsigned int diskWrites;
+	unsigned int liveMeshes;    // Meshes someone still holds a handle to
+	double hashSeconds;
+	double loadSeconds;         // Disk cache reads plus parsing/processing
+};
+
+// --------------------------------------------------------
+// Content addressed mesh cache
+// - Keyed by the hash of the file's bytes (plus import options)
+//   rather than its name, so an edited file is picked up and
+//   two copies of the same file share one Mesh
+// - Each path's size and modified time are kept with its hash,
+//   so asking again for a file that hasn't changed doesn't
+//   read it again
+// - The cache only holds weak references; handles own meshes
+// - With a disk cache directory, processed results are stored
+//   as cooked meshes named after their key, so unchanged assets
+//   skip parsing on the next launch
+// - Everything but Create() (and so Get()) can be called from any
+//   thread; those two use the factory, which may need the device
+// --------------------------------------------------------
+class MeshCache
+{
+public:
+	MeshCache(MeshCacheFactory factory, const std::string& diskCacheDirectory = "");
+
+	// Returns a shared handle, or an empty one if loading failed
+	// - Same as MakeKey(), Find(), then LoadData() and Create()
+	MeshHandle Get(const std::string& path, const MeshImportOptions& options = MeshImportOptions());
+
+	// The steps of Get(), for MeshLoader to split across threads
+	// - Everything but Create() is CPU only
+	bool MakeKey(const std::string& path, const MeshImportOptions& options, MeshCacheKey& key);
+	MeshHandle Find(const MeshCacheKey& key);
+	bool LoadData(const std::string& path, const MeshImportOptions& options, const MeshCacheKey& key, MeshData& out,
+		unsigned int threadCount = 0);
+	MeshHandle Create(const std::string& path, const MeshImportOptions& options, const MeshCacheKey& key, MeshData& data);
+
+	// Hashes the file every time - MakeKey() only does when it's
+	// new or has changed
+	static bool ComputeKey(const std::string& path, const MeshImportOptions& options, MeshCacheKey& key);
+	static unsigned long long HashBytes(const void* data, size_t size, unsigned long long seed = 0);
+
+	// Forgets entries whose meshes are gone - returns how many
+	unsigned int Trim();
+
+	MeshCacheStats GetStats();
+
+private:
+	std::string DiskCachePath(unsigned long long dataKey);
+
+	struct Entry
+	{
+		std::string path;
+		std::weak_ptr<Mesh> mesh;
+	};
+
+	// What a path looked like when it was last hashed
+	struct FileStamp
+	{
+		unsigned long long size;
+		unsigned long long modifiedTime;
+		unsigned long long contentHash;
+	};
+
+	MeshCacheFactory factory;
+	std::string diskCacheDirectory;
+
+	std::mutex mutex;
+	std::unordered_map<unsigned long long, Entry> entries;
+	std::unordered_map<std::string, FileStamp> stamps;
+	MeshCacheStats stats;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Object space bounds of a mesh - an axis aligned box and a
+// sphere around the box's center
+// --------------------------------------------------------
+struct MeshBounds
+{
+	DirectX::XMFLOAT3 min;
+	DirectX::XMFLOAT3 max;
+	DirectX::XMFLOAT3 center;
+	float radius;
+};
+
+// --------------------------------------------------------
+// One level of detail - a range of the shared index buffer
+// - error is the simplifier's deviation relative to the mesh's
+//   bounding radius (0 for the full detail level)
+// --------------------------------------------------------
+struct MeshLod
+{
+	unsigned int indexStart;
+	unsigned int indexCount;
+	float error;
+};
+
+// --------------------------------------------------------
+// A small cluster of triangles (see MeshletBuilder) - a range
+// of the level 0 indices plus what's needed to cull it
+// - center/radius bound the cluster's vertices
+// - coneAxis/coneCutoff are a backface cone, quantized to
+//   signed bytes (value / 127); a cutoff of 127 means the
+//   cluster can never be back facing as a whole
+// --------------------------------------------------------
+struct Meshlet
+{
+	DirectX::XMFLOAT3 center;
+	float radius;
+	unsigned int indexStart;
+	unsigned int indexCount;
+	unsigned int vertexCount;      // Unique vertices, for statistics
+	signed char coneAxis[3];
+	signed char coneCutoff;
+};
+
+// --------------------------------------------------------
+// CPU-side copy of a mesh, before it's turned into GPU buffers
+// - Every stage of the import pipeline (welding, optimizing,
+//   cooking, etc.) reads and writes this
+// - When "lods" is empty the whole index buffer is one level;
+//   otherwise every level indexes the same vertex buffer
+// - Meshlets (optional) cover level 0 only
+// --------------------------------------------------------
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+};
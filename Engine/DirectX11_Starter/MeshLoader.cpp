@@ -0,0 +1,334 @@
+#include "MeshLoader.h"
+#include "CookedMesh.h"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+	double SecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	bool IsCookedFile(const std::string& filename)
+	{
+		const std::string extension = ".cmesh";
+		return filename.size() >= extension.size() &&
+			filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+	}
+}
+
+
+MeshLoader::MeshLoader(MeshFactory factory, unsigned int threadCount)
+{
+	this->factory = factory;
+	cache = nullptr;
+	Start(threadCount);
+}
+
+MeshLoader::MeshLoader(MeshCache * cache, unsigned int threadCount)
+{
+	this->cache = cache;
+	Start(threadCount);
+}
+
+void MeshLoader::Start(unsigned int threadCount)
+{
+	loading = 0;
+	nextSequence = 0;
+	stopping = false;
+	stats = {};
+
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	if (threadCount == 0)
+		threadCount = cores > 1 ? cores - 1 : 1;
+
+	// Each worker parses with its share of the cores, so one big
+	// file doesn't load single threaded and many small ones don't
+	// oversubscribe the machine
+	parseThreads = std::max(1u, cores / threadCount);
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.push_back(std::thread(&MeshLoader::WorkerLoop, this));
+}
+
+MeshLoader::~MeshLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+
+	// Nobody is left to create these, so don't leave futures hanging
+	while (!queue.empty())
+	{
+		MeshLoadHandle request = queue.top();
+		queue.pop();
+		if (!request->IsFinished())
+		{
+			request->state = MESH_LOAD_CANCELLED;
+			Finish(*request, MeshHandle(), false);
+		}
+	}
+	// Ready requests (including failed ones) haven't been finished yet
+	for (auto& request : ready)
+	{
+		if (request->state == MESH_LOAD_READY)
+			request->state = MESH_LOAD_CANCELLED;
+		Finish(*request, MeshHandle(), false);
+	}
+}
+
+MeshLoadHandle MeshLoader::Load(const std::string & filename, int priority, const MeshImportOptions & options, MeshLoadCallback callback)
+{
+	MeshLoadHandle request = std::make_shared<MeshLoadRequest>();
+	request->filename = filename;
+	request->options = options;
+	request->priority = priority;
+	request->state = MESH_LOAD_QUEUED;
+	request->callback = callback;
+	request->future = request->promise.get_future().share();
+	request->importStats = {};
+	request->loadSeconds = 0.0;
+	request->createSeconds = 0.0;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		request->sequence = nextSequence++;
+		queue.push(request);
+		stats.requested++;
+	}
+	workAvailable.notify_one();
+	return request;
+}
+
+// --------------------------------------------------------
+// Queued requests stay in the heap and are skipped when a
+// worker reaches them; ready ones are dropped right away
+// --------------------------------------------------------
+bool MeshLoader::Cancel(const MeshLoadHandle & request)
+{
+	if (!request)
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (request->IsFinished())
+			return false;
+
+		// A worker still owns the data while it's loading, and
+		// drops it itself once it sees the cancellation
+		if (request->state == MESH_LOAD_READY)
+		{
+			ready.erase(std::remove(ready.begin(), ready.end(), request), ready.end());
+			request->data = MeshData();
+			request->cachedMesh = MeshHandle();
+		}
+
+		request->state = MESH_LOAD_CANCELLED;
+		stats.cancelled++;
+	}
+
+	Finish(*request, MeshHandle(), true);
+	return true;
+}
+
+// --------------------------------------------------------
+// Runs on the owning thread - the only place meshes are made
+// --------------------------------------------------------
+unsigned int MeshLoader::Update(unsigned int maxCreates)
+{
+	std::vector<MeshLoadHandle> finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (ready.empty())
+			return 0;
+
+		// Most important first, in case the budget runs out
+		std::stable_sort(ready.begin(), ready.end(),
+			[](const MeshLoadHandle& a, const MeshLoadHandle& b) { return a->priority > b->priority; });
+
+		size_t count = std::min((size_t)maxCreates, ready.size());
+		finished.assign(ready.begin(), ready.begin() + count);
+		ready.erase(ready.begin(), ready.begin() + count);
+	}
+
+	for (auto& request : finished)
+	{
+		// A callback earlier in this loop may have cancelled it
+		if (request->state == MESH_LOAD_CANCELLED)
+			continue;
+
+		MeshHandle mesh;
+		if (request->state == MESH_LOAD_READY)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			mesh = Create(*request);
+			request->createSeconds = SecondsSince(start);
+			request->data = MeshData();
+			request->cachedMesh = MeshHandle();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			request->state = mesh ? MESH_LOAD_DONE : MESH_LOAD_FAILED;
+			if (mesh)
+				stats.completed++;
+			else
+				stats.failed++;
+			stats.createSeconds += request->createSeconds;
+		}
+
+		Finish(*request, mesh, true);
+	}
+
+	workFinished.notify_all();
+	return (unsigned int)finished.size();
+}
+
+void MeshLoader::Flush()
+{
+	while (true)
+	{
+		Update();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		bool pending = false;
+		for (auto copy = queue; !copy.empty(); copy.pop())
+		{
+			if (!copy.top()->IsFinished())
+			{
+				pending = true;
+				break;
+			}
+		}
+
+		if (!pending && loading == 0 && ready.empty())
+			return;
+
+		workFinished.wait(lock, [this]() { return !ready.empty() || (queue.empty() && loading == 0); });
+	}
+}
+
+MeshLoaderStats MeshLoader::GetStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+void MeshLoader::WorkerLoop()
+{
+	while (true)
+	{
+		MeshLoadHandle request;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workAvailable.wait(lock, [this]() { return stopping || !queue.empty(); });
+			if (stopping)
+				return;
+
+			request = queue.top();
+			queue.pop();
+
+			// Cancelled while it was still queued
+			if (request->state != MESH_LOAD_QUEUED)
+			{
+				if (queue.empty() && loading == 0)
+					workFinished.notify_all();
+				continue;
+			}
+
+			request->state = MESH_LOAD_LOADING;
+			loading++;
+		}
+
+		LoadData(*request);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			loading--;
+			stats.loadSeconds += request->loadSeconds;
+
+			// Cancelled while loading - nobody wants the data anymore
+			if (request->state == MESH_LOAD_CANCELLED)
+			{
+				request->data = MeshData();
+				request->cachedMesh = MeshHandle();
+			}
+			else
+			{
+				ready.push_back(request);
+			}
+		}
+		workFinished.notify_all();
+	}
+}
+
+// --------------------------------------------------------
+// The CPU side of a load - no D3D calls allowed in here
+// - Failures are marked MESH_LOAD_FAILED here, but still go
+//   through Update() so they're reported on the owning thread
+// --------------------------------------------------------
+void MeshLoader::LoadData(MeshLoadRequest & request)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	bool loaded = false;
+
+	if (cache)
+	{
+		// A live mesh means there's nothing to load at all, otherwise
+		// the cache goes to its disk cache before parsing
+		if (cache->MakeKey(request.filename, request.options, request.cacheKey))
+		{
+			request.cachedMesh = cache->Find(request.cacheKey);
+			loaded = request.cachedMesh ||
+				cache->LoadData(request.filename, request.options, request.cacheKey, request.data, parseThreads);
+		}
+	}
+	else if (IsCookedFile(request.filename))
+	{
+		// Copy out of the mapping, since the file can't stay open
+		// until the owning thread gets around to it
+		CookedMesh cooked;
+		if (cooked.Open(request.filename.c_str()))
+		{
+			request.data.vertices.assign(cooked.GetVertices(), cooked.GetVertices() + cooked.GetVertexCount());
+			cooked.CopyIndices(request.data.indices);
+			request.data.lods.assign(cooked.GetLods(), cooked.GetLods() + cooked.GetLodCount());
+			request.data.meshlets.assign(cooked.GetMeshlets(), cooked.GetMeshlets() + cooked.GetMeshletCount());
+			request.importStats.weld.inputVertices = cooked.GetVertexCount();
+			request.importStats.weld.outputVertices = cooked.GetVertexCount();
+			loaded = true;
+		}
+	}
+	else if (MeshBuilder::LoadObj(request.filename.c_str(), request.data, parseThreads))
+	{
+		request.importStats = MeshBuilder::Process(request.data, request.options);
+		loaded = true;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (request.state == MESH_LOAD_LOADING)
+		request.state = loaded && (request.cachedMesh || !request.data.indices.empty()) ? MESH_LOAD_READY : MESH_LOAD_FAILED;
+	request.loadSeconds = SecondsSince(start);
+}
+
+MeshHandle MeshLoader::Create(MeshLoadRequest & request)
+{
+	if (request.cachedMesh)
+		return request.cachedMesh;
+	if (cache)
+		return cache->Create(request.filename, request.options, request.cacheKey, request.data);
+	return factory(request.data, request);
+}
+
+// Completes the future and (optionally) calls the callback
+void MeshLoader::Finish(MeshLoadRequest & request, MeshHandle mesh, bool callCallback)
+{
+	request.promise.set_value(mesh);
+	if (callCallback && request.callback)
+		request.callback(mesh);
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MeshCache.h"
+
+// --------------------------------------------------------
+// Where a load request is in its life
+// --------------------------------------------------------
+enum MeshLoadState
+{
+	MESH_LOAD_QUEUED = 0,      // Waiting for a worker
+	MESH_LOAD_LOADING = 1,     // A worker is reading/processing it
+	MESH_LOAD_READY = 2,       // CPU data done, waiting for Update()
+	MESH_LOAD_DONE = 3,        // The mesh was created
+	MESH_LOAD_FAILED = 4,      // Couldn't read the file or create the mesh
+	MESH_LOAD_CANCELLED = 5
+};
+
+class MeshLoadRequest;
+typedef std::shared_ptr<MeshLoadRequest> MeshLoadHandle;
+
+// Called on the thread that calls MeshLoader::Update() (or Cancel())
+// - The handle is empty if the load failed or was cancelled
+typedef std::function<void(MeshHandle mesh)> MeshLoadCallback;
+
+// Turns finished CPU data into a Mesh - this is the only part of a
+// load that touches the GPU, so it runs on the owning thread
+// - Normally creates a Mesh with the D3D device; tools and tests can
+//   pass one that never touches a device at all
+typedef std::function<MeshHandle(MeshData& data, const MeshLoadRequest& request)> MeshFactory;
+
+// --------------------------------------------------------
+// One queued load - shared between the caller and the loader
+// --------------------------------------------------------
+class MeshLoadRequest
+{
+public:
+	const std::string& GetFilename() const { return filename; }
+	const MeshImportOptions& GetOptions() const { return options; }
+	int GetPriority() const { return priority; }
+	MeshLoadState GetState() const { return state.load(); }
+	bool IsFinished() const { return state.load() >= MESH_LOAD_DONE; }
+
+	// Becomes ready once the request is done, failed or cancelled
+	// - Don't wait on this from the thread that calls Update()
+	//   unless you use MeshLoader::Flush(), it would never finish
+	// - The future holds a handle, so it keeps the mesh alive
+	std::shared_future<MeshHandle> GetFuture() const { return future; }
+
+	// Filled in by the worker (OBJ files parsed without a cache only)
+	const MeshImportStats& GetImportStats() const { return importStats; }
+	double GetLoadSeconds() const { return loadSeconds; }
+	double GetCreateSeconds() const { return createSeconds; }
+
+private:
+	friend class MeshLoader;
+
+	std::string filename;
+	MeshImportOptions options;
+	int priority;
+	unsigned long long sequence;
+	std::atomic<MeshLoadState> state;
+	MeshLoadCallback callback;
+	std::promise<MeshHandle> promise;
+	std::shared_future<MeshHandle> future;
+
+	MeshCacheKey cacheKey;
+	MeshHandle cachedMesh;     // Found in the cache, nothing to create
+	MeshData data;
+	MeshImportStats importStats;
+	double loadSeconds;
+	double createSeconds;
+};
+
+// --------------------------------------------------------
+// Counters for every request the loader has seen
+// --------------------------------------------------------
+struct MeshLoaderStats
+{
+	unsigned int requested;
+	unsigned int completed;
+	unsigned int failed;
+	unsigned int cancelled;
+	double loadSeconds;      // Summed over all workers
+	double createSeconds;    // Time spent in the factory
+};
+
+// --------------------------------------------------------
+// Loads meshes in the background
+// - Worker threads read and process files (OBJ through the
+//   whole MeshBuilder pipeline, or cooked .cmesh files) into
+//   MeshData, highest priority first
+// - Update(), called on the owning thread once a frame, hands
+//   finished data to the factory to create GPU buffers, then
+//   completes the future and calls the callback
+// - Given a MeshCache, workers check it (and its disk cache)
+//   first and every mesh is created through it, so async and
+//   Get() loads of the same file share one Mesh
+// --------------------------------------------------------
+class MeshLoader
+{
+public:
+	// threadCount of 0 uses one worker per core (minus the main thread)
+	MeshLoader(MeshFactory factory, unsigned int threadCount = 0);
+	MeshLoader(MeshCache* cache, unsigned int threadCount = 0);
+
+	// Cancels whatever hasn't been created yet - futures of those
+	// requests get an empty handle, but callbacks aren't called
+	~MeshLoader();
+
+	// Higher priorities load first; equal priorities load in order
+	MeshLoadHandle Load(const std::string& filename, int priority = 0,
+		const MeshImportOptions& options = MeshImportOptions(), MeshLoadCallback callback = nullptr);
+
+	// Returns false if the request already finished
+	// - Work already in progress is thrown away when it's done
+	// - Call from the owning thread, like Update()
+	bool Cancel(const MeshLoadHandle& request);
+
+	// Creates up to maxCreates finished meshes, to spread GPU work
+	// over several frames - returns how many requests completed
+	unsigned int Update(unsigned int maxCreates = 0xFFFFFFFF);
+
+	// Blocks (calling Update) until nothing is queued or loading
+	void Flush();
+
+	MeshLoaderStats GetStats();
+	unsigned int GetThreadCount() { return (unsigned int)workers.size(); }
+
+private:
+	void Start(unsigned int threadCount);
+	void WorkerLoop();
+	void LoadData(MeshLoadRequest& request);
+	MeshHandle Create(MeshLoadRequest& request);
+	void Finish(MeshLoadRequest& request, MeshHandle mesh, bool callCallback);
+
+	// Heap order: highest priority first, then oldest first
+	struct CompareRequests
+	{
+		bool operator()(const MeshLoadHandle& a, const MeshLoadHandle& b) const
+		{
+			if (a->priority != b->priority)
+				return a->priority < b->priority;
+			return a->sequence > b->sequence;
+		}
+	};
+
+	MeshFactory factory;
+	MeshCache* cache;
+	unsigned int parseThreads;
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workFinished;
+	std::priority_queue<MeshLoadHandle, std::vector<MeshLoadHandle>, CompareRequests> queue;
+	std::vector<MeshLoadHandle> ready;
+	unsigned int loading;
+	unsigned long long nextSequence;
+	bool stopping;
+	MeshLoaderStats stats;
+};
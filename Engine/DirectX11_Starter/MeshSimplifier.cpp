@@ -0,0 +1,541 @@
+#include "MeshSimplifier.h"
+#include "VertexCacheOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	// Extra weight for the planes that hold open edges in place
+	const double BorderWeight = 10.0;
+
+	const unsigned int None = 0xFFFFFFFF;
+
+	// Marks a wedge that has no target yet while matching wedges
+	const unsigned int Unmatched = 0xFFFFFFFE;
+
+	// --------------------------------------------------------
+	// Symmetric 4x4 error quadric plus the total weight that went
+	// into it, so errors come out as squared distances
+	// - attribute is the normal/UV error of the collapses that
+	//   already ended at this vertex, so it carries on to the
+	//   next collapse along with the planes
+	// --------------------------------------------------------
+	struct Quadric
+	{
+		double a2, ab, ac, ad;
+		double b2, bc, bd;
+		double c2, cd;
+		double d2;
+		double weight;
+		double attribute;
+	};
+
+	void AddPlane(Quadric& q, double a, double b, double c, double d, double weight)
+	{
+		q.a2 += a * a * weight; q.ab += a * b * weight; q.ac += a * c * weight; q.ad += a * d * weight;
+		q.b2 += b * b * weight; q.bc += b * c * weight; q.bd += b * d * weight;
+		q.c2 += c * c * weight; q.cd += c * d * weight;
+		q.d2 += d * d * weight;
+		q.weight += weight;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& other)
+	{
+		q.a2 += other.a2; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+		q.b2 += other.b2; q.bc += other.bc; q.bd += other.bd;
+		q.c2 += other.c2; q.cd += other.cd;
+		q.d2 += other.d2;
+		q.weight += other.weight;
+		q.attribute += other.attribute;
+	}
+
+	double Evaluate(const Quadric& q, const XMFLOAT3& p)
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double error =
+			q.a2 * x * x + 2 * q.ab * x * y + 2 * q.ac * x * z + 2 * q.ad * x +
+			q.b2 * y * y + 2 * q.bc * y * z + 2 * q.bd * y +
+			q.c2 * z * z + 2 * q.cd * z +
+			q.d2;
+		if (q.weight > 0.0)
+			error /= q.weight;
+		return (error > 0.0 ? error : 0.0) + q.attribute;
+	}
+
+	inline XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	// Squared distance between two vertices' normals and UVs
+	inline float AttributeDistance(const Vertex& a, const Vertex& b)
+	{
+		float nx = a.Normal.x - b.Normal.x, ny = a.Normal.y - b.Normal.y, nz = a.Normal.z - b.Normal.z;
+		float u = a.UV.x - b.UV.x, v = a.UV.y - b.UV.y;
+		return nx * nx + ny * ny + nz * nz + u * u + v * v;
+	}
+
+	// Exact position key, so vertices split by seams share an id
+	struct PositionKey
+	{
+		unsigned int x, y, z;
+		bool operator==(const PositionKey& other) const { return x == other.x && y == other.y && z == other.z; }
+	};
+
+	struct PositionHash
+	{
+		size_t operator()(const PositionKey& key) const
+		{
+			return (key.x * 73856093u) ^ (key.y * 19349663u) ^ (key.z * 83492791u);
+		}
+	};
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		double cost;
+	};
+
+	inline unsigned long long EdgeKey(unsigned int a, unsigned int b)
+	{
+		return a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+	}
+}
+
+
+float MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const unsigned int * indices, size_t indexCount,
+	const SimplifyOptions & options, std::vector<unsigned int>& out)
+{
+	out.assign(indices, indices + indexCount);
+
+	size_t vertexCount = vertices.size();
+	size_t triangleCount = indexCount / 3;
+	size_t targetTriangles = (size_t)(triangleCount * options.targetRatio + 0.5f);
+	if (targetTriangles < 1)
+		targetTriangles = 1;
+	if (vertexCount == 0 || triangleCount <= targetTriangles)
+		return 0.0f;
+
+	// Group vertices by position - "canonical" is the first vertex
+	// at each position, and "wedges" lists every vertex there
+	std::vector<unsigned int> canonical(vertexCount);
+	{
+		std::unordered_map<PositionKey, unsigned int, PositionHash> positions;
+		positions.reserve(vertexCount);
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			PositionKey key;
+			memcpy(&key.x, &vertices[i].Position.x, sizeof(float));
+			memcpy(&key.y, &vertices[i].Position.y, sizeof(float));
+			memcpy(&key.z, &vertices[i].Position.z, sizeof(float));
+			auto inserted = positions.insert(std::make_pair(key, (unsigned int)i));
+			canonical[i] = inserted.first->second;
+		}
+	}
+
+	std::vector<unsigned int> wedgeCount(vertexCount, 0);
+	for (size_t i = 0; i < vertexCount; i++)
+		wedgeCount[canonical[i]]++;
+	std::vector<unsigned int> wedgeOffset(vertexCount + 1, 0);
+	for (size_t i = 0; i < vertexCount; i++)
+		wedgeOffset[i + 1] = wedgeOffset[i] + wedgeCount[i];
+	std::vector<unsigned int> wedges(vertexCount);
+	{
+		std::vector<unsigned int> fill(wedgeOffset.begin(), wedgeOffset.end() - 1);
+		for (size_t i = 0; i < vertexCount; i++)
+			wedges[fill[canonical[i]]++] = (unsigned int)i;
+	}
+
+	// Bounding radius, so errors can be given relative to size
+	MeshBounds bounds;
+	{
+		XMFLOAT3 minimum = vertices[0].Position, maximum = vertices[0].Position;
+		for (auto& v : vertices)
+		{
+			minimum.x = std::min(minimum.x, v.Position.x); maximum.x = std::max(maximum.x, v.Position.x);
+			minimum.y = std::min(minimum.y, v.Position.y); maximum.y = std::max(maximum.y, v.Position.y);
+			minimum.z = std::min(minimum.z, v.Position.z); maximum.z = std::max(maximum.z, v.Position.z);
+		}
+		XMFLOAT3 extent = Sub(maximum, minimum);
+		bounds.radius = 0.5f * sqrtf(Dot(extent, extent));
+	}
+	if (bounds.radius <= 0.0f)
+		return 0.0f;
+
+	double radiusSquared = (double)bounds.radius * bounds.radius;
+	double maxCost = (double)options.maxError * options.maxError * radiusSquared;
+	double attributeScale = options.attributeWeight * radiusSquared;
+
+	// Find open edges - edges used by exactly one triangle
+	std::vector<bool> border(vertexCount, false);
+	std::vector<unsigned long long> edges;
+	edges.reserve(indexCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int e = 0; e < 3; e++)
+		{
+			unsigned int a = canonical[out[t * 3 + e]];
+			unsigned int b = canonical[out[t * 3 + (e + 1) % 3]];
+			if (a != b)
+				edges.push_back(EdgeKey(a, b));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	std::vector<unsigned long long> borderEdges;
+	for (size_t i = 0; i < edges.size();)
+	{
+		size_t j = i + 1;
+		while (j < edges.size() && edges[j] == edges[i])
+			j++;
+		if (j - i == 1)
+		{
+			border[(unsigned int)(edges[i] >> 32)] = true;
+			border[(unsigned int)(edges[i] & 0xFFFFFFFF)] = true;
+			borderEdges.push_back(edges[i]);
+		}
+		i = j;
+	}
+
+	// Build the quadrics from every triangle's plane (area weighted)
+	std::vector<Quadric> quadrics(vertexCount);
+	memset(&quadrics[0], 0, sizeof(Quadric) * vertexCount);
+	std::vector<XMFLOAT3> faceNormal(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		unsigned int c[3] = { canonical[out[t * 3]], canonical[out[t * 3 + 1]], canonical[out[t * 3 + 2]] };
+		const XMFLOAT3& p0 = vertices[c[0]].Position;
+		XMFLOAT3 n = Cross(Sub(vertices[c[1]].Position, p0), Sub(vertices[c[2]].Position, p0));
+		faceNormal[t] = n;
+
+		double length = sqrt((double)Dot(n, n));
+		if (length <= 0.0)
+			continue;
+
+		double a = n.x / length, b = n.y / length, cc = n.z / length;
+		double d = -(a * p0.x + b * p0.y + cc * p0.z);
+		for (int k = 0; k < 3; k++)
+			AddPlane(quadrics[c[k]], a, b, cc, d, length * 0.5);
+	}
+
+	// Planes perpendicular to open edges keep the outline in place
+	// even when border vertices are allowed to move
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int e = 0; e < 3; e++)
+		{
+			unsigned int a = canonical[out[t * 3 + e]];
+			unsigned int b = canonical[out[t * 3 + (e + 1) % 3]];
+			if (a == b || !std::binary_search(borderEdges.begin(), borderEdges.end(), EdgeKey(a, b)))
+				continue;
+
+			XMFLOAT3 edge = Sub(vertices[b].Position, vertices[a].Position);
+			XMFLOAT3 n = Cross(edge, faceNormal[t]);
+			double length = sqrt((double)Dot(n, n));
+			if (length <= 0.0)
+				continue;
+
+			double pa = n.x / length, pb = n.y / length, pc = n.z / length;
+			const XMFLOAT3& p = vertices[a].Position;
+			double d = -(pa * p.x + pb * p.y + pc * p.z);
+			double weight = Dot(edge, edge) * BorderWeight;
+			AddPlane(quadrics[a], pa, pb, pc, d, weight);
+			AddPlane(quadrics[b], pa, pb, pc, d, weight);
+		}
+	}
+
+	// Collapses work on positions, with every wedge there moving
+	// together - so any position can go unless it's on an open
+	// edge and those are locked
+	std::vector<bool> movable(vertexCount, false);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		if (canonical[i] == i && !(options.lockBorder && border[i]))
+			movable[i] = true;
+	}
+
+	// Wedge a collapsed vertex should be remapped to
+	std::vector<unsigned int> remap(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+		remap[i] = (unsigned int)i;
+
+	std::vector<unsigned int> adjacencyOffset(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<bool> touched(vertexCount);
+	double worstCost = 0.0;
+	size_t currentTriangles = triangleCount;
+
+	// Finds the wedge at "to" that each wedge at "from" becomes
+	// - A wedge that shares an edge with one at "to" goes to that
+	//   one, so seams slide along themselves without tearing
+	// - Any other wedge goes to the one with the closest normal
+	//   and UV, and the difference is returned in attributes
+	// - Fails if one wedge shares edges with two different wedges
+	//   at "to" (a seam that ends or turns there would tear)
+	std::vector<unsigned int> wedgeTarget(vertexCount, None);
+	std::vector<unsigned int> moved, movedTo;
+	auto matchWedges = [&](unsigned int from, unsigned int to, float& attributes) -> bool
+	{
+		moved.clear();
+		bool split = false;
+		for (unsigned int k = adjacencyOffset[from]; k < adjacencyOffset[from + 1]; k++)
+		{
+			const unsigned int* t = &out[adjacency[k] * 3];
+			unsigned int wedge = None, target = None;
+			for (int i = 0; i < 3; i++)
+			{
+				if (canonical[t[i]] == from)
+					wedge = t[i];
+				else if (canonical[t[i]] == to)
+					target = t[i];
+			}
+
+			if (wedgeTarget[wedge] == None)
+			{
+				wedgeTarget[wedge] = Unmatched;
+				moved.push_back(wedge);
+			}
+			if (target == None)
+				continue;
+			if (wedgeTarget[wedge] == Unmatched)
+				wedgeTarget[wedge] = target;
+			else if (wedgeTarget[wedge] != target)
+				split = true;
+		}
+
+		attributes = 0.0f;
+		movedTo.resize(moved.size());
+		for (size_t m = 0; m < moved.size(); m++)
+		{
+			unsigned int wedge = moved[m];
+			unsigned int target = wedgeTarget[wedge];
+			wedgeTarget[wedge] = None;
+			if (target == Unmatched)
+			{
+				float bestDistance = -1.0f;
+				for (unsigned int w = wedgeOffset[to]; w < wedgeOffset[to + 1]; w++)
+				{
+					float distance = AttributeDistance(vertices[wedge], vertices[wedges[w]]);
+					if (bestDistance < 0.0f || distance < bestDistance)
+					{
+						bestDistance = distance;
+						target = wedges[w];
+					}
+				}
+			}
+			attributes += AttributeDistance(vertices[wedge], vertices[target]);
+			movedTo[m] = target;
+		}
+		return !split;
+	};
+
+	// Each pass collapses a batch of independent edges, cheapest
+	// first, then rebuilds the triangle list
+	while (currentTriangles > targetTriangles)
+	{
+		// Vertex -> triangle adjacency, by position
+		std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+		for (size_t i = 0; i < currentTriangles * 3; i++)
+			adjacencyOffset[canonical[out[i]] + 1]++;
+		for (size_t i = 0; i < vertexCount; i++)
+			adjacencyOffset[i + 1] += adjacencyOffset[i];
+		adjacency.resize(currentTriangles * 3);
+		{
+			std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+			for (size_t i = 0; i < currentTriangles * 3; i++)
+				adjacency[fill[canonical[out[i]]]++] = (unsigned int)(i / 3);
+		}
+
+		// Cheapest direction of every edge
+		collapses.clear();
+		for (size_t t = 0; t < currentTriangles; t++)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = canonical[out[t * 3 + e]];
+				unsigned int b = canonical[out[t * 3 + (e + 1) % 3]];
+
+				// Each edge is seen from both of its triangles - only
+				// handle it once (open edges only have one triangle)
+				if (a == b || (a > b && !border[a] && !border[b]))
+					continue;
+
+				Collapse best = { None, None, 0.0 };
+				for (int direction = 0; direction < 2; direction++)
+				{
+					unsigned int from = direction == 0 ? a : b;
+					unsigned int to = direction == 0 ? b : a;
+					if (!movable[from])
+						continue;
+
+					float attributes;
+					if (!matchWedges(from, to, attributes))
+						continue;
+
+					double cost = Evaluate(quadrics[from], vertices[to].Position) + attributeScale * attributes;
+					if (best.from == None || cost < best.cost)
+					{
+						best.from = from;
+						best.to = to;
+						best.cost = cost;
+					}
+				}
+
+				if (best.from != None && best.cost <= maxCost)
+					collapses.push_back(best);
+			}
+		}
+
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		// Pick collapses that don't touch each other this pass
+		std::fill(touched.begin(), touched.end(), false);
+		size_t removed = 0;
+		size_t accepted = 0;
+		for (auto& collapse : collapses)
+		{
+			if (currentTriangles - removed <= targetTriangles)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			// Reject the collapse if any remaining triangle would flip
+			const XMFLOAT3& target = vertices[collapse.to].Position;
+			bool flips = false;
+			size_t dying = 0;
+			for (unsigned int k = adjacencyOffset[collapse.from]; k < adjacencyOffset[collapse.from + 1]; k++)
+			{
+				unsigned int t = adjacency[k];
+				unsigned int c[3] = { canonical[out[t * 3]], canonical[out[t * 3 + 1]], canonical[out[t * 3 + 2]] };
+				if (c[0] == collapse.to || c[1] == collapse.to || c[2] == collapse.to)
+				{
+					dying++;
+					continue;
+				}
+
+				XMFLOAT3 p[3], q[3];
+				for (int i = 0; i < 3; i++)
+				{
+					p[i] = vertices[c[i]].Position;
+					q[i] = c[i] == collapse.from ? target : p[i];
+				}
+				XMFLOAT3 before = Cross(Sub(p[1], p[0]), Sub(p[2], p[0]));
+				XMFLOAT3 after = Cross(Sub(q[1], q[0]), Sub(q[2], q[0]));
+				if (Dot(before, after) <= 0.0f)
+				{
+					flips = true;
+					break;
+				}
+			}
+			if (flips)
+				continue;
+
+			// Lock the whole neighborhood for the rest of this pass
+			for (unsigned int k = adjacencyOffset[collapse.from]; k < adjacencyOffset[collapse.from + 1]; k++)
+			{
+				unsigned int t = adjacency[k];
+				for (int i = 0; i < 3; i++)
+					touched[canonical[out[t * 3 + i]]] = true;
+			}
+
+			// Every wedge at the old position moves at once
+			float attributes;
+			matchWedges(collapse.from, collapse.to, attributes);
+			for (size_t m = 0; m < moved.size(); m++)
+				remap[moved[m]] = movedTo[m];
+
+			movable[collapse.from] = false;
+			AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			quadrics[collapse.to].attribute += attributeScale * attributes;
+			worstCost = std::max(worstCost, collapse.cost);
+			removed += dying;
+			accepted++;
+		}
+
+		if (accepted == 0)
+			break;
+
+		// Apply the remap and drop triangles that became degenerate
+		size_t write = 0;
+		for (size_t t = 0; t < currentTriangles; t++)
+		{
+			unsigned int i0 = remap[out[t * 3]];
+			unsigned int i1 = remap[out[t * 3 + 1]];
+			unsigned int i2 = remap[out[t * 3 + 2]];
+			unsigned int c0 = canonical[i0], c1 = canonical[i1], c2 = canonical[i2];
+			if (c0 == c1 || c1 == c2 || c0 == c2)
+				continue;
+
+			out[write * 3] = i0;
+			out[write * 3 + 1] = i1;
+			out[write * 3 + 2] = i2;
+			write++;
+		}
+		currentTriangles = write;
+		out.resize(currentTriangles * 3);
+	}
+
+	return (float)(sqrt(worstCost) / bounds.radius);
+}
+
+// --------------------------------------------------------
+// Each level is simplified from the one before it, which is
+// both faster and keeps the levels consistent with each other
+// --------------------------------------------------------
+void MeshSimplifier::BuildLods(MeshData & data, unsigned int lodCount, float lodRatio, const SimplifyOptions & options)
+{
+	data.lods.clear();
+
+	MeshLod full;
+	full.indexStart = 0;
+	full.indexCount = (unsigned int)data.indices.size();
+	full.error = 0.0f;
+	data.lods.push_back(full);
+
+	SimplifyOptions levelOptions = options;
+	levelOptions.targetRatio = lodRatio;
+
+	std::vector<unsigned int> previous(data.indices);
+	std::vector<unsigned int> simplified;
+	float error = 0.0f;
+
+	for (unsigned int level = 1; level < lodCount; level++)
+	{
+		// Each level only gets what the ones before it left over
+		levelOptions.maxError = options.maxError - error;
+		if (levelOptions.maxError <= 0.0f)
+			break;
+		float levelError = Simplify(data.vertices, &previous[0], previous.size(), levelOptions, simplified);
+
+		// Stop once the simplifier can't make any more progress
+		// within the error bound
+		if (simplified.empty() || simplified.size() >= previous.size() || error + levelError > options.maxError)
+			break;
+
+		VertexCacheOptimizer::Optimize(simplified, (unsigned int)data.vertices.size());
+
+		// Errors add up since every level starts from the last one
+		error += levelError;
+
+		MeshLod lod;
+		lod.indexStart = (unsigned int)data.indices.size();
+		lod.indexCount = (unsigned int)simplified.size();
+		lod.error = error;
+		data.lods.push_back(lod);
+		data.indices.insert(data.indices.end(), simplified.begin(), simplified.end());
+
+		previous.swap(simplified);
+	}
+}
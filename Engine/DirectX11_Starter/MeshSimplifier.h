@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include "MeshData.h"
+
+// --------------------------------------------------------
+// Settings for a single simplification
+// --------------------------------------------------------
+struct SimplifyOptions
+{
+	float targetRatio;       // Fraction of triangles to keep
+	float maxError;          // Largest allowed error, relative to the bounding radius
+	bool lockBorder;         // Never move vertices on open edges
+	float attributeWeight;   // How much normal/UV changes count against a collapse
+
+	SimplifyOptions()
+	{
+		targetRatio = 0.5f;
+		maxError = 0.05f;
+		lockBorder = true;
+		attributeWeight = 0.05f;
+	}
+};
+
+// --------------------------------------------------------
+// Quadric error mesh simplification (Garland & Heckbert)
+// - Uses half-edge collapses, so the output only references
+//   vertices that already exist - every LOD can share the
+//   original vertex buffer
+// - Works on positions - vertices split by UV/normal seams
+//   collapse together, each wedge onto the one it shares an
+//   edge with, so seams slide along themselves instead of
+//   tearing. Normal/UV changes are added to the error
+// - With lockBorder, vertices on open edges never move
+// - Collapses that would flip a triangle are rejected
+// --------------------------------------------------------
+class MeshSimplifier
+{
+public:
+	// Returns the error that was reached (relative to the radius)
+	static float Simplify(const std::vector<Vertex>& vertices, const unsigned int* indices, size_t indexCount,
+		const SimplifyOptions& options, std::vector<unsigned int>& out);
+
+	// Appends up to lodCount - 1 simplified levels after the existing
+	// indices (each about lodRatio of the previous one) and fills
+	// in data.lods, with level 0 being the original triangles.
+	// options.maxError bounds every level's total error - the chain
+	// stops early rather than go past it
+	static void BuildLods(MeshData& data, unsigned int lodCount, float lodRatio = 0.5f,
+		const SimplifyOptions& options = SimplifyOptions());
+};
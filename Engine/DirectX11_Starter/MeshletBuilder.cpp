@@ -0,0 +1,337 @@
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	const unsigned int None = 0xFFFFFFFF;
+
+	// Cones wider than this (dot product between the axis and the
+	// worst normal) can't reject anything useful
+	const float MinimumConeDot = 0.1f;
+
+	inline XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	inline signed char QuantizeSigned(float value)
+	{
+		int q = (int)floorf(value * 127.0f + 0.5f);
+		return (signed char)std::max(-127, std::min(127, q));
+	}
+
+	// The axis exactly as Cull() will see it
+	XMFLOAT3 DecodeAxis(const signed char* axis)
+	{
+		XMFLOAT3 decoded(axis[0] / 127.0f, axis[1] / 127.0f, axis[2] / 127.0f);
+		float length = sqrtf(Dot(decoded, decoded));
+		if (length > 0.0f)
+		{
+			decoded.x /= length;
+			decoded.y /= length;
+			decoded.z /= length;
+		}
+		return decoded;
+	}
+
+	// --------------------------------------------------------
+	// Bounding sphere and backface cone of one finished meshlet
+	// - The sphere is centered on the vertices' box
+	// - The cone's axis is the average face normal; the cutoff is
+	//   computed against the *quantized* axis and rounded up, so
+	//   quantizing never makes culling less conservative
+	// --------------------------------------------------------
+	void ComputeBounds(Meshlet& meshlet, const std::vector<Vertex>& vertices, const unsigned int* indices, const std::vector<XMFLOAT3>& faceNormals, size_t firstTriangle)
+	{
+		XMFLOAT3 minimum = vertices[indices[0]].Position;
+		XMFLOAT3 maximum = minimum;
+		for (unsigned int i = 1; i < meshlet.indexCount; i++)
+		{
+			const XMFLOAT3& p = vertices[indices[i]].Position;
+			minimum.x = std::min(minimum.x, p.x); maximum.x = std::max(maximum.x, p.x);
+			minimum.y = std::min(minimum.y, p.y); maximum.y = std::max(maximum.y, p.y);
+			minimum.z = std::min(minimum.z, p.z); maximum.z = std::max(maximum.z, p.z);
+		}
+		meshlet.center = XMFLOAT3((minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f);
+
+		float radiusSquared = 0.0f;
+		for (unsigned int i = 0; i < meshlet.indexCount; i++)
+		{
+			XMFLOAT3 offset = Sub(vertices[indices[i]].Position, meshlet.center);
+			radiusSquared = std::max(radiusSquared, Dot(offset, offset));
+		}
+		meshlet.radius = sqrtf(radiusSquared);
+
+		// Average of the (unit) face normals
+		unsigned int triangleCount = meshlet.indexCount / 3;
+		XMFLOAT3 axis(0, 0, 0);
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			const XMFLOAT3& n = faceNormals[firstTriangle + t];
+			axis.x += n.x;
+			axis.y += n.y;
+			axis.z += n.z;
+		}
+
+		meshlet.coneAxis[0] = 0;
+		meshlet.coneAxis[1] = 0;
+		meshlet.coneAxis[2] = 0;
+		meshlet.coneCutoff = 127;
+
+		float axisLength = sqrtf(Dot(axis, axis));
+		if (axisLength <= 0.0f)
+			return;
+
+		signed char quantized[3] =
+		{
+			QuantizeSigned(axis.x / axisLength),
+			QuantizeSigned(axis.y / axisLength),
+			QuantizeSigned(axis.z / axisLength)
+		};
+		XMFLOAT3 decoded = DecodeAxis(quantized);
+
+		float minimumDot = 1.0f;
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			const XMFLOAT3& n = faceNormals[firstTriangle + t];
+			if (n.x == 0.0f && n.y == 0.0f && n.z == 0.0f)
+				continue;
+			minimumDot = std::min(minimumDot, Dot(n, decoded));
+		}
+		if (minimumDot <= MinimumConeDot)
+			return;
+
+		// Sine of the cone's half angle, rounded up
+		float cutoff = sqrtf(1.0f - minimumDot * minimumDot);
+		int quantizedCutoff = (int)ceilf(cutoff * 127.0f);
+
+		meshlet.coneAxis[0] = quantized[0];
+		meshlet.coneAxis[1] = quantized[1];
+		meshlet.coneAxis[2] = quantized[2];
+		meshlet.coneCutoff = (signed char)std::min(127, quantizedCutoff);
+	}
+}
+
+
+// --------------------------------------------------------
+// Greedy clustering:
+// - Start a meshlet at the first triangle not used yet (the
+//   input is already in vertex cache order, so that's a good
+//   place to continue from)
+// - Keep adding the neighboring triangle that needs the fewest
+//   new vertices, breaking ties by distance to the meshlet's
+//   centroid, until a limit is hit
+// - When the meshlet runs out of neighbors (a disconnected
+//   piece) it carries on with the next unused triangle
+// --------------------------------------------------------
+void MeshletBuilder::Build(MeshData & data, unsigned int maxVertices, unsigned int maxTriangles)
+{
+	data.meshlets.clear();
+
+	size_t indexCount = data.lods.empty() ? data.indices.size() : data.lods[0].indexCount;
+	size_t triangleCount = indexCount / 3;
+	size_t vertexCount = data.vertices.size();
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	maxVertices = std::max(maxVertices, 3u);
+	maxTriangles = std::max(maxTriangles, 1u);
+	const unsigned int* indices = &data.indices[0];
+
+	// Triangles using each vertex
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacencyOffsets[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	{
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+	}
+
+	// Centroids and unit normals of every triangle
+	std::vector<XMFLOAT3> centroids(triangleCount);
+	std::vector<XMFLOAT3> normals(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const XMFLOAT3& a = data.vertices[indices[t * 3 + 0]].Position;
+		const XMFLOAT3& b = data.vertices[indices[t * 3 + 1]].Position;
+		const XMFLOAT3& c = data.vertices[indices[t * 3 + 2]].Position;
+		centroids[t] = XMFLOAT3((a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f);
+
+		// Front faces are clockwise, so this points at the viewer
+		XMFLOAT3 n = Cross(Sub(b, a), Sub(c, a));
+		float length = sqrtf(Dot(n, n));
+		normals[t] = length > 0.0f ? XMFLOAT3(n.x / length, n.y / length, n.z / length) : XMFLOAT3(0, 0, 0);
+	}
+
+	std::vector<char> emitted(triangleCount, 0);
+	std::vector<unsigned int> vertexStamp(vertexCount, None);
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(indexCount);
+
+	// Triangles in output order, to line the normals up with meshlets
+	std::vector<XMFLOAT3> outputNormals;
+	outputNormals.reserve(triangleCount);
+
+	size_t nextSeed = 0;
+	unsigned int stamp = 0;
+	while (true)
+	{
+		while (nextSeed < triangleCount && emitted[nextSeed])
+			nextSeed++;
+		if (nextSeed == triangleCount)
+			break;
+
+		Meshlet meshlet = {};
+		meshlet.indexStart = (unsigned int)output.size();
+		size_t firstTriangle = output.size() / 3;
+		unsigned int meshletVertices = 0;
+		unsigned int meshletTriangles = 0;
+		XMFLOAT3 centroidSum(0, 0, 0);
+		candidates.clear();
+
+		while (meshletTriangles < maxTriangles)
+		{
+			// Best neighbor, dropping ones that are used or can't fit
+			unsigned int best = None;
+			unsigned int bestNew = 4;
+			float bestDistance = FLT_MAX;
+			XMFLOAT3 centroid(0, 0, 0);
+			if (meshletTriangles > 0)
+				centroid = XMFLOAT3(centroidSum.x / meshletTriangles, centroidSum.y / meshletTriangles, centroidSum.z / meshletTriangles);
+
+			size_t kept = 0;
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				unsigned int t = candidates[i];
+				if (emitted[t])
+					continue;
+
+				unsigned int newVertices = 0;
+				for (int c = 0; c < 3; c++)
+					newVertices += vertexStamp[indices[t * 3 + c]] != stamp;
+				if (meshletVertices + newVertices > maxVertices)
+					continue;
+
+				candidates[kept++] = t;
+				XMFLOAT3 offset = Sub(centroids[t], centroid);
+				float distance = Dot(offset, offset);
+				if (newVertices < bestNew || (newVertices == bestNew && distance < bestDistance))
+				{
+					best = t;
+					bestNew = newVertices;
+					bestDistance = distance;
+				}
+			}
+			candidates.resize(kept);
+
+			// No neighbors - continue with the next piece if it fits
+			if (best == None)
+			{
+				while (nextSeed < triangleCount && emitted[nextSeed])
+					nextSeed++;
+				if (nextSeed == triangleCount || meshletVertices + 3 > maxVertices)
+					break;
+				best = (unsigned int)nextSeed;
+			}
+
+			emitted[best] = 1;
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[best * 3 + c];
+				output.push_back(v);
+				if (vertexStamp[v] != stamp)
+				{
+					vertexStamp[v] = stamp;
+					meshletVertices++;
+				}
+				for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+				{
+					if (!emitted[adjacency[a]])
+						candidates.push_back(adjacency[a]);
+				}
+			}
+			outputNormals.push_back(normals[best]);
+			centroidSum.x += centroids[best].x;
+			centroidSum.y += centroids[best].y;
+			centroidSum.z += centroids[best].z;
+			meshletTriangles++;
+		}
+
+		meshlet.indexCount = meshletTriangles * 3;
+		meshlet.vertexCount = meshletVertices;
+		ComputeBounds(meshlet, data.vertices, &output[meshlet.indexStart], outputNormals, firstTriangle);
+		data.meshlets.push_back(meshlet);
+		stamp++;
+	}
+
+	std::copy(output.begin(), output.end(), data.indices.begin());
+}
+
+// --------------------------------------------------------
+// Sphere vs. frustum, then the cone test from meshoptimizer:
+// the whole cluster faces away when
+//   dot(center - camera, axis) >= cutoff * |center - camera| + radius
+// --------------------------------------------------------
+unsigned int MeshletBuilder::Cull(const Meshlet * meshlets, size_t meshletCount, const Frustum & frustum,
+	const XMFLOAT3 & cameraPosition, std::vector<IndexRange>& visible, MeshletCullStats * stats)
+{
+	visible.clear();
+	unsigned int survivors = 0;
+	unsigned int frustumCulled = 0;
+	unsigned int coneCulled = 0;
+
+	for (size_t i = 0; i < meshletCount; i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		if (!frustum.IntersectsSphere(meshlet.center, meshlet.radius))
+		{
+			frustumCulled++;
+			continue;
+		}
+
+		if (meshlet.coneCutoff < 127)
+		{
+			XMFLOAT3 axis = DecodeAxis(meshlet.coneAxis);
+			XMFLOAT3 toCenter = Sub(meshlet.center, cameraPosition);
+			float distance = sqrtf(Dot(toCenter, toCenter));
+			if (Dot(toCenter, axis) >= meshlet.coneCutoff / 127.0f * distance + meshlet.radius)
+			{
+				coneCulled++;
+				continue;
+			}
+		}
+
+		survivors++;
+		if (!visible.empty() && visible.back().indexStart + visible.back().indexCount == meshlet.indexStart)
+		{
+			visible.back().indexCount += meshlet.indexCount;
+		}
+		else
+		{
+			IndexRange range;
+			range.indexStart = meshlet.indexStart;
+			range.indexCount = meshlet.indexCount;
+			visible.push_back(range);
+		}
+	}
+
+	if (stats)
+	{
+		stats->tested = (unsigned int)meshletCount;
+		stats->frustumCulled = frustumCulled;
+		stats->coneCulled = coneCulled;
+	}
+	return survivors;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include "MeshData.h"
+#include "Frustum.h"
+
+// --------------------------------------------------------
+// A contiguous run of indices to hand to DrawIndexed
+// --------------------------------------------------------
+struct IndexRange
+{
+	unsigned int indexStart;
+	unsigned int indexCount;
+};
+
+// --------------------------------------------------------
+// What one call to MeshletBuilder::Cull() threw away
+// --------------------------------------------------------
+struct MeshletCullStats
+{
+	unsigned int tested;
+	unsigned int frustumCulled;
+	unsigned int coneCulled;
+};
+
+// --------------------------------------------------------
+// Splits a mesh into meshlets - small clusters of triangles
+// that can be culled as a unit on the CPU
+// - Clusters are grown across shared vertices, preferring the
+//   triangle that adds the fewest new vertices, so each one
+//   stays compact (tight sphere, narrow normal cone)
+// - Level 0's triangles are rewritten in meshlet order, so every
+//   meshlet is one range of the index buffer
+// --------------------------------------------------------
+class MeshletBuilder
+{
+public:
+	// Sized for the usual 64 vertex / 124 triangle limits
+	static const unsigned int DefaultMaxVertices = 64;
+	static const unsigned int DefaultMaxTriangles = 124;
+
+	// Fills data.meshlets and reorders level 0 of data.indices
+	// - Must run before extra LODs are built if those should
+	//   follow the same triangle order (they don't have to)
+	static void Build(MeshData& data, unsigned int maxVertices = DefaultMaxVertices,
+		unsigned int maxTriangles = DefaultMaxTriangles);
+
+	// Tests every meshlet against the frustum and its backface
+	// cone, and writes the survivors as index ranges (neighbors
+	// are merged so there are as few draws as possible)
+	// - frustum and cameraPosition must be in the mesh's object
+	//   space (see Frustum::FromMatrix)
+	// - Returns the number of meshlets that survived
+	static unsigned int Cull(const Meshlet* meshlets, size_t meshletCount, const Frustum& frustum,
+		const DirectX::XMFLOAT3& cameraPosition, std::vector<IndexRange>& visible, MeshletCullStats* stats = nullptr);
+};
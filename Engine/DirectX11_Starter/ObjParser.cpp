@@ -0,0 +1,465 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	// Files smaller than this are not worth spinning up threads for
+	const size_t MinBytesPerThread = 256 * 1024;
+
+	// Marks an index that was not present in the face
+	const int MissingIndex = INT_MIN;
+
+	// Flags telling the merge step which indices of a corner were
+	// negative (relative) and so still need the chunk's base count
+	const unsigned char RelativePosition = 1;
+	const unsigned char RelativeUV = 2;
+	const unsigned char RelativeNormal = 4;
+
+	// Exact powers of ten for the float scanner
+	const double PowersOfTen[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	// The output of a single chunk, before merging
+	struct ChunkResult
+	{
+		std::vector<XMFLOAT3> positions;
+		std::vector<XMFLOAT3> normals;
+		std::vector<XMFLOAT2> uvs;
+		std::vector<ObjCorner> corners;
+		std::vector<unsigned char> relative;
+	};
+
+	inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+	inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+	inline const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p))
+			++p;
+		return p;
+	}
+
+	inline const char* NextLine(const char* p, const char* end)
+	{
+		const char* newline = (const char*)memchr(p, '\n', end - p);
+		return newline ? newline + 1 : end;
+	}
+
+	// --------------------------------------------------------
+	// Reads a decimal float such as "-1.25e-3"
+	// - Up to 19 significant digits are kept in an integer mantissa
+	//   and scaled once at the end, which is both faster and more
+	//   accurate than accumulating a float digit by digit
+	// - Returns nullptr if there was no number to read
+	// --------------------------------------------------------
+	const char* ScanFloat(const char* p, const char* end, float& out)
+	{
+		p = SkipSpaces(p, end);
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			++p;
+		}
+
+		unsigned long long mantissa = 0;
+		int significant = 0;
+		int exponent = 0;
+		bool anyDigits = false;
+
+		while (p < end && IsDigit(*p))
+		{
+			if (significant < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) significant++;
+			}
+			else
+			{
+				exponent++;
+			}
+			anyDigits = true;
+			++p;
+		}
+
+		if (p < end && *p == '.')
+		{
+			++p;
+			while (p < end && IsDigit(*p))
+			{
+				if (significant < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa != 0) significant++;
+					exponent--;
+				}
+				anyDigits = true;
+				++p;
+			}
+		}
+
+		if (!anyDigits)
+			return nullptr;
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			bool negativeExponent = false;
+			if (e < end && (*e == '-' || *e == '+'))
+			{
+				negativeExponent = (*e == '-');
+				++e;
+			}
+			if (e < end && IsDigit(*e))
+			{
+				int value = 0;
+				while (e < end && IsDigit(*e))
+				{
+					if (value < 10000) value = value * 10 + (*e - '0');
+					++e;
+				}
+				exponent += negativeExponent ? -value : value;
+				p = e;
+			}
+		}
+
+		double result = (double)mantissa;
+		if (mantissa != 0 && exponent != 0)
+		{
+			if (exponent > 0 && exponent <= 22) result *= PowersOfTen[exponent];
+			else if (exponent < 0 && exponent >= -22) result /= PowersOfTen[-exponent];
+			else result *= pow(10.0, exponent);
+		}
+
+		out = (float)(negative ? -result : result);
+		return p;
+	}
+
+	// --------------------------------------------------------
+	// Reads a signed integer with no leading whitespace
+	// - Returns nullptr if there was no number to read
+	// --------------------------------------------------------
+	const char* ScanInt(const char* p, const char* end, int& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			++p;
+		}
+
+		if (p >= end || !IsDigit(*p))
+			return nullptr;
+
+		int value = 0;
+		while (p < end && IsDigit(*p))
+		{
+			value = value * 10 + (*p - '0');
+			++p;
+		}
+
+		out = negative ? -value : value;
+		return p;
+	}
+
+	// --------------------------------------------------------
+	// Converts a raw OBJ index into either an absolute 0-based
+	// index or, for negative indices, an offset from the element
+	// count of this chunk (fixed up during the merge)
+	// --------------------------------------------------------
+	inline int ResolveIndex(int raw, size_t localCount, unsigned char flag, unsigned char& relative)
+	{
+		if (raw > 0)
+			return raw - 1;
+		if (raw < 0)
+		{
+			relative |= flag;
+			return (int)localCount + raw;
+		}
+		return MissingIndex;
+	}
+
+	// --------------------------------------------------------
+	// Reads one face corner - "v", "v/vt", "v//vn" or "v/vt/vn"
+	// --------------------------------------------------------
+	const char* ScanCorner(const char* p, const char* end, const ChunkResult& chunk, ObjCorner& corner, unsigned char& relative)
+	{
+		int raw = 0;
+		relative = 0;
+		corner.uv = MissingIndex;
+		corner.normal = MissingIndex;
+
+		p = ScanInt(p, end, raw);
+		if (!p)
+			return nullptr;
+		corner.position = ResolveIndex(raw, chunk.positions.size(), RelativePosition, relative);
+
+		if (p < end && *p == '/')
+		{
+			++p;
+			if (p < end && *p != '/')
+			{
+				const char* next = ScanInt(p, end, raw);
+				if (next)
+				{
+					corner.uv = ResolveIndex(raw, chunk.uvs.size(), RelativeUV, relative);
+					p = next;
+				}
+			}
+
+			if (p < end && *p == '/')
+			{
+				++p;
+				const char* next = ScanInt(p, end, raw);
+				if (next)
+				{
+					corner.normal = ResolveIndex(raw, chunk.normals.size(), RelativeNormal, relative);
+					p = next;
+				}
+			}
+		}
+
+		// Skip anything unexpected up to the next separator
+		while (p < end && !IsSpace(*p) && *p != '\n')
+			++p;
+
+		return p;
+	}
+
+	// --------------------------------------------------------
+	// Parses every line in [begin, end) into a chunk result
+	// --------------------------------------------------------
+	void ParseChunk(const char* begin, const char* end, ChunkResult& chunk)
+	{
+		// Rough guess to avoid most reallocations; OBJ lines
+		// average somewhere around 30 bytes
+		size_t estimatedLines = (end - begin) / 30;
+		chunk.positions.reserve(estimatedLines / 3);
+		chunk.corners.reserve(estimatedLines * 3 / 2);
+		chunk.relative.reserve(estimatedLines * 3 / 2);
+
+		std::vector<ObjCorner> faceCorners;
+		std::vector<unsigned char> faceRelative;
+
+		const char* p = begin;
+		while (p < end)
+		{
+			p = SkipSpaces(p, end);
+			if (p >= end)
+				break;
+
+			if (p[0] == 'v' && p + 1 < end)
+			{
+				if (IsSpace(p[1]))
+				{
+					XMFLOAT3 pos(0, 0, 0);
+					const char* q = ScanFloat(p + 1, end, pos.x);
+					if (q) q = ScanFloat(q, end, pos.y);
+					if (q) q = ScanFloat(q, end, pos.z);
+					chunk.positions.push_back(pos);
+				}
+				else if (p[1] == 't')
+				{
+					XMFLOAT2 uv(0, 0);
+					const char* q = ScanFloat(p + 2, end, uv.x);
+					if (q) q = ScanFloat(q, end, uv.y);
+					chunk.uvs.push_back(uv);
+				}
+				else if (p[1] == 'n')
+				{
+					XMFLOAT3 norm(0, 0, 0);
+					const char* q = ScanFloat(p + 2, end, norm.x);
+					if (q) q = ScanFloat(q, end, norm.y);
+					if (q) q = ScanFloat(q, end, norm.z);
+					chunk.normals.push_back(norm);
+				}
+			}
+			else if (p[0] == 'f' && p + 1 < end && IsSpace(p[1]))
+			{
+				faceCorners.clear();
+				faceRelative.clear();
+
+				const char* q = p + 1;
+				while (true)
+				{
+					q = SkipSpaces(q, end);
+					if (q >= end || *q == '\n')
+						break;
+
+					ObjCorner corner;
+					unsigned char relative;
+					q = ScanCorner(q, end, chunk, corner, relative);
+					if (!q)
+						break;
+
+					faceCorners.push_back(corner);
+					faceRelative.push_back(relative);
+				}
+
+				// Fan triangulate n-gons around the first corner
+				for (size_t i = 1; i + 1 < faceCorners.size(); i++)
+				{
+					chunk.corners.push_back(faceCorners[0]);
+					chunk.corners.push_back(faceCorners[i]);
+					chunk.corners.push_back(faceCorners[i + 1]);
+					chunk.relative.push_back(faceRelative[0]);
+					chunk.relative.push_back(faceRelative[i]);
+					chunk.relative.push_back(faceRelative[i + 1]);
+				}
+			}
+
+			p = NextLine(p, end);
+		}
+	}
+
+	// --------------------------------------------------------
+	// Turns a chunk-local index into a final index, or -1 if it
+	// is missing or out of range
+	// --------------------------------------------------------
+	inline int FinalIndex(int index, bool relative, size_t base, size_t total)
+	{
+		if (index == MissingIndex)
+			return -1;
+
+		long long absolute = relative ? (long long)base + index : index;
+		if (absolute < 0 || absolute >= (long long)total)
+			return -1;
+		return (int)absolute;
+	}
+}
+
+
+// --------------------------------------------------------
+// Maps the file and parses it
+// --------------------------------------------------------
+bool ObjParser::ParseFile(const char * filename, ObjData & out, unsigned int threadCount)
+{
+	MappedFile file;
+	if (!file.Open(filename))
+		return false;
+
+	return ParseBuffer(file.GetData(), file.GetSize(), out, threadCount);
+}
+
+// --------------------------------------------------------
+// Parses OBJ text that is already in memory
+// --------------------------------------------------------
+bool ObjParser::ParseBuffer(const char * data, size_t size, ObjData & out, unsigned int threadCount)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	out.positions.clear();
+	out.normals.clear();
+	out.uvs.clear();
+	out.corners.clear();
+	out.fileBytes = size;
+	out.parseSeconds = 0.0;
+	out.threadsUsed = 0;
+
+	if (data == nullptr || size == 0)
+		return false;
+
+	// Decide how many chunks to use
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+	size_t maxChunks = size / MinBytesPerThread;
+	if (maxChunks < 1)
+		maxChunks = 1;
+	if (threadCount > maxChunks)
+		threadCount = (unsigned int)maxChunks;
+
+	// Split at line boundaries so no line straddles two chunks
+	const char* end = data + size;
+	std::vector<const char*> bounds(threadCount + 1);
+	bounds[0] = data;
+	bounds[threadCount] = end;
+	for (unsigned int i = 1; i < threadCount; i++)
+	{
+		const char* guess = data + (size / threadCount) * i;
+		if (guess < bounds[i - 1])
+			guess = bounds[i - 1];
+		bounds[i] = NextLine(guess, end);
+	}
+
+	// Parse every chunk - the calling thread takes the first one
+	std::vector<ChunkResult> chunks(threadCount);
+	std::vector<std::thread> workers;
+	for (unsigned int i = 1; i < threadCount; i++)
+		workers.push_back(std::thread(ParseChunk, bounds[i], bounds[i + 1], std::ref(chunks[i])));
+	ParseChunk(bounds[0], bounds[1], chunks[0]);
+	for (auto& worker : workers)
+		worker.join();
+
+	// Merge in file order so results never depend on scheduling
+	size_t positionCount = 0, uvCount = 0, normalCount = 0, cornerCount = 0;
+	for (auto& chunk : chunks)
+	{
+		positionCount += chunk.positions.size();
+		uvCount += chunk.uvs.size();
+		normalCount += chunk.normals.size();
+		cornerCount += chunk.corners.size();
+	}
+
+	out.positions.reserve(positionCount);
+	out.uvs.reserve(uvCount);
+	out.normals.reserve(normalCount);
+	out.corners.reserve(cornerCount);
+
+	for (auto& chunk : chunks)
+	{
+		size_t positionBase = out.positions.size();
+		size_t uvBase = out.uvs.size();
+		size_t normalBase = out.normals.size();
+
+		out.positions.insert(out.positions.end(), chunk.positions.begin(), chunk.positions.end());
+		out.uvs.insert(out.uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+		out.normals.insert(out.normals.end(), chunk.normals.begin(), chunk.normals.end());
+
+		// Fix up indices one triangle at a time, dropping any
+		// triangle that points at a position that doesn't exist
+		for (size_t i = 0; i + 2 < chunk.corners.size(); i += 3)
+		{
+			ObjCorner tri[3];
+			bool valid = true;
+			for (int c = 0; c < 3; c++)
+			{
+				const ObjCorner& src = chunk.corners[i + c];
+				unsigned char relative = chunk.relative[i + c];
+				tri[c].position = FinalIndex(src.position, (relative & RelativePosition) != 0, positionBase, positionCount);
+				tri[c].uv = FinalIndex(src.uv, (relative & RelativeUV) != 0, uvBase, uvCount);
+				tri[c].normal = FinalIndex(src.normal, (relative & RelativeNormal) != 0, normalBase, normalCount);
+				if (tri[c].position < 0)
+					valid = false;
+			}
+
+			if (valid)
+				out.corners.insert(out.corners.end(), tri, tri + 3);
+		}
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	out.parseSeconds = std::chrono::duration<double>(endTime - startTime).count();
+	out.threadsUsed = threadCount;
+	return true;
+}
+
+double ObjParser::GetThroughput(const ObjData & data)
+{
+	if (data.parseSeconds <= 0.0)
+		return 0.0;
+	return (data.fileBytes / (1024.0 * 1024.0)) / data.parseSeconds;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <vector>
+
+// --------------------------------------------------------
+// One corner of a triangle read from an OBJ file
+// - Indices are already 0-based and point into ObjData's arrays
+// - A missing uv or normal (e.g. "f 1//3" or "f 1/2") is -1
+// --------------------------------------------------------
+struct ObjCorner
+{
+	int position;
+	int uv;
+	int normal;
+};
+
+// --------------------------------------------------------
+// Everything the parser pulls out of an OBJ file
+// - Faces with more than three corners are fanned into triangles,
+//   so "corners" always holds three entries per triangle
+// --------------------------------------------------------
+struct ObjData
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT3> normals;
+	std::vector<DirectX::XMFLOAT2> uvs;
+	std::vector<ObjCorner> corners;
+
+	// Load statistics, handy for comparing parse throughput
+	size_t fileBytes;
+	double parseSeconds;
+	unsigned int threadsUsed;
+};
+
+// --------------------------------------------------------
+// Fast OBJ reader
+// - The file is memory mapped and split into line-aligned chunks
+// - Each chunk is parsed on its own thread with a hand-written
+//   number scanner (no sscanf, no line length limit)
+// - Chunks are merged in file order, so the output is identical
+//   no matter how many threads were used
+// --------------------------------------------------------
+class ObjParser
+{
+public:
+	// threadCount of 0 picks one thread per hardware core
+	static bool ParseFile(const char* filename, ObjData& out, unsigned int threadCount = 0);
+	static bool ParseBuffer(const char* data, size_t size, ObjData& out, unsigned int threadCount = 0);
+
+	// Converts "ParseFile" statistics into megabytes per second
+	static double GetThroughput(const ObjData& data);
+};
@@ -0,0 +1,712 @@
+#include "OcclusionCuller.h"
+#include "TransformStore.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// Same as in TransformStore.cpp - GCC and Clang need each
+// instruction set enabled per function
+#if defined(__GNUC__)
+#define OCCLUSION_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define OCCLUSION_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define OCCLUSION_TARGET_SSE41
+#define OCCLUSION_TARGET_AVX2
+#endif
+
+namespace
+{
+	const unsigned int TilePixels = OcclusionCuller::TileWidth * OcclusionCuller::TileHeight;
+	const unsigned int FullMask = 0xFFFFFFFF;
+
+	// 28.4 fixed point - a pixel is 16 steps
+	const int SubpixelBits = 4;
+	const int PixelSize = 1 << SubpixelBits;
+	const int HalfPixel = PixelSize / 2;
+
+	// Triangles are clipped to twice the screen in x and y, which
+	// keeps fixed point coordinates under 2^16 and edge products
+	// in 64 bits - edge values beyond this are clamped, as no
+	// step inside a tile can bring them back to 0
+	const float GuardBand = 2.0f;
+	const long long EdgeLimit = 1ll << 30;
+
+	// Tile rows per band when rendering on a pool, and boxes per
+	// chunk when testing
+	const unsigned int BandGrainSize = 2;
+	const unsigned int CullGrainSize = 256;
+
+	const int ClipPlaneCount = 5;
+
+	// Each edge's value at the 32 pixel centers of a tile, relative
+	// to the tile's corner - a * x + b * y in fixed point
+	struct EdgeOffsets
+	{
+		alignas(32) int values[3][TilePixels];
+		int minimum[3];
+		int maximum[3];
+	};
+
+	bool DetectSSE41()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 19)) != 0;
+#elif defined(__GNUC__)
+		return __builtin_cpu_supports("sse4.1") != 0;
+#else
+		return false;
+#endif
+	}
+
+	// AVX2 also needs the OS to save the wide registers, which the
+	// AVX check already covers
+	bool DetectAVX2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0 && TransformStore::IsKernelSupported(TRANSFORM_KERNEL_AVX);
+#elif defined(__GNUC__)
+		return __builtin_cpu_supports("avx2") != 0;
+#else
+		return false;
+#endif
+	}
+
+	void RunRange(ThreadPool* pool, unsigned int count, unsigned int grainSize, const ParallelForFunction& function)
+	{
+		if (pool)
+			pool->ParallelFor(count, grainSize, function);
+		else if (count > 0)
+			function(0, count);
+	}
+
+	// How far inside each clip plane a vertex is - near (D3D's
+	// z >= 0), then the guard band's left, right, bottom and top
+	float ClipDistance(const XMFLOAT4& v, int plane)
+	{
+		switch (plane)
+		{
+		case 0: return v.z;
+		case 1: return GuardBand * v.w + v.x;
+		case 2: return GuardBand * v.w - v.x;
+		case 3: return GuardBand * v.w + v.y;
+		default: return GuardBand * v.w - v.y;
+		}
+	}
+
+	unsigned int OutCode(const XMFLOAT4& v)
+	{
+		unsigned int code = 0;
+		for (int p = 0; p < ClipPlaneCount; p++)
+			code |= ClipDistance(v, p) < 0.0f ? 1u << p : 0u;
+		return code;
+	}
+
+	XMFLOAT4 Lerp(const XMFLOAT4& a, const XMFLOAT4& b, float t)
+	{
+		return XMFLOAT4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t);
+	}
+
+	// --------------------------------------------------------
+	// Sutherland-Hodgman against the planes in "planes" - a
+	// triangle comes out with at most one more vertex per plane
+	// --------------------------------------------------------
+	unsigned int ClipPolygon(XMFLOAT4* polygon, unsigned int count, unsigned int planes)
+	{
+		XMFLOAT4 clipped[3 + ClipPlaneCount];
+		for (int p = 0; p < ClipPlaneCount && count >= 3; p++)
+		{
+			if ((planes & (1u << p)) == 0)
+				continue;
+
+			unsigned int clippedCount = 0;
+			for (unsigned int i = 0; i < count; i++)
+			{
+				const XMFLOAT4& a = polygon[i];
+				const XMFLOAT4& b = polygon[(i + 1) % count];
+				float da = ClipDistance(a, p);
+				float db = ClipDistance(b, p);
+				if (da >= 0.0f)
+					clipped[clippedCount++] = a;
+				if ((da >= 0.0f) != (db >= 0.0f))
+					clipped[clippedCount++] = Lerp(a, b, da / (da - db));
+			}
+			std::copy(clipped, clipped + clippedCount, polygon);
+			count = clippedCount;
+		}
+		return count;
+	}
+
+	// --------------------------------------------------------
+	// The kernels - each turns the three edge values at a tile's
+	// corner into the tile's coverage mask (bit y * 8 + x), a
+	// pixel being covered when no edge is negative there
+	// - OR-ing the three values leaves the sign bit set exactly
+	//   when one of them is negative
+	// --------------------------------------------------------
+	void ComputeOffsetsScalar(const int* a, const int* b, EdgeOffsets& offsets)
+	{
+		for (int e = 0; e < 3; e++)
+		{
+			for (unsigned int p = 0; p < TilePixels; p++)
+			{
+				int x = (int)(p % OcclusionCuller::TileWidth) * PixelSize + HalfPixel;
+				int y = (int)(p / OcclusionCuller::TileWidth) * PixelSize + HalfPixel;
+				offsets.values[e][p] = a[e] * x + b[e] * y;
+			}
+		}
+	}
+
+	unsigned int CoverScalar(const int* edges, const EdgeOffsets& offsets)
+	{
+		unsigned int mask = 0;
+		for (unsigned int p = 0; p < TilePixels; p++)
+		{
+			int inside = (edges[0] + offsets.values[0][p]) | (edges[1] + offsets.values[1][p]) | (edges[2] + offsets.values[2][p]);
+			mask |= inside >= 0 ? 1u << p : 0u;
+		}
+		return mask;
+	}
+
+	// _mm_mullo_epi32 is what needs SSE4.1
+	OCCLUSION_TARGET_SSE41
+	void ComputeOffsetsSSE41(const int* a, const int* b, EdgeOffsets& offsets)
+	{
+		const __m128i columns[2] = {
+			_mm_setr_epi32(HalfPixel, PixelSize + HalfPixel, 2 * PixelSize + HalfPixel, 3 * PixelSize + HalfPixel),
+			_mm_setr_epi32(4 * PixelSize + HalfPixel, 5 * PixelSize + HalfPixel, 6 * PixelSize + HalfPixel, 7 * PixelSize + HalfPixel) };
+		for (int e = 0; e < 3; e++)
+		{
+			__m128i ea = _mm_set1_epi32(a[e]);
+			for (unsigned int p = 0; p < TilePixels; p += 4)
+			{
+				int y = (int)(p / OcclusionCuller::TileWidth) * PixelSize + HalfPixel;
+				__m128i value = _mm_add_epi32(_mm_mullo_epi32(ea, columns[(p / 4) & 1]), _mm_set1_epi32(b[e] * y));
+				_mm_store_si128((__m128i*)&offsets.values[e][p], value);
+			}
+		}
+	}
+
+	OCCLUSION_TARGET_SSE41
+	unsigned int CoverSSE41(const int* edges, const EdgeOffsets& offsets)
+	{
+		__m128i e0 = _mm_set1_epi32(edges[0]);
+		__m128i e1 = _mm_set1_epi32(edges[1]);
+		__m128i e2 = _mm_set1_epi32(edges[2]);
+
+		unsigned int mask = 0;
+		for (unsigned int p = 0; p < TilePixels; p += 4)
+		{
+			__m128i inside = _mm_or_si128(
+				_mm_or_si128(
+					_mm_add_epi32(e0, _mm_load_si128((const __m128i*)&offsets.values[0][p])),
+					_mm_add_epi32(e1, _mm_load_si128((const __m128i*)&offsets.values[1][p]))),
+				_mm_add_epi32(e2, _mm_load_si128((const __m128i*)&offsets.values[2][p])));
+			mask |= (unsigned int)(~_mm_movemask_ps(_mm_castsi128_ps(inside)) & 0xF) << p;
+		}
+		return mask;
+	}
+
+	OCCLUSION_TARGET_AVX2
+	void ComputeOffsetsAVX2(const int* a, const int* b, EdgeOffsets& offsets)
+	{
+		const __m256i columns = _mm256_setr_epi32(HalfPixel, PixelSize + HalfPixel, 2 * PixelSize + HalfPixel,
+			3 * PixelSize + HalfPixel, 4 * PixelSize + HalfPixel, 5 * PixelSize + HalfPixel, 6 * PixelSize + HalfPixel,
+			7 * PixelSize + HalfPixel);
+		for (int e = 0; e < 3; e++)
+		{
+			__m256i row = _mm256_mullo_epi32(_mm256_set1_epi32(a[e]), columns);
+			for (unsigned int y = 0; y < OcclusionCuller::TileHeight; y++)
+			{
+				__m256i value = _mm256_add_epi32(row, _mm256_set1_epi32(b[e] * ((int)y * PixelSize + HalfPixel)));
+				_mm256_store_si256((__m256i*)&offsets.values[e][y * OcclusionCuller::TileWidth], value);
+			}
+		}
+	}
+
+	OCCLUSION_TARGET_AVX2
+	unsigned int CoverAVX2(const int* edges, const EdgeOffsets& offsets)
+	{
+		__m256i e0 = _mm256_set1_epi32(edges[0]);
+		__m256i e1 = _mm256_set1_epi32(edges[1]);
+		__m256i e2 = _mm256_set1_epi32(edges[2]);
+
+		unsigned int mask = 0;
+		for (unsigned int p = 0; p < TilePixels; p += 8)
+		{
+			__m256i inside = _mm256_or_si256(
+				_mm256_or_si256(
+					_mm256_add_epi32(e0, _mm256_load_si256((const __m256i*)&offsets.values[0][p])),
+					_mm256_add_epi32(e1, _mm256_load_si256((const __m256i*)&offsets.values[1][p]))),
+				_mm256_add_epi32(e2, _mm256_load_si256((const __m256i*)&offsets.values[2][p])));
+			mask |= (unsigned int)(~_mm256_movemask_ps(_mm256_castsi256_ps(inside)) & 0xFF) << p;
+		}
+		return mask;
+	}
+
+	int ClampEdge(long long value)
+	{
+		return (int)std::max(-EdgeLimit, std::min(EdgeLimit, value));
+	}
+}
+
+
+std::shared_ptr<OccluderMesh> OccluderMesh::FromMeshData(const MeshData & data, int lod)
+{
+	std::shared_ptr<OccluderMesh> mesh = std::make_shared<OccluderMesh>();
+	mesh->positions.reserve(data.vertices.size());
+	for (const Vertex& vertex : data.vertices)
+		mesh->positions.push_back(vertex.Position);
+
+	if (data.lods.empty())
+		mesh->indices = data.indices;
+	else
+	{
+		const MeshLod& level = data.lods[std::min(std::max(lod, 0), (int)data.lods.size() - 1)];
+		mesh->indices.assign(data.indices.begin() + level.indexStart, data.indices.begin() + level.indexStart + level.indexCount);
+	}
+	return mesh;
+}
+
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+{
+	Resize(width, height);
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+}
+
+void OcclusionCuller::Resize(unsigned int width, unsigned int height)
+{
+	width = std::max((unsigned int)TileWidth, std::min(width, 2048u));
+	height = std::max((unsigned int)TileHeight, std::min(height, 2048u));
+	tilesX = (width + TileWidth - 1) / TileWidth;
+	tilesY = (height + TileHeight - 1) / TileHeight;
+	tileDepths.assign(tilesX * tilesY, 1.0f);
+	workingDepths.assign(tilesX * tilesY, 0.0f);
+	workingMasks.assign(tilesX * tilesY, 0);
+}
+
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4 & newViewProjection)
+{
+	viewProjection = newViewProjection;
+	std::fill(tileDepths.begin(), tileDepths.end(), 1.0f);
+	std::fill(workingDepths.begin(), workingDepths.end(), 0.0f);
+	std::fill(workingMasks.begin(), workingMasks.end(), 0);
+	occluders.clear();
+}
+
+// The stored world matrix is transposed, so row i of the real
+// one is column i here
+void OcclusionCuller::AddOccluder(const OccluderMesh & mesh, const XMFLOAT4X4 & worldMatrix)
+{
+	Occluder occluder;
+	occluder.mesh = &mesh;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			occluder.clipMatrix.m[i][j] =
+				worldMatrix.m[0][i] * viewProjection.m[0][j] + worldMatrix.m[1][i] * viewProjection.m[1][j] +
+				worldMatrix.m[2][i] * viewProjection.m[2][j] + worldMatrix.m[3][i] * viewProjection.m[3][j];
+		}
+	}
+	occluders.push_back(occluder);
+}
+
+// --------------------------------------------------------
+// Set up every occluder's triangles in parallel, then split
+// the screen into bands of tile rows - each band goes through
+// every triangle that reaches it, and no two touch the same
+// tile
+// --------------------------------------------------------
+unsigned int OcclusionCuller::RenderOccluders(ThreadPool * pool, OcclusionKernel kernel)
+{
+	if (kernel == OCCLUSION_KERNEL_BEST)
+		kernel = IsKernelSupported(OCCLUSION_KERNEL_AVX2) ? OCCLUSION_KERNEL_AVX2 :
+			IsKernelSupported(OCCLUSION_KERNEL_SSE41) ? OCCLUSION_KERNEL_SSE41 : OCCLUSION_KERNEL_SCALAR;
+
+	if (occluderTriangles.size() < occluders.size())
+		occluderTriangles.resize(occluders.size());
+
+	RunRange(pool, (unsigned int)occluders.size(), 1, [this](unsigned int begin, unsigned int end)
+	{
+		std::vector<XMFLOAT4> clipPositions;
+		for (unsigned int i = begin; i < end; i++)
+			SetupOccluder(i, clipPositions);
+	});
+
+	RunRange(pool, tilesY, BandGrainSize, [this, kernel](unsigned int begin, unsigned int end)
+	{
+		RasterizeBand((int)begin, (int)end, kernel);
+	});
+
+	unsigned int triangleCount = 0;
+	for (unsigned int i = 0; i < occluders.size(); i++)
+		triangleCount += (unsigned int)occluderTriangles[i].size();
+	return triangleCount;
+}
+
+// --------------------------------------------------------
+// The box's corners on the screen give a rectangle of tiles
+// and the nearest depth the box reaches - it's hidden if
+// every one of those tiles is known to be in front of that
+// --------------------------------------------------------
+bool OcclusionCuller::IsOccluded(const Aabb & bounds) const
+{
+	const XMFLOAT4X4& m = viewProjection;
+	float width = (float)(tilesX * TileWidth);
+	float height = (float)(tilesY * TileHeight);
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearest = FLT_MAX;
+	for (int c = 0; c < 8; c++)
+	{
+		float x = (c & 1) ? bounds.max.x : bounds.min.x;
+		float y = (c & 2) ? bounds.max.y : bounds.min.y;
+		float z = (c & 4) ? bounds.max.z : bounds.min.z;
+		float clipX = x * m._11 + y * m._21 + z * m._31 + m._41;
+		float clipY = x * m._12 + y * m._22 + z * m._32 + m._42;
+		float clipZ = x * m._13 + y * m._23 + z * m._33 + m._43;
+		float clipW = x * m._14 + y * m._24 + z * m._34 + m._44;
+		if (clipZ < 0.0f || clipW <= 0.0f)
+			return false;
+
+		float inverseW = 1.0f / clipW;
+		float screenX = (clipX * inverseW * 0.5f + 0.5f) * width;
+		float screenY = (0.5f - clipY * inverseW * 0.5f) * height;
+		minX = std::min(minX, screenX);
+		maxX = std::max(maxX, screenX);
+		minY = std::min(minY, screenY);
+		maxY = std::max(maxY, screenY);
+		nearest = std::min(nearest, clipZ * inverseW);
+	}
+
+	// Entirely off the screen - that's for the frustum to decide
+	if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+		return false;
+
+	int tileMinX = std::max(0, (int)floorf(minX) / (int)TileWidth);
+	int tileMaxX = std::min((int)tilesX - 1, (int)floorf(maxX) / (int)TileWidth);
+	int tileMinY = std::max(0, (int)floorf(minY) / (int)TileHeight);
+	int tileMaxY = std::min((int)tilesY - 1, (int)floorf(maxY) / (int)TileHeight);
+
+	__m128 depth = _mm_set1_ps(nearest);
+	for (int ty = tileMinY; ty <= tileMaxY; ty++)
+	{
+		const float* row = &tileDepths[ty * tilesX];
+		int tx = tileMinX;
+		for (; tx + 4 <= tileMaxX + 1; tx += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmplt_ps(depth, _mm_loadu_ps(row + tx))) != 0)
+				return false;
+		}
+		for (; tx <= tileMaxX; tx++)
+		{
+			if (nearest < row[tx])
+				return false;
+		}
+	}
+	return true;
+}
+
+unsigned int OcclusionCuller::Cull(const Aabb * bounds, const unsigned int * ids, unsigned int count, std::vector<unsigned int>& visible,
+	ThreadPool * pool)
+{
+	occludedFlags.resize(count);
+	RunRange(pool, count, CullGrainSize, [this, bounds](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+			occludedFlags[i] = IsOccluded(bounds[i]) ? 1 : 0;
+	});
+
+	visible.clear();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (!occludedFlags[i])
+			visible.push_back(ids[i]);
+	}
+	return (unsigned int)visible.size();
+}
+
+bool OcclusionCuller::IsKernelSupported(OcclusionKernel kernel)
+{
+	static const bool hasSSE41 = DetectSSE41();
+	static const bool hasAVX2 = DetectAVX2();
+	if (kernel == OCCLUSION_KERNEL_SSE41)
+		return hasSSE41;
+	if (kernel == OCCLUSION_KERNEL_AVX2)
+		return hasAVX2;
+	return true;
+}
+
+// --------------------------------------------------------
+// Object space to clip space, then each triangle is clipped
+// only if it crosses the near plane or the guard band - most
+// don't - and the ones left are turned into ScreenTriangles
+// --------------------------------------------------------
+void OcclusionCuller::SetupOccluder(unsigned int index, std::vector<XMFLOAT4>& clipPositions)
+{
+	Occluder& occluder = occluders[index];
+	std::vector<ScreenTriangle>& output = occluderTriangles[index];
+	const OccluderMesh& mesh = *occluder.mesh;
+	const XMFLOAT4X4& m = occluder.clipMatrix;
+	output.clear();
+
+	clipPositions.resize(mesh.positions.size());
+	for (size_t i = 0; i < mesh.positions.size(); i++)
+	{
+		const XMFLOAT3& p = mesh.positions[i];
+		clipPositions[i] = XMFLOAT4(
+			p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41,
+			p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42,
+			p.x * m._13 + p.y * m._23 + p.z * m._33 + m._43,
+			p.x * m._14 + p.y * m._24 + p.z * m._34 + m._44);
+	}
+
+	for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+	{
+		const XMFLOAT4& v0 = clipPositions[mesh.indices[t]];
+		const XMFLOAT4& v1 = clipPositions[mesh.indices[t + 1]];
+		const XMFLOAT4& v2 = clipPositions[mesh.indices[t + 2]];
+		unsigned int code0 = OutCode(v0);
+		unsigned int code1 = OutCode(v1);
+		unsigned int code2 = OutCode(v2);
+
+		// All three outside the same plane
+		if ((code0 & code1 & code2) != 0)
+			continue;
+
+		if ((code0 | code1 | code2) == 0)
+		{
+			AddTriangle(v0, v1, v2, output);
+			continue;
+		}
+
+		XMFLOAT4 polygon[3 + ClipPlaneCount] = { v0, v1, v2 };
+		unsigned int count = ClipPolygon(polygon, 3, code0 | code1 | code2);
+		for (unsigned int i = 2; i < count; i++)
+			AddTriangle(polygon[0], polygon[i - 1], polygon[i], output);
+	}
+
+	occluder.tileMinY = (int)tilesY;
+	occluder.tileMaxY = -1;
+	for (const ScreenTriangle& triangle : output)
+	{
+		occluder.tileMinY = std::min(occluder.tileMinY, triangle.tileMinY);
+		occluder.tileMaxY = std::max(occluder.tileMaxY, triangle.tileMaxY);
+	}
+}
+
+// --------------------------------------------------------
+// Projects a clipped triangle onto the screen - both windings
+// are kept (occluders needn't be closed), flipped so edges
+// are positive inside
+// --------------------------------------------------------
+void OcclusionCuller::AddTriangle(const XMFLOAT4 & v0, const XMFLOAT4 & v1, const XMFLOAT4 & v2, std::vector<ScreenTriangle>& output)
+{
+	const XMFLOAT4* vertices[3] = { &v0, &v1, &v2 };
+	float width = (float)(tilesX * TileWidth);
+	float height = (float)(tilesY * TileHeight);
+
+	ScreenTriangle triangle;
+	float depth[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const XMFLOAT4& v = *vertices[i];
+		float inverseW = 1.0f / v.w;
+		triangle.x[i] = (int)lrintf((v.x * inverseW * 0.5f + 0.5f) * width * PixelSize);
+		triangle.y[i] = (int)lrintf((0.5f - v.y * inverseW * 0.5f) * height * PixelSize);
+		depth[i] = v.z * inverseW;
+	}
+
+	long long area = (long long)(triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) -
+		(long long)(triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+	if (area == 0)
+		return;
+	if (area < 0)
+	{
+		std::swap(triangle.x[1], triangle.x[2]);
+		std::swap(triangle.y[1], triangle.y[2]);
+		std::swap(depth[1], depth[2]);
+	}
+
+	int minX = std::min(triangle.x[0], std::min(triangle.x[1], triangle.x[2]));
+	int maxX = std::max(triangle.x[0], std::max(triangle.x[1], triangle.x[2]));
+	int minY = std::min(triangle.y[0], std::min(triangle.y[1], triangle.y[2]));
+	int maxY = std::max(triangle.y[0], std::max(triangle.y[1], triangle.y[2]));
+	triangle.tileMinX = std::max(0, (minX >> SubpixelBits) / (int)TileWidth);
+	triangle.tileMaxX = std::min((int)tilesX - 1, (maxX >> SubpixelBits) / (int)TileWidth);
+	triangle.tileMinY = std::max(0, (minY >> SubpixelBits) / (int)TileHeight);
+	triangle.tileMaxY = std::min((int)tilesY - 1, (maxY >> SubpixelBits) / (int)TileHeight);
+	if (triangle.tileMinX > triangle.tileMaxX || triangle.tileMinY > triangle.tileMaxY)
+		return;
+
+	// Depth as a plane over pixel coordinates
+	float x0 = triangle.x[0] / (float)PixelSize, y0 = triangle.y[0] / (float)PixelSize;
+	float dx1 = triangle.x[1] / (float)PixelSize - x0, dy1 = triangle.y[1] / (float)PixelSize - y0;
+	float dx2 = triangle.x[2] / (float)PixelSize - x0, dy2 = triangle.y[2] / (float)PixelSize - y0;
+	float dz1 = depth[1] - depth[0], dz2 = depth[2] - depth[0];
+	float determinant = dx1 * dy2 - dx2 * dy1;
+	triangle.depthX = (dz1 * dy2 - dz2 * dy1) / determinant;
+	triangle.depthY = (dx1 * dz2 - dx2 * dz1) / determinant;
+	triangle.depthC = depth[0] - triangle.depthX * x0 - triangle.depthY * y0;
+	triangle.maxDepth = std::max(depth[0], std::max(depth[1], depth[2]));
+	output.push_back(triangle);
+}
+
+// --------------------------------------------------------
+// Walks the tiles each triangle's bounds cover within the band
+// - Edge values at a tile's corner come from 64 bit math and
+//   step along the row; the 32 pixels inside are offsets from
+//   that, worked out once per triangle
+// - A tile no edge can reach is covered without looking at
+//   its pixels, and one an edge can't reach into is skipped
+// - Each tile gets the farthest the triangle's depth plane
+//   reaches over it, no farther than its farthest vertex
+// --------------------------------------------------------
+void OcclusionCuller::RasterizeBand(int tileRowBegin, int tileRowEnd, OcclusionKernel kernel)
+{
+	EdgeOffsets offsets;
+	for (unsigned int o = 0; o < occluders.size(); o++)
+	{
+		const Occluder& occluder = occluders[o];
+		if (occluder.tileMaxY < tileRowBegin || occluder.tileMinY >= tileRowEnd)
+			continue;
+
+		for (const ScreenTriangle& triangle : occluderTriangles[o])
+		{
+			int rowBegin = std::max(triangle.tileMinY, tileRowBegin);
+			int rowEnd = std::min(triangle.tileMaxY + 1, tileRowEnd);
+			if (rowBegin >= rowEnd)
+				continue;
+
+			int a[3], b[3];
+			for (int e = 0; e < 3; e++)
+			{
+				int next = e == 2 ? 0 : e + 1;
+				a[e] = triangle.y[e] - triangle.y[next];
+				b[e] = triangle.x[next] - triangle.x[e];
+			}
+
+			switch (kernel)
+			{
+			case OCCLUSION_KERNEL_AVX2:
+				ComputeOffsetsAVX2(a, b, offsets);
+				break;
+			case OCCLUSION_KERNEL_SSE41:
+				ComputeOffsetsSSE41(a, b, offsets);
+				break;
+			default:
+				ComputeOffsetsScalar(a, b, offsets);
+				break;
+			}
+
+			// Offsets are linear, so their extremes are at corner pixels
+			const unsigned int corners[4] = { 0, TileWidth - 1, TilePixels - TileWidth, TilePixels - 1 };
+			for (int e = 0; e < 3; e++)
+			{
+				offsets.minimum[e] = offsets.maximum[e] = offsets.values[e][0];
+				for (unsigned int c = 1; c < 4; c++)
+				{
+					offsets.minimum[e] = std::min(offsets.minimum[e], offsets.values[e][corners[c]]);
+					offsets.maximum[e] = std::max(offsets.maximum[e], offsets.values[e][corners[c]]);
+				}
+			}
+
+			float depthX = triangle.depthX >= 0.0f ? (float)TileWidth : 0.0f;
+			float depthY = triangle.depthY >= 0.0f ? (float)TileHeight : 0.0f;
+
+			for (int ty = rowBegin; ty < rowEnd; ty++)
+			{
+				long long rowEdges[3];
+				int tileX = triangle.tileMinX * TileWidth * PixelSize;
+				int tileY = ty * TileHeight * PixelSize;
+				for (int e = 0; e < 3; e++)
+					rowEdges[e] = (long long)a[e] * (tileX - triangle.x[e]) + (long long)b[e] * (tileY - triangle.y[e]);
+
+				for (int tx = triangle.tileMinX; tx <= triangle.tileMaxX; tx++)
+				{
+					int edges[3];
+					bool empty = false;
+					bool full = true;
+					for (int e = 0; e < 3; e++)
+					{
+						edges[e] = ClampEdge(rowEdges[e]);
+						rowEdges[e] += (long long)a[e] * (TileWidth * PixelSize);
+						empty = empty || edges[e] + offsets.maximum[e] < 0;
+						full = full && edges[e] + offsets.minimum[e] >= 0;
+					}
+					if (empty)
+						continue;
+
+					unsigned int coverage = FullMask;
+					if (!full)
+					{
+						switch (kernel)
+						{
+						case OCCLUSION_KERNEL_AVX2:
+							coverage = CoverAVX2(edges, offsets);
+							break;
+						case OCCLUSION_KERNEL_SSE41:
+							coverage = CoverSSE41(edges, offsets);
+							break;
+						default:
+							coverage = CoverScalar(edges, offsets);
+							break;
+						}
+						if (coverage == 0)
+							continue;
+					}
+
+					float farthest = triangle.depthC + triangle.depthX * (tx * TileWidth + depthX) + triangle.depthY * (ty * TileHeight + depthY);
+					UpdateTile(ty * tilesX + tx, coverage, std::min(farthest, triangle.maxDepth));
+				}
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Merges a triangle's pixels into a tile's working layer
+// - Nothing changes if the triangle is behind what the tile
+//   already has
+// - A triangle much nearer than the working layer (further
+//   from it than the working layer is from the tile's depth)
+//   starts a new working layer, rather than be held back by
+//   the old one - the paper's heuristic
+// - When the working layer covers the whole tile, its depth
+//   becomes the tile's
+// --------------------------------------------------------
+void OcclusionCuller::UpdateTile(unsigned int tile, unsigned int coverage, float depth)
+{
+	float& tileDepth = tileDepths[tile];
+	if (depth >= tileDepth)
+		return;
+
+	float& workingDepth = workingDepths[tile];
+	unsigned int& workingMask = workingMasks[tile];
+	if (workingMask != 0 && workingDepth - depth > tileDepth - workingDepth)
+	{
+		workingDepth = 0.0f;
+		workingMask = 0;
+	}
+
+	workingDepth = std::max(workingDepth, depth);
+	workingMask |= coverage;
+	if (workingMask == FullMask)
+	{
+		tileDepth = std::min(tileDepth, workingDepth);
+		workingDepth = 0.0f;
+		workingMask = 0;
+	}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <memory>
+#include <vector>
+#include "AabbTree.h"
+#include "MeshData.h"
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Which coverage loop OcclusionCuller::RenderOccluders() runs
+// - They all give exactly the same depth buffer
+// --------------------------------------------------------
+enum OcclusionKernel
+{
+	OCCLUSION_KERNEL_SCALAR = 0,   // One pixel at a time
+	OCCLUSION_KERNEL_SSE41 = 1,    // 4 pixels at a time
+	OCCLUSION_KERNEL_AVX2 = 2,     // 8 pixels (a tile row) at a time, if the CPU has it
+	OCCLUSION_KERNEL_BEST = 3      // Widest one the CPU supports
+};
+
+// --------------------------------------------------------
+// Triangles something is hidden behind - usually a few big,
+// simple pieces of the scenery (terrain, walls, grandstands)
+// rather than the mesh that's drawn
+// - Positions are in object space; indices are a triangle list
+// - Shared - every entity using the same occluder points at
+//   one copy
+// --------------------------------------------------------
+struct OccluderMesh
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+
+	// The triangles of one level of detail - a simplified level
+	// can stick out past the real mesh and hide things it
+	// shouldn't, so level 0 is the safe choice
+	static std::shared_ptr<OccluderMesh> FromMeshData(const MeshData& data, int lod = 0);
+};
+
+// --------------------------------------------------------
+// A small depth buffer drawn on the CPU from occluders, that
+// bounding boxes are tested against before they're drawn
+// - Masked occlusion culling: the screen is split into 8x4
+//   pixel tiles, and instead of a depth per pixel each tile
+//   keeps two depths - one the whole tile is in front of, and
+//   one for the pixels in its coverage mask. Once the mask is
+//   full, that becomes the tile's depth
+// - Depths are conservative (the farthest an occluder can be
+//   in the tile), so nothing visible is ever reported hidden
+// - Edges are evaluated in fixed point, 4 bits below a pixel,
+//   so every kernel covers exactly the same pixels
+// - Rendering splits the screen into bands of tile rows across
+//   a ThreadPool; tests only read, so they can run on any
+//   number of threads
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+	// Sizes are rounded up to whole tiles - at most 2048 wide
+	// and tall
+	OcclusionCuller(unsigned int width = 320, unsigned int height = 192);
+
+	void Resize(unsigned int width, unsigned int height);
+	unsigned int GetWidth() { return tilesX * TileWidth; }
+	unsigned int GetHeight() { return tilesY * TileHeight; }
+
+	// Starts a frame - empties the depth buffer and the occluder
+	// list; viewProjection is not transposed, as Frustum::FromMatrix
+	// takes it
+	void BeginFrame(const DirectX::XMFLOAT4X4& viewProjection);
+
+	// The mesh has to stay alive until RenderOccluders() - the
+	// world matrix is (transposed, as stored for HLSL) copied
+	void AddOccluder(const OccluderMesh& mesh, const DirectX::XMFLOAT4X4& worldMatrix);
+	unsigned int GetOccluderCount() { return (unsigned int)occluders.size(); }
+
+	// Draws every occluder added since BeginFrame() - returns how
+	// many triangles made it onto the screen
+	unsigned int RenderOccluders(ThreadPool* pool = nullptr, OcclusionKernel kernel = OCCLUSION_KERNEL_BEST);
+
+	// True if a world space box is completely behind what's been
+	// rendered - boxes that reach the near plane never are
+	bool IsOccluded(const Aabb& bounds) const;
+
+	// Replaces visible with the ids of every box that isn't
+	// occluded, in order - returns how many there are
+	unsigned int Cull(const Aabb* bounds, const unsigned int* ids, unsigned int count, std::vector<unsigned int>& visible,
+		ThreadPool* pool = nullptr);
+
+	// The depth each tile is known to be in front of (1 where
+	// nothing was drawn), row by row - for debugging views
+	const float* GetTileDepths() { return tileDepths.empty() ? nullptr : &tileDepths[0]; }
+	unsigned int GetTilesX() { return tilesX; }
+	unsigned int GetTilesY() { return tilesY; }
+
+	static bool IsKernelSupported(OcclusionKernel kernel);
+
+	static const unsigned int TileWidth = 8;
+	static const unsigned int TileHeight = 4;
+
+private:
+	// A triangle after clipping, in 28.4 fixed point pixels, with
+	// its depth as a plane over the screen and the tiles it reaches
+	struct ScreenTriangle
+	{
+		int x[3];
+		int y[3];
+		float depthX, depthY, depthC;
+		float maxDepth;
+		int tileMinX, tileMaxX, tileMinY, tileMaxY;
+	};
+
+	struct Occluder
+	{
+		const OccluderMesh* mesh;
+		DirectX::XMFLOAT4X4 clipMatrix;   // Object space straight to clip space
+		int tileMinY, tileMaxY;           // Rows its triangles reach, after setup
+	};
+
+	void SetupOccluder(unsigned int index, std::vector<DirectX::XMFLOAT4>& clipPositions);
+	void AddTriangle(const DirectX::XMFLOAT4& v0, const DirectX::XMFLOAT4& v1, const DirectX::XMFLOAT4& v2,
+		std::vector<ScreenTriangle>& output);
+	void RasterizeBand(int tileRowBegin, int tileRowEnd, OcclusionKernel kernel);
+	void UpdateTile(unsigned int tile, unsigned int coverage, float depth);
+
+	unsigned int tilesX;
+	unsigned int tilesY;
+	DirectX::XMFLOAT4X4 viewProjection;
+
+	// Per tile: the depth everything is in front of, the depth of
+	// the covered pixels, and which pixels those are (bit y * 8 + x)
+	std::vector<float> tileDepths;
+	std::vector<float> workingDepths;
+	std::vector<unsigned int> workingMasks;
+
+	// Each occluder's triangles go in its own list, so they can
+	// be set up in parallel - the lists are kept between frames
+	std::vector<Occluder> occluders;
+	std::vector<std::vector<ScreenTriangle>> occluderTriangles;
+	std::vector<unsigned char> occludedFlags;
+};
@@ -0,0 +1,339 @@
+#include "OverdrawOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	// Cache size used to find cluster boundaries
+	const unsigned int ClusterCacheSize = 16;
+
+	// Resolution of the overdraw simulation, per view
+	const int ViewportSize = 256;
+
+	// View directions used by Analyze() - the six axes and the
+	// eight corners of a cube
+	const float ViewDirections[][3] =
+	{
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+		{ 1, 1, 1 }, { 1, 1, -1 }, { 1, -1, 1 }, { 1, -1, -1 },
+		{ -1, 1, 1 }, { -1, 1, -1 }, { -1, -1, 1 }, { -1, -1, -1 }
+	};
+
+	inline XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+	inline XMFLOAT3 Normalize(const XMFLOAT3& v)
+	{
+		float length = sqrtf(Dot(v, v));
+		return length > 0.0f ? XMFLOAT3(v.x / length, v.y / length, v.z / length) : v;
+	}
+
+	// --------------------------------------------------------
+	// Minimal FIFO cache used while walking the index buffer
+	// --------------------------------------------------------
+	struct FifoCache
+	{
+		std::vector<unsigned int> insertedAt;
+		unsigned int timestamp;
+
+		FifoCache(size_t vertexCount) : insertedAt(vertexCount, 0), timestamp(ClusterCacheSize + 1) {}
+
+		// Starting over just means moving time far enough forward
+		void Reset() { timestamp += ClusterCacheSize + 1; }
+
+		// Returns the number of misses for one triangle
+		unsigned int Process(const unsigned int* tri)
+		{
+			unsigned int misses = 0;
+			for (int c = 0; c < 3; c++)
+			{
+				if (timestamp - insertedAt[tri[c]] > ClusterCacheSize)
+				{
+					insertedAt[tri[c]] = timestamp++;
+					misses++;
+				}
+			}
+			return misses;
+		}
+	};
+
+	// --------------------------------------------------------
+	// Splits the triangle list into clusters
+	// - Hard boundaries: triangles where all three vertices miss,
+	//   i.e. where the cache optimizer had to jump elsewhere
+	// - Soft boundaries: inside a hard cluster, cut as soon as the
+	//   piece so far is within "threshold" of the cluster's ACMR
+	// --------------------------------------------------------
+	void BuildClusters(const std::vector<unsigned int>& indices, size_t vertexCount, float threshold, std::vector<size_t>& clusters)
+	{
+		size_t triangleCount = indices.size() / 3;
+
+		std::vector<size_t> hard;
+		FifoCache cache(vertexCount);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			if (cache.Process(&indices[t * 3]) == 3)
+				hard.push_back(t);
+		}
+		if (hard.empty() || hard[0] != 0)
+			hard.insert(hard.begin(), 0);
+		hard.push_back(triangleCount);
+
+		for (size_t h = 0; h + 1 < hard.size(); h++)
+		{
+			size_t start = hard[h];
+			size_t end = hard[h + 1];
+
+			// ACMR of the whole hard cluster
+			cache.Reset();
+			unsigned int clusterMisses = 0;
+			for (size_t t = start; t < end; t++)
+				clusterMisses += cache.Process(&indices[t * 3]);
+			float clusterThreshold = threshold * clusterMisses / (end - start);
+
+			clusters.push_back(start);
+			cache.Reset();
+			size_t pieceStart = start;
+			unsigned int pieceMisses = 0;
+			for (size_t t = start; t < end; t++)
+			{
+				pieceMisses += cache.Process(&indices[t * 3]);
+				if (t + 1 < end && (float)pieceMisses / (t + 1 - pieceStart) <= clusterThreshold)
+				{
+					clusters.push_back(t + 1);
+					pieceStart = t + 1;
+					pieceMisses = 0;
+					cache.Reset();
+				}
+			}
+		}
+
+		clusters.push_back(triangleCount);
+	}
+
+	// --------------------------------------------------------
+	// Rasterizes one view of the mesh into a depth buffer and
+	// counts how many pixels pass the depth test
+	// --------------------------------------------------------
+	unsigned int RasterizeView(const std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices,
+		const XMFLOAT3& center, float radius, const float* direction, std::vector<float>& depth, unsigned int& covered)
+	{
+		// Build a left handed view basis like XMMatrixLookToLH does
+		XMFLOAT3 forward = Normalize(XMFLOAT3(direction[0], direction[1], direction[2]));
+		XMFLOAT3 up = fabsf(forward.y) < 0.99f ? XMFLOAT3(0, 1, 0) : XMFLOAT3(1, 0, 0);
+		XMFLOAT3 right = Normalize(Cross(up, forward));
+		up = Cross(forward, right);
+
+		std::fill(depth.begin(), depth.end(), FLT_MAX);
+		float scale = 0.5f * ViewportSize / radius;
+
+		unsigned int shaded = 0;
+		size_t triangleCount = indices.size() / 3;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			XMFLOAT3 screen[3];
+			for (int c = 0; c < 3; c++)
+			{
+				XMFLOAT3 local = Sub(vertices[indices[t * 3 + c]].Position, center);
+				screen[c].x = 0.5f * ViewportSize + Dot(local, right) * scale;
+				screen[c].y = 0.5f * ViewportSize - Dot(local, up) * scale;
+				screen[c].z = Dot(local, forward);
+			}
+
+			// Clockwise (in y-down screen space) is front facing,
+			// matching D3D11's default rasterizer state
+			float area =
+				(screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+				(screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+			if (area <= 0.0f)
+				continue;
+
+			int minX = std::max(0, (int)floorf(std::min(screen[0].x, std::min(screen[1].x, screen[2].x))));
+			int maxX = std::min(ViewportSize - 1, (int)ceilf(std::max(screen[0].x, std::max(screen[1].x, screen[2].x))));
+			int minY = std::max(0, (int)floorf(std::min(screen[0].y, std::min(screen[1].y, screen[2].y))));
+			int maxY = std::min(ViewportSize - 1, (int)ceilf(std::max(screen[0].y, std::max(screen[1].y, screen[2].y))));
+
+			float inverseArea = 1.0f / area;
+			for (int y = minY; y <= maxY; y++)
+			{
+				float py = y + 0.5f;
+				for (int x = minX; x <= maxX; x++)
+				{
+					float px = x + 0.5f;
+					float w0 = (screen[2].x - screen[1].x) * (py - screen[1].y) - (screen[2].y - screen[1].y) * (px - screen[1].x);
+					float w1 = (screen[0].x - screen[2].x) * (py - screen[2].y) - (screen[0].y - screen[2].y) * (px - screen[2].x);
+					float w2 = (screen[1].x - screen[0].x) * (py - screen[0].y) - (screen[1].y - screen[0].y) * (px - screen[0].x);
+					if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+						continue;
+
+					float z = (w0 * screen[0].z + w1 * screen[1].z + w2 * screen[2].z) * inverseArea;
+					float& stored = depth[y * ViewportSize + x];
+					if (z < stored)
+					{
+						stored = z;
+						shaded++;
+					}
+				}
+			}
+		}
+
+		for (float d : depth)
+		{
+			if (d != FLT_MAX)
+				covered++;
+		}
+		return shaded;
+	}
+}
+
+
+// --------------------------------------------------------
+// Sorts clusters by how much they face away from the mesh's
+// center, so the outer shell tends to draw before whatever it
+// hides (same idea as meshoptimizer's overdraw optimizer)
+// --------------------------------------------------------
+void OverdrawOptimizer::Optimize(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || vertices.empty())
+		return;
+
+	std::vector<size_t> clusters;
+	BuildClusters(indices, vertices.size(), threshold, clusters);
+	size_t clusterCount = clusters.size() - 1;
+
+	// Mesh centroid
+	XMFLOAT3 meshCenter(0, 0, 0);
+	for (auto& v : vertices)
+	{
+		meshCenter.x += v.Position.x;
+		meshCenter.y += v.Position.y;
+		meshCenter.z += v.Position.z;
+	}
+	meshCenter.x /= vertices.size();
+	meshCenter.y /= vertices.size();
+	meshCenter.z /= vertices.size();
+
+	// Area weighted centroid and normal of every cluster
+	std::vector<float> sortKey(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		XMFLOAT3 centroid(0, 0, 0);
+		XMFLOAT3 normal(0, 0, 0);
+		float totalArea = 0.0f;
+
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const XMFLOAT3& a = vertices[indices[t * 3 + 0]].Position;
+			const XMFLOAT3& b = vertices[indices[t * 3 + 1]].Position;
+			const XMFLOAT3& p = vertices[indices[t * 3 + 2]].Position;
+
+			XMFLOAT3 n = Cross(Sub(b, a), Sub(p, a));
+			float area = sqrtf(Dot(n, n));
+
+			centroid.x += (a.x + b.x + p.x) * (area / 3.0f);
+			centroid.y += (a.y + b.y + p.y) * (area / 3.0f);
+			centroid.z += (a.z + b.z + p.z) * (area / 3.0f);
+			normal.x += n.x;
+			normal.y += n.y;
+			normal.z += n.z;
+			totalArea += area;
+		}
+
+		if (totalArea > 0.0f)
+		{
+			centroid.x /= totalArea;
+			centroid.y /= totalArea;
+			centroid.z /= totalArea;
+		}
+
+		sortKey[c] = Dot(Sub(centroid, meshCenter), Normalize(normal));
+	}
+
+	// Highest key first; stable so equal keys keep cache order
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(),
+		[&sortKey](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<unsigned int> output;
+	output.reserve(indices.size());
+	for (size_t c : order)
+		output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+
+	indices.swap(output);
+}
+
+// --------------------------------------------------------
+// Renumbers vertices in the order the index buffer first uses
+// them - unreferenced vertices are dropped
+// --------------------------------------------------------
+void OverdrawOptimizer::OptimizeVertexFetch(MeshData & data)
+{
+	const unsigned int Unused = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(data.vertices.size(), Unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(data.vertices.size());
+
+	for (auto& index : data.indices)
+	{
+		if (remap[index] == Unused)
+		{
+			remap[index] = (unsigned int)reordered.size();
+			reordered.push_back(data.vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	data.vertices.swap(reordered);
+}
+
+OverdrawStats OverdrawOptimizer::Analyze(const std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices)
+{
+	OverdrawStats stats;
+	stats.pixelsCovered = 0;
+	stats.pixelsShaded = 0;
+	stats.overdraw = 0.0f;
+
+	if (indices.size() < 3 || vertices.empty())
+		return stats;
+
+	// Bounding sphere (box center, farthest vertex) to fit every view
+	XMFLOAT3 minimum = vertices[0].Position;
+	XMFLOAT3 maximum = vertices[0].Position;
+	for (auto& v : vertices)
+	{
+		minimum.x = std::min(minimum.x, v.Position.x);
+		minimum.y = std::min(minimum.y, v.Position.y);
+		minimum.z = std::min(minimum.z, v.Position.z);
+		maximum.x = std::max(maximum.x, v.Position.x);
+		maximum.y = std::max(maximum.y, v.Position.y);
+		maximum.z = std::max(maximum.z, v.Position.z);
+	}
+	XMFLOAT3 center((minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f);
+	float radius = 0.0f;
+	for (auto& v : vertices)
+	{
+		XMFLOAT3 offset = Sub(v.Position, center);
+		radius = std::max(radius, Dot(offset, offset));
+	}
+	radius = sqrtf(radius);
+	if (radius <= 0.0f)
+		return stats;
+
+	std::vector<float> depth(ViewportSize * ViewportSize);
+	for (auto& direction : ViewDirections)
+		stats.pixelsShaded += RasterizeView(indices, vertices, center, radius, direction, depth, stats.pixelsCovered);
+
+	if (stats.pixelsCovered > 0)
+		stats.overdraw = (float)stats.pixelsShaded / stats.pixelsCovered;
+	return stats;
+}
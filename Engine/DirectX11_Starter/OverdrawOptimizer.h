@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include "MeshData.h"
+
+// --------------------------------------------------------
+// Result of the software overdraw simulation
+// - overdraw = pixelsShaded / pixelsCovered, so 1.0 means every
+//   visible pixel was shaded exactly once
+// --------------------------------------------------------
+struct OverdrawStats
+{
+	unsigned int pixelsCovered;
+	unsigned int pixelsShaded;
+	float overdraw;
+};
+
+// --------------------------------------------------------
+// Second optimization pass, run after VertexCacheOptimizer
+// - Optimize() splits the cache-ordered triangles into clusters
+//   and sorts them so outward facing clusters draw first, which
+//   lets early-z reject more of the (expensive) pixel shader
+// - OptimizeVertexFetch() reorders the vertex buffer into first
+//   use order so the GPU reads it mostly sequentially
+// - Analyze() rasterizes the mesh on the CPU from a fixed set of
+//   view directions to measure overdraw without a GPU
+// --------------------------------------------------------
+class OverdrawOptimizer
+{
+public:
+	// threshold is how much worse than the original ACMR a cluster
+	// is allowed to get (1.05 = 5%) - larger values give smaller
+	// clusters and better sorting at the cost of cache efficiency
+	static void Optimize(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+	static void OptimizeVertexFetch(MeshData& data);
+	static OverdrawStats Analyze(const std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices);
+};
@@ -0,0 +1,210 @@
+#include "Picker.h"
+#include <algorithm>
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	// Rays per chunk of a pooled PickBatch()
+	const unsigned int BatchGrainSize = 64;
+
+	// A point (w = 1) or direction (w = 0) through a transposed
+	// matrix's 3x4 part
+	XMFLOAT3 Transform(const XMFLOAT4X4& m, const XMFLOAT3& v, float w)
+	{
+		return XMFLOAT3(
+			m._11 * v.x + m._12 * v.y + m._13 * v.z + m._14 * w,
+			m._21 * v.x + m._22 * v.y + m._23 * v.z + m._24 * w,
+			m._31 * v.x + m._32 * v.y + m._33 * v.z + m._34 * w);
+	}
+}
+
+Picker::Picker()
+{
+	dirty = false;
+}
+
+void Picker::Clear()
+{
+	ids.clear();
+	bounds.clear();
+	inverseMatrices.clear();
+	triangles.clear();
+	bvh.Clear();
+	dirty = false;
+}
+
+void Picker::Reserve(unsigned int count)
+{
+	ids.reserve(count);
+	bounds.reserve(count);
+	inverseMatrices.reserve(count);
+	triangles.reserve(count);
+}
+
+unsigned int Picker::Add(unsigned int id, const MeshBounds & meshBounds, const XMFLOAT4X4 & worldMatrix, const TriangleBvh * meshTriangles)
+{
+	if (meshTriangles != nullptr && meshTriangles->IsEmpty())
+		meshTriangles = nullptr;
+
+	ids.push_back(id);
+	bounds.push_back(Aabb::FromBounds(meshBounds, worldMatrix));
+	inverseMatrices.push_back(meshTriangles != nullptr ? InvertAffine(worldMatrix) : worldMatrix);
+	triangles.push_back(meshTriangles);
+	dirty = true;
+	return (unsigned int)ids.size() - 1;
+}
+
+void Picker::Build()
+{
+	if (!dirty)
+		return;
+	bvh.Build(bounds.empty() ? nullptr : &bounds[0], (unsigned int)bounds.size());
+	dirty = false;
+}
+
+bool Picker::Pick(const XMFLOAT3 & origin, const XMFLOAT3 & direction, PickHit & hit, float maxDistance)
+{
+	Build();
+	Trace(origin, direction, maxDistance, hit);
+	return hit.hit;
+}
+
+unsigned int Picker::PickBatch(const XMFLOAT3 * origins, const XMFLOAT3 * directions, unsigned int count, PickHit * hits,
+	float maxDistance, ThreadPool * pool)
+{
+	Build();
+
+	auto trace = [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int r = begin; r < end; r++)
+			Trace(origins[r], directions[r], maxDistance, hits[r]);
+	};
+	if (pool != nullptr)
+		pool->ParallelFor(count, BatchGrainSize, trace);
+	else
+		trace(0, count);
+
+	unsigned int hitCount = 0;
+	for (unsigned int r = 0; r < count; r++)
+		hitCount += hits[r].hit ? 1 : 0;
+	return hitCount;
+}
+
+// --------------------------------------------------------
+// Boxes come out of the tree nearest leaf first; each one the
+// ray reaches before the best hit so far is tested for real,
+// which then shortens the ray for everything after it
+// - Rays go into object space without being normalized, so a
+//   distance along one is the same distance along the other
+// --------------------------------------------------------
+void Picker::Trace(const XMFLOAT3 & origin, const XMFLOAT3 & direction, float maxDistance, PickHit & hit) const
+{
+	hit.hit = false;
+	hit.id = 0;
+	hit.triangle = TriangleBvh::NoTriangle;
+	hit.distance = maxDistance;
+
+	const unsigned int* order = bvh.GetOrder();
+	XMFLOAT3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	bvh.QueryRay(origin, direction, maxDistance, [&](unsigned int first, unsigned int count, float)
+	{
+		for (unsigned int slot = first; slot < first + count; slot++)
+		{
+			unsigned int i = order[slot];
+			float boxDistance;
+			if (!bounds[i].IntersectRay(origin, inverse, hit.distance, boxDistance))
+				continue;
+
+			float distance = boxDistance;
+			unsigned int triangle = TriangleBvh::NoTriangle;
+			if (triangles[i] != nullptr)
+			{
+				XMFLOAT3 localOrigin = Transform(inverseMatrices[i], origin, 1.0f);
+				XMFLOAT3 localDirection = Transform(inverseMatrices[i], direction, 0.0f);
+				if (!triangles[i]->IntersectRay(localOrigin, localDirection, hit.distance, distance, triangle))
+					continue;
+			}
+			if (hit.hit && distance >= hit.distance)
+				continue;
+
+			hit.hit = true;
+			hit.id = ids[i];
+			hit.triangle = triangle;
+			hit.distance = distance;
+		}
+		return hit.distance;
+	});
+
+	hit.position = XMFLOAT3(
+		origin.x + direction.x * hit.distance,
+		origin.y + direction.y * hit.distance,
+		origin.z + direction.z * hit.distance);
+}
+
+// --------------------------------------------------------
+// The matrix is stored transposed, so it maps column vectors:
+// world = A * local + t. Its inverse is A^-1 * (world - t),
+// with A^-1 from the cofactors
+// --------------------------------------------------------
+XMFLOAT4X4 Picker::InvertAffine(const XMFLOAT4X4 & m)
+{
+	float c11 = m._22 * m._33 - m._23 * m._32;
+	float c12 = m._23 * m._31 - m._21 * m._33;
+	float c13 = m._21 * m._32 - m._22 * m._31;
+	float determinant = m._11 * c11 + m._12 * c12 + m._13 * c13;
+	float s = determinant != 0.0f ? 1.0f / determinant : 0.0f;
+
+	XMFLOAT4X4 r;
+	r._11 = c11 * s;
+	r._12 = (m._13 * m._32 - m._12 * m._33) * s;
+	r._13 = (m._12 * m._23 - m._13 * m._22) * s;
+	r._21 = c12 * s;
+	r._22 = (m._11 * m._33 - m._13 * m._31) * s;
+	r._23 = (m._13 * m._21 - m._11 * m._23) * s;
+	r._31 = c13 * s;
+	r._32 = (m._12 * m._31 - m._11 * m._32) * s;
+	r._33 = (m._11 * m._22 - m._12 * m._21) * s;
+
+	r._14 = -(r._11 * m._14 + r._12 * m._24 + r._13 * m._34);
+	r._24 = -(r._21 * m._14 + r._22 * m._24 + r._23 * m._34);
+	r._34 = -(r._31 * m._14 + r._32 * m._24 + r._33 * m._34);
+	r._41 = 0.0f;
+	r._42 = 0.0f;
+	r._43 = 0.0f;
+	r._44 = 1.0f;
+	return r;
+}
+
+// --------------------------------------------------------
+// Unprojects the cursor at depth 0 and 1 (the near and far
+// planes) and takes the ray between them
+// --------------------------------------------------------
+void Picker::ScreenRay(float x, float y, float width, float height, const XMFLOAT4X4 & viewProjection,
+	XMFLOAT3 & origin, XMFLOAT3 & direction)
+{
+	XMFLOAT4X4 inverse;
+	XMStoreFloat4x4(&inverse, XMMatrixInverse(nullptr, XMLoadFloat4x4(&viewProjection)));
+
+	float ndcX = 2.0f * x / width - 1.0f;
+	float ndcY = 1.0f - 2.0f * y / height;
+	XMFLOAT3 points[2];
+	for (int i = 0; i < 2; i++)
+	{
+		// Row vector times the (non-transposed) inverse
+		float z = (float)i;
+		float px = ndcX * inverse._11 + ndcY * inverse._21 + z * inverse._31 + inverse._41;
+		float py = ndcX * inverse._12 + ndcY * inverse._22 + z * inverse._32 + inverse._42;
+		float pz = ndcX * inverse._13 + ndcY * inverse._23 + z * inverse._33 + inverse._43;
+		float pw = ndcX * inverse._14 + ndcY * inverse._24 + z * inverse._34 + inverse._44;
+		points[i] = XMFLOAT3(px / pw, py / pw, pz / pw);
+	}
+
+	origin = points[0];
+	direction = XMFLOAT3(points[1].x - points[0].x, points[1].y - points[0].y, points[1].z - points[0].z);
+	float length = sqrtf(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+	if (length > 0.0f)
+		direction = XMFLOAT3(direction.x / length, direction.y / length, direction.z / length);
+}
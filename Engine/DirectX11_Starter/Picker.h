@@ -0,0 +1,80 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cfloat>
+#include <vector>
+#include "AabbTree.h"
+#include "MeshData.h"
+#include "StaticBvh.h"
+#include "ThreadPool.h"
+#include "TriangleBvh.h"
+
+// What a ray hit - triangle is TriangleBvh::NoTriangle when the
+// object had no triangles to test, so its box was the hit
+struct PickHit
+{
+	bool hit;
+	unsigned int id;
+	unsigned int triangle;
+	float distance;                  // In multiples of the ray's direction
+	DirectX::XMFLOAT3 position;      // World space
+};
+
+// --------------------------------------------------------
+// Finds what's under the cursor (or along any other ray)
+// - Objects are added like FrustumCuller's: an id, mesh bounds
+//   and a world matrix, plus the mesh's TriangleBvh if it has
+//   one
+// - The first query after adding builds a StaticBvh over the
+//   world space boxes; rays go through that, then into each
+//   box's object space to test the exact triangles, nearest
+//   box first, stopping once no box is closer than the best hit
+// - Queries only read, so PickBatch() can spread a batch of
+//   rays across a ThreadPool
+// --------------------------------------------------------
+class Picker
+{
+public:
+	Picker();
+
+	void Clear();
+	void Reserve(unsigned int count);
+
+	// The matrix is (transposed, as stored for HLSL) copied - the
+	// triangles have to stay alive until the picker is cleared
+	unsigned int Add(unsigned int id, const MeshBounds& bounds, const DirectX::XMFLOAT4X4& worldMatrix,
+		const TriangleBvh* triangles = nullptr);
+	unsigned int GetCount() { return (unsigned int)ids.size(); }
+
+	// The nearest object along a ray - direction doesn't need to be
+	// normalized, distances are in multiples of it
+	bool Pick(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, PickHit& hit,
+		float maxDistance = FLT_MAX);
+
+	// Picks for count rays at once, one hit each - returns how
+	// many of them hit something
+	unsigned int PickBatch(const DirectX::XMFLOAT3* origins, const DirectX::XMFLOAT3* directions, unsigned int count,
+		PickHit* hits, float maxDistance = FLT_MAX, ThreadPool* pool = nullptr);
+
+	// The ray under a point on the screen - pixels from the top left
+	// of a width x height viewport, and a (non-transposed) view *
+	// projection matrix like Camera::getViewProjectionMatrix()
+	// - Starts on the near plane; direction is normalized
+	static void ScreenRay(float x, float y, float width, float height, const DirectX::XMFLOAT4X4& viewProjection,
+		DirectX::XMFLOAT3& origin, DirectX::XMFLOAT3& direction);
+
+private:
+	void Build();
+	void Trace(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, PickHit& hit) const;
+
+	// The inverse of a (transposed) world matrix's 3x4 part,
+	// in the same layout
+	static DirectX::XMFLOAT4X4 InvertAffine(const DirectX::XMFLOAT4X4& worldMatrix);
+
+	std::vector<unsigned int> ids;
+	std::vector<Aabb> bounds;
+	std::vector<DirectX::XMFLOAT4X4> inverseMatrices;   // World space into object space, for the triangles
+	std::vector<const TriangleBvh*> triangles;
+	StaticBvh bvh;
+	bool dirty;
+};
@@ -0,0 +1,142 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	const unsigned int PassShift = 60;
+	const RenderKey IdMask = 0xFFFF;
+	const RenderKey DepthMask = (1ull << 28) - 1;
+
+	// Fewer draws than this are insertion sorted - clearing and
+	// summing eight histograms would take longer
+	const unsigned int SmallSort = 64;
+}
+
+RenderQueue::RenderQueue()
+{
+	sortPasses = 0;
+	SetDepthRange(0.1f, 100.0f);
+}
+
+void RenderQueue::SetDepthRange(float nearDistance, float farDistance)
+{
+	nearDepth = nearDistance;
+	depthScale = farDistance > nearDistance ? (float)DepthMask / (farDistance - nearDistance) : 0.0f;
+}
+
+void RenderQueue::Reserve(unsigned int count)
+{
+	items.reserve(count);
+	scratch.reserve(count);
+}
+
+void RenderQueue::Add(RenderPass pass, unsigned int material, unsigned int mesh, float depth, unsigned int payload)
+{
+	RenderItem item = { MakeKey(pass, material, mesh, depth), payload };
+	items.push_back(item);
+}
+
+// --------------------------------------------------------
+// Depth outside the range is clamped to it, so everything
+// behind the far plane sorts as if it were on it
+// --------------------------------------------------------
+RenderKey RenderQueue::MakeKey(RenderPass pass, unsigned int material, unsigned int mesh, float depth)
+{
+	float scaled = (depth - nearDepth) * depthScale;
+	RenderKey quantized = 0;
+	if (scaled > 0.0f)
+		quantized = std::min((RenderKey)std::min(scaled, (float)DepthMask), DepthMask);
+
+	RenderKey key = (RenderKey)pass << PassShift;
+	if (pass == RENDER_PASS_TRANSPARENT)
+		return key | (DepthMask - quantized) << 32 | (material & IdMask) << 16 | (mesh & IdMask);
+	return key | (material & IdMask) << 44 | (mesh & IdMask) << 28 | quantized;
+}
+
+unsigned int RenderQueue::GetMaterial(RenderKey key)
+{
+	return (unsigned int)((GetPass(key) == RENDER_PASS_TRANSPARENT ? key >> 16 : key >> 44) & IdMask);
+}
+
+unsigned int RenderQueue::GetMesh(RenderKey key)
+{
+	return (unsigned int)((GetPass(key) == RENDER_PASS_TRANSPARENT ? key : key >> 28) & IdMask);
+}
+
+// --------------------------------------------------------
+// Every byte's histogram comes from one pass over the keys up
+// front. A byte whose histogram has all the keys in one bucket
+// would leave the order as it is, so that pass is skipped
+// - Each pass scatters from one array into the other; if the
+//   last one landed in the scratch array the two are swapped
+// --------------------------------------------------------
+void RenderQueue::Sort()
+{
+	sortPasses = 0;
+	unsigned int count = (unsigned int)items.size();
+	if (count < SmallSort)
+	{
+		for (unsigned int i = 1; i < count; i++)
+		{
+			RenderItem item = items[i];
+			unsigned int j = i;
+			for (; j > 0 && items[j - 1].key > item.key; j--)
+				items[j] = items[j - 1];
+			items[j] = item;
+		}
+		return;
+	}
+
+	unsigned int counts[8][256];
+	memset(counts, 0, sizeof(counts));
+	for (const RenderItem& item : items)
+	{
+		RenderKey key = item.key;
+		for (int b = 0; b < 8; b++)
+			counts[b][(key >> (b * 8)) & 0xFF]++;
+	}
+
+	scratch.resize(count);
+	RenderItem* source = &items[0];
+	RenderItem* destination = &scratch[0];
+	for (int b = 0; b < 8; b++)
+	{
+		unsigned int shift = b * 8;
+		unsigned int* offsets = counts[b];
+		if (offsets[(source[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		unsigned int total = 0;
+		for (int d = 0; d < 256; d++)
+		{
+			unsigned int bucket = offsets[d];
+			offsets[d] = total;
+			total += bucket;
+		}
+		for (unsigned int i = 0; i < count; i++)
+			destination[offsets[(source[i].key >> shift) & 0xFF]++] = source[i];
+
+		std::swap(source, destination);
+		sortPasses++;
+	}
+
+	if (source != &items[0])
+		items.swap(scratch);
+}
+
+RenderQueueStats RenderQueue::GetStats()
+{
+	RenderQueueStats stats = RenderQueueStats();
+	stats.draws = (unsigned int)items.size();
+	stats.sortPasses = sortPasses;
+	for (unsigned int i = 0; i < items.size(); i++)
+	{
+		RenderKey key = items[i].key;
+		if (i == 0 || GetMaterial(key) != GetMaterial(items[i - 1].key))
+			stats.materialChanges++;
+		if (i == 0 || GetMesh(key) != GetMesh(items[i - 1].key))
+			stats.meshChanges++;
+	}
+	return stats;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+
+typedef unsigned long long RenderKey;
+
+// --------------------------------------------------------
+// Which pass a draw belongs to - passes are drawn in this order
+// --------------------------------------------------------
+enum RenderPass
+{
+	RENDER_PASS_OPAQUE = 0,        // By material and mesh, then front to back
+	RENDER_PASS_TRANSPARENT = 1,   // Back to front, then by material and mesh
+	RENDER_PASS_OVERLAY = 2        // Like opaque, after everything else
+};
+
+// One draw - payload is whatever the caller needs to issue it,
+// usually an index into its own list
+struct RenderItem
+{
+	RenderKey key;
+	unsigned int payload;
+};
+
+// --------------------------------------------------------
+// What the queue's current order costs - changes count the
+// first draw too
+// --------------------------------------------------------
+struct RenderQueueStats
+{
+	unsigned int draws;
+	unsigned int materialChanges;
+	unsigned int meshChanges;
+	unsigned int sortPasses;        // Byte passes the last Sort() needed - 8 at most
+};
+
+// --------------------------------------------------------
+// Draws packed into 64-bit keys, so sorting the keys puts them
+// in the order they should be drawn in
+// - From the top: 4 bits of pass, then 16 of material, 16 of
+//   mesh and 28 of depth - transparent draws put their depth
+//   first, flipped, so the farthest come first
+// - Depth is the distance along the view direction, quantized
+//   over the range given to SetDepthRange()
+// - Material and mesh ids only group equal ones together - any
+//   small numbers will do, and only their low 16 bits are used
+// - Sort() is a radix sort, so equal keys keep the order they
+//   were added in
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	static const unsigned int MaxId = 0xFFFF;
+
+	RenderQueue();
+
+	// Distances along the view direction - the camera's near and
+	// far planes
+	void SetDepthRange(float nearDistance, float farDistance);
+
+	void Clear() { items.clear(); }
+	void Reserve(unsigned int count);
+
+	void Add(RenderPass pass, unsigned int material, unsigned int mesh, float depth, unsigned int payload);
+
+	void Sort();
+
+	unsigned int GetCount() { return (unsigned int)items.size(); }
+	const RenderItem* GetItems() { return items.empty() ? nullptr : &items[0]; }
+	unsigned int GetPayload(unsigned int index) { return items[index].payload; }
+	RenderQueueStats GetStats();
+
+	RenderKey MakeKey(RenderPass pass, unsigned int material, unsigned int mesh, float depth);
+	static RenderPass GetPass(RenderKey key) { return (RenderPass)(key >> 60); }
+	static unsigned int GetMaterial(RenderKey key);
+	static unsigned int GetMesh(RenderKey key);
+
+private:
+	std::vector<RenderItem> items;
+	std::vector<RenderItem> scratch;
+	float nearDepth;
+	float depthScale;               // Depth range to 28 bits
+	unsigned int sortPasses;
+};
@@ -0,0 +1,229 @@
+#include "SceneGenerator.h"
+#include "TransformStore.h"
+#include <algorithm>
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	const float TwoPi = 6.2831853f;
+
+	// Xorshift - unlike <random>'s distributions, it gives the
+	// same numbers with every standard library
+	class SceneRandom
+	{
+	public:
+		explicit SceneRandom(unsigned int seed) : state(seed * 2654435761u + 0x9E3779B9u)
+		{
+			if (state == 0)
+				state = 1;
+		}
+
+		unsigned int NextBits()
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		// [0, 1)
+		float Next() { return (NextBits() >> 8) * (1.0f / 16777216.0f); }
+		float Next(float low, float high) { return low + (high - low) * Next(); }
+		unsigned int Next(unsigned int count) { return count > 1 ? NextBits() % count : 0; }
+
+		// Roughly normal, mean 0 and deviation 1 - three uniforms
+		// summed, so no logs or cosines that could round differently
+		float NextNormal() { return (Next() + Next() + Next() - 1.5f) * 2.0f; }
+
+	private:
+		unsigned int state;
+	};
+
+	float Wrap(float value, float extent)
+	{
+		float size = extent * 2.0f;
+		float wrapped = fmodf(value + extent, size);
+		if (wrapped < 0.0f)
+			wrapped += size;
+		return wrapped - extent;
+	}
+
+	// FNV-1a
+	void Mix(unsigned int& hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Every entity takes its random numbers in the same order -
+// placement, look, then motion - so changing one option (like
+// the motion) leaves where things are and what they look like
+// alone
+// --------------------------------------------------------
+void SceneGenerator::Generate(const SceneOptions & options, std::vector<SceneEntity>& entities)
+{
+	SceneRandom random(options.seed);
+	unsigned int count = options.entityCount;
+	entities.resize(count);
+
+	std::vector<XMFLOAT3> clusters(std::max(options.clusterCount, 1u));
+	for (auto& cluster : clusters)
+	{
+		cluster.x = random.Next(-options.extent, options.extent);
+		cluster.y = random.Next(-options.height, options.height);
+		cluster.z = random.Next(-options.extent, options.extent);
+	}
+	float spread = options.extent / sqrtf((float)clusters.size()) * 0.25f;
+
+	unsigned int side = (unsigned int)ceilf(sqrtf((float)count));
+	float spacing = side > 0 ? options.extent * 2.0f / side : 0.0f;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		SceneEntity& entity = entities[i];
+		switch (options.layout)
+		{
+		case SCENE_LAYOUT_CLUSTERED:
+		{
+			const XMFLOAT3& cluster = clusters[random.Next((unsigned int)clusters.size())];
+			entity.position.x = Wrap(cluster.x + random.NextNormal() * spread, options.extent);
+			entity.position.y = std::min(std::max(cluster.y + random.NextNormal() * spread * 0.25f, -options.height), options.height);
+			entity.position.z = Wrap(cluster.z + random.NextNormal() * spread, options.extent);
+			break;
+		}
+		case SCENE_LAYOUT_GRID:
+			entity.position.x = -options.extent + (i % side + 0.5f) * spacing;
+			entity.position.y = 0.0f;
+			entity.position.z = -options.extent + (i / side + 0.5f) * spacing;
+			break;
+		default:
+			entity.position.x = random.Next(-options.extent, options.extent);
+			entity.position.y = random.Next(-options.height, options.height);
+			entity.position.z = random.Next(-options.extent, options.extent);
+			break;
+		}
+
+		float yaw = random.Next(0.0f, TwoPi);
+		float scale = random.Next(options.minScale, options.maxScale);
+		entity.rotation = TransformStore::QuaternionFromEuler(0.0f, yaw, 0.0f);
+		entity.scale = XMFLOAT3(scale, scale, scale);
+		entity.mesh = random.Next(options.meshCount);
+		entity.material = random.Next(options.materialCount);
+
+		// Drawn whether or not it moves, so the rest of the scene
+		// stays put when the share changes
+		float roll = random.Next();
+		SceneMotion motion = options.motion;
+		if (motion == SCENE_MOTION_MIXED)
+			motion = (SceneMotion)(SCENE_MOTION_DRIFT + random.Next(3u));
+		float heading = random.Next(0.0f, TwoPi);
+		float pace = options.speed * random.Next(0.5f, 1.5f);
+		float radius = random.Next(1.0f, 10.0f);
+
+		entity.moves = motion != SCENE_MOTION_STATIC && roll < options.movingShare;
+		MotionComponent& m = entity.motion;
+		m.motion = entity.moves ? motion : SCENE_MOTION_STATIC;
+		m.origin = entity.position;
+		m.velocity = XMFLOAT3(0, 0, 0);
+		m.radius = 0.0f;
+		m.speed = 0.0f;
+		m.phase = yaw;
+		m.extent = options.extent;
+		if (m.motion == SCENE_MOTION_DRIFT)
+			m.velocity = XMFLOAT3(cosf(heading) * pace, 0.0f, sinf(heading) * pace);
+		else if (m.motion == SCENE_MOTION_ORBIT)
+		{
+			// Around a point radius away, starting where it was put
+			m.radius = radius;
+			m.speed = pace / radius;
+			m.phase = heading;
+			m.origin = XMFLOAT3(entity.position.x - cosf(heading) * radius, entity.position.y, entity.position.z - sinf(heading) * radius);
+		}
+		else if (m.motion == SCENE_MOTION_SPIN)
+			m.speed = pace;
+	}
+}
+
+// --------------------------------------------------------
+// Orbiting entities face along their circle; drifting ones
+// keep the way they started out facing
+// --------------------------------------------------------
+void SceneGenerator::Animate(const MotionComponent & motion, float time, XMFLOAT3 & position, XMFLOAT4 & rotation)
+{
+	switch (motion.motion)
+	{
+	case SCENE_MOTION_DRIFT:
+		position.x = Wrap(motion.origin.x + motion.velocity.x * time, motion.extent);
+		position.y = motion.origin.y + motion.velocity.y * time;
+		position.z = Wrap(motion.origin.z + motion.velocity.z * time, motion.extent);
+		rotation = TransformStore::QuaternionFromEuler(0.0f, motion.phase, 0.0f);
+		break;
+	case SCENE_MOTION_ORBIT:
+	{
+		float angle = motion.phase + motion.speed * time;
+		position.x = motion.origin.x + cosf(angle) * motion.radius;
+		position.y = motion.origin.y;
+		position.z = motion.origin.z + sinf(angle) * motion.radius;
+		rotation = TransformStore::QuaternionFromEuler(0.0f, -angle, 0.0f);
+		break;
+	}
+	case SCENE_MOTION_SPIN:
+		position = motion.origin;
+		rotation = TransformStore::QuaternionFromEuler(0.0f, motion.phase + motion.speed * time, 0.0f);
+		break;
+	default:
+		position = motion.origin;
+		rotation = TransformStore::QuaternionFromEuler(0.0f, motion.phase, 0.0f);
+		break;
+	}
+}
+
+// Rotations come from sines and cosines, which can round
+// differently elsewhere - so they're left out
+unsigned int SceneGenerator::Checksum(const std::vector<SceneEntity>& entities)
+{
+	unsigned int hash = 2166136261u;
+	for (const SceneEntity& entity : entities)
+	{
+		Mix(hash, &entity.position, sizeof(entity.position));
+		Mix(hash, &entity.scale, sizeof(entity.scale));
+		Mix(hash, &entity.mesh, sizeof(entity.mesh));
+		Mix(hash, &entity.material, sizeof(entity.material));
+		unsigned int motion = entity.motion.motion;
+		Mix(hash, &motion, sizeof(motion));
+	}
+	return hash;
+}
+
+const char * SceneGenerator::GetMotionName(SceneMotion motion)
+{
+	switch (motion)
+	{
+	case SCENE_MOTION_STATIC: return "static";
+	case SCENE_MOTION_DRIFT: return "drift";
+	case SCENE_MOTION_ORBIT: return "orbit";
+	case SCENE_MOTION_SPIN: return "spin";
+	case SCENE_MOTION_MIXED: return "mixed";
+	}
+	return "unknown";
+}
+
+const char * SceneGenerator::GetLayoutName(SceneLayout layout)
+{
+	switch (layout)
+	{
+	case SCENE_LAYOUT_UNIFORM: return "uniform";
+	case SCENE_LAYOUT_CLUSTERED: return "clustered";
+	case SCENE_LAYOUT_GRID: return "grid";
+	}
+	return "unknown";
+}
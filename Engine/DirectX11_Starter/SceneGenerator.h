@@ -0,0 +1,114 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// How SceneGenerator's entities move
+// --------------------------------------------------------
+enum SceneMotion
+{
+	SCENE_MOTION_STATIC = 0,   // Nothing moves
+	SCENE_MOTION_DRIFT = 1,    // Straight lines, wrapping around at the scene's edges
+	SCENE_MOTION_ORBIT = 2,    // Circles around where they started
+	SCENE_MOTION_SPIN = 3,     // Turning in place
+	SCENE_MOTION_MIXED = 4     // Each moving entity picks one of the above
+};
+
+// --------------------------------------------------------
+// Where SceneGenerator puts its entities
+// --------------------------------------------------------
+enum SceneLayout
+{
+	SCENE_LAYOUT_UNIFORM = 0,     // Anywhere in the box
+	SCENE_LAYOUT_CLUSTERED = 1,   // Bunched up around a few points, like towns
+	SCENE_LAYOUT_GRID = 2         // Evenly spaced on the ground
+};
+
+// --------------------------------------------------------
+// Everything that decides a generated scene - the same options
+// (seed included) always give the same one
+// --------------------------------------------------------
+struct SceneOptions
+{
+	unsigned int entityCount;
+	unsigned int seed;
+	SceneMotion motion;
+	float movingShare;           // Fraction that moves at all, unless the motion is static
+	float speed;                 // World units (or radians, spinning) per second
+	SceneLayout layout;
+	unsigned int clusterCount;
+	float extent;                // Half the width of the box everything starts in
+	float height;                // Half its height
+	unsigned int meshCount;      // How many different meshes are picked from
+	unsigned int materialCount;
+	float minScale;
+	float maxScale;
+
+	SceneOptions()
+	{
+		entityCount = 1000;
+		seed = 1;
+		motion = SCENE_MOTION_STATIC;
+		movingShare = 1.0f;
+		speed = 2.0f;
+		layout = SCENE_LAYOUT_UNIFORM;
+		clusterCount = 16;
+		extent = 500.0f;
+		height = 50.0f;
+		meshCount = 1;
+		materialCount = 1;
+		minScale = 0.5f;
+		maxScale = 2.0f;
+	}
+};
+
+// --------------------------------------------------------
+// How one entity moves - what SceneGenerator::Animate() needs
+// to put it somewhere at a given time
+// --------------------------------------------------------
+struct MotionComponent
+{
+	SceneMotion motion;          // Never mixed
+	DirectX::XMFLOAT3 origin;
+	DirectX::XMFLOAT3 velocity;  // Drifting
+	float radius;                // Orbiting
+	float speed;                 // Radians per second, orbiting and spinning
+	float phase;
+	float extent;                // Drifting wraps around at +-extent
+};
+
+// One entity as generated - mesh and material are indices into
+// whatever the caller draws with
+struct SceneEntity
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT4 rotation;   // Quaternion
+	DirectX::XMFLOAT3 scale;
+	unsigned int mesh;
+	unsigned int material;
+	bool moves;
+	MotionComponent motion;       // Only if it moves
+};
+
+// --------------------------------------------------------
+// Makes up scenes of any size for measuring how the engine
+// scales - see EngineBench's scene benchmark
+// - Uses its own random numbers, so a seed gives the same
+//   scene with every compiler and standard library
+// --------------------------------------------------------
+class SceneGenerator
+{
+public:
+	static void Generate(const SceneOptions& options, std::vector<SceneEntity>& entities);
+
+	// Where a moving entity is at time seconds
+	static void Animate(const MotionComponent& motion, float time, DirectX::XMFLOAT3& position, DirectX::XMFLOAT4& rotation);
+
+	// Mixes every entity's position, scale, mesh, material and
+	// motion into one number - equal scenes give equal checksums
+	static unsigned int Checksum(const std::vector<SceneEntity>& entities);
+
+	static const char* GetMotionName(SceneMotion motion);
+	static const char* GetLayoutName(SceneLayout layout);
+};
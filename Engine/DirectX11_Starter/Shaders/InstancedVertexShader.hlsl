@@ -0,0 +1,53 @@
+
+// Same as VertexShader.hlsl, but for DrawIndexedInstanced() -
+// each instance's world matrix comes from a second vertex buffer
+// instead of the constant buffer
+// - The input layout comes from Mesh::CreateInstancedInputLayout()
+// - See InstanceBatcher for how the instances are gathered
+cbuffer externalData : register(b0)
+{
+	matrix view;
+	matrix projection;
+};
+
+// A vertex from slot 0 and its instance's matrix from slot 1
+// - Must match Vertex and the instanced input layout
+struct VertexShaderInput
+{
+	float3 position		: POSITION;
+	float3 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+
+	// Rows of the world matrix as it's stored for HLSL - transposed
+	float4 world0		: WORLD0;
+	float4 world1		: WORLD1;
+	float4 world2		: WORLD2;
+	float4 world3		: WORLD3;
+};
+
+// Must match VertexShader.hlsl, so the same pixel shader works
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float3 normal		: NORMAL;
+	float3 worldPos		: POSITION;
+	float2 uv			: TEXCOORD;
+};
+
+VertexToPixel main( VertexShaderInput input )
+{
+	VertexToPixel output;
+
+	// Transposed back, it's the same matrix the constant buffer
+	// would have given VertexShader.hlsl
+	matrix world = transpose(float4x4(input.world0, input.world1, input.world2, input.world3));
+
+	matrix worldViewProj = mul(mul(world, view), projection);
+	output.position = mul(float4(input.position, 1.0f), worldViewProj);
+
+	output.normal = normalize(mul(input.normal, (float3x3)world));
+	output.worldPos = mul(float4(input.position, 1.0f), world).xyz;
+	output.uv = input.uv;
+
+	return output;
+}
@@ -0,0 +1,64 @@
+
+// Same as VertexShader.hlsl, but for meshes uploaded with
+// VERTEX_FORMAT_PACKED (see PackedVertex in Vertex.h)
+// - The input layout comes from Mesh::CreatePackedInputLayout(),
+//   which has the GPU turn the UNORM/SNORM/half data into floats
+cbuffer externalData : register(b0)
+{
+	matrix world;
+	matrix view;
+	matrix projection;
+
+	// position = positionOffset + unorm * positionScale
+	float3 positionOffset;
+	float3 positionScale;
+};
+
+// Struct representing a single packed vertex worth of data
+// - Must match PackedVertex and the packed input layout
+struct VertexShaderInput
+{
+	float4 position		: POSITION;     // R16G16B16A16_UNORM, 0..1 within the bounds
+	float2 normal		: NORMAL;       // R16G16_SNORM, octahedral
+	float2 uv			: TEXCOORD;     // R16G16_FLOAT
+};
+
+// Must match VertexShader.hlsl, so the same pixel shader works
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float3 normal		: NORMAL;
+	float3 worldPos		: POSITION;
+	float2 uv			: TEXCOORD;
+};
+
+// --------------------------------------------------------
+// Unfolds an octahedral normal (mirrors VertexCompressor)
+// --------------------------------------------------------
+float3 DecodeOctahedral(float2 e)
+{
+	float3 n = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f)
+	{
+		float2 signs = float2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+		n.xy = (1.0f - abs(n.yx)) * signs;
+	}
+	return normalize(n);
+}
+
+VertexToPixel main( VertexShaderInput input )
+{
+	VertexToPixel output;
+
+	// Dequantize back to object space first, then it's business as usual
+	float3 position = positionOffset + input.position.xyz * positionScale;
+
+	matrix worldViewProj = mul(mul(world, view), projection);
+	output.position = mul(float4(position, 1.0f), worldViewProj);
+
+	output.normal = normalize(mul(DecodeOctahedral(input.normal), (float3x3)world));
+	output.worldPos = mul(float4(position, 1.0f), world).xyz;
+	output.uv = input.uv;
+
+	return output;
+}
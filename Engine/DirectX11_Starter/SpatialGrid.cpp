@@ -0,0 +1,533 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	// Objects (or buckets) per ParallelFor chunk
+	const unsigned int HashGrainSize = 16384;
+	const unsigned int ScanGrainSize = 16384;
+
+	// Keeps small grids from hashing everything into a few buckets
+	const unsigned int MinimumBuckets = 1024;
+
+	const int Outside = -1;
+
+	// Runs on the pool if there is one - chunk k of the loop always
+	// starts at k * grainSize, either way
+	void Run(ThreadPool* pool, unsigned int count, unsigned int grainSize, const ParallelForFunction& function)
+	{
+		if (pool)
+			pool->ParallelFor(count, grainSize, function);
+		else if (count > 0)
+			function(0, count);
+	}
+
+	// --------------------------------------------------------
+	// Which of the planes in mask a box straddles, or Outside if
+	// it's completely behind one of them - same test as
+	// AabbTree::QueryFrustum
+	// --------------------------------------------------------
+	int ClassifyBox(const Frustum& frustum, const float* low, const float* high, int mask)
+	{
+		XMFLOAT3 center((low[0] + high[0]) * 0.5f, (low[1] + high[1]) * 0.5f, (low[2] + high[2]) * 0.5f);
+		XMFLOAT3 extents((high[0] - low[0]) * 0.5f, (high[1] - low[1]) * 0.5f, (high[2] - low[2]) * 0.5f);
+
+		for (int p = 0; p < 6; p++)
+		{
+			if ((mask & (1 << p)) == 0)
+				continue;
+
+			const XMFLOAT4& plane = frustum.planes[p];
+			float d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			float reach = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+			if (d + reach < 0.0f)
+				return Outside;
+			if (d - reach >= 0.0f)
+				mask &= ~(1 << p);
+		}
+		return mask;
+	}
+
+	bool SphereInside(const Frustum& frustum, float x, float y, float z, float radius, int mask)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			const XMFLOAT4& plane = frustum.planes[p];
+			if ((mask & (1 << p)) != 0 && plane.x * x + plane.y * y + plane.z * z + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	// Where three planes meet - false if two of them are parallel
+	bool IntersectPlanes(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c, XMFLOAT3& point)
+	{
+		XMFLOAT3 bc(b.y * c.z - b.z * c.y, b.z * c.x - b.x * c.z, b.x * c.y - b.y * c.x);
+		XMFLOAT3 ca(c.y * a.z - c.z * a.y, c.z * a.x - c.x * a.z, c.x * a.y - c.y * a.x);
+		XMFLOAT3 ab(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+		float determinant = a.x * bc.x + a.y * bc.y + a.z * bc.z;
+		if (fabsf(determinant) < 1e-6f)
+			return false;
+
+		float scale = -1.0f / determinant;
+		point = XMFLOAT3(
+			(a.w * bc.x + b.w * ca.x + c.w * ab.x) * scale,
+			(a.w * bc.y + b.w * ca.y + c.w * ab.y) * scale,
+			(a.w * bc.z + b.w * ca.z + c.w * ab.z) * scale);
+		return true;
+	}
+
+	// What a matrix or position array looks like to BuildFrom
+	struct PositionSource
+	{
+		const XMFLOAT3* positions;
+		const float* radii;
+
+		XMFLOAT3 Position(unsigned int i) const { return positions[i]; }
+		float Radius(unsigned int i) const { return radii ? radii[i] : 0.0f; }
+	};
+
+	struct MatrixSource
+	{
+		const XMFLOAT4X4* worldMatrices;
+		float radius;
+
+		XMFLOAT3 Position(unsigned int i) const
+		{
+			const XMFLOAT4X4& m = worldMatrices[i];
+			return XMFLOAT3(m._14, m._24, m._34);
+		}
+		float Radius(unsigned int) const { return radius; }
+	};
+}
+
+
+SpatialGrid::SpatialGrid(float cellSize)
+{
+	this->cellSize = cellSize;
+	inverseCellSize = 1.0f / cellSize;
+	count = 0;
+	bucketMask = 0;
+	maxRadius = 0.0f;
+	bucketCountsSize = 0;
+}
+
+void SpatialGrid::Build(const XMFLOAT3* positions, const float* radii, unsigned int newCount, ThreadPool* pool)
+{
+	BuildFrom(newCount, pool, PositionSource{ positions, radii });
+}
+
+void SpatialGrid::Build(const XMFLOAT4X4* worldMatrices, float radius, unsigned int newCount, ThreadPool* pool)
+{
+	BuildFrom(newCount, pool, MatrixSource{ worldMatrices, radius });
+}
+
+// Forgets every object, but keeps the memory
+void SpatialGrid::Clear()
+{
+	count = 0;
+	maxRadius = 0.0f;
+}
+
+// --------------------------------------------------------
+// A counting sort of the objects by bucket
+// - Hash: each object's cell and bucket, counting how many
+//   land in each bucket (atomically - different chunks hit
+//   the same buckets), and the range of occupied cells
+// - Scan: bucket counts become start offsets, a sum per block
+//   of buckets first, then each block from its sum
+// - Scatter: each object's id takes the next slot in its
+//   bucket - only 4 bytes go to a random place, the rest is
+//   gathered afterwards, bucket by bucket, in the order the
+//   sorted arrays are written
+// - Which slot an id gets depends on thread timing, so each
+//   bucket is sorted before that - they're a handful of
+//   objects each, so that's cheap
+// --------------------------------------------------------
+template <typename Source>
+void SpatialGrid::BuildFrom(unsigned int newCount, ThreadPool* pool, const Source& source)
+{
+	count = newCount;
+	inverseCellSize = 1.0f / cellSize;
+
+	unsigned int bucketCount = MinimumBuckets;
+	while (bucketCount < count)
+		bucketCount *= 2;
+	bucketMask = bucketCount - 1;
+
+	if (bucketCountsSize < bucketCount)
+	{
+		bucketCounts.reset(new std::atomic<unsigned int>[bucketCount]);
+		bucketCountsSize = bucketCount;
+	}
+	bucketStart.resize(bucketCount + 1);
+	objectBuckets.resize(count);
+	objectCells.resize(count);
+	sortedX.resize(count);
+	sortedY.resize(count);
+	sortedZ.resize(count);
+	sortedRadius.resize(count);
+	sortedIds.resize(count);
+	sortedCells.resize(count);
+
+	Run(pool, bucketCount, ScanGrainSize, [this](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int b = begin; b < end; b++)
+			bucketCounts[b].store(0, std::memory_order_relaxed);
+	});
+
+	unsigned int chunkCount = std::max(1u, (count + HashGrainSize - 1) / HashGrainSize);
+	chunkRanges.assign(chunkCount, CellRange{ { INT_MAX, INT_MAX, INT_MAX }, { INT_MIN, INT_MIN, INT_MIN } });
+	chunkRadii.assign(chunkCount, 0.0f);
+	Run(pool, count, HashGrainSize, [this, &source](unsigned int begin, unsigned int end)
+	{
+		CellRange& range = chunkRanges[begin / HashGrainSize];
+		float largest = 0.0f;
+		for (unsigned int i = begin; i < end; i++)
+		{
+			XMFLOAT3 position = source.Position(i);
+			int cell[3] = { ToCell(position.x), ToCell(position.y), ToCell(position.z) };
+			for (int a = 0; a < 3; a++)
+			{
+				range.min[a] = std::min(range.min[a], cell[a]);
+				range.max[a] = std::max(range.max[a], cell[a]);
+			}
+
+			unsigned int bucket = Hash(cell[0], cell[1], cell[2]);
+			objectBuckets[i] = bucket;
+			objectCells[i] = PackCell(cell[0], cell[1], cell[2]);
+			bucketCounts[bucket].fetch_add(1, std::memory_order_relaxed);
+			largest = std::max(largest, source.Radius(i));
+		}
+		chunkRadii[begin / HashGrainSize] = largest;
+	});
+
+	occupied = chunkRanges[0];
+	maxRadius = chunkRadii[0];
+	for (unsigned int c = 1; c < chunkCount; c++)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			occupied.min[a] = std::min(occupied.min[a], chunkRanges[c].min[a]);
+			occupied.max[a] = std::max(occupied.max[a], chunkRanges[c].max[a]);
+		}
+		maxRadius = std::max(maxRadius, chunkRadii[c]);
+	}
+
+	unsigned int blockCount = (bucketCount + ScanGrainSize - 1) / ScanGrainSize;
+	blockSums.resize(blockCount);
+	Run(pool, bucketCount, ScanGrainSize, [this](unsigned int begin, unsigned int end)
+	{
+		unsigned int sum = 0;
+		for (unsigned int b = begin; b < end; b++)
+			sum += bucketCounts[b].load(std::memory_order_relaxed);
+		blockSums[begin / ScanGrainSize] = sum;
+	});
+
+	unsigned int running = 0;
+	for (auto& sum : blockSums)
+	{
+		unsigned int blockTotal = sum;
+		sum = running;
+		running += blockTotal;
+	}
+
+	// The counts turn into each bucket's next free slot
+	Run(pool, bucketCount, ScanGrainSize, [this](unsigned int begin, unsigned int end)
+	{
+		unsigned int start = blockSums[begin / ScanGrainSize];
+		for (unsigned int b = begin; b < end; b++)
+		{
+			unsigned int bucketSize = bucketCounts[b].load(std::memory_order_relaxed);
+			bucketStart[b] = start;
+			bucketCounts[b].store(start, std::memory_order_relaxed);
+			start += bucketSize;
+		}
+	});
+	bucketStart[bucketCount] = count;
+
+	Run(pool, count, HashGrainSize, [this](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+			sortedIds[bucketCounts[objectBuckets[i]].fetch_add(1, std::memory_order_relaxed)] = i;
+	});
+
+	Run(pool, bucketCount, ScanGrainSize, [this, &source](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int b = begin; b < end; b++)
+		{
+			unsigned int first = bucketStart[b];
+			unsigned int last = bucketStart[b + 1];
+			SortBucket(first, last);
+
+			for (unsigned int i = first; i < last; i++)
+			{
+				unsigned int id = sortedIds[i];
+				XMFLOAT3 position = source.Position(id);
+				sortedX[i] = position.x;
+				sortedY[i] = position.y;
+				sortedZ[i] = position.z;
+				sortedRadius[i] = source.Radius(id);
+				sortedCells[i] = objectCells[id];
+			}
+		}
+	});
+}
+
+// Insertion sort of a bucket's ids by cell, then id - buckets are tiny
+void SpatialGrid::SortBucket(unsigned int begin, unsigned int end)
+{
+	for (unsigned int i = begin + 1; i < end; i++)
+	{
+		unsigned int id = sortedIds[i];
+		CellKey cell = objectCells[id];
+
+		unsigned int j = i;
+		while (j > begin)
+		{
+			unsigned int previous = sortedIds[j - 1];
+			CellKey previousCell = objectCells[previous];
+			if (previousCell < cell || (previousCell == cell && previous < id))
+				break;
+			sortedIds[j] = previous;
+			j--;
+		}
+		sortedIds[j] = id;
+	}
+}
+
+// --------------------------------------------------------
+// Consecutive cells of a row are consecutive buckets, so the
+// whole row is one stretch of the sorted arrays (two, if it
+// wraps around the end of the table) - objects there from
+// other rows that hashed into the same buckets are skipped
+// by their cell
+// --------------------------------------------------------
+template <typename Function>
+void SpatialGrid::ForEachInRow(int x0, int x1, int y, int z, Function function)
+{
+	unsigned int bucketCount = bucketMask + 1;
+	unsigned int first = Hash(x0, y, z);
+	unsigned int length = (unsigned int)(x1 - x0) + 1;
+
+	CellKey row = PackCell(0, y, z) & ~CellMask;
+	CellKey low = (CellKey)(x0 + CellBias);
+	CellKey high = (CellKey)(x1 + CellBias);
+	auto scan = [&](unsigned int beginBucket, unsigned int endBucket)
+	{
+		for (unsigned int i = bucketStart[beginBucket]; i < bucketStart[endBucket]; i++)
+		{
+			CellKey cell = sortedCells[i];
+			CellKey x = cell & CellMask;
+			if ((cell & ~CellMask) == row && x >= low && x <= high)
+				function(i);
+		}
+	};
+
+	if (length >= bucketCount)
+		scan(0, bucketCount);
+	else if (first + length <= bucketCount)
+		scan(first, first + length);
+	else
+	{
+		scan(first, bucketCount);
+		scan(0, first + length - bucketCount);
+	}
+}
+
+unsigned int SpatialGrid::QueryNeighbours(const XMFLOAT3 & position, std::vector<unsigned int>& results)
+{
+	results.clear();
+	if (count == 0)
+		return 0;
+
+	int cell[3] = { ToCell(position.x), ToCell(position.y), ToCell(position.z) };
+	CellRange range = { { cell[0] - 1, cell[1] - 1, cell[2] - 1 }, { cell[0] + 1, cell[1] + 1, cell[2] + 1 } };
+	if (!ClampToOccupied(range))
+		return 0;
+
+	for (int z = range.min[2]; z <= range.max[2]; z++)
+	{
+		for (int y = range.min[1]; y <= range.max[1]; y++)
+			ForEachInRow(range.min[0], range.max[0], y, z, [&](unsigned int i) { results.push_back(sortedIds[i]); });
+	}
+	return (unsigned int)results.size();
+}
+
+// Rows are skipped when the sphere (grown by the largest
+// radius) can't reach their y/z slab
+unsigned int SpatialGrid::QueryRadius(const XMFLOAT3 & center, float radius, std::vector<unsigned int>& results)
+{
+	results.clear();
+	if (count == 0)
+		return 0;
+
+	float reach = radius + maxRadius;
+	CellRange range = {
+		{ ToCell(center.x - reach), ToCell(center.y - reach), ToCell(center.z - reach) },
+		{ ToCell(center.x + reach), ToCell(center.y + reach), ToCell(center.z + reach) } };
+	if (!ClampToOccupied(range))
+		return 0;
+
+	float reachSquared = reach * reach;
+	for (int z = range.min[2]; z <= range.max[2]; z++)
+	{
+		float dz = std::max(std::max(z * cellSize - center.z, center.z - (z + 1) * cellSize), 0.0f);
+		for (int y = range.min[1]; y <= range.max[1]; y++)
+		{
+			float dy = std::max(std::max(y * cellSize - center.y, center.y - (y + 1) * cellSize), 0.0f);
+			if (dy * dy + dz * dz > reachSquared)
+				continue;
+
+			ForEachInRow(range.min[0], range.max[0], y, z, [&](unsigned int i)
+			{
+				float dx = sortedX[i] - center.x;
+				float ey = sortedY[i] - center.y;
+				float ez = sortedZ[i] - center.z;
+				float touch = radius + sortedRadius[i];
+				if (dx * dx + ey * ey + ez * ez <= touch * touch)
+					results.push_back(sortedIds[i]);
+			});
+		}
+	}
+	return (unsigned int)results.size();
+}
+
+// --------------------------------------------------------
+// The frustum's corners give a range of cells to look at -
+// when that's more cells than there are objects (a long far
+// plane over a sparse scene), the sorted objects are walked
+// instead, one cell's run at a time
+// - Either way a row or cell is tested first, and the planes
+//   it's completely inside aren't tested again per object
+// --------------------------------------------------------
+unsigned int SpatialGrid::QueryFrustum(const Frustum & frustum, std::vector<unsigned int>& results)
+{
+	results.clear();
+	if (count == 0)
+		return 0;
+
+	CellRange range = occupied;
+	bool corners = true;
+	float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int c = 0; c < 8; c++)
+	{
+		XMFLOAT3 corner;
+		if (!IntersectPlanes(frustum.planes[c & 1], frustum.planes[2 + ((c >> 1) & 1)], frustum.planes[4 + (c >> 2)], corner))
+		{
+			corners = false;
+			break;
+		}
+		low[0] = std::min(low[0], corner.x);
+		low[1] = std::min(low[1], corner.y);
+		low[2] = std::min(low[2], corner.z);
+		high[0] = std::max(high[0], corner.x);
+		high[1] = std::max(high[1], corner.y);
+		high[2] = std::max(high[2], corner.z);
+	}
+	if (corners)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			range.min[a] = ToCell(low[a] - maxRadius);
+			range.max[a] = ToCell(high[a] + maxRadius);
+		}
+	}
+	if (!ClampToOccupied(range))
+		return 0;
+
+	// Row and cell boxes are grown by the largest radius, so a
+	// box outside a plane means every sphere in it is too
+	double cells = 1.0;
+	for (int a = 0; a < 3; a++)
+		cells *= (double)(range.max[a] - range.min[a] + 1);
+
+	if (cells <= count)
+	{
+		for (int z = range.min[2]; z <= range.max[2]; z++)
+		{
+			for (int y = range.min[1]; y <= range.max[1]; y++)
+			{
+				float rowLow[3] = { range.min[0] * cellSize - maxRadius, y * cellSize - maxRadius, z * cellSize - maxRadius };
+				float rowHigh[3] = { (range.max[0] + 1) * cellSize + maxRadius, (y + 1) * cellSize + maxRadius, (z + 1) * cellSize + maxRadius };
+				int mask = ClassifyBox(frustum, rowLow, rowHigh, 0x3F);
+				if (mask == Outside)
+					continue;
+
+				ForEachInRow(range.min[0], range.max[0], y, z, [&](unsigned int i)
+				{
+					if (mask == 0 || SphereInside(frustum, sortedX[i], sortedY[i], sortedZ[i], sortedRadius[i], mask))
+						results.push_back(sortedIds[i]);
+				});
+			}
+		}
+		return (unsigned int)results.size();
+	}
+
+	unsigned int i = 0;
+	while (i < count)
+	{
+		CellKey cell = sortedCells[i];
+		unsigned int end = i + 1;
+		while (end < count && sortedCells[end] == cell)
+			end++;
+
+		int x = (int)(cell & CellMask) - CellBias;
+		int y = (int)((cell >> CellBits) & CellMask) - CellBias;
+		int z = (int)(cell >> (CellBits * 2)) - CellBias;
+		float cellLow[3] = { x * cellSize - maxRadius, y * cellSize - maxRadius, z * cellSize - maxRadius };
+		float cellHigh[3] = { (x + 1) * cellSize + maxRadius, (y + 1) * cellSize + maxRadius, (z + 1) * cellSize + maxRadius };
+		int mask = ClassifyBox(frustum, cellLow, cellHigh, 0x3F);
+		if (mask != Outside)
+		{
+			for (; i < end; i++)
+			{
+				if (mask == 0 || SphereInside(frustum, sortedX[i], sortedY[i], sortedZ[i], sortedRadius[i], mask))
+					results.push_back(sortedIds[i]);
+			}
+		}
+		i = end;
+	}
+	return (unsigned int)results.size();
+}
+
+// Clamped to what fits in CellBits, so far away objects share
+// the outermost cells instead of wrapping around
+int SpatialGrid::ToCell(float coordinate) const
+{
+	float cell = floorf(coordinate * inverseCellSize);
+	cell = std::max(cell, (float)(1 - CellBias));
+	cell = std::min(cell, (float)(CellBias - 1));
+	return (int)cell;
+}
+
+SpatialGrid::CellKey SpatialGrid::PackCell(int x, int y, int z)
+{
+	return (CellKey)(x + CellBias) | ((CellKey)(y + CellBias) << CellBits) | ((CellKey)(z + CellBias) << (CellBits * 2));
+}
+
+// Large odd multipliers spread y and z, while x + 1 is always
+// the next bucket along
+unsigned int SpatialGrid::Hash(int x, int y, int z) const
+{
+	return ((unsigned int)x + (unsigned int)y * 19349663u + (unsigned int)z * 83492791u) & bucketMask;
+}
+
+bool SpatialGrid::ClampToOccupied(CellRange & range)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		range.min[a] = std::max(range.min[a], occupied.min[a]);
+		range.max[a] = std::min(range.max[a], occupied.max[a]);
+		if (range.min[a] > range.max[a])
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "Frustum.h"
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Uniform grid over many small things that all move every
+// frame (particles, debris, crowds) - instead of updating it,
+// it's rebuilt from scratch each frame
+// - Cells are cubes of one size, hashed into a table about as
+//   big as the object count, so empty space costs nothing and
+//   the grid has no edges
+// - Build() is a counting sort by bucket: count, prefix sum,
+//   scatter - each step split across a ThreadPool if given one
+// - The hash is linear in x, so a row of cells is a row of
+//   buckets, and queries read the sorted arrays front to back
+//   one row at a time
+// - Objects are points with a radius; queries look as far as
+//   the largest radius, so cellSize should be at least twice
+//   that or they end up visiting many cells
+// - Within a bucket objects are sorted by cell, then id, so
+//   the same input always gives the same order
+// --------------------------------------------------------
+class SpatialGrid
+{
+public:
+	SpatialGrid(float cellSize = 4.0f);
+
+	// Takes effect at the next Build()
+	void SetCellSize(float cellSize) { this->cellSize = cellSize; }
+	float GetCellSize() { return cellSize; }
+
+	// ids are indices into the arrays - radii can be null, for points
+	void Build(const DirectX::XMFLOAT3* positions, const float* radii, unsigned int count, ThreadPool* pool = nullptr);
+
+	// Positions are the translations of (transposed, as stored for
+	// HLSL) world matrices, like TransformStore::GetWorldMatrices()
+	// - ids are transform indices, and removed slots sit at the origin
+	void Build(const DirectX::XMFLOAT4X4* worldMatrices, float radius, unsigned int count, ThreadPool* pool = nullptr);
+
+	void Clear();
+
+	unsigned int GetCount() { return count; }
+	unsigned int GetBucketCount() { return bucketMask + 1; }
+	float GetMaxRadius() { return maxRadius; }
+
+	// Each one replaces results with the ids found, and returns
+	// how many there are
+
+	// Everything in the 27 cells around position's cell - a broad
+	// phase for neighbour searches, nothing is tested
+	unsigned int QueryNeighbours(const DirectX::XMFLOAT3& position, std::vector<unsigned int>& results);
+
+	// Objects whose sphere touches this one
+	unsigned int QueryRadius(const DirectX::XMFLOAT3& center, float radius, std::vector<unsigned int>& results);
+
+	// Objects whose sphere isn't completely outside a plane
+	unsigned int QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& results);
+
+private:
+	// Cells are packed 21 bits per axis, x lowest
+	typedef unsigned long long CellKey;
+	static const int CellBits = 21;
+	static const int CellBias = 1 << (CellBits - 1);
+	static const CellKey CellMask = (1ull << CellBits) - 1;
+
+	struct CellRange
+	{
+		int min[3];
+		int max[3];
+	};
+
+	template <typename Source>
+	void BuildFrom(unsigned int newCount, ThreadPool* pool, const Source& source);
+	void SortBucket(unsigned int begin, unsigned int end);
+
+	int ToCell(float coordinate) const;
+	static CellKey PackCell(int x, int y, int z);
+	unsigned int Hash(int x, int y, int z) const;
+
+	// Calls function(sortedIndex) for every object in cells
+	// [x0, x1] of row (y, z)
+	template <typename Function>
+	void ForEachInRow(int x0, int x1, int y, int z, Function function);
+
+	// Clamps a range to the cells anything was in - false if
+	// nothing is left
+	bool ClampToOccupied(CellRange& range);
+
+	float cellSize;
+	float inverseCellSize;
+	unsigned int count;
+	unsigned int bucketMask;
+	float maxRadius;
+	CellRange occupied;
+
+	// Objects sorted by bucket - bucket b is [bucketStart[b], bucketStart[b + 1])
+	std::vector<unsigned int> bucketStart;
+	std::vector<float> sortedX, sortedY, sortedZ, sortedRadius;
+	std::vector<unsigned int> sortedIds;
+	std::vector<CellKey> sortedCells;
+
+	// Build() scratch, kept between frames
+	std::vector<unsigned int> objectBuckets;
+	std::vector<CellKey> objectCells;
+	std::vector<unsigned int> blockSums;
+	std::vector<CellRange> chunkRanges;
+	std::vector<float> chunkRadii;
+	std::unique_ptr<std::atomic<unsigned int>[]> bucketCounts;
+	unsigned int bucketCountsSize;
+};
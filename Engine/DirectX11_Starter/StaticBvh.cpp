@@ -0,0 +1,199 @@
+#include "StaticBvh.h"
+#include <algorithm>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	const int BinCount = 16;
+
+	// Past this depth splits just halve, so the tree can't get
+	// deeper than StackSize whatever the boxes look like
+	const int MaxSahDepth = 48;
+
+	// Surface area can say a few more boxes are cheaper to test
+	// than another node - up to this many
+	const unsigned int MaxSahLeafSize = 16;
+
+	float Axis(const XMFLOAT3& v, int axis)
+	{
+		return (&v.x)[axis];
+	}
+}
+
+StaticBvh::StaticBvh()
+{
+	depth = 0;
+}
+
+void StaticBvh::Clear()
+{
+	nodes.clear();
+	order.clear();
+	depth = 0;
+}
+
+// --------------------------------------------------------
+// Top down - each node takes the bounds of its slots, then is
+// either a leaf or split in two and both halves queued
+// --------------------------------------------------------
+void StaticBvh::Build(const Aabb * boxes, unsigned int count, unsigned int maxLeafSize)
+{
+	Clear();
+	if (count == 0)
+		return;
+
+	maxLeafSize = std::max(maxLeafSize, 1u);
+	order.resize(count);
+	centers.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		order[i] = i;
+		centers[i] = XMFLOAT3(
+			(boxes[i].min.x + boxes[i].max.x) * 0.5f,
+			(boxes[i].min.y + boxes[i].max.y) * 0.5f,
+			(boxes[i].min.z + boxes[i].max.z) * 0.5f);
+	}
+
+	nodes.reserve(count * 2);
+	nodes.push_back(Node());
+	buildStack.clear();
+	buildStack.push_back(BuildEntry{ 0, 0, count, 0 });
+	while (!buildStack.empty())
+	{
+		BuildEntry entry = buildStack.back();
+		buildStack.pop_back();
+		depth = std::max(depth, entry.depth);
+
+		Aabb bounds = boxes[order[entry.begin]];
+		for (unsigned int i = entry.begin + 1; i < entry.end; i++)
+			bounds = Aabb::Union(bounds, boxes[order[i]]);
+		nodes[entry.node].bounds = bounds;
+
+		unsigned int middle = Split(entry, boxes, maxLeafSize);
+		if (middle == entry.begin)
+		{
+			nodes[entry.node].first = entry.begin;
+			nodes[entry.node].count = entry.end - entry.begin;
+			continue;
+		}
+
+		unsigned int left = (unsigned int)nodes.size();
+		nodes[entry.node].first = left;
+		nodes[entry.node].count = 0;
+		nodes.push_back(Node());
+		nodes.push_back(Node());
+		buildStack.push_back(BuildEntry{ left + 1, middle, entry.end, entry.depth + 1 });
+		buildStack.push_back(BuildEntry{ left, entry.begin, middle, entry.depth + 1 });
+	}
+}
+
+// --------------------------------------------------------
+// Sorts a node's slots into two halves and returns where the
+// second starts - or begin, if the node should be a leaf
+// - Bins split along the longest axis of the box centers; the
+//   cost of a split is each side's area times its box count,
+//   against the node's area times all of them
+// --------------------------------------------------------
+unsigned int StaticBvh::Split(const BuildEntry & entry, const Aabb * boxes, unsigned int maxLeafSize)
+{
+	unsigned int count = entry.end - entry.begin;
+	if (count <= maxLeafSize)
+		return entry.begin;
+
+	XMFLOAT3 low = centers[order[entry.begin]];
+	XMFLOAT3 high = low;
+	for (unsigned int i = entry.begin + 1; i < entry.end; i++)
+	{
+		const XMFLOAT3& c = centers[order[i]];
+		low = XMFLOAT3(std::min(low.x, c.x), std::min(low.y, c.y), std::min(low.z, c.z));
+		high = XMFLOAT3(std::max(high.x, c.x), std::max(high.y, c.y), std::max(high.z, c.z));
+	}
+
+	int axis = 0;
+	if (high.y - low.y > Axis(high, axis) - Axis(low, axis))
+		axis = 1;
+	if (high.z - low.z > Axis(high, axis) - Axis(low, axis))
+		axis = 2;
+	float axisLow = Axis(low, axis);
+	float extent = Axis(high, axis) - axisLow;
+
+	// Every center in one place - nothing would tell them apart
+	if (!(extent > 0.0f))
+		return entry.begin;
+
+	unsigned int* first = &order[0] + entry.begin;
+	unsigned int* last = &order[0] + entry.end;
+	auto halve = [&]()
+	{
+		unsigned int* middle = first + count / 2;
+		std::nth_element(first, middle, last, [&](unsigned int a, unsigned int b)
+		{
+			return Axis(centers[a], axis) < Axis(centers[b], axis);
+		});
+		return entry.begin + count / 2;
+	};
+
+	if (entry.depth >= MaxSahDepth)
+		return halve();
+
+	float scale = BinCount / extent;
+	auto binOf = [&](unsigned int box)
+	{
+		return std::min((int)((Axis(centers[box], axis) - axisLow) * scale), BinCount - 1);
+	};
+
+	unsigned int binCounts[BinCount] = {};
+	Aabb binBounds[BinCount];
+	for (unsigned int i = entry.begin; i < entry.end; i++)
+	{
+		int bin = binOf(order[i]);
+		binBounds[bin] = binCounts[bin] == 0 ? boxes[order[i]] : Aabb::Union(binBounds[bin], boxes[order[i]]);
+		binCounts[bin]++;
+	}
+
+	// Left to right, then right to left, so every split between
+	// bins knows both sides
+	float leftCosts[BinCount];
+	Aabb sweep;
+	unsigned int swept = 0;
+	for (int b = 0; b < BinCount - 1; b++)
+	{
+		if (binCounts[b] > 0)
+			sweep = swept == 0 ? binBounds[b] : Aabb::Union(sweep, binBounds[b]);
+		swept += binCounts[b];
+		leftCosts[b] = swept == 0 ? 0.0f : sweep.SurfaceArea() * swept;
+	}
+
+	float bestCost = 0.0f;
+	int bestBin = -1;
+	swept = 0;
+	for (int b = BinCount - 1; b > 0; b--)
+	{
+		if (binCounts[b] > 0)
+			sweep = swept == 0 ? binBounds[b] : Aabb::Union(sweep, binBounds[b]);
+		swept += binCounts[b];
+		if (swept == 0 || swept == count)
+			continue;
+
+		float cost = leftCosts[b - 1] + sweep.SurfaceArea() * swept;
+		if (bestBin < 0 || cost < bestCost)
+		{
+			bestCost = cost;
+			bestBin = b;
+		}
+	}
+
+	// Going down a node costs about as much as testing one box
+	float area = nodes[entry.node].bounds.SurfaceArea();
+	if (bestBin >= 0 && area + bestCost >= area * count && count <= MaxSahLeafSize)
+		return entry.begin;
+	if (bestBin < 0)
+		return halve();
+
+	unsigned int* middle = std::partition(first, last, [&](unsigned int box) { return binOf(box) < bestBin; });
+	if (middle == first || middle == last)
+		return halve();
+	return entry.begin + (unsigned int)(middle - first);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "AabbTree.h"
+
+// --------------------------------------------------------
+// Bounding volume hierarchy over boxes that don't move - built
+// once from all of them, then only queried
+// - Unlike AabbTree there are no fat boxes or free nodes: a
+//   node's two children sit next to each other in one array,
+//   and each leaf is a range of the boxes, sorted
+// - Splits are picked by surface area over 16 bins of box
+//   centers; deep branches fall back to halving, so the depth
+//   stays under StackSize
+// - Queries keep their stack on the stack, so any number of
+//   threads can run them at once
+// --------------------------------------------------------
+class StaticBvh
+{
+public:
+	StaticBvh();
+
+	void Build(const Aabb* boxes, unsigned int count, unsigned int maxLeafSize = 4);
+	void Clear();
+
+	unsigned int GetCount() const { return (unsigned int)order.size(); }
+	unsigned int GetNodeCount() const { return (unsigned int)nodes.size(); }
+	int GetDepth() const { return depth; }
+	const Aabb& GetBounds() const { return nodes[0].bounds; }
+
+	// Which box is in each leaf slot - leaves are ranges of these
+	const unsigned int* GetOrder() const { return order.empty() ? nullptr : &order[0]; }
+
+	// --------------------------------------------------------
+	// Walks the leaves whose boxes a ray hits, nearest first,
+	// calling function(first, count, distance) with a range of
+	// leaf slots and where the ray enters the leaf
+	// - function returns how far the ray still needs to go, as
+	//   with AabbTree::QueryRay - 0 stops
+	// - direction doesn't need to be normalized; distances are
+	//   in multiples of it
+	// --------------------------------------------------------
+	template <typename Function>
+	void QueryRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, Function function) const
+	{
+		if (nodes.empty())
+			return;
+
+		DirectX::XMFLOAT3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		float distance;
+		if (!nodes[0].bounds.IntersectRay(origin, inverse, maxDistance, distance))
+			return;
+
+		unsigned int stack[StackSize];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0)
+		{
+			// Boxes were hit when pushed, but the ray may have been
+			// shortened since
+			const Node& node = nodes[stack[--top]];
+			if (!node.bounds.IntersectRay(origin, inverse, maxDistance, distance))
+				continue;
+
+			if (node.count > 0)
+			{
+				maxDistance = function(node.first, node.count, distance);
+				if (maxDistance <= 0.0f)
+					return;
+				continue;
+			}
+
+			// Nearer child goes on top, so it's looked at first
+			float distance1, distance2;
+			bool hit1 = nodes[node.first].bounds.IntersectRay(origin, inverse, maxDistance, distance1);
+			bool hit2 = nodes[node.first + 1].bounds.IntersectRay(origin, inverse, maxDistance, distance2);
+			if (hit1 && hit2 && distance1 < distance2)
+			{
+				stack[top++] = node.first + 1;
+				stack[top++] = node.first;
+			}
+			else
+			{
+				if (hit1)
+					stack[top++] = node.first;
+				if (hit2)
+					stack[top++] = node.first + 1;
+			}
+		}
+	}
+
+	static const int StackSize = 96;
+
+private:
+	// Leaves have a count, and first is their first slot; inner
+	// nodes have a count of 0, and first is their left child
+	struct Node
+	{
+		Aabb bounds;
+		unsigned int first;
+		unsigned int count;
+	};
+
+	// A node still to be split, and the slots it covers
+	struct BuildEntry
+	{
+		unsigned int node;
+		unsigned int begin;
+		unsigned int end;
+		int depth;
+	};
+
+	unsigned int Split(const BuildEntry& entry, const Aabb* boxes, unsigned int maxLeafSize);
+
+	std::vector<Node> nodes;
+	std::vector<unsigned int> order;
+	std::vector<DirectX::XMFLOAT3> centers;
+	std::vector<BuildEntry> buildStack;
+	int depth;
+};
@@ -0,0 +1,112 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	generation = 0;
+	activeWorkers = 0;
+	stopping = false;
+	function = nullptr;
+	count = 0;
+	grainSize = 1;
+	chunkCount = 0;
+	nextChunk = 0;
+	finishedChunks = 0;
+
+	if (threadCount == 0)
+	{
+		unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+		threadCount = cores - 1;
+	}
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::ParallelFor(unsigned int loopCount, unsigned int loopGrainSize, const ParallelForFunction & loopFunction)
+{
+	if (loopCount == 0)
+		return;
+
+	loopGrainSize = std::max(1u, loopGrainSize);
+	unsigned int loopChunks = (loopCount + loopGrainSize - 1) / loopGrainSize;
+	if (loopChunks == 1 || workers.empty())
+	{
+		loopFunction(0, loopCount);
+		return;
+	}
+
+	{
+		// A worker that woke up late for the last loop may still be
+		// on its way out - it has to be gone before anything changes
+		std::unique_lock<std::mutex> lock(mutex);
+		workFinished.wait(lock, [this]() { return activeWorkers == 0; });
+
+		function = &loopFunction;
+		count = loopCount;
+		grainSize = loopGrainSize;
+		chunkCount = loopChunks;
+		nextChunk = 0;
+		finishedChunks = 0;
+		generation++;
+	}
+	workAvailable.notify_all();
+
+	RunChunks();
+
+	// Wait for the last chunks, and for every worker to be out of
+	// the loop before its state can be reused
+	std::unique_lock<std::mutex> lock(mutex);
+	workFinished.wait(lock, [this]() { return finishedChunks == chunkCount && activeWorkers == 0; });
+	function = nullptr;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	unsigned long long seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workAvailable.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+			if (stopping)
+				return;
+			seenGeneration = generation;
+			activeWorkers++;
+		}
+
+		RunChunks();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			activeWorkers--;
+		}
+		workFinished.notify_all();
+	}
+}
+
+// Grabs chunks until there are none left
+void ThreadPool::RunChunks()
+{
+	while (true)
+	{
+		unsigned int chunk = nextChunk++;
+		if (chunk >= chunkCount)
+			return;
+
+		unsigned int begin = chunk * grainSize;
+		(*function)(begin, std::min(begin + grainSize, count));
+		finishedChunks++;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs one chunk [begin, end) of a ParallelFor
+typedef std::function<void(unsigned int begin, unsigned int end)> ParallelForFunction;
+
+// --------------------------------------------------------
+// A fixed set of worker threads for data parallel loops
+// - ParallelFor splits a range into chunks that the workers
+//   and the calling thread take turns grabbing, and returns
+//   once every chunk is done
+// - Ranges of one chunk (or a pool without workers) just run
+//   on the calling thread, so small loops cost nothing extra
+// - One ParallelFor at a time; don't call it from inside one
+// --------------------------------------------------------
+class ThreadPool
+{
+public:
+	// threadCount of 0 uses one worker per core, minus the caller
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	// Not copyable - the object owns the threads
+	ThreadPool(ThreadPool const&) = delete;
+	void operator=(ThreadPool const&) = delete;
+
+	void ParallelFor(unsigned int count, unsigned int grainSize, const ParallelForFunction& function);
+
+	// Including the calling thread
+	unsigned int GetThreadCount() { return (unsigned int)workers.size() + 1; }
+
+private:
+	void WorkerLoop();
+	void RunChunks();
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workFinished;
+	unsigned long long generation;
+	unsigned int activeWorkers;
+	bool stopping;
+
+	// The current loop - only changed while no worker is in it
+	const ParallelForFunction* function;
+	unsigned int count;
+	unsigned int grainSize;
+	unsigned int chunkCount;
+	std::atomic<unsigned int> nextChunk;
+	std::atomic<unsigned int> finishedChunks;
+};
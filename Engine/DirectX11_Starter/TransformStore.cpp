@@ -0,0 +1,844 @@
+#include "TransformStore.h"
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// MSVC lets any function use AVX intrinsics; GCC and Clang need
+// to be told, so the rest of the file can stay plain SSE
+#if defined(__GNUC__)
+#define TRANSFORM_TARGET_AVX __attribute__((target("avx")))
+#else
+#define TRANSFORM_TARGET_AVX
+#endif
+
+namespace
+{
+	struct TransformArrays
+	{
+		const float* positionX;
+		const float* positionY;
+		const float* positionZ;
+		const float* rotationX;
+		const float* rotationY;
+		const float* rotationZ;
+		const float* rotationW;
+		const float* scaleX;
+		const float* scaleY;
+		const float* scaleZ;
+		XMFLOAT4X4* worldMatrices;
+	};
+
+	// --------------------------------------------------------
+	// The reference version of the kernels below
+	// - With r = the quaternion's rotation matrix, the world
+	//   matrix S * R * T transposed has rows
+	//     (sx r00, sy r10, sz r20, tx)
+	//     (sx r01, sy r11, sz r21, ty)
+	//     (sx r02, sy r12, sz r22, tz)
+	//     (0, 0, 0, 1)
+	// --------------------------------------------------------
+	void ComposeScalar(const TransformArrays& a, unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			float x = a.rotationX[i], y = a.rotationY[i], z = a.rotationZ[i], w = a.rotationW[i];
+			float sx = a.scaleX[i], sy = a.scaleY[i], sz = a.scaleZ[i];
+
+			float xx = x * x, yy = y * y, zz = z * z;
+			float xy = x * y, xz = x * z, yz = y * z;
+			float xw = x * w, yw = y * w, zw = z * w;
+
+			XMFLOAT4X4& m = a.worldMatrices[i];
+			m.m[0][0] = sx * (1.0f - 2.0f * (yy + zz));
+			m.m[0][1] = sy * (2.0f * (xy - zw));
+			m.m[0][2] = sz * (2.0f * (xz + yw));
+			m.m[0][3] = a.positionX[i];
+			m.m[1][0] = sx * (2.0f * (xy + zw));
+			m.m[1][1] = sy * (1.0f - 2.0f * (xx + zz));
+			m.m[1][2] = sz * (2.0f * (yz - xw));
+			m.m[1][3] = a.positionY[i];
+			m.m[2][0] = sx * (2.0f * (xz - yw));
+			m.m[2][1] = sy * (2.0f * (yz + xw));
+			m.m[2][2] = sz * (1.0f - 2.0f * (xx + yy));
+			m.m[2][3] = a.positionZ[i];
+			m.m[3][0] = 0.0f;
+			m.m[3][1] = 0.0f;
+			m.m[3][2] = 0.0f;
+			m.m[3][3] = 1.0f;
+		}
+	}
+
+	// --------------------------------------------------------
+	// 4 transforms per iteration - each register holds one
+	// matrix element for 4 objects, and a 4x4 transpose turns
+	// them into one matrix row per object at the end
+	// --------------------------------------------------------
+	void ComposeSSE(const TransformArrays& a, unsigned int begin, unsigned int end)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		const __m128 lastRow = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+		for (unsigned int i = begin; i < end; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(a.rotationX + i);
+			__m128 y = _mm_loadu_ps(a.rotationY + i);
+			__m128 z = _mm_loadu_ps(a.rotationZ + i);
+			__m128 w = _mm_loadu_ps(a.rotationW + i);
+			__m128 sx = _mm_loadu_ps(a.scaleX + i);
+			__m128 sy = _mm_loadu_ps(a.scaleY + i);
+			__m128 sz = _mm_loadu_ps(a.scaleZ + i);
+
+			__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			__m128 xw = _mm_mul_ps(x, w), yw = _mm_mul_ps(y, w), zw = _mm_mul_ps(z, w);
+
+			__m128 rows[3][4];
+			rows[0][0] = _mm_mul_ps(sx, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))));
+			rows[0][1] = _mm_mul_ps(sy, _mm_mul_ps(two, _mm_sub_ps(xy, zw)));
+			rows[0][2] = _mm_mul_ps(sz, _mm_mul_ps(two, _mm_add_ps(xz, yw)));
+			rows[0][3] = _mm_loadu_ps(a.positionX + i);
+			rows[1][0] = _mm_mul_ps(sx, _mm_mul_ps(two, _mm_add_ps(xy, zw)));
+			rows[1][1] = _mm_mul_ps(sy, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))));
+			rows[1][2] = _mm_mul_ps(sz, _mm_mul_ps(two, _mm_sub_ps(yz, xw)));
+			rows[1][3] = _mm_loadu_ps(a.positionY + i);
+			rows[2][0] = _mm_mul_ps(sx, _mm_mul_ps(two, _mm_sub_ps(xz, yw)));
+			rows[2][1] = _mm_mul_ps(sy, _mm_mul_ps(two, _mm_add_ps(yz, xw)));
+			rows[2][2] = _mm_mul_ps(sz, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))));
+			rows[2][3] = _mm_loadu_ps(a.positionZ + i);
+
+			XMFLOAT4X4* out = a.worldMatrices + i;
+			for (int row = 0; row < 3; row++)
+			{
+				// Element-per-register -> row-per-register
+				_MM_TRANSPOSE4_PS(rows[row][0], rows[row][1], rows[row][2], rows[row][3]);
+				for (int k = 0; k < 4; k++)
+					_mm_storeu_ps(out[k].m[row], rows[row][k]);
+			}
+			for (int k = 0; k < 4; k++)
+				_mm_storeu_ps(out[k].m[3], lastRow);
+		}
+	}
+
+	// --------------------------------------------------------
+	// Same as ComposeSSE, 8 transforms per iteration
+	// - The transpose works within each 128-bit half, so the
+	//   low half holds objects 0-3 and the high half 4-7
+	// --------------------------------------------------------
+	TRANSFORM_TARGET_AVX
+	void ComposeAVX(const TransformArrays& a, unsigned int begin, unsigned int end)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 two = _mm256_set1_ps(2.0f);
+		const __m128 lastRow = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+		for (unsigned int i = begin; i < end; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(a.rotationX + i);
+			__m256 y = _mm256_loadu_ps(a.rotationY + i);
+			__m256 z = _mm256_loadu_ps(a.rotationZ + i);
+			__m256 w = _mm256_loadu_ps(a.rotationW + i);
+			__m256 sx = _mm256_loadu_ps(a.scaleX + i);
+			__m256 sy = _mm256_loadu_ps(a.scaleY + i);
+			__m256 sz = _mm256_loadu_ps(a.scaleZ + i);
+
+			__m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+			__m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+			__m256 xw = _mm256_mul_ps(x, w), yw = _mm256_mul_ps(y, w), zw = _mm256_mul_ps(z, w);
+
+			__m256 rows[3][4];
+			rows[0][0] = _mm256_mul_ps(sx, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))));
+			rows[0][1] = _mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_sub_ps(xy, zw)));
+			rows[0][2] = _mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_add_ps(xz, yw)));
+			rows[0][3] = _mm256_loadu_ps(a.positionX + i);
+			rows[1][0] = _mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_add_ps(xy, zw)));
+			rows[1][1] = _mm256_mul_ps(sy, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))));
+			rows[1][2] = _mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_sub_ps(yz, xw)));
+			rows[1][3] = _mm256_loadu_ps(a.positionY + i);
+			rows[2][0] = _mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_sub_ps(xz, yw)));
+			rows[2][1] = _mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_add_ps(yz, xw)));
+			rows[2][2] = _mm256_mul_ps(sz, _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))));
+			rows[2][3] = _mm256_loadu_ps(a.positionZ + i);
+
+			XMFLOAT4X4* out = a.worldMatrices + i;
+			for (int row = 0; row < 3; row++)
+			{
+				__m256 t0 = _mm256_unpacklo_ps(rows[row][0], rows[row][1]);
+				__m256 t1 = _mm256_unpackhi_ps(rows[row][0], rows[row][1]);
+				__m256 t2 = _mm256_unpacklo_ps(rows[row][2], rows[row][3]);
+				__m256 t3 = _mm256_unpackhi_ps(rows[row][2], rows[row][3]);
+				__m256 r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+				__m256 r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+				__m256 r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+				__m256 r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+				_mm_storeu_ps(out[0].m[row], _mm256_castps256_ps128(r0));
+				_mm_storeu_ps(out[1].m[row], _mm256_castps256_ps128(r1));
+				_mm_storeu_ps(out[2].m[row], _mm256_castps256_ps128(r2));
+				_mm_storeu_ps(out[3].m[row], _mm256_castps256_ps128(r3));
+				_mm_storeu_ps(out[4].m[row], _mm256_extractf128_ps(r0, 1));
+				_mm_storeu_ps(out[5].m[row], _mm256_extractf128_ps(r1, 1));
+				_mm_storeu_ps(out[6].m[row], _mm256_extractf128_ps(r2, 1));
+				_mm_storeu_ps(out[7].m[row], _mm256_extractf128_ps(r3, 1));
+			}
+			for (int k = 0; k < 8; k++)
+				_mm_storeu_ps(out[k].m[3], lastRow);
+		}
+	}
+
+	// --------------------------------------------------------
+	// AVX needs both the CPU and the OS (which has to save the
+	// wider registers on a context switch)
+	// --------------------------------------------------------
+	bool DetectAVX()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		return osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+#elif defined(__GNUC__)
+		return __builtin_cpu_supports("avx") != 0;
+#else
+		return false;
+#endif
+	}
+
+	// --------------------------------------------------------
+	// World = local * parent with row vectors - what's stored is
+	// transposed, which makes it parent * local here
+	// - out can't be either input
+	// --------------------------------------------------------
+	void MultiplyStored(const XMFLOAT4X4& parent, const XMFLOAT4X4& local, XMFLOAT4X4& out)
+	{
+		__m128 row0 = _mm_loadu_ps(local.m[0]);
+		__m128 row1 = _mm_loadu_ps(local.m[1]);
+		__m128 row2 = _mm_loadu_ps(local.m[2]);
+		__m128 row3 = _mm_loadu_ps(local.m[3]);
+		for (int i = 0; i < 4; i++)
+		{
+			__m128 result = _mm_mul_ps(_mm_set1_ps(parent.m[i][0]), row0);
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(parent.m[i][1]), row1));
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(parent.m[i][2]), row2));
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(parent.m[i][3]), row3));
+			_mm_storeu_ps(out.m[i], result);
+		}
+	}
+
+	// Work per chunk when splitting across threads - multiples of
+	// 8, so SIMD blocks never straddle two chunks
+	const unsigned int ComposeGrainSize = 16384;
+	const unsigned int PropagateGrainSize = 2048;
+	const unsigned int BlockGrainSize = 1024;
+
+	// Past one dirty transform in this many, a hierarchy is cheaper
+	// to rebuild level by level than subtree by subtree
+	const unsigned int DenseDirtyRatio = 16;
+
+	unsigned int RoundUp(unsigned int value, unsigned int multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+}
+
+
+TransformStore::TransformStore()
+{
+	count = 0;
+	hasHierarchy = false;
+}
+
+unsigned int TransformStore::Add(const XMFLOAT3 & position, const XMFLOAT4 & rotation, const XMFLOAT3 & scale)
+{
+	unsigned int index;
+	if (!freeSlots.empty())
+	{
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		index = count;
+		Resize(count + 1);
+	}
+
+	HierarchyNode& node = nodes[index];
+	node.parent = node.firstChild = node.nextSibling = node.previousSibling = NoParent;
+	node.depth = 0;
+	AddToLevel(index);
+
+	// The setters leave it dirty, so consumers hear about new
+	// transforms in the next changed list too
+	SetPosition(index, position);
+	SetRotation(index, rotation);
+	SetScale(index, scale);
+	UpdateWorldMatrix(index);
+	return index;
+}
+
+// --------------------------------------------------------
+// Removed slots become identity transforms until they're
+// reused - their children become roots
+// --------------------------------------------------------
+void TransformStore::Remove(unsigned int index)
+{
+	while (nodes[index].firstChild != NoParent)
+		SetParent(nodes[index].firstChild, NoParent);
+	Unlink(index);
+	RemoveFromLevel(index);
+
+	SetIdentity(index);
+	dirtyFlags[index] = 0;
+	freeSlots.push_back(index);
+}
+
+void TransformStore::Clear()
+{
+	Resize(0);
+	freeSlots.clear();
+	dirtyIndices.clear();
+	dirtyBlocks.clear();
+	changedIndices.clear();
+	levels.clear();
+	localMatrices.clear();
+	worldChanged.clear();
+	hasHierarchy = false;
+}
+
+void TransformStore::Reserve(unsigned int reserveCount)
+{
+	unsigned int padded = RoundUp(reserveCount, 8);
+	positionX.reserve(padded);
+	positionY.reserve(padded);
+	positionZ.reserve(padded);
+	rotationX.reserve(padded);
+	rotationY.reserve(padded);
+	rotationZ.reserve(padded);
+	rotationW.reserve(padded);
+	scaleX.reserve(padded);
+	scaleY.reserve(padded);
+	scaleZ.reserve(padded);
+	worldMatrices.reserve(padded);
+	dirtyFlags.reserve(padded);
+	dirtyBlockFlags.reserve(padded / 8);
+	nodes.reserve(padded);
+	if (hasHierarchy)
+	{
+		localMatrices.reserve(padded);
+		worldChanged.reserve(padded);
+	}
+}
+
+XMFLOAT3 TransformStore::GetPosition(unsigned int index)
+{
+	return XMFLOAT3(positionX[index], positionY[index], positionZ[index]);
+}
+
+XMFLOAT4 TransformStore::GetRotation(unsigned int index)
+{
+	return XMFLOAT4(rotationX[index], rotationY[index], rotationZ[index], rotationW[index]);
+}
+
+XMFLOAT3 TransformStore::GetScale(unsigned int index)
+{
+	return XMFLOAT3(scaleX[index], scaleY[index], scaleZ[index]);
+}
+
+void TransformStore::SetPosition(unsigned int index, const XMFLOAT3 & position)
+{
+	positionX[index] = position.x;
+	positionY[index] = position.y;
+	positionZ[index] = position.z;
+	MarkDirty(index);
+}
+
+// Normalized on the way in, since the kernels assume it
+void TransformStore::SetRotation(unsigned int index, const XMFLOAT4 & rotation)
+{
+	float length = sqrtf(rotation.x * rotation.x + rotation.y * rotation.y + rotation.z * rotation.z + rotation.w * rotation.w);
+	float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+	rotationX[index] = rotation.x * inverse;
+	rotationY[index] = rotation.y * inverse;
+	rotationZ[index] = rotation.z * inverse;
+	rotationW[index] = length > 0.0f ? rotation.w * inverse : 1.0f;
+	MarkDirty(index);
+}
+
+void TransformStore::SetScale(unsigned int index, const XMFLOAT3 & scale)
+{
+	scaleX[index] = scale.x;
+	scaleY[index] = scale.y;
+	scaleZ[index] = scale.z;
+	MarkDirty(index);
+}
+
+// --------------------------------------------------------
+// Only the moved transform itself is marked dirty - its
+// descendants follow along when it's propagated
+// --------------------------------------------------------
+bool TransformStore::SetParent(unsigned int index, unsigned int parent)
+{
+	if (nodes[index].parent == parent)
+		return true;
+
+	for (unsigned int ancestor = parent; ancestor != NoParent; ancestor = nodes[ancestor].parent)
+	{
+		if (ancestor == index)
+			return false;
+	}
+
+	if (!hasHierarchy)
+		EnableHierarchy();
+
+	Unlink(index);
+	Link(index, parent);
+	MarkDirty(index);
+
+	// Move the subtree to its new depths, if they changed at all
+	unsigned int depth = parent == NoParent ? 0 : nodes[parent].depth + 1;
+	if (depth != nodes[index].depth)
+	{
+		walkStack.assign(1, index);
+		while (!walkStack.empty())
+		{
+			unsigned int i = walkStack.back();
+			walkStack.pop_back();
+
+			unsigned int p = nodes[i].parent;
+			RemoveFromLevel(i);
+			nodes[i].depth = p == NoParent ? 0 : nodes[p].depth + 1;
+			AddToLevel(i);
+
+			for (unsigned int child = nodes[i].firstChild; child != NoParent; child = nodes[child].nextSibling)
+				walkStack.push_back(child);
+		}
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Dirty transforms are rebuilt a whole SIMD block at a time -
+// neighbors that didn't change just get the same matrix again
+// - Once most blocks are dirty, one pass over everything beats
+//   jumping around between them
+// - With a hierarchy, only the subtrees under dirty transforms
+//   are then walked (PropagateDirty) - unless so much is dirty
+//   that most of it changes anyway, in which case it's all
+//   rebuilt and the changed ones are picked out level by level
+// --------------------------------------------------------
+unsigned int TransformStore::UpdateDirtyWorldMatrices(ThreadPool* pool, TransformKernel kernel)
+{
+	changedIndices.clear();
+	if (dirtyBlocks.empty())
+		return 0;
+
+	if (dirtyBlocks.size() * 2 > dirtyBlockFlags.size())
+		ComposeAll(pool, kernel);
+	else
+		ComposeDirtyBlocks(pool, kernel);
+
+	if (hasHierarchy && dirtyIndices.size() * DenseDirtyRatio > count)
+	{
+		Propagate(pool, true);
+
+		// Written whether it changed or not, and only counted if it did
+		changedIndices.resize(count);
+		unsigned int changedCount = 0;
+		for (auto& level : levels)
+		{
+			for (unsigned int i : level)
+			{
+				changedIndices[changedCount] = i;
+				changedCount += worldChanged[i];
+			}
+		}
+		changedIndices.resize(changedCount);
+		for (unsigned int i : changedIndices)
+			worldChanged[i] = 0;
+		for (unsigned int i : dirtyIndices)
+			dirtyFlags[i] = 0;
+	}
+	else
+	{
+		// Drop transforms removed since they were marked, and the
+		// second listing of any that were re-added after that
+		unsigned int dirtyCount = 0;
+		for (unsigned int i : dirtyIndices)
+		{
+			if (dirtyFlags[i])
+			{
+				dirtyFlags[i] = 0;
+				dirtyIndices[dirtyCount++] = i;
+			}
+		}
+		dirtyIndices.resize(dirtyCount);
+
+		if (hasHierarchy)
+			PropagateDirty(pool);
+		else
+			changedIndices.swap(dirtyIndices);
+	}
+
+	for (unsigned int block : dirtyBlocks)
+		dirtyBlockFlags[block] = 0;
+	dirtyBlocks.clear();
+	dirtyIndices.clear();
+	return (unsigned int)changedIndices.size();
+}
+
+void TransformStore::UpdateWorldMatrices(ThreadPool* pool, TransformKernel kernel)
+{
+	ComposeAll(pool, kernel);
+	if (hasHierarchy)
+		Propagate(pool, false);
+}
+
+void TransformStore::UpdateWorldMatrix(unsigned int index)
+{
+	Compose(index, index + 1, TRANSFORM_KERNEL_SCALAR);
+	if (hasHierarchy)
+	{
+		unsigned int parent = nodes[index].parent;
+		if (parent == NoParent)
+			worldMatrices[index] = localMatrices[index];
+		else
+			MultiplyStored(worldMatrices[parent], localMatrices[index], worldMatrices[index]);
+	}
+}
+
+// --------------------------------------------------------
+// The SIMD kernels round the range out to whole blocks - the
+// padding is always there, so that never reads or writes past
+// the arrays
+// --------------------------------------------------------
+void TransformStore::Compose(unsigned int begin, unsigned int end, TransformKernel kernel)
+{
+	if (begin >= end)
+		return;
+
+	TransformArrays arrays;
+	arrays.positionX = &positionX[0];
+	arrays.positionY = &positionY[0];
+	arrays.positionZ = &positionZ[0];
+	arrays.rotationX = &rotationX[0];
+	arrays.rotationY = &rotationY[0];
+	arrays.rotationZ = &rotationZ[0];
+	arrays.rotationW = &rotationW[0];
+	arrays.scaleX = &scaleX[0];
+	arrays.scaleY = &scaleY[0];
+	arrays.scaleZ = &scaleZ[0];
+	arrays.worldMatrices = hasHierarchy ? &localMatrices[0] : &worldMatrices[0];
+
+	if (kernel == TRANSFORM_KERNEL_BEST)
+		kernel = IsKernelSupported(TRANSFORM_KERNEL_AVX) ? TRANSFORM_KERNEL_AVX : TRANSFORM_KERNEL_SSE;
+
+	switch (kernel)
+	{
+	case TRANSFORM_KERNEL_AVX:
+		ComposeAVX(arrays, begin & ~7u, RoundUp(end, 8));
+		break;
+	case TRANSFORM_KERNEL_SSE:
+		ComposeSSE(arrays, begin & ~3u, RoundUp(end, 4));
+		break;
+	default:
+		ComposeScalar(arrays, begin, end);
+		break;
+	}
+}
+
+void TransformStore::ComposeAll(ThreadPool* pool, TransformKernel kernel)
+{
+	if (!pool)
+	{
+		Compose(0, count, kernel);
+		return;
+	}
+
+	pool->ParallelFor(count, ComposeGrainSize, [this, kernel](unsigned int begin, unsigned int end)
+	{
+		Compose(begin, end, kernel);
+	});
+}
+
+void TransformStore::ComposeDirtyBlocks(ThreadPool* pool, TransformKernel kernel)
+{
+	auto composeBlocks = [this, kernel](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			unsigned int block = dirtyBlocks[i];
+			Compose(block * 8, std::min(block * 8 + 8, count), kernel);
+		}
+	};
+
+	if (pool)
+		pool->ParallelFor((unsigned int)dirtyBlocks.size(), BlockGrainSize, composeBlocks);
+	else
+		composeBlocks(0, (unsigned int)dirtyBlocks.size());
+}
+
+// --------------------------------------------------------
+// Level by level, so every parent is final before its
+// children read it - within a level nothing depends on
+// anything else, so it's split into chunks across the pool
+// - With markChanged, everything dirty or under something
+//   dirty also gets its changed flag set on the way
+// --------------------------------------------------------
+void TransformStore::Propagate(ThreadPool* pool, bool markChanged)
+{
+	for (auto& level : levels)
+	{
+		const unsigned int* members = level.empty() ? nullptr : &level[0];
+		auto propagateChunk = [this, members, markChanged](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int k = begin; k < end; k++)
+			{
+				unsigned int i = members[k];
+				unsigned int parent = nodes[i].parent;
+				if (parent == NoParent)
+					worldMatrices[i] = localMatrices[i];
+				else
+					MultiplyStored(worldMatrices[parent], localMatrices[i], worldMatrices[i]);
+
+				if (markChanged)
+					worldChanged[i] = dirtyFlags[i] | (parent == NoParent ? 0 : worldChanged[parent]);
+			}
+		};
+
+		if (pool)
+			pool->ParallelFor((unsigned int)level.size(), PropagateGrainSize, propagateChunk);
+		else
+			propagateChunk(0, (unsigned int)level.size());
+	}
+}
+
+// --------------------------------------------------------
+// Only walks the subtrees under dirty transforms, so a frame
+// costs as much as what changed, not the whole hierarchy
+// - The dirty list is sorted by depth, so every subtree is
+//   reached from its top - anything already walked from a
+//   dirty ancestor is skipped
+// - Each subtree goes into the changed list parents first, and
+//   no two overlap, so they're split across the pool
+// --------------------------------------------------------
+void TransformStore::PropagateDirty(ThreadPool* pool)
+{
+	depthStarts.assign(levels.size() + 1, 0);
+	for (unsigned int i : dirtyIndices)
+		depthStarts[nodes[i].depth + 1]++;
+	for (size_t depth = 1; depth < depthStarts.size(); depth++)
+		depthStarts[depth] += depthStarts[depth - 1];
+
+	dirtyByDepth.resize(dirtyIndices.size());
+	for (unsigned int i : dirtyIndices)
+		dirtyByDepth[depthStarts[nodes[i].depth]++] = i;
+
+	subtreeStarts.clear();
+	for (unsigned int top : dirtyByDepth)
+	{
+		if (worldChanged[top])
+			continue;
+
+		subtreeStarts.push_back((unsigned int)changedIndices.size());
+		walkStack.assign(1, top);
+		while (!walkStack.empty())
+		{
+			unsigned int i = walkStack.back();
+			walkStack.pop_back();
+			worldChanged[i] = 1;
+			changedIndices.push_back(i);
+
+			for (unsigned int child = nodes[i].firstChild; child != NoParent; child = nodes[child].nextSibling)
+				walkStack.push_back(child);
+		}
+	}
+	unsigned int subtreeCount = (unsigned int)subtreeStarts.size();
+	subtreeStarts.push_back((unsigned int)changedIndices.size());
+
+	auto propagateSubtrees = [this](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int k = subtreeStarts[begin]; k < subtreeStarts[end]; k++)
+		{
+			unsigned int i = changedIndices[k];
+			unsigned int parent = nodes[i].parent;
+			if (parent == NoParent)
+				worldMatrices[i] = localMatrices[i];
+			else
+				MultiplyStored(worldMatrices[parent], localMatrices[i], worldMatrices[i]);
+			worldChanged[i] = 0;
+		}
+	};
+
+	// Chunks of about PropagateGrainSize transforms each
+	if (pool && subtreeCount > 0)
+	{
+		unsigned long long grain = (unsigned long long)PropagateGrainSize * subtreeCount / std::max<size_t>(1, changedIndices.size());
+		pool->ParallelFor(subtreeCount, (unsigned int)std::max(1ull, grain), propagateSubtrees);
+	}
+	else
+	{
+		propagateSubtrees(0, subtreeCount);
+	}
+}
+
+bool TransformStore::IsKernelSupported(TransformKernel kernel)
+{
+	static const bool hasAVX = DetectAVX();
+	return kernel != TRANSFORM_KERNEL_AVX || hasAVX;
+}
+
+// --------------------------------------------------------
+// Entity used to build rotZ * rotY * rotX, which (with row
+// vectors) rotates around Z first, then Y, then X
+// --------------------------------------------------------
+XMFLOAT4 TransformStore::QuaternionFromEuler(float x, float y, float z)
+{
+	XMFLOAT4 aroundX(sinf(x * 0.5f), 0.0f, 0.0f, cosf(x * 0.5f));
+	XMFLOAT4 aroundY(0.0f, sinf(y * 0.5f), 0.0f, cosf(y * 0.5f));
+	XMFLOAT4 aroundZ(0.0f, 0.0f, sinf(z * 0.5f), cosf(z * 0.5f));
+	return QuaternionMultiply(QuaternionMultiply(aroundZ, aroundY), aroundX);
+}
+
+// The Hamilton product b * a - same as XMQuaternionMultiply(a, b)
+XMFLOAT4 TransformStore::QuaternionMultiply(const XMFLOAT4 & a, const XMFLOAT4 & b)
+{
+	return XMFLOAT4(
+		b.w * a.x + b.x * a.w + b.y * a.z - b.z * a.y,
+		b.w * a.y - b.x * a.z + b.y * a.w + b.z * a.x,
+		b.w * a.z + b.x * a.y - b.y * a.x + b.z * a.w,
+		b.w * a.w - b.x * a.x - b.y * a.y - b.z * a.z);
+}
+
+// New slots (and the padding after them) start as identity
+void TransformStore::Resize(unsigned int newCount)
+{
+	unsigned int oldPadded = (unsigned int)positionX.size();
+	unsigned int padded = RoundUp(newCount, 8);
+
+	positionX.resize(padded);
+	positionY.resize(padded);
+	positionZ.resize(padded);
+	rotationX.resize(padded);
+	rotationY.resize(padded);
+	rotationZ.resize(padded);
+	rotationW.resize(padded);
+	scaleX.resize(padded);
+	scaleY.resize(padded);
+	scaleZ.resize(padded);
+	worldMatrices.resize(padded);
+	dirtyFlags.resize(padded);
+	dirtyBlockFlags.resize(padded / 8);
+	nodes.resize(padded);
+	if (hasHierarchy)
+	{
+		localMatrices.resize(padded);
+		worldChanged.resize(padded);
+	}
+
+	for (unsigned int i = oldPadded; i < padded; i++)
+		SetIdentity(i);
+	count = newCount;
+}
+
+void TransformStore::MarkDirty(unsigned int index)
+{
+	if (!dirtyFlags[index])
+	{
+		dirtyFlags[index] = 1;
+		dirtyIndices.push_back(index);
+	}
+
+	unsigned int block = index / 8;
+	if (!dirtyBlockFlags[block])
+	{
+		dirtyBlockFlags[block] = 1;
+		dirtyBlocks.push_back(block);
+	}
+}
+
+void TransformStore::SetIdentity(unsigned int index)
+{
+	positionX[index] = positionY[index] = positionZ[index] = 0.0f;
+	rotationX[index] = rotationY[index] = rotationZ[index] = 0.0f;
+	rotationW[index] = 1.0f;
+	scaleX[index] = scaleY[index] = scaleZ[index] = 1.0f;
+	Compose(index, index + 1, TRANSFORM_KERNEL_SCALAR);
+	if (hasHierarchy)
+		worldMatrices[index] = localMatrices[index];
+}
+
+// --------------------------------------------------------
+// Until something has a parent, every world matrix is its
+// own local matrix, so that's where they start out
+// --------------------------------------------------------
+void TransformStore::EnableHierarchy()
+{
+	localMatrices = worldMatrices;
+	worldChanged.assign(worldMatrices.size(), 0);
+	hasHierarchy = true;
+}
+
+void TransformStore::Link(unsigned int index, unsigned int parent)
+{
+	HierarchyNode& node = nodes[index];
+	node.parent = parent;
+	node.previousSibling = NoParent;
+	node.nextSibling = NoParent;
+	if (parent == NoParent)
+		return;
+
+	node.nextSibling = nodes[parent].firstChild;
+	if (node.nextSibling != NoParent)
+		nodes[node.nextSibling].previousSibling = index;
+	nodes[parent].firstChild = index;
+}
+
+void TransformStore::Unlink(unsigned int index)
+{
+	HierarchyNode& node = nodes[index];
+	if (node.parent == NoParent)
+		return;
+
+	if (node.previousSibling != NoParent)
+		nodes[node.previousSibling].nextSibling = node.nextSibling;
+	else
+		nodes[node.parent].firstChild = node.nextSibling;
+	if (node.nextSibling != NoParent)
+		nodes[node.nextSibling].previousSibling = node.previousSibling;
+
+	node.parent = node.nextSibling = node.previousSibling = NoParent;
+}
+
+void TransformStore::AddToLevel(unsigned int index)
+{
+	HierarchyNode& node = nodes[index];
+	if (node.depth >= levels.size())
+		levels.resize(node.depth + 1);
+
+	node.levelPosition = (unsigned int)levels[node.depth].size();
+	levels[node.depth].push_back(index);
+}
+
+// Swaps the last member of the level into the hole
+void TransformStore::RemoveFromLevel(unsigned int index)
+{
+	HierarchyNode& node = nodes[index];
+	std::vector<unsigned int>& level = levels[node.depth];
+
+	unsigned int last = level.back();
+	level[node.levelPosition] = last;
+	nodes[last].levelPosition = node.levelPosition;
+	level.pop_back();
+
+	// Drop empty levels at the bottom
+	while (!levels.empty() && levels.back().empty())
+		levels.pop_back();
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Which world matrix kernel UpdateWorldMatrices() runs
+// --------------------------------------------------------
+enum TransformKernel
+{
+	TRANSFORM_KERNEL_SCALAR = 0,   // One transform at a time
+	TRANSFORM_KERNEL_SSE = 1,      // 4 at a time
+	TRANSFORM_KERNEL_AVX = 2,      // 8 at a time, if the CPU has it
+	TRANSFORM_KERNEL_BEST = 3      // Widest one the CPU supports
+};
+
+// --------------------------------------------------------
+// Positions, rotations and scales of many objects, stored as
+// structure-of-arrays so world matrices can be built several
+// at a time with SIMD
+// - Rotations are unit quaternions (x, y, z, w)
+// - World matrices are scale * rotation * translation, stored
+//   transposed for HLSL like every other matrix we upload
+// - Indices stay valid until they're removed; removed slots
+//   are reused by later Add() calls
+// - Setters mark a transform dirty, so a frame where little
+//   moved only rebuilds what did (UpdateDirtyWorldMatrices)
+// - Transforms can have parents, in which case position,
+//   rotation and scale are relative to the parent - every
+//   transform is also listed by its depth in the hierarchy,
+//   so each depth can be done in parallel once the one above
+//   it is finished
+// --------------------------------------------------------
+class TransformStore
+{
+public:
+	TransformStore();
+
+	unsigned int Add(
+		const DirectX::XMFLOAT3& position = DirectX::XMFLOAT3(0, 0, 0),
+		const DirectX::XMFLOAT4& rotation = DirectX::XMFLOAT4(0, 0, 0, 1),
+		const DirectX::XMFLOAT3& scale = DirectX::XMFLOAT3(1, 1, 1));
+	void Remove(unsigned int index);
+	void Clear();
+	void Reserve(unsigned int count);
+
+	// Slots in use, including removed ones waiting to be reused -
+	// valid indices are below this
+	unsigned int GetCount() { return count; }
+	unsigned int GetLiveCount() { return count - (unsigned int)freeSlots.size(); }
+
+	DirectX::XMFLOAT3 GetPosition(unsigned int index);
+	DirectX::XMFLOAT4 GetRotation(unsigned int index);
+	DirectX::XMFLOAT3 GetScale(unsigned int index);
+	void SetPosition(unsigned int index, const DirectX::XMFLOAT3& position);
+	void SetRotation(unsigned int index, const DirectX::XMFLOAT4& rotation);
+	void SetScale(unsigned int index, const DirectX::XMFLOAT3& scale);
+
+	// Makes a transform relative to another one (or to nothing,
+	// with NoParent) - costs as much as the moved subtree's size
+	// only if its depth changes
+	// - Returns false, and changes nothing, if it would make a cycle
+	bool SetParent(unsigned int index, unsigned int parent);
+	unsigned int GetParent(unsigned int index) { return nodes[index].parent; }
+	unsigned int GetDepth(unsigned int index) { return nodes[index].depth; }
+	unsigned int GetLevelCount() { return (unsigned int)levels.size(); }
+	static const unsigned int NoParent = 0xFFFFFFFF;
+
+	// Only valid until the next Add() or Reserve(), which can
+	// move the array
+	DirectX::XMFLOAT4X4* GetWorldMatrix(unsigned int index) { return &worldMatrices[index]; }
+	const DirectX::XMFLOAT4X4* GetWorldMatrices() { return worldMatrices.empty() ? nullptr : &worldMatrices[0]; }
+
+	// Rebuilds the world matrices of everything changed since the
+	// last call (and everything below it in the hierarchy), then
+	// makes those indices the changed list
+	// - Returns how many changed
+	// - With a pool, big batches and hierarchy levels are split
+	//   across its threads
+	unsigned int UpdateDirtyWorldMatrices(ThreadPool* pool = nullptr, TransformKernel kernel = TRANSFORM_KERNEL_BEST);
+
+	// Indices whose world matrix the last UpdateDirtyWorldMatrices()
+	// rebuilt, for culling, rendering, etc. to update only those
+	// - In no particular order, but each index is only listed once
+	const std::vector<unsigned int>& GetChangedIndices() { return changedIndices; }
+	bool IsDirty(unsigned int index) { return dirtyFlags[index] != 0; }
+
+	// Rebuilds every world matrix (dirty flags are left alone)
+	void UpdateWorldMatrices(ThreadPool* pool = nullptr, TransformKernel kernel = TRANSFORM_KERNEL_BEST);
+
+	// Rebuilds one, assuming its parent's is up to date - its
+	// children aren't touched
+	void UpdateWorldMatrix(unsigned int index);
+
+	static bool IsKernelSupported(TransformKernel kernel);
+
+	// Same rotation Entity's Euler angles always meant - Z first,
+	// then Y, then X - so existing scenes look the same
+	static DirectX::XMFLOAT4 QuaternionFromEuler(float x, float y, float z);
+
+	// Rotation a followed by rotation b
+	static DirectX::XMFLOAT4 QuaternionMultiply(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b);
+
+private:
+	// Builds the matrices of [begin, end) from their own position,
+	// rotation and scale - into the local matrices once there is
+	// a hierarchy, straight into the world matrices before that
+	void Compose(unsigned int begin, unsigned int end, TransformKernel kernel);
+	void ComposeAll(ThreadPool* pool, TransformKernel kernel);
+	void ComposeDirtyBlocks(ThreadPool* pool, TransformKernel kernel);
+	void Propagate(ThreadPool* pool, bool markChanged);
+	void PropagateDirty(ThreadPool* pool);
+
+	void Resize(unsigned int newCount);
+	void SetIdentity(unsigned int index);
+	void MarkDirty(unsigned int index);
+
+	void EnableHierarchy();
+	void Link(unsigned int index, unsigned int parent);
+	void Unlink(unsigned int index);
+	void AddToLevel(unsigned int index);
+	void RemoveFromLevel(unsigned int index);
+
+	struct HierarchyNode
+	{
+		unsigned int parent;
+		unsigned int firstChild;
+		unsigned int nextSibling;
+		unsigned int previousSibling;
+		unsigned int depth;
+		unsigned int levelPosition;   // Where it is in levels[depth]
+	};
+
+	// Every array is padded to a multiple of 8 with identity
+	// transforms, so the kernels never need a scalar tail
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+
+	unsigned int count;
+	std::vector<unsigned int> freeSlots;
+
+	// Dirty transforms are tracked per index and per block of 8
+	// (what the kernels work on) - each is listed when its flag
+	// is first set, so nothing has to search the flags
+	std::vector<unsigned char> dirtyFlags;
+	std::vector<unsigned int> dirtyIndices;
+	std::vector<unsigned char> dirtyBlockFlags;
+	std::vector<unsigned int> dirtyBlocks;
+	std::vector<unsigned int> changedIndices;
+
+	// Every live transform is in the level of its depth, in no
+	// particular order - the local matrices and per transform
+	// changed flags only exist once something has a parent
+	std::vector<HierarchyNode> nodes;
+	std::vector<std::vector<unsigned int>> levels;
+	std::vector<DirectX::XMFLOAT4X4> localMatrices;
+	std::vector<unsigned char> worldChanged;
+	bool hasHierarchy;
+
+	// Scratch space for walking subtrees, kept so SetParent() and
+	// PropagateDirty() don't allocate every time
+	std::vector<unsigned int> walkStack;
+	std::vector<unsigned int> depthStarts;
+	std::vector<unsigned int> dirtyByDepth;
+	std::vector<unsigned int> subtreeStarts;
+};
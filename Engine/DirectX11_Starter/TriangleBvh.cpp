@@ -0,0 +1,117 @@
+#include "TriangleBvh.h"
+#include <algorithm>
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+}
+
+void TriangleBvh::Clear()
+{
+	bvh.Clear();
+	corners.clear();
+}
+
+void TriangleBvh::Build(const XMFLOAT3 * positions, unsigned int stride, const void * indices, unsigned int indexSize, unsigned int indexCount)
+{
+	Clear();
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	auto position = [&](unsigned int corner)
+	{
+		unsigned int index = indexSize == sizeof(unsigned short) ?
+			((const unsigned short*)indices)[corner] : ((const unsigned int*)indices)[corner];
+		return *(const XMFLOAT3*)((const char*)positions + (size_t)index * stride);
+	};
+
+	std::vector<Aabb> boxes(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		XMFLOAT3 a = position(t * 3);
+		XMFLOAT3 b = position(t * 3 + 1);
+		XMFLOAT3 c = position(t * 3 + 2);
+		boxes[t].min = XMFLOAT3(std::min(std::min(a.x, b.x), c.x), std::min(std::min(a.y, b.y), c.y), std::min(std::min(a.z, b.z), c.z));
+		boxes[t].max = XMFLOAT3(std::max(std::max(a.x, b.x), c.x), std::max(std::max(a.y, b.y), c.y), std::max(std::max(a.z, b.z), c.z));
+	}
+	bvh.Build(&boxes[0], triangleCount);
+
+	// Corners go in leaf order; the order itself says which
+	// triangle each one was
+	const unsigned int* order = bvh.GetOrder();
+	corners.resize(triangleCount * 3);
+	for (unsigned int slot = 0; slot < triangleCount; slot++)
+	{
+		for (int k = 0; k < 3; k++)
+			corners[slot * 3 + k] = position(order[slot] * 3 + k);
+	}
+}
+
+// --------------------------------------------------------
+// Moller-Trumbore against each triangle of the leaves the ray
+// reaches, nearest leaf first - a hit shortens the ray, so
+// leaves behind it are skipped
+// --------------------------------------------------------
+bool TriangleBvh::IntersectRay(const XMFLOAT3 & origin, const XMFLOAT3 & direction, float maxDistance,
+	float & distance, unsigned int & triangle) const
+{
+	unsigned int nearestSlot = NoTriangle;
+	float nearest = maxDistance;
+
+	bvh.QueryRay(origin, direction, maxDistance, [&](unsigned int first, unsigned int count, float)
+	{
+		for (unsigned int slot = first; slot < first + count; slot++)
+		{
+			const XMFLOAT3* corner = &corners[slot * 3];
+			XMFLOAT3 edge1 = Subtract(corner[1], corner[0]);
+			XMFLOAT3 edge2 = Subtract(corner[2], corner[0]);
+			XMFLOAT3 p = Cross(direction, edge2);
+			float determinant = Dot(edge1, p);
+			if (determinant == 0.0f)
+				continue;
+
+			float inverse = 1.0f / determinant;
+			XMFLOAT3 s = Subtract(origin, corner[0]);
+			float u = Dot(s, p) * inverse;
+			if (u < 0.0f || u > 1.0f)
+				continue;
+
+			XMFLOAT3 q = Cross(s, edge1);
+			float v = Dot(direction, q) * inverse;
+			if (v < 0.0f || u + v > 1.0f)
+				continue;
+
+			float t = Dot(edge2, q) * inverse;
+			if (t >= 0.0f && t < nearest)
+			{
+				nearest = t;
+				nearestSlot = slot;
+			}
+		}
+		return nearest;
+	});
+
+	if (nearestSlot == NoTriangle)
+		return false;
+	distance = nearest;
+	triangle = bvh.GetOrder()[nearestSlot];
+	return true;
+}
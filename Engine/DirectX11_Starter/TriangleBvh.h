@@ -0,0 +1,46 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "StaticBvh.h"
+
+// --------------------------------------------------------
+// A mesh's triangles in a StaticBvh, for finding exactly where
+// a ray hits it
+// - Built once per Mesh, in object space, and shared by every
+//   entity drawing that mesh - rays are moved into object
+//   space instead (see Picker)
+// - Keeps its own copy of the corners, in leaf order, so a
+//   leaf's triangles are next to each other in memory
+// - Both sides of a triangle count as a hit
+// --------------------------------------------------------
+class TriangleBvh
+{
+public:
+	static const unsigned int NoTriangle = 0xFFFFFFFF;
+
+	// positions are stride bytes apart, so they can be read
+	// straight out of a vertex array - indices are indexSize bytes
+	// each (2 or 4), so 16-bit index buffers work as they are
+	void Build(const DirectX::XMFLOAT3* positions, unsigned int stride, const void* indices, unsigned int indexSize, unsigned int indexCount);
+	void Build(const DirectX::XMFLOAT3* positions, unsigned int stride, const unsigned int* indices, unsigned int indexCount)
+	{
+		Build(positions, stride, indices, sizeof(unsigned int), indexCount);
+	}
+	void Clear();
+
+	bool IsEmpty() const { return corners.empty(); }
+	unsigned int GetTriangleCount() const { return (unsigned int)corners.size() / 3; }
+	unsigned int GetNodeCount() const { return bvh.GetNodeCount(); }
+	const Aabb& GetBounds() const { return bvh.GetBounds(); }
+
+	// The nearest triangle closer than maxDistance - distance is in
+	// multiples of direction, and triangle is its index in the
+	// indices it was built from (divided by 3)
+	bool IntersectRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance,
+		float& distance, unsigned int& triangle) const;
+
+private:
+	StaticBvh bvh;
+	std::vector<DirectX::XMFLOAT3> corners;
+};
@@ -10,4 +10,20 @@ struct Vertex
 	DirectX::XMFLOAT3 Position;	    // The position of the vertex
 	DirectX::XMFLOAT3 Normal;	//DirectX::XMFLOAT4 Color;        // The color of the vertex
 	DirectX::XMFLOAT2 UV; 
-};
\ No newline at end of file
+};
+
+// --------------------------------------------------------
+// Compressed vertex - 16 bytes instead of 32
+// - Position: 16-bit UNORM per axis, relative to the mesh's
+//   bounding box (w is padding, the GPU needs 4 components)
+// - Normal: octahedral encoding in two 16-bit SNORMs
+// - UV: two half floats
+// See VertexCompressor for the encoding and PackedVertexShader
+// for the matching decode
+// --------------------------------------------------------
+struct PackedVertex
+{
+	unsigned short Position[4];   // DXGI_FORMAT_R16G16B16A16_UNORM
+	short Normal[2];              // DXGI_FORMAT_R16G16_SNORM
+	unsigned short UV[2];         // DXGI_FORMAT_R16G16_FLOAT
+};
@@ -0,0 +1,253 @@
+#include "VertexCacheOptimizer.h"
+#include <cmath>
+
+namespace
+{
+	// Forsyth's tuning values
+	const int MaxCacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+
+	// Valences above this share the last table entry
+	const unsigned int MaxValence = 32;
+
+	// Score tables, built once on first use
+	struct ScoreTables
+	{
+		float cache[MaxCacheSize];
+		float valence[MaxValence + 1];
+
+		ScoreTables()
+		{
+			for (int i = 0; i < MaxCacheSize; i++)
+			{
+				if (i < 3)
+				{
+					// The three vertices of the last triangle get a fixed score,
+					// so the next triangle doesn't just pick one of them
+					cache[i] = LastTriScore;
+				}
+				else
+				{
+					const float scaler = 1.0f / (MaxCacheSize - 3);
+					cache[i] = powf(1.0f - (i - 3) * scaler, CacheDecayPower);
+				}
+			}
+
+			valence[0] = 0.0f;
+			for (unsigned int i = 1; i <= MaxValence; i++)
+				valence[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
+		}
+	};
+
+	const ScoreTables& GetScoreTables()
+	{
+		static ScoreTables tables;
+		return tables;
+	}
+
+	inline float VertexScore(const ScoreTables& tables, int cachePosition, unsigned int remainingValence)
+	{
+		// No triangles left that need this vertex
+		if (remainingValence == 0)
+			return -1.0f;
+
+		float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+		score += tables.valence[remainingValence < MaxValence ? remainingValence : MaxValence];
+		return score;
+	}
+}
+
+
+// --------------------------------------------------------
+// Greedy triangle reordering
+// - Each step emits the triangle with the highest score among
+//   the triangles touching the cache
+// - If nothing in the cache has triangles left, the next
+//   unused triangle in the original order is taken
+// --------------------------------------------------------
+void VertexCacheOptimizer::Optimize(std::vector<unsigned int>& indices, unsigned int vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	const ScoreTables& tables = GetScoreTables();
+
+	// Build vertex -> triangle adjacency (CSR style)
+	std::vector<unsigned int> valence(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		valence[indices[i]]++;
+
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + valence[v];
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[t * 3 + c];
+			adjacency[fill[v]++] = (unsigned int)t;
+		}
+	}
+
+	// Per vertex state - "valence" is now the number of triangles
+	// still waiting to be emitted, and the first "valence" entries
+	// of each adjacency range are those triangles
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		vertexScore[v] = VertexScore(tables, -1, valence[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] =
+			vertexScore[indices[t * 3 + 0]] +
+			vertexScore[indices[t * 3 + 1]] +
+			vertexScore[indices[t * 3 + 2]];
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+
+	// Room for the full cache plus the three incoming vertices
+	unsigned int cache[MaxCacheSize + 3];
+	int cacheCount = 0;
+
+	size_t cursor = 0;
+	long long best = -1;
+
+	for (size_t step = 0; step < triangleCount; step++)
+	{
+		if (best < 0)
+		{
+			while (emitted[cursor])
+				cursor++;
+			best = (long long)cursor;
+		}
+
+		size_t t = (size_t)best;
+		emitted[t] = true;
+		const unsigned int* tri = &indices[t * 3];
+		output.push_back(tri[0]);
+		output.push_back(tri[1]);
+		output.push_back(tri[2]);
+
+		// Remove the triangle from each of its vertices' active lists
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = tri[c];
+			unsigned int* begin = &adjacency[offsets[v]];
+			unsigned int count = valence[v];
+			for (unsigned int i = 0; i < count; i++)
+			{
+				if (begin[i] == t)
+				{
+					begin[i] = begin[count - 1];
+					begin[count - 1] = (unsigned int)t;
+					break;
+				}
+			}
+			valence[v]--;
+		}
+
+		// New cache: this triangle's vertices first, then the old
+		// contents minus duplicates
+		unsigned int newCache[MaxCacheSize + 3];
+		int newCount = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			if (c > 0 && (tri[c] == tri[0] || (c == 2 && tri[c] == tri[1])))
+				continue;
+			newCache[newCount++] = tri[c];
+		}
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Rescore everything that was or is in the cache
+		for (int i = 0; i < newCount; i++)
+		{
+			unsigned int v = newCache[i];
+			cachePosition[v] = i < MaxCacheSize ? i : -1;
+		}
+
+		best = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < newCount; i++)
+		{
+			unsigned int v = newCache[i];
+			float newScore = VertexScore(tables, cachePosition[v], valence[v]);
+			float delta = newScore - vertexScore[v];
+			vertexScore[v] = newScore;
+
+			unsigned int* begin = &adjacency[offsets[v]];
+			for (unsigned int j = 0; j < valence[v]; j++)
+			{
+				unsigned int other = begin[j];
+				triangleScore[other] += delta;
+				if (i < MaxCacheSize && triangleScore[other] > bestScore)
+				{
+					bestScore = triangleScore[other];
+					best = other;
+				}
+			}
+		}
+
+		// Vertices pushed out of the cache are dropped from the list
+		cacheCount = newCount < MaxCacheSize ? newCount : MaxCacheSize;
+		for (int i = 0; i < cacheCount; i++)
+			cache[i] = newCache[i];
+	}
+
+	indices.swap(output);
+}
+
+VertexCacheStats VertexCacheOptimizer::Analyze(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	stats.acmr = 0.0f;
+	stats.atvr = 0.0f;
+
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return stats;
+
+	// FIFO cache simulated with insertion timestamps - a vertex
+	// is a hit if it was inserted fewer than cacheSize misses ago
+	std::vector<unsigned int> insertedAt(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	unsigned int timestamp = cacheSize + 1;
+	unsigned int misses = 0;
+	unsigned int uniqueVertices = 0;
+
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		unsigned int v = indices[i];
+		if (!used[v])
+		{
+			used[v] = true;
+			uniqueVertices++;
+		}
+
+		if (timestamp - insertedAt[v] > cacheSize)
+		{
+			insertedAt[v] = timestamp++;
+			misses++;
+		}
+	}
+
+	stats.acmr = (float)misses / triangleCount;
+	stats.atvr = (float)misses / uniqueVertices;
+	return stats;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// Post-transform cache efficiency of an index buffer
+// - ACMR: cache misses per triangle (0.5 is ideal for large
+//   regular meshes, 3.0 is the worst case)
+// - ATVR: cache misses per unique vertex (1.0 is ideal)
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	float acmr;
+	float atvr;
+};
+
+// --------------------------------------------------------
+// Reorders triangles so vertices are reused while they are
+// still in the GPU's post-transform cache
+// - Uses Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+//   scoring (LRU cache model, valence boost)
+// - Only the triangle order changes - the vertex buffer and the
+//   set of triangles (and their winding) stay the same
+// --------------------------------------------------------
+class VertexCacheOptimizer
+{
+public:
+	static void Optimize(std::vector<unsigned int>& indices, unsigned int vertexCount);
+
+	// Simulates a FIFO cache of the given size
+	static VertexCacheStats Analyze(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize = 16);
+};
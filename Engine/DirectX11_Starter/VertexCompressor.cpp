@@ -0,0 +1,266 @@
+#include "VertexCompressor.h"
+#include "MeshBuilder.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+namespace
+{
+	inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+	inline float SignNotZero(float value) { return value >= 0.0f ? 1.0f : -1.0f; }
+
+	// What the GPU does when it reads an SNORM16
+	inline float SnormToFloat(short value) { return std::max(value / 32767.0f, -1.0f); }
+
+	inline short FloatToSnorm(float value)
+	{
+		value = std::max(-1.0f, std::min(1.0f, value));
+		float scaled = floorf(fabsf(value) * 32767.0f + 0.5f);
+		return (short)(value >= 0.0f ? scaled : -scaled);
+	}
+
+	inline unsigned short FloatToUnorm(float value)
+	{
+		value = std::max(0.0f, std::min(1.0f, value));
+		return (unsigned short)floorf(value * 65535.0f + 0.5f);
+	}
+}
+
+
+// --------------------------------------------------------
+// The box gets stretched over the full 16-bit range; flat
+// axes get a scale of 0 so they decode to exactly the box
+// --------------------------------------------------------
+PackedPositionScale VertexCompressor::ComputeScale(const MeshBounds & bounds)
+{
+	PackedPositionScale scale;
+	scale.offset = bounds.min;
+	scale.scale = XMFLOAT3(
+		bounds.max.x - bounds.min.x,
+		bounds.max.y - bounds.min.y,
+		bounds.max.z - bounds.min.z);
+	return scale;
+}
+
+void VertexCompressor::Encode(const Vertex * vertices, size_t vertexCount, const PackedPositionScale & scale, PackedVertex * out)
+{
+	float inverse[3] =
+	{
+		scale.scale.x > 0.0f ? 1.0f / scale.scale.x : 0.0f,
+		scale.scale.y > 0.0f ? 1.0f / scale.scale.y : 0.0f,
+		scale.scale.z > 0.0f ? 1.0f / scale.scale.z : 0.0f
+	};
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const Vertex& v = vertices[i];
+		PackedVertex& p = out[i];
+
+		p.Position[0] = FloatToUnorm((v.Position.x - scale.offset.x) * inverse[0]);
+		p.Position[1] = FloatToUnorm((v.Position.y - scale.offset.y) * inverse[1]);
+		p.Position[2] = FloatToUnorm((v.Position.z - scale.offset.z) * inverse[2]);
+		p.Position[3] = 0;
+
+		EncodeOctahedral(v.Normal, p.Normal);
+
+		p.UV[0] = FloatToHalf(v.UV.x);
+		p.UV[1] = FloatToHalf(v.UV.y);
+	}
+}
+
+Vertex VertexCompressor::Decode(const PackedVertex & packed, const PackedPositionScale & scale)
+{
+	Vertex v;
+	v.Position = XMFLOAT3(
+		scale.offset.x + packed.Position[0] / 65535.0f * scale.scale.x,
+		scale.offset.y + packed.Position[1] / 65535.0f * scale.scale.y,
+		scale.offset.z + packed.Position[2] / 65535.0f * scale.scale.z);
+	v.Normal = DecodeOctahedral(packed.Normal);
+	v.UV = XMFLOAT2(HalfToFloat(packed.UV[0]), HalfToFloat(packed.UV[1]));
+	return v;
+}
+
+VertexCompressionStats VertexCompressor::Measure(const Vertex * vertices, size_t vertexCount, size_t indexCount)
+{
+	VertexCompressionStats stats = {};
+	stats.vertexBytesBefore = (unsigned int)(vertexCount * sizeof(Vertex));
+	stats.vertexBytesAfter = (unsigned int)(vertexCount * sizeof(PackedVertex));
+	stats.indexBytesBefore = (unsigned int)(indexCount * sizeof(unsigned int));
+	stats.indexBytesAfter = (unsigned int)(indexCount * (CanUse16BitIndices(vertexCount) ? sizeof(unsigned short) : sizeof(unsigned int)));
+
+	if (vertexCount == 0)
+		return stats;
+
+	PackedPositionScale scale = ComputeScale(MeshBuilder::ComputeBounds(vertices, vertexCount));
+	float maxNormalDot = 1.0f;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		PackedVertex packed;
+		Encode(&vertices[i], 1, scale, &packed);
+		Vertex decoded = Decode(packed, scale);
+		const Vertex& original = vertices[i];
+
+		stats.maxPositionError = std::max(stats.maxPositionError, fabsf(decoded.Position.x - original.Position.x));
+		stats.maxPositionError = std::max(stats.maxPositionError, fabsf(decoded.Position.y - original.Position.y));
+		stats.maxPositionError = std::max(stats.maxPositionError, fabsf(decoded.Position.z - original.Position.z));
+		stats.maxUVError = std::max(stats.maxUVError, fabsf(decoded.UV.x - original.UV.x));
+		stats.maxUVError = std::max(stats.maxUVError, fabsf(decoded.UV.y - original.UV.y));
+
+		// Normals are compared by direction only - the decode is unit length
+		float length = sqrtf(Dot(original.Normal, original.Normal));
+		if (length > 0.0f)
+			maxNormalDot = std::min(maxNormalDot, Dot(decoded.Normal, original.Normal) / length);
+	}
+
+	maxNormalDot = std::max(-1.0f, std::min(1.0f, maxNormalDot));
+	stats.maxNormalError = acosf(maxNormalDot) * (180.0f / 3.14159265f);
+	return stats;
+}
+
+// --------------------------------------------------------
+// Bit twiddling float <-> half conversion, so this also
+// builds where DirectXPackedVector isn't available
+// - Values too large become infinity, tiny ones become
+//   denormals or zero
+// --------------------------------------------------------
+unsigned short VertexCompressor::FloatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int magnitude = bits & 0x7FFFFFFF;
+
+	// NaN stays NaN, infinity and overflow become infinity
+	if (magnitude > 0x7F800000)
+		return (unsigned short)(sign | 0x7E00);
+	if (magnitude >= 0x477FF000)
+		return (unsigned short)(sign | 0x7C00);
+
+	// Too small for a denormal half - round to zero
+	if (magnitude < 0x33000000)
+		return (unsigned short)sign;
+
+	unsigned int exponent = magnitude >> 23;
+	unsigned int mantissa = magnitude & 0x7FFFFF;
+
+	if (exponent < 113)
+	{
+		// Denormal: shift the (implicit 1 +) mantissa into place
+		mantissa |= 0x800000;
+		unsigned int shift = 126 - exponent;
+		unsigned int half = mantissa >> shift;
+		unsigned int remainder = mantissa & ((1u << shift) - 1);
+		unsigned int halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1)))
+			half++;
+		return (unsigned short)(sign | half);
+	}
+
+	// Normal: rebias the exponent and round the mantissa to 10 bits
+	unsigned int half = ((exponent - 112) << 10) | (mantissa >> 13);
+	unsigned int remainder = mantissa & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		half++;
+	return (unsigned short)(sign | half);
+}
+
+float VertexCompressor::HalfToFloat(unsigned short value)
+{
+	unsigned int sign = (unsigned int)(value & 0x8000) << 16;
+	unsigned int exponent = (value >> 10) & 0x1F;
+	unsigned int mantissa = value & 0x3FF;
+
+	unsigned int bits;
+	if (exponent == 0)
+	{
+		// Zero or denormal - the value is just mantissa * 2^-24
+		float result = mantissa * (1.0f / 16777216.0f);
+		return sign ? -result : result;
+	}
+	else if (exponent == 31)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+// --------------------------------------------------------
+// Projects the normal onto an octahedron and unfolds the
+// lower half over the upper one (Cigolle et al. 2014)
+// --------------------------------------------------------
+void VertexCompressor::EncodeOctahedral(const XMFLOAT3 & normal, short * out)
+{
+	float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	if (length <= 0.0f)
+	{
+		out[0] = 0;
+		out[1] = FloatToSnorm(1.0f);
+		return;
+	}
+
+	float u = normal.x / length;
+	float v = normal.y / length;
+	if (normal.z < 0.0f)
+	{
+		float foldedU = (1.0f - fabsf(v)) * SignNotZero(u);
+		float foldedV = (1.0f - fabsf(u)) * SignNotZero(v);
+		u = foldedU;
+		v = foldedV;
+	}
+
+	// Rounding each axis on its own isn't always the closest
+	// point, so try the four around it
+	float unitLength = sqrtf(Dot(normal, normal));
+	XMFLOAT3 unit(normal.x / unitLength, normal.y / unitLength, normal.z / unitLength);
+
+	int baseU = (int)floorf(std::max(-1.0f, std::min(1.0f, u)) * 32767.0f);
+	int baseV = (int)floorf(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f);
+	float bestDot = -2.0f;
+	for (int du = 0; du <= 1; du++)
+	{
+		for (int dv = 0; dv <= 1; dv++)
+		{
+			short candidate[2] =
+			{
+				(short)std::max(-32767, std::min(32767, baseU + du)),
+				(short)std::max(-32767, std::min(32767, baseV + dv))
+			};
+			float d = Dot(DecodeOctahedral(candidate), unit);
+			if (d > bestDot)
+			{
+				bestDot = d;
+				out[0] = candidate[0];
+				out[1] = candidate[1];
+			}
+		}
+	}
+}
+
+XMFLOAT3 VertexCompressor::DecodeOctahedral(const short * encoded)
+{
+	float u = SnormToFloat(encoded[0]);
+	float v = SnormToFloat(encoded[1]);
+	XMFLOAT3 n(u, v, 1.0f - fabsf(u) - fabsf(v));
+	if (n.z < 0.0f)
+	{
+		float x = (1.0f - fabsf(n.y)) * SignNotZero(n.x);
+		float y = (1.0f - fabsf(n.x)) * SignNotZero(n.y);
+		n.x = x;
+		n.y = y;
+	}
+
+	float length = sqrtf(Dot(n, n));
+	return XMFLOAT3(n.x / length, n.y / length, n.z / length);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include "MeshData.h"
+
+// --------------------------------------------------------
+// Vertex layouts a Mesh can upload
+// --------------------------------------------------------
+enum MeshVertexFormat
+{
+	VERTEX_FORMAT_FULL = 0,      // Vertex, 32 bytes
+	VERTEX_FORMAT_PACKED = 1     // PackedVertex, 16 bytes
+};
+
+// --------------------------------------------------------
+// Dequantization constants for packed positions:
+//   position = offset + unorm * scale
+// --------------------------------------------------------
+struct PackedPositionScale
+{
+	DirectX::XMFLOAT3 offset;
+	DirectX::XMFLOAT3 scale;
+};
+
+// --------------------------------------------------------
+// How much precision (and memory) packing gave up
+// - Position error is in object space units
+// - Normal error is an angle in degrees
+// - Byte counts assume 16-bit indices whenever they fit
+// --------------------------------------------------------
+struct VertexCompressionStats
+{
+	float maxPositionError;
+	float maxNormalError;
+	float maxUVError;
+	unsigned int vertexBytesBefore;
+	unsigned int vertexBytesAfter;
+	unsigned int indexBytesBefore;
+	unsigned int indexBytesAfter;
+};
+
+// --------------------------------------------------------
+// Encodes and decodes PackedVertex
+// - Decode() is the CPU mirror of PackedVertexShader.hlsl,
+//   used for the error report
+// --------------------------------------------------------
+class VertexCompressor
+{
+public:
+	static PackedPositionScale ComputeScale(const MeshBounds& bounds);
+
+	static void Encode(const Vertex* vertices, size_t vertexCount, const PackedPositionScale& scale, PackedVertex* out);
+	static Vertex Decode(const PackedVertex& packed, const PackedPositionScale& scale);
+
+	// Packs and unpacks every vertex and reports the worst errors
+	static VertexCompressionStats Measure(const Vertex* vertices, size_t vertexCount, size_t indexCount);
+
+	// True if indices fit in DXGI_FORMAT_R16_UINT
+	static bool CanUse16BitIndices(size_t vertexCount) { return vertexCount <= 0xFFFF; }
+
+	// IEEE half precision conversion (round to nearest even)
+	static unsigned short FloatToHalf(float value);
+	static float HalfToFloat(unsigned short value);
+
+	// Octahedral normal encoding, picking whichever of the nearby
+	// quantized points decodes closest to the input
+	static void EncodeOctahedral(const DirectX::XMFLOAT3& normal, short* out);
+	static DirectX::XMFLOAT3 DecodeOctahedral(const short* encoded);
+};
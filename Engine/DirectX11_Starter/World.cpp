@@ -0,0 +1,187 @@
+#include "World.h"
+
+// Everything starts out in the archetype with no components
+World::World()
+{
+	entityCount = 0;
+	freeHead = 0;
+	archetypes.push_back(new Archetype(0));
+	archetypeIndices[0] = 0;
+	lastFoundMask = 0;
+	lastFoundArchetype = 0;
+}
+
+World::~World()
+{
+	for (auto archetype : archetypes)
+		delete archetype;
+}
+
+bool World::Destroy(EntityId id)
+{
+	if (!IsAlive(id))
+		return false;
+
+	unsigned int index = GetIndex(id);
+	EntityRecord freed = records[index];
+	Archetype& archetype = *archetypes[freed.archetype];
+	Released(freed, archetype.Destroy(freed.chunk, freed.row));
+	FreeSlot(index);
+	return true;
+}
+
+// --------------------------------------------------------
+// Destroys every entity, but keeps the archetypes (and their
+// chunks) around for whatever gets created next - old ids stay
+// dead, like they would destroying one at a time
+// --------------------------------------------------------
+void World::Clear()
+{
+	for (auto archetype : archetypes)
+		archetype->Clear();
+
+	for (unsigned int index = 0; index < records.size(); index++)
+	{
+		if (records[index].archetype != NoArchetype)
+			FreeSlot(index);
+	}
+}
+
+void World::Reserve(unsigned int count)
+{
+	records.reserve(count);
+	freeSlots.reserve(count);
+}
+
+void World::Trim()
+{
+	for (auto archetype : archetypes)
+		archetype->Trim();
+
+	freeSlots.erase(freeSlots.begin(), freeSlots.begin() + freeHead);
+	freeHead = 0;
+	freeSlots.shrink_to_fit();
+}
+
+// --------------------------------------------------------
+// Takes the oldest free slot once enough are waiting, so the
+// same few slots aren't reused (and their generations used up)
+// over and over when things come and go every frame
+// --------------------------------------------------------
+EntityId World::NewId()
+{
+	unsigned int index;
+	if (freeSlots.size() - freeHead > MinimumFreeSlots || records.size() >= MaxEntities)
+	{
+		if (freeHead == freeSlots.size())
+			throw std::length_error("Too many entities");
+		index = freeSlots[freeHead++];
+
+		// Drop the taken part of the queue once it's most of it -
+		// the copy is paid for by all the slots taken since
+		if (freeHead > MinimumFreeSlots && freeHead * 2 > freeSlots.size())
+		{
+			freeSlots.erase(freeSlots.begin(), freeSlots.begin() + freeHead);
+			freeHead = 0;
+		}
+	}
+	else
+	{
+		index = (unsigned int)records.size();
+		EntityRecord record;
+		record.archetype = NoArchetype;
+		record.generation = 0;
+		records.push_back(record);
+	}
+
+	entityCount++;
+	return (records[index].generation << IndexBits) | index;
+}
+
+// The generation moves on, which is what kills the old ids
+void World::FreeSlot(unsigned int index)
+{
+	EntityRecord& record = records[index];
+	record.archetype = NoArchetype;
+	record.generation = (record.generation + 1) & (NullId >> IndexBits);
+	freeSlots.push_back(index);
+	entityCount--;
+}
+
+void World::Place(EntityId id, unsigned int archetype)
+{
+	EntityRecord& record = records[GetIndex(id)];
+	record.archetype = archetype;
+	archetypes[archetype]->Allocate(id, record.chunk, record.row);
+}
+
+// --------------------------------------------------------
+// Moves every component the target has room for, destroys the
+// rest, and closes the gap left behind - components only the
+// target has are still to be constructed by the caller
+// --------------------------------------------------------
+void World::Move(EntityId id, unsigned int archetype)
+{
+	EntityRecord from = records[GetIndex(id)];
+	Archetype& source = *archetypes[from.archetype];
+
+	Place(id, archetype);
+	const EntityRecord& to = records[GetIndex(id)];
+	source.MoveRow(from.chunk, from.row, *archetypes[archetype], to.chunk, to.row);
+	Released(from, source.Release(from.chunk, from.row));
+}
+
+// The entity that filled the freed row now lives there
+void World::Released(const EntityRecord& freed, EntityId moved)
+{
+	EntityRecord& record = records[GetIndex(moved)];
+	if (record.archetype == freed.archetype && (record.chunk != freed.chunk || record.row != freed.row))
+	{
+		record.chunk = freed.chunk;
+		record.row = freed.row;
+	}
+}
+
+// Creating lots of one kind of thing asks for the same one over and over
+unsigned int World::FindArchetype(ComponentMask mask)
+{
+	if (mask == lastFoundMask)
+		return lastFoundArchetype;
+
+	auto found = archetypeIndices.find(mask);
+	unsigned int index;
+	if (found != archetypeIndices.end())
+		index = found->second;
+	else
+	{
+		index = (unsigned int)archetypes.size();
+		archetypes.push_back(new Archetype(mask));
+		archetypeIndices[mask] = index;
+	}
+
+	lastFoundMask = mask;
+	lastFoundArchetype = index;
+	return index;
+}
+
+unsigned int World::AddEdge(unsigned int archetype, ComponentTypeId type)
+{
+	int& edge = archetypes[archetype]->addEdges[type];
+	if (edge < 0)
+	{
+		edge = (int)FindArchetype(archetypes[archetype]->GetMask() | (1ull << type));
+		archetypes[edge]->removeEdges[type] = (int)archetype;
+	}
+	return (unsigned int)edge;
+}
+
+unsigned int World::RemoveEdge(unsigned int archetype, ComponentTypeId type)
+{
+	int& edge = archetypes[archetype]->removeEdges[type];
+	if (edge < 0)
+	{
+		edge = (int)FindArchetype(archetypes[archetype]->GetMask() & ~(1ull << type));
+		archetypes[edge]->addEdges[type] = (int)archetype;
+	}
+	return (unsigned int)edge;
+}
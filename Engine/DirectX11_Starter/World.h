@@ -0,0 +1,228 @@
+#pragma once
+
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Archetype.h"
+
+// --------------------------------------------------------
+// Every entity in a scene and its components, kept by
+// archetype - entities with the same set of components share
+// chunks, so systems run over plain arrays
+// - Components are any movable struct; their type is the key
+// - Adding or removing a component moves the entity to the
+//   archetype with the new set (those are found through
+//   remembered edges, so it's a lookup, not a search)
+// - Pointers and references to components only last until
+//   the next structural change (Create, Destroy, Add, Remove)
+//   - don't make any while iterating with ForEach
+// - Not thread safe; systems can split chunks across threads
+//   themselves
+// - Ids are handles: a slot index in the low bits, and in the
+//   high bits how many times that slot had been reused when
+//   the id was made - ids of destroyed entities stop working
+//   instead of quietly finding whatever took the slot next
+// - Freed slots wait in a queue, and only come back once
+//   enough others are waiting, so one slot's generation wraps
+//   around only after millions of entities have come and gone
+// --------------------------------------------------------
+class World
+{
+public:
+	World();
+	~World();
+
+	// Not copyable - the object owns the archetypes
+	World(World const&) = delete;
+	void operator=(World const&) = delete;
+
+	// Makes an entity with all its components in one go - straight
+	// into its final archetype, so nothing is moved around
+	template <typename... Components>
+	EntityId Create(Components&&... components)
+	{
+		unsigned int archetype = FindArchetype(MaskOf<typename std::decay<Components>::type...>());
+		EntityId id = NewId();
+		Place(id, archetype);
+
+		EntityRecord& record = records[GetIndex(id)];
+		Archetype& target = *archetypes[archetype];
+		int expand[] = { 0, (Construct(target, record, std::forward<Components>(components)), 0)... };
+		(void)expand;
+		return id;
+	}
+
+	// False (and nothing happens) if it was already gone
+	bool Destroy(EntityId id);
+	bool IsAlive(EntityId id)
+	{
+		unsigned int index = GetIndex(id);
+		return index < records.size() && records[index].generation == GetGeneration(id) && records[index].archetype != NoArchetype;
+	}
+	void Clear();
+	void Reserve(unsigned int count);
+
+	// Gives spare chunks and free slot memory back
+	void Trim();
+
+	// Adds a component, or replaces the one already there - the
+	// entity has to be alive
+	template <typename T>
+	T& Add(EntityId id, T component = T())
+	{
+		if (!IsAlive(id))
+			throw std::invalid_argument("Adding a component to a destroyed entity");
+
+		ComponentTypeId type = ComponentRegistry::GetId<T>();
+		if (T* existing = Get<T>(id))
+		{
+			*existing = std::move(component);
+			return *existing;
+		}
+
+		Move(id, AddEdge(records[GetIndex(id)].archetype, type));
+		EntityRecord& record = records[GetIndex(id)];
+		void* memory = archetypes[record.archetype]->GetComponent(record.chunk, record.row, type);
+		return *new (memory) T(std::move(component));
+	}
+
+	template <typename T>
+	void Remove(EntityId id)
+	{
+		ComponentTypeId type = ComponentRegistry::GetId<T>();
+		if (Has<T>(id))
+			Move(id, RemoveEdge(records[GetIndex(id)].archetype, type));
+	}
+
+	// nullptr if the entity doesn't have one, or is gone
+	template <typename T>
+	T* Get(EntityId id)
+	{
+		if (!IsAlive(id))
+			return nullptr;
+
+		ComponentTypeId type = ComponentRegistry::GetId<T>();
+		const EntityRecord& record = records[GetIndex(id)];
+		Archetype& archetype = *archetypes[record.archetype];
+		if (!archetype.Has(type))
+			return nullptr;
+		return static_cast<T*>(archetype.GetComponent(record.chunk, record.row, type));
+	}
+
+	template <typename T>
+	bool Has(EntityId id) { return IsAlive(id) && archetypes[records[GetIndex(id)].archetype]->Has(ComponentRegistry::GetId<T>()); }
+
+	// --------------------------------------------------------
+	// Calls function(count, ids, arrays...) once per chunk of
+	// every archetype with at least these components - the
+	// fastest way through, since each array is contiguous
+	// --------------------------------------------------------
+	template <typename... Components, typename Function>
+	void ForEachChunk(Function function)
+	{
+		ComponentMask mask = MaskOf<Components...>();
+		for (Archetype* archetype : archetypes)
+		{
+			if ((archetype->GetMask() & mask) != mask)
+				continue;
+
+			for (unsigned int c = 0; c < archetype->GetChunkCount(); c++)
+			{
+				function(archetype->GetChunk(c).count, (const EntityId*)archetype->GetIds(c),
+					static_cast<Components*>(archetype->GetComponents(c, ComponentRegistry::GetId<Components>()))...);
+			}
+		}
+	}
+
+	// Same, but calls function(id, components...) per entity
+	template <typename... Components, typename Function>
+	void ForEach(Function function)
+	{
+		ForEachChunk<Components...>([&function](unsigned int count, const EntityId* ids, Components*... arrays)
+		{
+			for (unsigned int i = 0; i < count; i++)
+				function(ids[i], arrays[i]...);
+		});
+	}
+
+	// How many entities have at least these components
+	template <typename... Components>
+	unsigned int Count()
+	{
+		ComponentMask mask = MaskOf<Components...>();
+		unsigned int total = 0;
+		for (Archetype* archetype : archetypes)
+		{
+			if ((archetype->GetMask() & mask) == mask)
+				total += archetype->GetEntityCount();
+		}
+		return total;
+	}
+
+	unsigned int GetEntityCount() { return entityCount; }
+	unsigned int GetArchetypeCount() { return (unsigned int)archetypes.size(); }
+
+	// Never the id of a live entity
+	static const EntityId NullId = 0xFFFFFFFF;
+
+	static const unsigned int IndexBits = 22;
+	static const unsigned int MaxEntities = (1u << IndexBits) - 1;
+	static unsigned int GetIndex(EntityId id) { return id & MaxEntities; }
+	static unsigned int GetGeneration(EntityId id) { return id >> IndexBits; }
+
+	template <typename... Components>
+	static ComponentMask MaskOf()
+	{
+		ComponentMask mask = 0;
+		int expand[] = { 0, (mask |= 1ull << ComponentRegistry::GetId<Components>(), 0)... };
+		(void)expand;
+		return mask;
+	}
+
+private:
+	static const unsigned int NoArchetype = 0xFFFFFFFF;
+
+	// Freed slots aren't reused until this many are waiting
+	static const unsigned int MinimumFreeSlots = 1024;
+
+	// Where a slot's entity is - archetype is NoArchetype while
+	// the slot is free
+	struct EntityRecord
+	{
+		unsigned int archetype;
+		unsigned int chunk;
+		unsigned int row;
+		unsigned int generation;
+	};
+
+	template <typename T>
+	void Construct(Archetype& archetype, const EntityRecord& record, T&& component)
+	{
+		typedef typename std::decay<T>::type Type;
+		void* memory = archetype.GetComponent(record.chunk, record.row, ComponentRegistry::GetId<Type>());
+		new (memory) Type(std::forward<T>(component));
+	}
+
+	EntityId NewId();
+	void FreeSlot(unsigned int index);
+	void Place(EntityId id, unsigned int archetype);
+	void Move(EntityId id, unsigned int archetype);
+	void Released(const EntityRecord& freed, EntityId moved);
+
+	unsigned int FindArchetype(ComponentMask mask);
+	unsigned int AddEdge(unsigned int archetype, ComponentTypeId type);
+	unsigned int RemoveEdge(unsigned int archetype, ComponentTypeId type);
+
+	std::vector<Archetype*> archetypes;
+	std::unordered_map<ComponentMask, unsigned int> archetypeIndices;
+	ComponentMask lastFoundMask;
+	unsigned int lastFoundArchetype;
+
+	// Free slots are a queue - taken from freeHead, added at the end
+	std::vector<EntityRecord> records;
+	std::vector<unsigned int> freeSlots;
+	size_t freeHead;
+	unsigned int entityCount;
+};
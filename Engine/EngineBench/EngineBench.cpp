@@ -0,0 +1,2509 @@
+// ----------------------------------------------------------------------------
+//  EngineBench - headless benchmarks for the engine's CPU-side systems
+//
+//  Usage:
+//    EngineBench [options] benchmark [benchmark ...]
+//
+//  Benchmarks:
+//    transforms      World matrix builds - the old one-Entity-at-a-time
+//                    path against every TransformStore kernel, for 100
+//                    up to -max objects
+//    dirty           A frame of -max objects where only some moved -
+//                    dirty tracking against rebuilding everything,
+//                    without and with a hierarchy
+//    hierarchy       -max objects in deep (long chains) and wide (a few
+//                    parents with many children) hierarchies - level
+//                    by level propagation on one thread and on a
+//                    ThreadPool, plus what reparenting costs
+//    ecs             Creating, updating and restructuring 1000 up to -max
+//                    entities in a World, against one heap allocation
+//                    per object reached through pointers
+//    churn           Frames that each spawn and despawn thousands of
+//                    entities out of -max live ones, then update them
+//    culling         Frustum culling 1000 up to -max objects scattered
+//                    around a camera, with every FrustumCuller kernel
+//    bvh             Building, moving and querying an AabbTree of 1000
+//                    up to -max objects, against testing every object
+//    grid            Rebuilding a SpatialGrid of 1000 up to -max moving
+//                    particles each frame, on one thread and on a
+//                    ThreadPool, and querying it - against moving
+//                    them all in an AabbTree, and testing every one
+//    occlusion       Rendering a race track's walls and grandstands into
+//                    an OcclusionCuller with every kernel, then testing
+//                    1000 up to -max small objects against them
+//    picking         Casting rays through the screen at 1000 up to -max
+//                    copies of a mesh with a Picker, one at a time and
+//                    in pooled batches, against testing every object
+//    coherence       Frames of 1000 up to -max objects culled from scratch
+//                    and with FrustumCuller::CullCoherent(), for a still,
+//                    sliding and turning camera
+//    lod             A shaking camera drifting through 1000 up to -max
+//                    objects, picking their levels of detail with a
+//                    LodSelector, and how often levels change with and
+//                    without hysteresis
+//    scene           Generated scenes of 100 up to -max entities, static
+//                    and moving, run through a frame's update, world
+//                    matrix, culling, level of detail and draw list
+//                    stages for -frames frames, timing each one
+//    queue           Sorting 10000 up to -max draws' keys in a RenderQueue,
+//                    radix sort against std::sort, and the state
+//                    changes that saves
+//    instancing      Gathering 1000 up to -max sorted draws into
+//                    InstanceBatcher batches, and the draw calls and
+//                    bytes that saves against one draw each
+//    obj             Reading each OBJ model in -models with the old
+//                    getline/sscanf loop against MeshBuilder::LoadObj
+//                    (ObjParser) on one thread and on every core
+//    vcache          ACMR and ATVR before and after VertexCacheOptimizer
+//                    for the models in -models and for spheres and tori
+//                    made the way DirectXTK's Geometry.cpp makes them,
+//                    checking that the triangles are all still there
+//    loader          A batch of every model in -models through a
+//                    MeshLoader with 1 up to every core's workers, the
+//                    order mixed priorities come out in, and what
+//                    cancelling half of a batch saves
+//
+//  Options:
+//    -max <n>        Largest object count (default 1000000)
+//    -seconds <s>    Minimum time per measurement (default 0.25)
+//    -seed <n>       Seed for the scene benchmark's scenes (default 1)
+//    -frames <n>     Frames per scene benchmark run (default 100)
+//    -json <path>    Also write the scene benchmark's timings to a file
+//    -models <dir>   Where the model benchmarks find their OBJ files
+//                    (default Models, as seen from Engine/Debug)
+//
+//  None of the systems above make D3D calls, so they can be timed anywhere,
+//  and like MeshCooker this also builds on Linux:
+//    g++ -O2 -std=c++14 -I../DirectX11_Starter -I<DirectXMath> EngineBench.cpp
+//        ../DirectX11_Starter/TransformStore.cpp
+//        ../DirectX11_Starter/ThreadPool.cpp ../DirectX11_Starter/World.cpp
+//        ../DirectX11_Starter/Archetype.cpp ../DirectX11_Starter/Frustum.cpp
+//        ../DirectX11_Starter/FrustumCuller.cpp
+//        ../DirectX11_Starter/AabbTree.cpp
+//        ../DirectX11_Starter/SpatialGrid.cpp
+//        ../DirectX11_Starter/OcclusionCuller.cpp
+//        ../DirectX11_Starter/StaticBvh.cpp
+//        ../DirectX11_Starter/TriangleBvh.cpp
+//        ../DirectX11_Starter/Picker.cpp
+//        ../DirectX11_Starter/LodSelector.cpp
+//        ../DirectX11_Starter/SceneGenerator.cpp
+//        ../DirectX11_Starter/RenderQueue.cpp
+//        ../DirectX11_Starter/InstanceBatcher.cpp
+//        ../DirectX11_Starter/{MappedFile,ObjParser,MeshBuilder,
+//        VertexCacheOptimizer,OverdrawOptimizer,MeshSimplifier,
+//        MeshletBuilder,VertexCompressor}.cpp
+//        ../DirectX11_Starter/{CookedMesh,MeshCache,MeshLoader}.cpp -pthread
+// ----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <DirectXMath.h>
+#include "AabbTree.h"
+#include "FrustumCuller.h"
+#include "InstanceBatcher.h"
+#include "LodSelector.h"
+#include "MeshBuilder.h"
+#include "MeshLoader.h"
+#include "OcclusionCuller.h"
+#include "Picker.h"
+#include "RenderQueue.h"
+#include "SceneGenerator.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+#include "TransformStore.h"
+#include "World.h"
+
+using namespace DirectX;
+
+namespace
+{
+	struct BenchOptions
+	{
+		unsigned int maxCount;
+		double minSeconds;
+		unsigned int seed;
+		unsigned int frameCount;
+		std::string jsonPath;
+		std::string modelDirectory;
+	};
+
+	void PrintUsage()
+	{
+		printf("Usage: EngineBench [-max n] [-seconds s] [-seed n] [-frames n] [-json path] [-models dir] benchmark ...\n");
+		printf("Benchmarks: transforms dirty hierarchy ecs churn culling bvh grid occlusion picking coherence lod scene queue instancing\n");
+		printf("            obj vcache loader\n");
+	}
+
+	// Small deterministic generator, so every run measures the same data
+	class Random
+	{
+	public:
+		Random(unsigned int seed) { state = seed * 2654435761u + 1; }
+		float Next(float low, float high)
+		{
+			state = state * 1664525u + 1013904223u;
+			return low + (high - low) * ((state >> 8) / 16777216.0f);
+		}
+	private:
+		unsigned int state;
+	};
+
+	// --------------------------------------------------------
+	// Runs a function until minSeconds have passed (at least
+	// twice, the first run only warms up) - returns the average
+	// seconds per run
+	// --------------------------------------------------------
+	template <typename Function>
+	double Measure(double minSeconds, Function function)
+	{
+		function();
+
+		unsigned int runs = 0;
+		double total = 0.0;
+		while (runs < 1 || total < minSeconds)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			function();
+			total += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			runs++;
+		}
+		return total / runs;
+	}
+
+	// What Entity used to hold, allocated one at a time and
+	// reached through an array of pointers like Main's entities
+	struct LegacyTransform
+	{
+		XMFLOAT3 position;
+		XMFLOAT3 rotation;
+		XMFLOAT3 scale;
+		XMFLOAT4X4 worldMatrix;
+	};
+
+	// Entity::updateScene() before the transform store
+	void UpdateLegacy(LegacyTransform* t)
+	{
+		XMMATRIX trans = XMMatrixTranslation(t->position.x, t->position.y, t->position.z);
+		XMMATRIX rotX = XMMatrixRotationX(t->rotation.x);
+		XMMATRIX rotY = XMMatrixRotationY(t->rotation.y);
+		XMMATRIX rotZ = XMMatrixRotationZ(t->rotation.z);
+		XMMATRIX sc = XMMatrixScaling(t->scale.x, t->scale.y, t->scale.z);
+
+		XMMATRIX total = sc * rotZ * rotY * rotX * trans;
+		XMStoreFloat4x4(&t->worldMatrix, XMMatrixTranspose(total));
+	}
+
+	// --------------------------------------------------------
+	// World matrices per second at growing object counts - the
+	// SoA kernels should stay flat per object until the arrays
+	// fall out of cache, the legacy path falls off sooner
+	// --------------------------------------------------------
+	void BenchmarkTransforms(const BenchOptions& options)
+	{
+		const TransformKernel kernels[] = { TRANSFORM_KERNEL_SCALAR, TRANSFORM_KERNEL_SSE, TRANSFORM_KERNEL_AVX };
+
+		printf("transforms: ns per world matrix\n");
+		printf("  %10s %10s %10s %10s %10s %10s\n", "objects", "legacy", "scalar", "sse", "avx", "speedup");
+
+		for (unsigned int count = 100; count <= options.maxCount; count *= 10)
+		{
+			Random random(count);
+			TransformStore store;
+			store.Reserve(count);
+			std::vector<LegacyTransform*> legacy(count);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				XMFLOAT3 position(random.Next(-100, 100), random.Next(-100, 100), random.Next(-100, 100));
+				XMFLOAT3 rotation(random.Next(-3, 3), random.Next(-3, 3), random.Next(-3, 3));
+				XMFLOAT3 scale(random.Next(0.5f, 2), random.Next(0.5f, 2), random.Next(0.5f, 2));
+
+				store.Add(position, TransformStore::QuaternionFromEuler(rotation.x, rotation.y, rotation.z), scale);
+				legacy[i] = new LegacyTransform();
+				legacy[i]->position = position;
+				legacy[i]->rotation = rotation;
+				legacy[i]->scale = scale;
+			}
+
+			double legacySeconds = Measure(options.minSeconds, [&]()
+			{
+				for (auto t : legacy)
+					UpdateLegacy(t);
+			});
+
+			double kernelSeconds[3] = {};
+			double best = legacySeconds;
+			for (int k = 0; k < 3; k++)
+			{
+				if (!TransformStore::IsKernelSupported(kernels[k]))
+					continue;
+				kernelSeconds[k] = Measure(options.minSeconds, [&]() { store.UpdateWorldMatrices(nullptr, kernels[k]); });
+				best = std::min(best, kernelSeconds[k]);
+			}
+
+			printf("  %10u %10.2f", count, legacySeconds * 1e9 / count);
+			for (int k = 0; k < 3; k++)
+			{
+				if (kernelSeconds[k] > 0.0)
+					printf(" %10.2f", kernelSeconds[k] * 1e9 / count);
+				else
+					printf(" %10s", "n/a");
+			}
+			printf(" %9.1fx\n", legacySeconds / best);
+
+			for (auto t : legacy)
+				delete t;
+		}
+	}
+
+	// --------------------------------------------------------
+	// Builds count transforms where each level holds branching
+	// times as many as the one above, until there are no more
+	// - branching 1 with several roots gives chains, a big one
+	//   gives a shallow, wide tree
+	// --------------------------------------------------------
+	void BuildHierarchy(TransformStore& store, unsigned int count, unsigned int roots, unsigned int branching)
+	{
+		Random random(count + branching);
+		store.Reserve(count);
+
+		std::vector<unsigned int> level;
+		for (unsigned int i = 0; i < roots && i < count; i++)
+			level.push_back(store.Add(XMFLOAT3(random.Next(-100, 100), 0, random.Next(-100, 100))));
+
+		unsigned int added = (unsigned int)level.size();
+		while (added < count)
+		{
+			std::vector<unsigned int> next;
+			for (unsigned int parent : level)
+			{
+				for (unsigned int b = 0; b < branching && added < count; b++, added++)
+				{
+					XMFLOAT3 position(random.Next(-2, 2), random.Next(-2, 2), random.Next(-2, 2));
+					unsigned int child = store.Add(position, TransformStore::QuaternionFromEuler(0, random.Next(-0.2f, 0.2f), 0));
+					store.SetParent(child, parent);
+					next.push_back(child);
+				}
+			}
+			level.swap(next);
+		}
+		store.UpdateWorldMatrices();
+	}
+
+	// --------------------------------------------------------
+	// Moves a share of the objects each frame, then rebuilds -
+	// only the changed share should cost anything
+	// - Once with no hierarchy, and once with the objects under
+	//   parents 4 levels deep, where what moved drags its
+	//   children along
+	// --------------------------------------------------------
+	void BenchmarkDirty(const BenchOptions& options)
+	{
+		const float movingShares[] = { 0.0f, 0.001f, 0.01f, 0.1f, 0.5f, 1.0f };
+		unsigned int count = options.maxCount;
+
+		for (int hierarchy = 0; hierarchy < 2; hierarchy++)
+		{
+			Random random(count);
+			TransformStore store;
+			if (hierarchy)
+			{
+				BuildHierarchy(store, count, std::max(1u, count / 85), 4);
+			}
+			else
+			{
+				store.Reserve(count);
+				for (unsigned int i = 0; i < count; i++)
+				{
+					XMFLOAT3 position(random.Next(-100, 100), random.Next(-100, 100), random.Next(-100, 100));
+					store.Add(position, TransformStore::QuaternionFromEuler(random.Next(-3, 3), random.Next(-3, 3), random.Next(-3, 3)));
+				}
+			}
+			store.UpdateDirtyWorldMatrices();
+
+			printf("dirty: %u objects, %u levels, ms per frame\n", count, store.GetLevelCount());
+			printf("  %10s %10s %10s %10s %10s\n", "moving", "changed", "all", "dirty", "speedup");
+
+			for (float share : movingShares)
+			{
+				// The same scattered objects move every frame
+				unsigned int moving = (unsigned int)(count * share);
+				std::vector<unsigned int> movers(moving);
+				for (unsigned int i = 0; i < moving; i++)
+					movers[i] = (unsigned int)random.Next(0, (float)count) % count;
+
+				auto moveSome = [&]()
+				{
+					for (unsigned int index : movers)
+					{
+						XMFLOAT3 position = store.GetPosition(index);
+						position.x += 0.01f;
+						store.SetPosition(index, position);
+					}
+				};
+
+				double allSeconds = Measure(options.minSeconds, [&]()
+				{
+					moveSome();
+					store.UpdateWorldMatrices();
+				});
+				unsigned int changed = 0;
+				double dirtySeconds = Measure(options.minSeconds, [&]()
+				{
+					moveSome();
+					changed = store.UpdateDirtyWorldMatrices();
+				});
+
+				printf("  %9.1f%% %10u %10.3f %10.3f %9.1fx\n", share * 100.0f, changed,
+					allSeconds * 1e3, dirtySeconds * 1e3, allSeconds / dirtySeconds);
+			}
+		}
+	}
+
+	void BenchmarkHierarchy(const BenchOptions& options)
+	{
+		struct Shape
+		{
+			const char* name;
+			unsigned int roots;
+			unsigned int branching;
+		};
+		const Shape shapes[] = {
+			{ "flat", options.maxCount, 1 },
+			{ "deep", 1000, 1 },
+			{ "wide", 10, 64 },
+			{ "binary", 1, 2 },
+		};
+
+		ThreadPool pool;
+		unsigned int count = options.maxCount;
+
+		printf("hierarchy: %u objects, %u threads, ms per update\n", count, pool.GetThreadCount());
+		printf("  %8s %8s %10s %10s %10s %10s %12s\n", "shape", "levels", "1 thread", "pool", "speedup", "root moved", "reparent us");
+
+		for (const Shape& shape : shapes)
+		{
+			TransformStore store;
+			BuildHierarchy(store, count, shape.roots, shape.branching);
+
+			double singleSeconds = Measure(options.minSeconds, [&]() { store.UpdateWorldMatrices(); });
+			double poolSeconds = Measure(options.minSeconds, [&]() { store.UpdateWorldMatrices(&pool); });
+
+			// Moving the first root drags its whole subtree along
+			double rootSeconds = Measure(options.minSeconds, [&]()
+			{
+				XMFLOAT3 position = store.GetPosition(0);
+				position.x += 0.01f;
+				store.SetPosition(0, position);
+				store.UpdateDirtyWorldMatrices(&pool);
+			});
+
+			// Moves leaves between parents at other depths, so their
+			// level changes too
+			Random random(count);
+			const unsigned int moves = 1000;
+			std::vector<unsigned int> picks(moves * 2);
+			for (auto& pick : picks)
+				pick = (unsigned int)random.Next(0, (float)count) % count;
+			unsigned int next = 0;
+
+			// The first parent turns the hierarchy on for "flat", which
+			// is a one-off copy - not what a reparent costs after that
+			store.SetParent(count - 1, 0);
+			auto start = std::chrono::high_resolution_clock::now();
+			for (unsigned int i = 0; i < moves; i++, next += 2)
+				store.SetParent(count - 1 - picks[next] % (count / 4 + 1), picks[next + 1] % (count / 4 + 1));
+			double reparentSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / moves;
+
+			printf("  %8s %8u %10.3f %10.3f %9.1fx %10.3f %12.3f\n", shape.name, store.GetLevelCount(),
+				singleSeconds * 1e3, poolSeconds * 1e3, singleSeconds / poolSeconds, rootSeconds * 1e3, reparentSeconds * 1e6);
+		}
+	}
+
+	// Components for the ecs benchmark - the usual position and
+	// velocity, plus something rarely touched that legacy objects
+	// drag through the cache with them
+	struct Position { float x, y, z; };
+	struct Velocity { float x, y, z; };
+	struct Health { float current, maximum; };
+	struct Frozen {};
+	struct Cold { float data[16]; };
+
+	struct LegacyObject
+	{
+		Position position;
+		Velocity velocity;
+		Health health;
+		Cold cold;
+	};
+
+	// --------------------------------------------------------
+	// Per entity costs of the common operations - the World's
+	// update should stay flat as the count grows, since it's a
+	// linear walk over just the arrays it needs
+	// --------------------------------------------------------
+	void BenchmarkEcs(const BenchOptions& options)
+	{
+		printf("ecs: ns per entity\n");
+		printf("  %10s %10s %10s %10s %10s %10s %10s\n", "entities", "legacy new", "create", "legacy upd", "update", "add+remove", "destroy");
+
+		for (unsigned int count = 1000; count <= options.maxCount; count *= 10)
+		{
+			Random random(count);
+			std::vector<LegacyObject*> legacy(count);
+			double legacyCreateSeconds = Measure(options.minSeconds, [&]()
+			{
+				for (auto& object : legacy)
+					delete object;
+				for (unsigned int i = 0; i < count; i++)
+				{
+					legacy[i] = new LegacyObject();
+					legacy[i]->velocity = Velocity{ 1, 0, 0 };
+				}
+			});
+
+			// Create and destroy everything each run - after the first,
+			// the chunks are spares being reused
+			World world;
+			world.Reserve(count);
+			std::vector<EntityId> ids(count);
+			double createSeconds = Measure(options.minSeconds, [&]()
+			{
+				world.Clear();
+				for (unsigned int i = 0; i < count; i++)
+					ids[i] = world.Create(Position{ random.Next(-1, 1), 0, 0 }, Velocity{ 1, 0, 0 }, Health{ 1, 1 }, Cold());
+			});
+
+			const float deltaTime = 1.0f / 60.0f;
+			double legacyUpdateSeconds = Measure(options.minSeconds, [&]()
+			{
+				for (auto object : legacy)
+				{
+					object->position.x += object->velocity.x * deltaTime;
+					object->position.y += object->velocity.y * deltaTime;
+					object->position.z += object->velocity.z * deltaTime;
+				}
+			});
+			double updateSeconds = Measure(options.minSeconds, [&]()
+			{
+				world.ForEachChunk<Position, Velocity>([deltaTime](unsigned int chunkCount, const EntityId*, Position* positions, Velocity* velocities)
+				{
+					for (unsigned int i = 0; i < chunkCount; i++)
+					{
+						positions[i].x += velocities[i].x * deltaTime;
+						positions[i].y += velocities[i].y * deltaTime;
+						positions[i].z += velocities[i].z * deltaTime;
+					}
+				});
+			});
+
+			// A tag on and off again moves the entity to another
+			// archetype and back
+			unsigned int toggles = std::min(count, 10000u);
+			double structuralSeconds = Measure(options.minSeconds, [&]()
+			{
+				for (unsigned int i = 0; i < toggles; i++)
+					world.Add<Frozen>(ids[i]);
+				for (unsigned int i = 0; i < toggles; i++)
+					world.Remove<Frozen>(ids[i]);
+			});
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (EntityId id : ids)
+				world.Destroy(id);
+			double destroySeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			printf("  %10u %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n", count,
+				legacyCreateSeconds * 1e9 / count, createSeconds * 1e9 / count,
+				legacyUpdateSeconds * 1e9 / count, updateSeconds * 1e9 / count,
+				structuralSeconds * 1e9 / toggles, destroySeconds * 1e9 / count);
+
+			for (auto object : legacy)
+				delete object;
+		}
+	}
+
+	// --------------------------------------------------------
+	// A frame of churn: despawn some random live entities,
+	// spawn as many new ones, then run the usual update over
+	// everything - the update shouldn't get slower as the frames
+	// go by, since despawning never leaves holes behind
+	// --------------------------------------------------------
+	void BenchmarkChurn(const BenchOptions& options)
+	{
+		const unsigned int churnCounts[] = { 1000, 5000, 20000 };
+		const unsigned int frames = 200;
+		const float deltaTime = 1.0f / 60.0f;
+		unsigned int count = options.maxCount;
+
+		printf("churn: %u live entities, %u frames, us per frame\n", count, frames);
+		printf("  %10s %12s %12s %12s %12s %10s\n", "churn", "legacy", "world", "legacy upd", "world upd", "stale ok");
+
+		for (unsigned int churn : churnCounts)
+		{
+			churn = std::min(churn, count);
+			Random random(churn);
+
+			// Legacy: a heap object per entity, despawned by pointer and
+			// swapped out of the array
+			std::vector<LegacyObject*> legacy(count);
+			for (auto& object : legacy)
+				object = new LegacyObject();
+
+			auto legacyStart = std::chrono::high_resolution_clock::now();
+			double legacyUpdateSeconds = 0.0;
+			for (unsigned int frame = 0; frame < frames; frame++)
+			{
+				for (unsigned int i = 0; i < churn; i++)
+				{
+					unsigned int victim = (unsigned int)random.Next(0, (float)legacy.size()) % legacy.size();
+					delete legacy[victim];
+					legacy[victim] = legacy.back();
+					legacy.pop_back();
+				}
+				for (unsigned int i = 0; i < churn; i++)
+				{
+					LegacyObject* object = new LegacyObject();
+					object->velocity = Velocity{ 1, 0, 0 };
+					legacy.push_back(object);
+				}
+
+				auto updateStart = std::chrono::high_resolution_clock::now();
+				for (auto object : legacy)
+					object->position.x += object->velocity.x * deltaTime;
+				legacyUpdateSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - updateStart).count();
+			}
+			double legacySeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - legacyStart).count();
+
+			// World: entities are handles, kept in a plain array here
+			// the way a game would keep them in its own structures
+			World world;
+			world.Reserve(count);
+			std::vector<EntityId> live(count);
+			for (auto& id : live)
+				id = world.Create(Position{ 0, 0, 0 }, Velocity{ 1, 0, 0 }, Health{ 1, 1 }, Cold());
+
+			std::vector<EntityId> despawned;
+			auto worldStart = std::chrono::high_resolution_clock::now();
+			double worldUpdateSeconds = 0.0;
+			for (unsigned int frame = 0; frame < frames; frame++)
+			{
+				for (unsigned int i = 0; i < churn; i++)
+				{
+					unsigned int victim = (unsigned int)random.Next(0, (float)live.size()) % live.size();
+					world.Destroy(live[victim]);
+					if (frame == 0)
+						despawned.push_back(live[victim]);
+					live[victim] = live.back();
+					live.pop_back();
+				}
+				for (unsigned int i = 0; i < churn; i++)
+					live.push_back(world.Create(Position{ 0, 0, 0 }, Velocity{ 1, 0, 0 }, Health{ 1, 1 }, Cold()));
+
+				auto updateStart = std::chrono::high_resolution_clock::now();
+				world.ForEachChunk<Position, Velocity>([deltaTime](unsigned int chunkCount, const EntityId*, Position* positions, Velocity* velocities)
+				{
+					for (unsigned int i = 0; i < chunkCount; i++)
+						positions[i].x += velocities[i].x * deltaTime;
+				});
+				worldUpdateSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - updateStart).count();
+			}
+			double worldSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - worldStart).count();
+
+			// Ids from the first frame must still be dead, even though
+			// their slots have long been reused
+			bool staleDetected = true;
+			for (EntityId id : despawned)
+				staleDetected = staleDetected && !world.IsAlive(id);
+
+			printf("  %10u %12.1f %12.1f %12.1f %12.1f %10s\n", churn,
+				legacySeconds * 1e6 / frames, worldSeconds * 1e6 / frames,
+				legacyUpdateSeconds * 1e6 / frames, worldUpdateSeconds * 1e6 / frames, staleDetected ? "yes" : "NO");
+
+			for (auto object : legacy)
+				delete object;
+		}
+	}
+
+	// --------------------------------------------------------
+	// Objects spread through a cube around a camera, so about a
+	// tenth of them are visible - times moving the mesh bounds
+	// into world space, then each kernel's test
+	// --------------------------------------------------------
+	void BenchmarkCulling(const BenchOptions& options)
+	{
+		const CullKernel kernels[] = { CULL_KERNEL_SCALAR, CULL_KERNEL_SSE, CULL_KERNEL_AVX };
+
+		MeshBounds bounds;
+		bounds.min = XMFLOAT3(-1, -1, -1);
+		bounds.max = XMFLOAT3(1, 1, 1);
+		bounds.center = XMFLOAT3(0, 0, 0);
+		bounds.radius = 1.7320508f;
+
+		Frustum frustum = Frustum::FromPerspective(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), XMFLOAT3(0, 1, 0),
+			0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+		printf("culling: ns per object\n");
+		printf("  %10s %10s %10s %10s %10s %10s %10s\n", "objects", "visible", "bounds", "scalar", "sse", "avx", "speedup");
+
+		for (unsigned int count = 1000; count <= options.maxCount; count *= 10)
+		{
+			Random random(count);
+			TransformStore store;
+			store.Reserve(count);
+			float spread = 1000.0f;
+			for (unsigned int i = 0; i < count; i++)
+			{
+				XMFLOAT3 position(random.Next(-spread, spread), random.Next(-spread, spread), random.Next(-spread, spread));
+				store.Add(position, TransformStore::QuaternionFromEuler(random.Next(-3, 3), random.Next(-3, 3), random.Next(-3, 3)),
+					XMFLOAT3(random.Next(0.5f, 4), random.Next(0.5f, 4), random.Next(0.5f, 4)));
+			}
+			store.UpdateWorldMatrices();
+
+			FrustumCuller culler;
+			culler.Reserve(count);
+			double boundsSeconds = Measure(options.minSeconds, [&]()
+			{
+				culler.Clear();
+				for (unsigned int i = 0; i < count; i++)
+					culler.Add(i, bounds, *store.GetWorldMatrix(i));
+			});
+
+			std::vector<unsigned int> visible;
+			double kernelSeconds[3] = {};
+			unsigned int visibleCounts[3] = {};
+			for (int k = 0; k < 3; k++)
+			{
+				if (!FrustumCuller::IsKernelSupported(kernels[k]))
+					continue;
+				kernelSeconds[k] = Measure(options.minSeconds, [&]() { visibleCounts[k] = culler.Cull(frustum, visible, kernels[k]); });
+			}
+
+			printf("  %10u %9.1f%% %10.2f", count, visibleCounts[0] * 100.0f / count, boundsSeconds * 1e9 / count);
+			double best = kernelSeconds[0];
+			for (int k = 0; k < 3; k++)
+			{
+				if (kernelSeconds[k] > 0.0)
+				{
+					printf(" %10.2f", kernelSeconds[k] * 1e9 / count);
+					best = std::min(best, kernelSeconds[k]);
+				}
+				else
+					printf(" %10s", "n/a");
+
+				// Every kernel has to find the same objects
+				if (kernelSeconds[k] > 0.0 && visibleCounts[k] != visibleCounts[0])
+					printf(" (mismatch)");
+			}
+			printf(" %9.1fx\n", kernelSeconds[0] / best);
+		}
+	}
+
+	// The brute force versions of AabbTree's queries
+	bool InsideFrustum(const Frustum& frustum, const Aabb& b)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			const XMFLOAT4& plane = frustum.planes[p];
+			XMFLOAT3 center((b.min.x + b.max.x) * 0.5f, (b.min.y + b.max.y) * 0.5f, (b.min.z + b.max.z) * 0.5f);
+			XMFLOAT3 extents((b.max.x - b.min.x) * 0.5f, (b.max.y - b.min.y) * 0.5f, (b.max.z - b.min.z) * 0.5f);
+			float d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			float reach = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+			if (d + reach < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	bool TouchesSphere(const Aabb& b, const XMFLOAT3& center, float radius)
+	{
+		float dx = std::max(std::max(b.min.x - center.x, center.x - b.max.x), 0.0f);
+		float dy = std::max(std::max(b.min.y - center.y, center.y - b.max.y), 0.0f);
+		float dz = std::max(std::max(b.min.z - center.z, center.z - b.max.z), 0.0f);
+		return dx * dx + dy * dy + dz * dz <= radius * radius;
+	}
+
+	float RayDistance(const Aabb& b, const XMFLOAT3& origin, const XMFLOAT3& inverse, float maxDistance)
+	{
+		const float* o = &origin.x;
+		const float* i = &inverse.x;
+		const float* low = &b.min.x;
+		const float* high = &b.max.x;
+		float nearest = 0.0f;
+		float farthest = maxDistance;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float t1 = (low[axis] - o[axis]) * i[axis];
+			float t2 = (high[axis] - o[axis]) * i[axis];
+			nearest = std::max(nearest, std::min(t1, t2));
+			farthest = std::min(farthest, std::max(t1, t2));
+		}
+		return nearest <= farthest ? nearest : -1.0f;
+	}
+
+	// --------------------------------------------------------
+	// Boxes scattered through a cube - times inserting them all,
+	// a frame where a tenth of them move, and each kind of query,
+	// against looping over every box (the same fat boxes, so
+	// both have to find exactly the same ones)
+	// --------------------------------------------------------
+	void BenchmarkBvh(const BenchOptions& options)
+	{
+		const unsigned int queryCount = 100;
+		const float spread = 1000.0f;
+
+		Frustum frustum = Frustum::FromPerspective(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), XMFLOAT3(0, 1, 0),
+			0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+		printf("bvh: build and move in ns per object, queries in us per query (brute force in brackets)\n");
+		printf("  %10s %6s %8s %8s %20s %20s %20s %20s\n", "objects", "height", "build", "move", "frustum", "box", "sphere", "ray");
+
+		for (unsigned int count = 1000; count <= options.maxCount; count *= 10)
+		{
+			Random random(count);
+			std::vector<Aabb> boxes(count);
+			for (auto& box : boxes)
+			{
+				XMFLOAT3 center(random.Next(-spread, spread), random.Next(-spread, spread), random.Next(-spread, spread));
+				box = Aabb::FromSphere(center, random.Next(0.5f, 4.0f));
+			}
+
+			AabbTree tree(0.5f);
+			tree.Reserve(count);
+			std::vector<unsigned int> leaves(count);
+			double buildSeconds = Measure(options.minSeconds, [&]()
+			{
+				tree.Clear();
+				for (unsigned int i = 0; i < count; i++)
+					leaves[i] = tree.Insert(boxes[i], i);
+			});
+
+			// Every tenth object takes a step, some far enough to leave
+			// their fat box
+			unsigned int moved = 0;
+			double moveSeconds = Measure(options.minSeconds, [&]()
+			{
+				moved = 0;
+				for (unsigned int i = random.Next(0, 10) > 5 ? 0 : 1; i < count; i += 10, moved++)
+				{
+					float step = random.Next(-1.0f, 1.0f);
+					boxes[i].min.x += step;
+					boxes[i].max.x += step;
+					tree.Move(leaves[i], boxes[i]);
+				}
+			});
+
+			std::vector<Aabb> fat(count);
+			for (unsigned int i = 0; i < count; i++)
+				fat[i] = tree.GetFatBounds(leaves[i]);
+
+			std::vector<Aabb> queryBoxes(queryCount);
+			std::vector<XMFLOAT3> origins(queryCount);
+			std::vector<XMFLOAT3> directions(queryCount);
+			for (unsigned int q = 0; q < queryCount; q++)
+			{
+				origins[q] = XMFLOAT3(random.Next(-spread, spread), random.Next(-spread, spread), random.Next(-spread, spread));
+				queryBoxes[q] = Aabb::FromSphere(origins[q], 50.0f);
+				directions[q] = XMFLOAT3(random.Next(-1, 1), random.Next(-1, 1), random.Next(-1, 1));
+			}
+
+			std::vector<unsigned int> results;
+			unsigned int treeFound[4] = {};
+			unsigned int bruteFound[4] = {};
+			double treeSeconds[4];
+			double bruteSeconds[4];
+
+			treeSeconds[0] = Measure(options.minSeconds, [&]() { treeFound[0] = tree.QueryFrustum(frustum, results); });
+			bruteSeconds[0] = Measure(options.minSeconds, [&]()
+			{
+				bruteFound[0] = 0;
+				for (unsigned int i = 0; i < count; i++)
+					bruteFound[0] += InsideFrustum(frustum, fat[i]) ? 1 : 0;
+			});
+
+			treeSeconds[1] = Measure(options.minSeconds, [&]()
+			{
+				treeFound[1] = 0;
+				for (unsigned int q = 0; q < queryCount; q++)
+					treeFound[1] += tree.QueryAabb(queryBoxes[q], results);
+			}) / queryCount;
+			bruteSeconds[1] = Measure(options.minSeconds, [&]()
+			{
+				bruteFound[1] = 0;
+				for (unsigned int q = 0; q < queryCount; q++)
+				{
+					for (unsigned int i = 0; i < count; i++)
+						bruteFound[1] += fat[i].Overlaps(queryBoxes[q]) ? 1 : 0;
+				}
+			}) / queryCount;
+
+			treeSeconds[2] = Measure(options.minSeconds, [&]()
+			{
+				treeFound[2] = 0;
+				for (unsigned int q = 0; q < queryCount; q++)
+					treeFound[2] += tree.QuerySphere(origins[q], 50.0f, results);
+			}) / queryCount;
+			bruteSeconds[2] = Measure(options.minSeconds, [&]()
+			{
+				bruteFound[2] = 0;
+				for (unsigned int q = 0; q < queryCount; q++)
+				{
+					for (unsigned int i = 0; i < count; i++)
+						bruteFound[2] += TouchesSphere(fat[i], origins[q], 50.0f) ? 1 : 0;
+				}
+			}) / queryCount;
+
+			// Nearest hit along each ray - "found" counts rays that hit something
+			treeSeconds[3] = Measure(options.minSeconds, [&]()
+			{
+				treeFound[3] = 0;
+				for (unsigned int q = 0; q < queryCount; q++)
+				{
+					float nearest = spread * 4.0f;
+					bool hit = false;
+					tree.QueryRay(origins[q], directions[q], nearest, [&](unsigned int, float distance)
+					{
+						hit = true;
+						nearest = std::min(nearest, distance);
+						return nearest;
+					});
+					treeFound[3] += hit ? 1 : 0;
+				}
+			}) / queryCount;
+			bruteSeconds[3] = Measure(options.minSeconds, [&]()
+			{
+				bruteFound[3] = 0;
+				for (unsigned int q = 0; q < queryCount; q++)
+				{
+					XMFLOAT3 inverse(1.0f / directions[q].x, 1.0f / directions[q].y, 1.0f / directions[q].z);
+					bool hit = false;
+					for (unsigned int i = 0; i < count; i++)
+						hit = RayDistance(fat[i], origins[q], inverse, spread * 4.0f) >= 0.0f || hit;
+					bruteFound[3] += hit ? 1 : 0;
+				}
+			}) / queryCount;
+
+			printf("  %10u %6d %8.1f %8.1f", count, tree.GetHeight(), buildSeconds * 1e9 / count, moveSeconds * 1e9 / moved);
+			for (int q = 0; q < 4; q++)
+			{
+				char column[32];
+				snprintf(column, sizeof(column), "%.2f (%.1f)%s", treeSeconds[q] * 1e6, bruteSeconds[q] * 1e6,
+					treeFound[q] == bruteFound[q] ? "" : "!");
+				printf(" %20s", column);
+			}
+			printf("%s\n", tree.Validate() ? "" : " (invalid tree)");
+		}
+	}
+
+	// --------------------------------------------------------
+	// Particles about one per cell, all of them moving every
+	// frame - a grid rebuild against moving each one in an
+	// AabbTree, then radius, frustum and neighbour queries
+	// against testing every particle (which has to find the
+	// same ones)
+	// --------------------------------------------------------
+	void BenchmarkGrid(const BenchOptions& options)
+	{
+		const unsigned int queryCount = 100;
+		const float cellSize = 4.0f;
+		const float queryRadius = 8.0f;
+
+		ThreadPool pool;
+
+		printf("grid: build and move in ns per particle, queries in us per query (brute force in brackets), %u threads\n",
+			pool.GetThreadCount());
+		printf("  %10s %8s %8s %8s %18s %20s %10s\n", "objects", "build", "pooled", "tree", "radius", "frustum", "neighbours");
+
+		for (unsigned int count = 1000; count <= options.maxCount; count *= 10)
+		{
+			Random random(count);
+			float half = cbrtf((float)count) * cellSize * 0.5f;
+			std::vector<XMFLOAT3> positions(count);
+			std::vector<float> radii(count);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				positions[i] = XMFLOAT3(random.Next(-half, half), random.Next(-half, half), random.Next(-half, half));
+				radii[i] = random.Next(0.1f, 1.0f);
+			}
+
+			// Every particle takes a small step each frame
+			auto step = [&]()
+			{
+				for (unsigned int i = 0; i < count; i++)
+				{
+					positions[i].x += random.Next(-0.25f, 0.25f);
+					positions[i].y += random.Next(-0.25f, 0.25f);
+					positions[i].z += random.Next(-0.25f, 0.25f);
+				}
+			};
+
+			SpatialGrid grid(cellSize);
+			double buildSeconds = Measure(options.minSeconds, [&]() { step(); grid.Build(&positions[0], &radii[0], count); });
+			double pooledSeconds = Measure(options.minSeconds, [&]() { step(); grid.Build(&positions[0], &radii[0], count, &pool); });
+
+			AabbTree tree(0.5f);
+			tree.Reserve(count);
+			std::vector<unsigned int> leaves(count);
+			for (unsigned int i = 0; i < count; i++)
+				leaves[i] = tree.Insert(Aabb::FromSphere(positions[i], radii[i]), i);
+			double treeSeconds = Measure(options.minSeconds, [&]()
+			{
+				step();
+				for (unsigned int i = 0; i < count; i++)
+					tree.Move(leaves[i], Aabb::FromSphere(positions[i], radii[i]));
+			});
+
+			// Stepping is timed on its own and taken off the numbers above,
+			// then the grid catches up with where everything ended up
+			double stepSeconds = Measure(options.minSeconds, step);
+			buildSeconds -= stepSeconds;
+			pooledSeconds -= stepSeconds;
+			treeSeconds -= stepSeconds;
+			grid.Build(&positions[0], &radii[0], count, &pool);
+
+			std::vector<XMFLOAT3> centers(queryCount);
+			for (auto& center : centers)
+				center = XMFLOAT3(random.Next(-half, half), random.Next(-half, half), random.Next(-half, half));
+
+			Frustum frustum = Frustum::FromPerspective(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), XMFLOAT3(0, 1, 0),
+				0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, half);
+
+			std::vector<unsigned int> results;
+			unsigned int gridFound[2] = {};
+			unsigned int bruteFound[2] = {};
+			double gridSeconds[2];
+			double bruteSeconds[2];
+
+			gridSeconds[0] = Measure(options.minSeconds, [&]()
+			{
+				gridFound[0] = 0;
+				for (auto& center : centers)
+					gridFound[0] += grid.QueryRadius(center, queryRadius, results);
+			}) / queryCount;
+			bruteSeconds[0] = Measure(options.minSeconds, [&]()
+			{
+				bruteFound[0] = 0;
+				for (auto& center : centers)
+				{
+					for (unsigned int i = 0; i < count; i++)
+					{
+						float dx = positions[i].x - center.x;
+						float dy = positions[i].y - center.y;
+						float dz = positions[i].z - center.z;
+						float touch = queryRadius + radii[i];
+						bruteFound[0] += dx * dx + dy * dy + dz * dz <= touch * touch ? 1 : 0;
+					}
+				}
+			}) / queryCount;
+
+			gridSeconds[1] = Measure(options.minSeconds, [&]() { gridFound[1] = grid.QueryFrustum(frustum, results); });
+			bruteSeconds[1] = Measure(options.minSeconds, [&]()
+			{
+				bruteFound[1] = 0;
+				for (unsigned int i = 0; i < count; i++)
+					bruteFound[1] += frustum.IntersectsSphere(positions[i], radii[i]) ? 1 : 0;
+			});
+
+			double neighbourSeconds = Measure(options.minSeconds, [&]()
+			{
+				for (auto& center : centers)
+					grid.QueryNeighbours(center, results);
+			}) / queryCount;
+
+			printf("  %10u %8.1f %8.1f %8.1f", count, buildSeconds * 1e9 / count, pooledSeconds * 1e9 / count, treeSeconds * 1e9 / count);
+			int widths[2] = { 18, 20 };
+			for (int q = 0; q < 2; q++)
+			{
+				char column[32];
+				snprintf(column, sizeof(column), "%.2f (%.1f)%s", gridSeconds[q] * 1e6, bruteSeconds[q] * 1e6,
+					gridFound[q] == bruteFound[q] ? "" : "!");
+				printf(" %*s", widths[q], column);
+			}
+			printf(" %10.2f\n", neighbourSeconds * 1e6);
+		}
+	}
+	// --------------------------------------------------------
+	// A race track seen from the driver's seat - ground, trackside
+	// barriers and grandstands as occluders, and 1000 up to -max
+	// small boxes (cones, signs, spectators) scattered over it
+	// - Rendering the occluders with every kernel, on one thread
+	//   and on a ThreadPool, then testing what the frustum lets
+	//   through against them
+	// --------------------------------------------------------
+	void BenchmarkOcclusion(const BenchOptions& options)
+	{
+		const OcclusionKernel kernels[] = { OCCLUSION_KERNEL_SCALAR, OCCLUSION_KERNEL_SSE41, OCCLUSION_KERNEL_AVX2 };
+		const float half = 300.0f;
+
+		// A unit box and a ground quad, placed with world matrices
+		OccluderMesh box;
+		for (int i = 0; i < 8; i++)
+			box.positions.push_back(XMFLOAT3(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f));
+		const unsigned int boxFaces[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+		for (auto& face : boxFaces)
+		{
+			unsigned int quad[6] = { face[0], face[1], face[2], face[0], face[2], face[3] };
+			box.indices.insert(box.indices.end(), quad, quad + 6);
+		}
+
+		OccluderMesh ground;
+		ground.positions.push_back(XMFLOAT3(-1, 0, -1));
+		ground.positions.push_back(XMFLOAT3(-1, 0, 1));
+		ground.positions.push_back(XMFLOAT3(1, 0, 1));
+		ground.positions.push_back(XMFLOAT3(1, 0, -1));
+		unsigned int groundQuad[6] = { 0, 1, 2, 0, 2, 3 };
+		ground.indices.assign(groundQuad, groundQuad + 6);
+
+		auto place = [](XMFLOAT3 scale, float yaw, XMFLOAT3 position)
+		{
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, XMMatrixTranspose(XMMatrixScaling(scale.x, scale.y, scale.z) * XMMatrixRotationY(yaw) *
+				XMMatrixTranslation(position.x, position.y, position.z)));
+			return world;
+		};
+
+		Random random(7);
+		std::vector<XMFLOAT4X4> occluderWorlds;
+		XMFLOAT4X4 groundWorld = place(XMFLOAT3(half, 1, half), 0, XMFLOAT3(0, 0, 0));
+
+		// Barriers about head height along the track, and a few
+		// grandstands well above it - the camera sits at the origin,
+		// on a clear stretch
+		while (occluderWorlds.size() < 312)
+		{
+			bool stand = occluderWorlds.size() >= 300;
+			float height = stand ? random.Next(10, 16) : random.Next(1, 3);
+			XMFLOAT3 scale = stand ? XMFLOAT3(random.Next(30, 60), height, 12) : XMFLOAT3(random.Next(8, 30), height, 0.5f);
+			float yaw = random.Next(-3.14f, 3.14f);
+			XMFLOAT3 position(random.Next(-half, half), height * 0.5f, random.Next(-half, half));
+			if (position.x * position.x + position.z * position.z > (scale.x + 20) * (scale.x + 20) * 0.25f)
+				occluderWorlds.push_back(place(scale, yaw, position));
+		}
+
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixTranslation(0, -1.7f, 0) *
+			XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 1000.0f));
+		Frustum frustum = Frustum::FromMatrix(viewProjection);
+
+		ThreadPool pool;
+		OcclusionCuller occlusion;
+		unsigned int triangles = 0;
+		auto render = [&](ThreadPool* threads, OcclusionKernel kernel)
+		{
+			occlusion.BeginFrame(viewProjection);
+			occlusion.AddOccluder(ground, groundWorld);
+			for (auto& world : occluderWorlds)
+				occlusion.AddOccluder(box, world);
+			triangles = occlusion.RenderOccluders(threads, kernel);
+		};
+
+		// Every kernel has to draw exactly the same depths
+		double renderSeconds[4] = {};
+		std::vector<float> firstDepths;
+		bool mismatch = false;
+		for (int k = 0; k < 3; k++)
+		{
+			if (!OcclusionCuller::IsKernelSupported(kernels[k]))
+				continue;
+			renderSeconds[k] = Measure(options.minSeconds, [&]() { render(nullptr, kernels[k]); });
+			std::vector<float> depths(occlusion.GetTileDepths(), occlusion.GetTileDepths() + occlusion.GetTilesX() * occlusion.GetTilesY());
+			if (firstDepths.empty())
+				firstDepths = depths;
+			else if (depths != firstDepths)
+				mismatch = true;
+		}
+		renderSeconds[3] = Measure(options.minSeconds, [&]() { render(&pool, OCCLUSION_KERNEL_BEST); });
+
+		printf("occlusion: %ux%u depth buffer, %u occluders, %u triangles on screen, %u threads\n", occlusion.GetWidth(),
+			occlusion.GetHeight(), occlusion.GetOccluderCount(), triangles, pool.GetThreadCount());
+		printf("  render ms per frame:");
+		const char* names[] = { "scalar", "sse41", "avx2", "pooled" };
+		for (int k = 0; k < 4; k++)
+		{
+			if (renderSeconds[k] > 0.0)
+				printf(" %s %.3f", names[k], renderSeconds[k] * 1e3);
+			else
+				printf(" %s n/a", names[k]);
+		}
+		printf("%s\n", mismatch ? " (mismatch)" : "");
+		printf("  %10s %10s %10s %10s %10s %12s\n", "objects", "frustum", "occluded", "test ms", "pooled ms", "ns per box");
+
+		std::vector<unsigned int> visible;
+		for (unsigned int count = 1000; count <= options.maxCount; count *= 10)
+		{
+			// What's left after frustum culling is what gets tested
+			std::vector<Aabb> bounds;
+			std::vector<unsigned int> ids;
+			for (unsigned int i = 0; i < count; i++)
+			{
+				float size = random.Next(0.3f, 1.5f);
+				XMFLOAT3 center(random.Next(-half, half), size * 0.5f, random.Next(-half, half));
+				Aabb b;
+				b.min = XMFLOAT3(center.x - size * 0.5f, 0.0f, center.z - size * 0.5f);
+				b.max = XMFLOAT3(center.x + size * 0.5f, size, center.z + size * 0.5f);
+				if (InsideFrustum(frustum, b))
+				{
+					bounds.push_back(b);
+					ids.push_back(i);
+				}
+			}
+			unsigned int tested = (unsigned int)bounds.size();
+			if (tested == 0)
+				continue;
+
+			unsigned int kept[2] = {};
+			double testSeconds = Measure(options.minSeconds, [&]() { kept[0] = occlusion.Cull(&bounds[0], &ids[0], tested, visible); });
+			double pooledSeconds = Measure(options.minSeconds, [&]() { kept[1] = occlusion.Cull(&bounds[0], &ids[0], tested, visible, &pool); });
+
+			printf("  %10u %9.1f%% %9.1f%% %10.3f %10.3f %12.1f%s\n", count, tested * 100.0f / count,
+				(tested - kept[0]) * 100.0f / tested, testSeconds * 1e3, pooledSeconds * 1e3, testSeconds * 1e9 / tested,
+				kept[0] == kept[1] ? "" : " (mismatch)");
+		}
+	}
+	// --------------------------------------------------------
+	// Clicking on 1000 up to -max copies of one 20000 triangle
+	// mesh in front of the camera - rays through random pixels,
+	// one at a time and as a pooled batch, against testing every
+	// object's box (and the triangles of the ones it hits)
+	// --------------------------------------------------------
+	void BenchmarkPicking(const BenchOptions& options)
+	{
+		const unsigned int rayCount = 1000;
+		const unsigned int bruteRayCount = 100;
+
+		// A sphere, as rings of quads
+		const int rings = 100;
+		const int segments = 100;
+		std::vector<XMFLOAT3> positions;
+		std::vector<unsigned int> indices;
+		for (int r = 0; r <= rings; r++)
+		{
+			for (int s = 0; s <= segments; s++)
+			{
+				float theta = 3.1415926535f * r / rings;
+				float phi = 2.0f * 3.1415926535f * s / segments;
+				positions.push_back(XMFLOAT3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)));
+			}
+		}
+		for (int r = 0; r < rings; r++)
+		{
+			for (int s = 0; s < segments; s++)
+			{
+				unsigned int a = r * (segments + 1) + s;
+				unsigned int b = a + segments + 1;
+				unsigned int quad[6] = { a, b, a + 1, a + 1, b, b + 1 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+
+		TriangleBvh triangles;
+		double meshSeconds = Measure(options.minSeconds, [&]()
+		{
+			triangles.Build(&positions[0], sizeof(XMFLOAT3), &indices[0], (unsigned int)indices.size());
+		});
+
+		MeshBounds bounds;
+		bounds.min = XMFLOAT3(-1, -1, -1);
+		bounds.max = XMFLOAT3(1, 1, 1);
+		bounds.center = XMFLOAT3(0, 0, 0);
+		bounds.radius = 1.7320508f;
+
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 1000.0f));
+
+		ThreadPool pool;
+		printf("picking: %u triangle mesh, its TriangleBvh built in %.2f ms (%u nodes), %u threads\n",
+			triangles.GetTriangleCount(), meshSeconds * 1e3, triangles.GetNodeCount(), pool.GetThreadCount());
+		printf("  %10s %10s %10s %12s %12s %14s\n", "objects", "build ms", "hit", "us per ray", "batch us", "brute us");
+
+		for (unsigned int count = 1000; count <= options.maxCount; count *= 10)
+		{
+			// Spread out so about as many rays miss as hit
+			Random random(count);
+			float spread = cbrtf((float)count) * 4.0f;
+			std::vector<XMFLOAT4X4> worlds(count);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				float z = random.Next(5.0f, 5.0f + spread);
+				XMStoreFloat4x4(&worlds[i], XMMatrixTranspose(
+					XMMatrixScaling(random.Next(0.5f, 1.5f), random.Next(0.5f, 1.5f), random.Next(0.5f, 1.5f)) *
+					XMMatrixRotationY(random.Next(-3.14f, 3.14f)) *
+					XMMatrixTranslation(random.Next(-z, z) * 0.4f, random.Next(-z, z) * 0.25f, z)));
+			}
+
+			Picker picker;
+			std::vector<XMFLOAT3> origins(rayCount);
+			std::vector<XMFLOAT3> directions(rayCount);
+			for (unsigned int r = 0; r < rayCount; r++)
+			{
+				Picker::ScreenRay(random.Next(0, 1280), random.Next(0, 720), 1280, 720, viewProjection, origins[r], directions[r]);
+			}
+
+			std::vector<PickHit> hits(rayCount);
+			double buildSeconds = Measure(options.minSeconds, [&]()
+			{
+				picker.Clear();
+				picker.Reserve(count);
+				for (unsigned int i = 0; i < count; i++)
+					picker.Add(i, bounds, worlds[i], &triangles);
+				picker.Pick(origins[0], directions[0], hits[0]);
+			});
+
+			unsigned int hitCount = 0;
+			double pickSeconds = Measure(options.minSeconds, [&]()
+			{
+				hitCount = 0;
+				for (unsigned int r = 0; r < rayCount; r++)
+					hitCount += picker.Pick(origins[r], directions[r], hits[r]) ? 1 : 0;
+			}) / rayCount;
+			double batchSeconds = Measure(options.minSeconds, [&]()
+			{
+				picker.PickBatch(&origins[0], &directions[0], rayCount, &hits[0], FLT_MAX, &pool);
+			}) / rayCount;
+
+			// Every box, and the triangles behind each one hit - has
+			// to find the same objects
+			std::vector<Aabb> boxes(count);
+			std::vector<XMFLOAT4X4> inverses(count);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				boxes[i] = Aabb::FromBounds(bounds, worlds[i]);
+				XMMATRIX world = XMMatrixTranspose(XMLoadFloat4x4(&worlds[i]));
+				XMStoreFloat4x4(&inverses[i], XMMatrixTranspose(XMMatrixInverse(nullptr, world)));
+			}
+			bool mismatch = false;
+			double bruteSeconds = Measure(options.minSeconds, [&]()
+			{
+				for (unsigned int r = 0; r < bruteRayCount; r++)
+				{
+					const XMFLOAT3& o = origins[r];
+					const XMFLOAT3& d = directions[r];
+					XMFLOAT3 inverse(1.0f / d.x, 1.0f / d.y, 1.0f / d.z);
+					float nearest = FLT_MAX;
+					unsigned int nearestId = 0;
+					bool hit = false;
+					for (unsigned int i = 0; i < count; i++)
+					{
+						float distance;
+						if (!boxes[i].IntersectRay(o, inverse, nearest, distance))
+							continue;
+
+						const XMFLOAT4X4& m = inverses[i];
+						XMFLOAT3 localOrigin(m._11 * o.x + m._12 * o.y + m._13 * o.z + m._14,
+							m._21 * o.x + m._22 * o.y + m._23 * o.z + m._24, m._31 * o.x + m._32 * o.y + m._33 * o.z + m._34);
+						XMFLOAT3 localDirection(m._11 * d.x + m._12 * d.y + m._13 * d.z,
+							m._21 * d.x + m._22 * d.y + m._23 * d.z, m._31 * d.x + m._32 * d.y + m._33 * d.z);
+						unsigned int triangle;
+						if (triangles.IntersectRay(localOrigin, localDirection, nearest, distance, triangle))
+						{
+							nearest = distance;
+							nearestId = i;
+							hit = true;
+						}
+					}
+					if (hit != hits[r].hit || (hit && nearestId != hits[r].id))
+						mismatch = true;
+				}
+			}) / bruteRayCount;
+
+			printf("  %10u %10.2f %9.1f%% %12.2f %12.2f %14.2f%s\n", count, buildSeconds * 1e3, hitCount * 100.0f / rayCount,
+				pickSeconds * 1e6, batchSeconds * 1e6, bruteSeconds * 1e6, mismatch ? " (mismatch)" : "");
+		}
+	}
+
+	// --------------------------------------------------------
+	// 60 frames of 1000 up to -max objects, culled from scratch
+	// and with CullCoherent() - with the camera still, the camera
+	// sliding sideways while a tenth of the objects move, and the
+	// camera turning
+	// --------------------------------------------------------
+	void BenchmarkCoherence(const BenchOptions& options)
+	{
+		const int frameCount = 60;
+		const char* scenarios[] = { "still", "sliding", "turning" };
+
+		printf("coherence: ms per frame, hit rate is objects decided from the cache\n");
+		printf("  %10s %10s %10s %10s %10s %10s %10s %10s\n", "objects", "camera", "visible", "cull", "coherent", "hit rate",
+			"skipped", "extra");
+
+		for (unsigned int count = 1000; count <= options.maxCount; count *= 10)
+		{
+			for (int scenario = 0; scenario < 3; scenario++)
+			{
+				Random random(count);
+				float spread = 1000.0f;
+				std::vector<XMFLOAT3> centers(count);
+				std::vector<XMFLOAT3> extents(count);
+				for (unsigned int i = 0; i < count; i++)
+				{
+					centers[i] = XMFLOAT3(random.Next(-spread, spread), random.Next(-spread, spread), random.Next(-spread, spread));
+					extents[i] = XMFLOAT3(random.Next(0.5f, 4), random.Next(0.5f, 4), random.Next(0.5f, 4));
+				}
+
+				FrustumCuller culler;
+				culler.Reserve(count);
+				std::vector<unsigned int> visible;
+				std::vector<unsigned int> coherent;
+				double cullSeconds = 0.0;
+				double coherentSeconds = 0.0;
+				double hits = 0.0;
+				double skipped = 0.0;
+				double extra = 0.0;
+				unsigned int visibleTotal = 0;
+				XMFLOAT3 eye(0, 0, 0);
+				float yaw = 0.0f;
+
+				for (int frame = 0; frame < frameCount; frame++)
+				{
+					if (scenario == 1)
+					{
+						eye.x += 0.05f;
+						for (unsigned int i = frame % 10; i < count; i += 10)
+						{
+							centers[i].x += random.Next(-0.1f, 0.1f);
+							centers[i].z += random.Next(-0.1f, 0.1f);
+						}
+					}
+					else if (scenario == 2)
+						yaw += 0.01f;
+
+					culler.Clear();
+					for (unsigned int i = 0; i < count; i++)
+						culler.Add(i, centers[i], extents[i], sqrtf(extents[i].x * extents[i].x + extents[i].y * extents[i].y +
+							extents[i].z * extents[i].z));
+
+					Frustum frustum = Frustum::FromPerspective(eye, XMFLOAT3(sinf(yaw), 0, cosf(yaw)), XMFLOAT3(0, 1, 0),
+						0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+					auto start = std::chrono::high_resolution_clock::now();
+					culler.Cull(frustum, visible);
+					auto middle = std::chrono::high_resolution_clock::now();
+					culler.CullCoherent(frustum, coherent);
+					auto end = std::chrono::high_resolution_clock::now();
+
+					// The first frame fills the cache
+					if (frame == 0)
+						continue;
+					cullSeconds += std::chrono::duration<double>(middle - start).count();
+					coherentSeconds += std::chrono::duration<double>(end - middle).count();
+					CullCacheStats stats = culler.GetCacheStats();
+					hits += (double)(stats.reused + stats.planeHits) / count;
+					skipped += (double)stats.reused / count;
+					extra += (double)coherent.size() - visible.size();
+					visibleTotal += (unsigned int)visible.size();
+				}
+
+				int frames = frameCount - 1;
+				printf("  %10u %10s %9.1f%% %10.3f %10.3f %9.1f%% %9.1f%% %9.2f%%\n", count, scenarios[scenario],
+					visibleTotal * 100.0 / ((double)count * frames), cullSeconds * 1e3 / frames, coherentSeconds * 1e3 / frames,
+					hits * 100.0 / frames, skipped * 100.0 / frames, visibleTotal > 0 ? extra * 100.0 / visibleTotal : 0.0);
+			}
+		}
+	}
+
+	// --------------------------------------------------------
+	// 120 frames of a camera drifting through 1000 up to -max
+	// objects and shaking more than it moves, each frame's levels
+	// fed into the next and the kept ones listed as Main does -
+	// how long LodSelector takes, and how many objects change
+	// level per frame without a hysteresis band and with the
+	// default one
+	// --------------------------------------------------------
+	void BenchmarkLod(const BenchOptions& options)
+	{
+		const int frameCount = 120;
+		const int levelCount = 6;
+		const float band = 0.15f;
+		const float cullSize = 2.0f;
+		const float thresholds[] = { 320.0f, 160.0f, 80.0f, 40.0f, 20.0f, 10.0f, 5.0f };
+		const int thresholdCount = sizeof(thresholds) / sizeof(thresholds[0]);
+		const float height = 1080.0f;
+
+		XMFLOAT4X4 projection;
+		XMStoreFloat4x4(&projection, XMMatrixTranspose(XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 1000.0f)));
+
+		auto eyeAt = [](int frame)
+		{
+			return XMFLOAT3(0.5f * sinf(frame * 1.7f), 0.5f * cosf(frame * 2.3f), frame * 0.1f);
+		};
+
+		printf("lod: ns per object, changes are objects switching level per frame\n");
+		printf("  %10s %10s %10s %10s %10s\n", "objects", "culled", "select", "no band", "band");
+
+		for (unsigned int count = 1000; count <= options.maxCount; count *= 10)
+		{
+			Random random(count);
+			float spread = 1000.0f;
+			std::vector<XMFLOAT3> centers(count);
+			std::vector<float> radii(count);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				centers[i] = XMFLOAT3(random.Next(-spread, spread), random.Next(-spread, spread), random.Next(-spread, spread));
+				radii[i] = random.Next(0.5f, 4);
+			}
+
+			LodSelector selector;
+			selector.SetProjection(projection, height);
+			selector.SetThresholds(thresholds, thresholdCount);
+			selector.SetCullSize(cullSize);
+			std::vector<unsigned int> kept(count);
+			std::vector<int> current(count);
+			double changes[2] = {};
+			double selectSeconds = 0.0;
+			double culled = 0.0;
+			LodStats stats = LodStats();
+			for (int b = 0; b < 2; b++)
+			{
+				selector.SetHysteresis(b == 0 ? 0.0f : band);
+				std::fill(current.begin(), current.end(), 0);
+				for (int frame = 0; frame < frameCount; frame++)
+				{
+					auto start = std::chrono::high_resolution_clock::now();
+					selector.BeginFrame(eyeAt(frame));
+					unsigned int keptCount = 0;
+					for (unsigned int i = 0; i < count; i++)
+					{
+						current[i] = selector.Select(centers[i], radii[i], current[i], levelCount);
+						kept[keptCount] = i;
+						keptCount += current[i] != LodSelector::Culled ? 1 : 0;
+					}
+					auto end = std::chrono::high_resolution_clock::now();
+
+					// The first frame moves everything off level 0
+					if (frame == 0)
+						continue;
+					stats = selector.GetStats();
+					changes[b] += stats.changed;
+					if (b == 1)
+					{
+						selectSeconds += std::chrono::duration<double>(end - start).count();
+						culled += stats.culled;
+					}
+				}
+			}
+
+			int frames = frameCount - 1;
+			double perObject = 1e9 / ((double)count * frames);
+			printf("  %10u %9.1f%% %10.2f %10.1f %10.1f\n", count, culled * 100.0 / ((double)count * frames),
+				selectSeconds * perObject, changes[0] / frames, changes[1] / frames);
+
+			printf("  %10s", "levels");
+			for (int level = 0; level < levelCount; level++)
+				printf(" %10u", stats.levels[level]);
+			printf("\n");
+		}
+	}
+
+	// What the scene benchmark's entities carry, besides a
+	// MotionComponent when they move - Components.h needs D3D
+	struct SceneTransform { unsigned int index; };
+	struct SceneLook { unsigned int mesh, material; int lod; };
+
+	// One scenario at one entity count - each stage's mean and
+	// worst milliseconds per frame
+	struct SceneResult
+	{
+		static const int StageCount = 6;
+
+		const char* scenario;
+		SceneOptions scene;
+		unsigned int moving;
+		unsigned int checksum;
+		double visible;
+		double drawn;
+		double batches;
+		double meanMs[StageCount];
+		double maxMs[StageCount];
+	};
+
+	const char* SceneStageNames[SceneResult::StageCount] = { "update", "transforms", "cull", "lod", "submit", "total" };
+
+	void WriteSceneJson(const BenchOptions& options, const std::vector<SceneResult>& results)
+	{
+		FILE* file = fopen(options.jsonPath.c_str(), "w");
+		if (file == nullptr)
+		{
+			printf("Can't write %s\n", options.jsonPath.c_str());
+			return;
+		}
+
+		fprintf(file, "{\n  \"benchmark\": \"scene\",\n  \"seed\": %u,\n  \"frames\": %u,\n  \"runs\": [\n", options.seed, options.frameCount);
+		for (size_t r = 0; r < results.size(); r++)
+		{
+			const SceneResult& result = results[r];
+			fprintf(file, "    {\n");
+			fprintf(file, "      \"scenario\": \"%s\",\n", result.scenario);
+			fprintf(file, "      \"motion\": \"%s\",\n", SceneGenerator::GetMotionName(result.scene.motion));
+			fprintf(file, "      \"layout\": \"%s\",\n", SceneGenerator::GetLayoutName(result.scene.layout));
+			fprintf(file, "      \"entities\": %u,\n", result.scene.entityCount);
+			fprintf(file, "      \"moving\": %u,\n", result.moving);
+			fprintf(file, "      \"meshes\": %u,\n", result.scene.meshCount);
+			fprintf(file, "      \"materials\": %u,\n", result.scene.materialCount);
+			fprintf(file, "      \"checksum\": %u,\n", result.checksum);
+			fprintf(file, "      \"visible\": %.1f,\n", result.visible);
+			fprintf(file, "      \"drawn\": %.1f,\n", result.drawn);
+			fprintf(file, "      \"batches\": %.1f,\n", result.batches);
+			fprintf(file, "      \"stages\": {\n");
+			for (int s = 0; s < SceneResult::StageCount; s++)
+				fprintf(file, "        \"%s\": { \"mean_ms\": %.4f, \"max_ms\": %.4f }%s\n", SceneStageNames[s], result.meanMs[s],
+					result.maxMs[s], s + 1 < SceneResult::StageCount ? "," : "");
+			fprintf(file, "      }\n    }%s\n", r + 1 < results.size() ? "," : "");
+		}
+		fprintf(file, "  ]\n}\n");
+		fclose(file);
+		printf("  wrote %s\n", options.jsonPath.c_str());
+	}
+
+	// --------------------------------------------------------
+	// -frames frames of generated scenes of 100 up to -max
+	// entities, each going through the same stages as a frame of
+	// Main - moving what moves, rebuilding world matrices, frustum
+	// culling, picking levels of detail, sorting draws and
+	// batching them into instances - with a camera flying slowly
+	// over it all
+	// - Scenes come from SceneGenerator with -seed, so two runs
+	//   with the same options time the same scenes (the checksum
+	//   says so)
+	// - -json also writes every stage's timings to a file
+	// --------------------------------------------------------
+	void BenchmarkScene(const BenchOptions& options)
+	{
+		struct Scenario
+		{
+			const char* name;
+			SceneMotion motion;
+			float movingShare;
+			SceneLayout layout;
+			unsigned int meshCount;
+			unsigned int materialCount;
+		};
+		const Scenario scenarios[] =
+		{
+			{ "static", SCENE_MOTION_STATIC, 0.0f, SCENE_LAYOUT_GRID, 1, 1 },
+			{ "drift", SCENE_MOTION_DRIFT, 1.0f, SCENE_LAYOUT_UNIFORM, 4, 8 },
+			{ "orbit", SCENE_MOTION_ORBIT, 0.25f, SCENE_LAYOUT_CLUSTERED, 8, 16 },
+			{ "mixed", SCENE_MOTION_MIXED, 0.5f, SCENE_LAYOUT_CLUSTERED, 16, 64 },
+		};
+		const int levelCount = 4;
+		const float height = 1080.0f;
+		const float frameTime = 1.0f / 60.0f;
+
+		XMFLOAT4X4 projection;
+		XMStoreFloat4x4(&projection, XMMatrixTranspose(XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 1000.0f)));
+
+		ThreadPool pool;
+		std::vector<SceneResult> results;
+
+		printf("scene: ms per frame over %u frames, seed %u\n", options.frameCount, options.seed);
+		printf("  %10s %10s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "entities", "scenario", "visible", "drawn", "batches", "update",
+			"transforms", "cull", "lod", "submit", "total");
+
+		for (unsigned int count = 100; count <= options.maxCount; count *= 10)
+		{
+			for (const Scenario& scenario : scenarios)
+			{
+				SceneOptions scene;
+				scene.entityCount = count;
+				scene.seed = options.seed;
+				scene.motion = scenario.motion;
+				scene.movingShare = scenario.movingShare;
+				scene.layout = scenario.layout;
+				scene.meshCount = scenario.meshCount;
+				scene.materialCount = scenario.materialCount;
+
+				// Denser scenes spread out, so about as much is in view
+				scene.extent = std::max(50.0f, sqrtf((float)count) * 5.0f);
+
+				std::vector<SceneEntity> entities;
+				SceneGenerator::Generate(scene, entities);
+
+				// Each mesh a different size
+				std::vector<MeshBounds> meshBounds(scene.meshCount);
+				for (unsigned int m = 0; m < scene.meshCount; m++)
+				{
+					float size = 0.5f + (m % 4) * 0.5f;
+					meshBounds[m].min = XMFLOAT3(-size, -size, -size);
+					meshBounds[m].max = XMFLOAT3(size, size, size);
+					meshBounds[m].center = XMFLOAT3(0, 0, 0);
+					meshBounds[m].radius = size * 1.7320508f;
+				}
+
+				World world;
+				TransformStore store;
+				store.Reserve(count);
+				unsigned int moving = 0;
+				for (const SceneEntity& entity : entities)
+				{
+					SceneTransform transform = { store.Add(entity.position, entity.rotation, entity.scale) };
+					SceneLook look = { entity.mesh, entity.material, 0 };
+					if (entity.moves)
+					{
+						world.Create(transform, look, entity.motion);
+						moving++;
+					}
+					else
+						world.Create(transform, look);
+				}
+				store.UpdateWorldMatrices(&pool);
+
+				FrustumCuller culler;
+				culler.Reserve(count);
+				LodSelector selector;
+				selector.SetProjection(projection, height);
+				std::vector<unsigned int> visible;
+				RenderQueue queue;
+				queue.SetDepthRange(0.1f, 1000.0f);
+				queue.Reserve(count);
+				InstanceBatcher batcher;
+				batcher.Reserve(count);
+
+				SceneResult result = SceneResult();
+				result.scenario = scenario.name;
+				result.scene = scene;
+				result.moving = moving;
+				result.checksum = SceneGenerator::Checksum(entities);
+
+				for (unsigned int frame = 0; frame < options.frameCount; frame++)
+				{
+					float time = frame * frameTime;
+					XMFLOAT3 eye(-scene.extent * 0.5f + time * 10.0f, 30.0f, -scene.extent * 0.5f);
+					XMFLOAT3 forward(0.6f, -0.2f, 0.77459667f);
+
+					double seconds[SceneResult::StageCount] = {};
+					auto stageStart = std::chrono::high_resolution_clock::now();
+					auto endStage = [&](int stage)
+					{
+						auto now = std::chrono::high_resolution_clock::now();
+						seconds[stage] = std::chrono::duration<double>(now - stageStart).count();
+						stageStart = now;
+					};
+
+					world.ForEachChunk<SceneTransform, MotionComponent>([&](unsigned int chunkCount, const EntityId*,
+						SceneTransform* transforms, MotionComponent* motions)
+					{
+						for (unsigned int i = 0; i < chunkCount; i++)
+						{
+							XMFLOAT3 position;
+							XMFLOAT4 rotation;
+							SceneGenerator::Animate(motions[i], time, position, rotation);
+							store.SetPosition(transforms[i].index, position);
+							store.SetRotation(transforms[i].index, rotation);
+						}
+					});
+					endStage(0);
+
+					store.UpdateDirtyWorldMatrices(&pool);
+					endStage(1);
+
+					culler.Clear();
+					world.ForEachChunk<SceneTransform, SceneLook>([&](unsigned int chunkCount, const EntityId* ids,
+						SceneTransform* transforms, SceneLook* looks)
+					{
+						for (unsigned int i = 0; i < chunkCount; i++)
+							culler.Add(ids[i], meshBounds[looks[i].mesh], *store.GetWorldMatrix(transforms[i].index));
+					});
+					Frustum frustum = Frustum::FromPerspective(eye, forward, XMFLOAT3(0, 1, 0), 0.25f * 3.1415926535f, 16.0f / 9.0f,
+						0.1f, 1000.0f);
+					culler.CullCoherent(frustum, visible);
+					endStage(2);
+					unsigned int visibleCount = (unsigned int)visible.size();
+
+					selector.BeginFrame(eye);
+					size_t keptCount = 0;
+					for (EntityId id : visible)
+					{
+						SceneLook* look = world.Get<SceneLook>(id);
+						look->lod = selector.Select(meshBounds[look->mesh], *store.GetWorldMatrix(world.Get<SceneTransform>(id)->index),
+							look->lod, levelCount);
+						if (look->lod != LodSelector::Culled)
+							visible[keptCount++] = id;
+					}
+					visible.resize(keptCount);
+					endStage(3);
+
+					queue.Clear();
+					for (EntityId id : visible)
+					{
+						const SceneLook* look = world.Get<SceneLook>(id);
+						const XMFLOAT4X4& matrix = *store.GetWorldMatrix(world.Get<SceneTransform>(id)->index);
+						float depth = (matrix._14 - eye.x) * forward.x + (matrix._24 - eye.y) * forward.y + (matrix._34 - eye.z) * forward.z;
+						queue.Add(RENDER_PASS_OPAQUE, look->material, look->mesh, depth, id);
+					}
+					queue.Sort();
+
+					batcher.Clear();
+					for (unsigned int q = 0; q < queue.GetCount(); q++)
+					{
+						EntityId id = queue.GetPayload(q);
+						const SceneLook* look = world.Get<SceneLook>(id);
+						batcher.Add(look->material, look->mesh, look->lod, id, *store.GetWorldMatrix(world.Get<SceneTransform>(id)->index));
+					}
+					endStage(4);
+
+					// The first frame fills the culler's cache
+					if (frame == 0)
+						continue;
+					for (int s = 0; s < SceneResult::StageCount - 1; s++)
+						seconds[SceneResult::StageCount - 1] += seconds[s];
+					for (int s = 0; s < SceneResult::StageCount; s++)
+					{
+						result.meanMs[s] += seconds[s] * 1e3;
+						result.maxMs[s] = std::max(result.maxMs[s], seconds[s] * 1e3);
+					}
+					result.visible += visibleCount;
+					result.drawn += batcher.GetInstanceCount();
+					result.batches += batcher.GetBatchCount();
+				}
+
+				double frames = std::max(options.frameCount, 2u) - 1.0;
+				for (int s = 0; s < SceneResult::StageCount; s++)
+					result.meanMs[s] /= frames;
+				result.visible /= frames;
+				result.drawn /= frames;
+				result.batches /= frames;
+				results.push_back(result);
+
+				printf("  %10u %10s %10.0f %10.0f %10.0f", count, scenario.name, result.visible, result.drawn, result.batches);
+				for (int s = 0; s < SceneResult::StageCount; s++)
+					printf(" %10.3f", result.meanMs[s]);
+				printf("\n");
+			}
+		}
+
+		if (!options.jsonPath.empty())
+			WriteSceneJson(options, results);
+	}
+
+	// --------------------------------------------------------
+	// 10000 up to -max draws with random materials, meshes and
+	// depths, sorted with RenderQueue's radix sort and with
+	// std::sort on the same keys - plus how many material and
+	// mesh changes drawing them takes before and after
+	// --------------------------------------------------------
+	void BenchmarkQueue(const BenchOptions& options)
+	{
+		const unsigned int materialCount = 64;
+		const unsigned int meshCount = 256;
+
+		printf("queue: ns per draw, changes are material / mesh switches\n");
+		printf("  %10s %10s %10s %10s %10s %10s %18s %18s\n", "draws", "add", "radix", "std::sort", "speedup", "passes",
+			"unsorted changes", "sorted changes");
+
+		for (unsigned int count = 10000; count <= options.maxCount; count *= 10)
+		{
+			Random random(count);
+			std::vector<unsigned int> materials(count);
+			std::vector<unsigned int> meshes(count);
+			std::vector<float> depths(count);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				materials[i] = (unsigned int)random.Next(0, (float)materialCount);
+				meshes[i] = (unsigned int)random.Next(0, (float)meshCount);
+				depths[i] = random.Next(0.1f, 1000.0f);
+			}
+
+			RenderQueue queue;
+			queue.SetDepthRange(0.1f, 1000.0f);
+			queue.Reserve(count);
+			auto fill = [&]()
+			{
+				queue.Clear();
+				for (unsigned int i = 0; i < count; i++)
+					queue.Add(RENDER_PASS_OPAQUE, materials[i], meshes[i], depths[i], i);
+			};
+			double addSeconds = Measure(options.minSeconds, fill);
+			RenderQueueStats unsortedStats = queue.GetStats();
+			std::vector<RenderItem> unsorted(queue.GetItems(), queue.GetItems() + count);
+
+			// Each run starts from the unsorted draws again, which
+			// isn't timed
+			std::vector<RenderItem> sorted;
+			double radixSeconds = 0.0;
+			double stdSeconds = 0.0;
+			unsigned int runs = 0;
+			while (runs < 2 || radixSeconds + stdSeconds < options.minSeconds * 2)
+			{
+				fill();
+				auto start = std::chrono::high_resolution_clock::now();
+				queue.Sort();
+				auto middle = std::chrono::high_resolution_clock::now();
+				sorted = unsorted;
+				auto middle2 = std::chrono::high_resolution_clock::now();
+				std::sort(sorted.begin(), sorted.end(), [](const RenderItem& a, const RenderItem& b) { return a.key < b.key; });
+				auto end = std::chrono::high_resolution_clock::now();
+
+				// The first run only warms up
+				if (runs++ == 0)
+					continue;
+				radixSeconds += std::chrono::duration<double>(middle - start).count();
+				stdSeconds += std::chrono::duration<double>(end - middle2).count();
+			}
+			runs--;
+
+			bool mismatch = false;
+			for (unsigned int i = 0; i < count; i++)
+				mismatch |= queue.GetItems()[i].key != sorted[i].key;
+			RenderQueueStats sortedStats = queue.GetStats();
+
+			char unsortedChanges[32];
+			char sortedChanges[32];
+			snprintf(unsortedChanges, sizeof(unsortedChanges), "%u / %u", unsortedStats.materialChanges, unsortedStats.meshChanges);
+			snprintf(sortedChanges, sizeof(sortedChanges), "%u / %u", sortedStats.materialChanges, sortedStats.meshChanges);
+			printf("  %10u %10.2f %10.2f %10.2f %9.1fx %10u %18s %18s%s\n", count, addSeconds * 1e9 / count,
+				radixSeconds * 1e9 / ((double)count * runs), stdSeconds * 1e9 / ((double)count * runs), stdSeconds / radixSeconds,
+				sortedStats.sortPasses, unsortedChanges, sortedChanges, mismatch ? " (mismatch)" : "");
+		}
+	}
+
+	// --------------------------------------------------------
+	// 1000 up to -max visible draws, put in RenderQueue order and
+	// gathered into instanced batches - how long that takes, and
+	// the draw calls and constant / instance bytes it comes to
+	// against one draw per entity. Levels of detail follow depth,
+	// as LodSelector's would
+	// --------------------------------------------------------
+	void BenchmarkInstancing(const BenchOptions& options)
+	{
+		struct Variety
+		{
+			const char* name;
+			unsigned int meshCount;
+			unsigned int materialCount;
+			int levelCount;
+		};
+		const Variety varieties[] =
+		{
+			{ "one", 1, 1, 1 },          // Like Main - one mesh and material
+			{ "some", 16, 8, 4 },
+			{ "many", 1024, 64, 4 },
+		};
+
+		printf("instancing: ns per instance, bytes are constants and instance data per frame\n");
+		printf("  %10s %10s %10s %10s %10s %10s %12s %12s\n", "draws", "variety", "batches", "largest", "batch", "draw ratio",
+			"batched KB", "unbatched KB");
+
+		for (unsigned int count = 1000; count <= options.maxCount; count *= 10)
+		{
+			for (const Variety& variety : varieties)
+			{
+				Random random(count);
+				std::vector<unsigned int> materials(count);
+				std::vector<unsigned int> meshes(count);
+				std::vector<int> levels(count);
+				std::vector<XMFLOAT4X4> matrices(count);
+				RenderQueue queue;
+				queue.SetDepthRange(0.1f, 1000.0f);
+				queue.Reserve(count);
+				for (unsigned int i = 0; i < count; i++)
+				{
+					materials[i] = (unsigned int)random.Next(0, (float)variety.materialCount);
+					meshes[i] = (unsigned int)random.Next(0, (float)variety.meshCount);
+					float depth = random.Next(0.1f, 1000.0f);
+					levels[i] = std::min((int)(depth / 1000.0f * variety.levelCount), variety.levelCount - 1);
+					XMStoreFloat4x4(&matrices[i], XMMatrixTranspose(XMMatrixTranslation(random.Next(-500, 500), 0, depth)));
+					queue.Add(RENDER_PASS_OPAQUE, materials[i], meshes[i], depth, i);
+				}
+				queue.Sort();
+
+				InstanceBatcher batcher;
+				batcher.Reserve(count);
+				double batchSeconds = Measure(options.minSeconds, [&]()
+				{
+					batcher.Clear();
+					for (unsigned int q = 0; q < count; q++)
+					{
+						unsigned int i = queue.GetPayload(q);
+						batcher.Add(materials[i], meshes[i], levels[i], i, matrices[i]);
+					}
+				});
+
+				InstanceBatchStats stats = batcher.GetStats();
+				printf("  %10u %10s %10u %10u %10.2f %9.1fx %12.1f %12.1f\n", count, variety.name, stats.batches, stats.largestBatch,
+					batchSeconds * 1e9 / count, (double)stats.instances / stats.batches, stats.bytes / 1024.0,
+					stats.unbatchedBytes / 1024.0);
+			}
+		}
+	}
+
+	// The models that ship in Assets (Engine/Debug/Models)
+	const char* const ModelNames[] = { "cube", "cone", "cylinder", "sphere", "torus", "helix" };
+
+	std::string ModelPath(const BenchOptions& options, const char* name)
+	{
+		return options.modelDirectory + "/" + name + ".obj";
+	}
+
+	// sscanf_s only differs from sscanf when reading strings, which
+	// the old loop never did - elsewhere the plain one does the same
+#ifdef _WIN32
+#define LEGACY_SSCANF sscanf_s
+#else
+#define LEGACY_SSCANF sscanf
+#endif
+
+	// --------------------------------------------------------
+	// Mesh(char*) as it was before ObjParser - a line at a time
+	// through getline and sscanf, one vertex per triangle corner
+	// - Only "v/vt/vn" triangles, like the original
+	// --------------------------------------------------------
+	bool LoadObjLegacy(const char* filename, std::vector<Vertex>& verts)
+	{
+		std::ifstream obj(filename);
+		if (!obj.is_open())
+			return false;
+
+		std::vector<XMFLOAT3> positions;
+		std::vector<XMFLOAT3> normals;
+		std::vector<XMFLOAT2> uvs;
+		verts.clear();
+		char chars[100];
+
+		while (obj.good())
+		{
+			obj.getline(chars, 100);
+
+			if (chars[0] == 'v' && chars[1] == 'n')
+			{
+				XMFLOAT3 norm;
+				LEGACY_SSCANF(chars, "vn %f %f %f", &norm.x, &norm.y, &norm.z);
+				normals.push_back(norm);
+			}
+			else if (chars[0] == 'v' && chars[1] == 't')
+			{
+				XMFLOAT2 uv;
+				LEGACY_SSCANF(chars, "vt %f %f", &uv.x, &uv.y);
+				uvs.push_back(uv);
+			}
+			else if (chars[0] == 'v')
+			{
+				XMFLOAT3 pos;
+				LEGACY_SSCANF(chars, "v %f %f %f", &pos.x, &pos.y, &pos.z);
+				positions.push_back(pos);
+			}
+			else if (chars[0] == 'f')
+			{
+				unsigned int i[9];
+				LEGACY_SSCANF(chars, "f %u/%u/%u %u/%u/%u %u/%u/%u",
+					&i[0], &i[1], &i[2], &i[3], &i[4], &i[5], &i[6], &i[7], &i[8]);
+
+				for (int c = 0; c < 3; c++)
+				{
+					Vertex v;
+					v.Position = positions[i[c * 3] - 1];
+					v.UV = uvs[i[c * 3 + 1] - 1];
+					v.Normal = normals[i[c * 3 + 2] - 1];
+					v.UV.y = 1.0f - v.UV.y;
+					verts.push_back(v);
+				}
+			}
+		}
+		return !verts.empty();
+	}
+
+	bool SameVertices(const std::vector<Vertex>& a, const std::vector<Vertex>& b)
+	{
+		if (a.size() != b.size())
+			return false;
+		const float tolerance = 1e-5f;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			const float* x = &a[i].Position.x;
+			const float* y = &b[i].Position.x;
+			for (int k = 0; k < 8; k++)
+			{
+				if (fabsf(x[k] - y[k]) > tolerance)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// Every model read into per-corner vertices the old way and
+	// through MeshBuilder::LoadObj - which should give the same
+	// vertices - on one thread and on every core
+	// --------------------------------------------------------
+	void BenchmarkObj(const BenchOptions& options)
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+
+		printf("obj: ms per file from %s, %u cores\n", options.modelDirectory.c_str(), cores);
+		printf("  %10s %10s %10s %10s %10s %10s %10s %10s\n", "model", "KB", "triangles", "legacy", "1 thread", "all cores",
+			"MB/s", "speedup");
+
+		double legacyTotal = 0.0, singleTotal = 0.0, allTotal = 0.0;
+		size_t bytesTotal = 0;
+		for (const char* name : ModelNames)
+		{
+			std::string path = ModelPath(options, name);
+			std::vector<Vertex> legacy;
+			MeshData data;
+			if (!LoadObjLegacy(path.c_str(), legacy) || !MeshBuilder::LoadObj(path.c_str(), data, 1))
+			{
+				printf("  %10s (couldn't read %s)\n", name, path.c_str());
+				continue;
+			}
+			bool same = SameVertices(legacy, data.vertices);
+
+			ObjData obj;
+			ObjParser::ParseFile(path.c_str(), obj, 1);
+
+			double legacySeconds = Measure(options.minSeconds, [&]() { LoadObjLegacy(path.c_str(), legacy); });
+			double singleSeconds = Measure(options.minSeconds, [&]() { MeshBuilder::LoadObj(path.c_str(), data, 1); });
+			double allSeconds = Measure(options.minSeconds, [&]() { MeshBuilder::LoadObj(path.c_str(), data, 0); });
+			double best = std::min(singleSeconds, allSeconds);
+
+			printf("  %10s %10.1f %10u %10.3f %10.3f %10.3f %10.1f %9.1fx%s\n", name, obj.fileBytes / 1024.0,
+				(unsigned int)data.indices.size() / 3, legacySeconds * 1e3, singleSeconds * 1e3, allSeconds * 1e3,
+				obj.fileBytes / best / 1e6, legacySeconds / best, same ? "" : " (mismatch)");
+
+			legacyTotal += legacySeconds;
+			singleTotal += singleSeconds;
+			allTotal += allSeconds;
+			bytesTotal += obj.fileBytes;
+		}
+
+		if (bytesTotal > 0)
+		{
+			double best = std::min(singleTotal, allTotal);
+			printf("  %10s %10.1f %10s %10.3f %10.3f %10.3f %10.1f %9.1fx\n", "total", bytesTotal / 1024.0, "",
+				legacyTotal * 1e3, singleTotal * 1e3, allTotal * 1e3, bytesTotal / best / 1e6, legacyTotal / best);
+		}
+	}
+
+	// --------------------------------------------------------
+	// Index orders of DirectXTK's ComputeSphere() and ComputeTorus()
+	// (Geometry.cpp) - the vertices themselves don't matter to the
+	// cache, only how many there are and the order they're used in
+	// --------------------------------------------------------
+	unsigned int GenerateSphereIndices(unsigned int tessellation, std::vector<unsigned int>& indices)
+	{
+		unsigned int verticalSegments = tessellation;
+		unsigned int horizontalSegments = tessellation * 2;
+		unsigned int stride = horizontalSegments + 1;
+
+		indices.clear();
+		for (unsigned int i = 0; i < verticalSegments; i++)
+		{
+			for (unsigned int j = 0; j <= horizontalSegments; j++)
+			{
+				unsigned int nextI = i + 1;
+				unsigned int nextJ = (j + 1) % stride;
+				unsigned int quad[6] = { i * stride + j, nextI * stride + j, i * stride + nextJ,
+					i * stride + nextJ, nextI * stride + j, nextI * stride + nextJ };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+		return (verticalSegments + 1) * stride;
+	}
+
+	unsigned int GenerateTorusIndices(unsigned int tessellation, std::vector<unsigned int>& indices)
+	{
+		unsigned int stride = tessellation + 1;
+
+		indices.clear();
+		for (unsigned int i = 0; i <= tessellation; i++)
+		{
+			for (unsigned int j = 0; j <= tessellation; j++)
+			{
+				unsigned int nextI = (i + 1) % stride;
+				unsigned int nextJ = (j + 1) % stride;
+				unsigned int quad[6] = { i * stride + j, i * stride + nextJ, nextI * stride + j,
+					i * stride + nextJ, nextI * stride + nextJ, nextI * stride + j };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+		return stride * stride;
+	}
+
+	// Triangles as sorted lists of their corners, each rotated to
+	// start at its smallest index - equal lists mean the same
+	// triangles with the same winding, however they were reordered
+	std::vector<unsigned long long> TriangleKeys(const std::vector<unsigned int>& indices)
+	{
+		std::vector<unsigned long long> keys(indices.size() / 3);
+		for (size_t t = 0; t < keys.size(); t++)
+		{
+			const unsigned int* c = &indices[t * 3];
+			int first = c[0] <= c[1] && c[0] <= c[2] ? 0 : (c[1] <= c[2] ? 1 : 2);
+			unsigned long long key = 0;
+			for (int k = 0; k < 3; k++)
+				key = (key << 21) | c[(first + k) % 3];
+			keys[t] = key;
+		}
+		std::sort(keys.begin(), keys.end());
+		return keys;
+	}
+
+	// --------------------------------------------------------
+	// Post-transform cache efficiency before and after
+	// VertexCacheOptimizer::Optimize() - models are welded first,
+	// as MeshBuilder::Process() does, so their vertices are shared
+	// --------------------------------------------------------
+	void BenchmarkVertexCache(const BenchOptions& options)
+	{
+		struct CacheMesh
+		{
+			std::string name;
+			std::vector<unsigned int> indices;
+			unsigned int vertexCount;
+		};
+		std::vector<CacheMesh> meshes;
+
+		for (const char* name : ModelNames)
+		{
+			std::string path = ModelPath(options, name);
+			MeshData data;
+			if (!MeshBuilder::LoadObj(path.c_str(), data, 1))
+			{
+				printf("vcache: couldn't read %s\n", path.c_str());
+				continue;
+			}
+			MeshBuilder::Weld(data);
+			CacheMesh mesh = { name, data.indices, (unsigned int)data.vertices.size() };
+			meshes.push_back(mesh);
+		}
+
+		const unsigned int tessellations[] = { 16, 64, 256 };
+		for (unsigned int tessellation : tessellations)
+		{
+			CacheMesh sphere, torus;
+			sphere.name = "sphere " + std::to_string(tessellation);
+			sphere.vertexCount = GenerateSphereIndices(tessellation, sphere.indices);
+			torus.name = "torus " + std::to_string(tessellation);
+			torus.vertexCount = GenerateTorusIndices(tessellation, torus.indices);
+			meshes.push_back(sphere);
+			meshes.push_back(torus);
+		}
+
+		printf("vcache: 16 entry FIFO cache, ms per optimization\n");
+		printf("  %12s %10s %10s %10s %10s %10s %10s %10s %10s\n", "mesh", "triangles", "vertices", "acmr", "optimized",
+			"atvr", "optimized", "ms", "triangles");
+
+		for (CacheMesh& mesh : meshes)
+		{
+			VertexCacheStats before = VertexCacheOptimizer::Analyze(mesh.indices, mesh.vertexCount);
+
+			std::vector<unsigned int> optimized;
+			double seconds = Measure(options.minSeconds, [&]()
+			{
+				optimized = mesh.indices;
+				VertexCacheOptimizer::Optimize(optimized, mesh.vertexCount);
+			});
+			VertexCacheStats after = VertexCacheOptimizer::Analyze(optimized, mesh.vertexCount);
+
+			std::vector<unsigned int> sortedBefore(mesh.indices), sortedAfter(optimized);
+			std::sort(sortedBefore.begin(), sortedBefore.end());
+			std::sort(sortedAfter.begin(), sortedAfter.end());
+			bool sameIndices = sortedBefore == sortedAfter;
+			bool sameTriangles = TriangleKeys(mesh.indices) == TriangleKeys(optimized);
+
+			printf("  %12s %10u %10u %10.3f %10.3f %10.3f %10.3f %10.3f %10s\n", mesh.name.c_str(),
+				(unsigned int)mesh.indices.size() / 3, mesh.vertexCount, before.acmr, after.acmr, before.atvr, after.atvr,
+				seconds * 1e3, !sameIndices ? "CHANGED" : (sameTriangles ? "same" : "rewound"));
+		}
+	}
+
+	// --------------------------------------------------------
+	// What the loader benchmark's factory makes instead of a Mesh -
+	// Mesh is only declared here, so the handles it returns point
+	// at one of these and are never dereferenced
+	// --------------------------------------------------------
+	struct BenchMesh
+	{
+		unsigned int vertexCount;
+		unsigned int indexCount;
+	};
+
+	MeshHandle MakeBenchMesh(const MeshData& data)
+	{
+		std::shared_ptr<BenchMesh> mesh = std::make_shared<BenchMesh>();
+		mesh->vertexCount = (unsigned int)data.vertices.size();
+		mesh->indexCount = (unsigned int)data.indices.size();
+		return MeshHandle(mesh, reinterpret_cast<Mesh*>(mesh.get()));
+	}
+
+	size_t FileBytes(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		return file.is_open() ? (size_t)file.tellg() : 0;
+	}
+
+	// --------------------------------------------------------
+	// MeshLoader with a factory that never touches a device:
+	// - Throughput of a batch of every model, against loading
+	//   them one after another on the calling thread
+	// - Order - a batch of mixed priorities queued behind the
+	//   helix on one worker should come out most important
+	//   first, and first come first served within a priority
+	// - Cancellation - half of a batch cancelled right after it's
+	//   queued should never reach the factory, and should save
+	//   about half the time
+	// --------------------------------------------------------
+	void BenchmarkLoader(const BenchOptions& options)
+	{
+		const unsigned int copies = 8;
+		std::vector<std::string> paths;
+		size_t batchBytes = 0;
+		for (unsigned int copy = 0; copy < copies; copy++)
+		{
+			for (const char* name : ModelNames)
+			{
+				std::string path = ModelPath(options, name);
+				size_t bytes = FileBytes(path);
+				if (bytes == 0)
+				{
+					printf("loader: couldn't read %s\n", path.c_str());
+					return;
+				}
+				paths.push_back(path);
+				batchBytes += bytes;
+			}
+		}
+		const unsigned int batch = (unsigned int)paths.size();
+		MeshImportOptions importOptions;
+		auto factory = [](MeshData& data, const MeshLoadRequest&) { return MakeBenchMesh(data); };
+
+		unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+		printf("loader: %u files (%.1f KB) imported with lodCount %u, %u cores\n", batch, batchBytes / 1024.0,
+			importOptions.lodCount, cores);
+		printf("  %10s %10s %10s %10s %10s %10s\n", "workers", "ms", "files/s", "MB/s", "speedup", "completed");
+
+		double syncSeconds = Measure(options.minSeconds, [&]()
+		{
+			for (const std::string& path : paths)
+			{
+				MeshData data;
+				if (MeshBuilder::LoadObj(path.c_str(), data, 1))
+					MeshBuilder::Process(data, importOptions);
+			}
+		});
+		printf("  %10s %10.3f %10.1f %10.1f %9.1fx %10u\n", "inline", syncSeconds * 1e3, batch / syncSeconds,
+			batchBytes / syncSeconds / 1e6, 1.0, batch);
+
+		std::vector<unsigned int> workerCounts = { 1, 2, 4 };
+		if (cores > 4)
+			workerCounts.push_back(cores);
+		for (unsigned int workers : workerCounts)
+		{
+			MeshLoaderStats stats = {};
+			double seconds = Measure(options.minSeconds, [&]()
+			{
+				MeshLoader loader(factory, workers);
+				for (const std::string& path : paths)
+					loader.Load(path, 0, importOptions);
+				loader.Flush();
+				stats = loader.GetStats();
+			});
+			printf("  %10u %10.3f %10.1f %10.1f %9.1fx %10u\n", workers, seconds * 1e3, batch / seconds,
+				batchBytes / seconds / 1e6, syncSeconds / seconds, stats.completed);
+		}
+
+		// Order: queue the helix first so the only worker is busy while
+		// the rest go in, then count every pair created out of order
+		{
+			const int levels = 4;
+			Random random(options.seed);
+			std::vector<int> priorities;
+			std::vector<unsigned int> created;
+			std::vector<double> waitSeconds(batch, 0.0);
+			auto queuedAt = std::chrono::high_resolution_clock::now();
+			{
+				MeshLoader loader(factory, 1);
+				loader.Load(ModelPath(options, "helix"), levels, importOptions);
+				queuedAt = std::chrono::high_resolution_clock::now();
+				for (unsigned int i = 0; i < batch; i++)
+				{
+					priorities.push_back((int)random.Next(0, levels));
+					loader.Load(paths[i], priorities[i], importOptions, [&, i](MeshHandle)
+					{
+						created.push_back(i);
+						waitSeconds[i] = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - queuedAt).count();
+					});
+				}
+				loader.Flush();
+			}
+
+			unsigned int outOfOrder = 0;
+			for (size_t a = 0; a < created.size(); a++)
+			{
+				for (size_t b = a + 1; b < created.size(); b++)
+				{
+					int first = priorities[created[a]], second = priorities[created[b]];
+					if (first < second || (first == second && created[a] > created[b]))
+						outOfOrder++;
+				}
+			}
+
+			printf("  order: %u requests, %d priorities, 1 worker - %u of %u created, %u pairs out of order\n", batch,
+				levels, (unsigned int)created.size(), batch, outOfOrder);
+			for (int level = levels - 1; level >= 0; level--)
+			{
+				double total = 0.0;
+				unsigned int count = 0;
+				for (unsigned int i = 0; i < batch; i++)
+				{
+					if (priorities[i] == level)
+					{
+						total += waitSeconds[i];
+						count++;
+					}
+				}
+				if (count > 0)
+					printf("    priority %d: %3u requests, %8.3f ms average wait\n", level, count, total / count * 1e3);
+			}
+		}
+
+		// Cancellation: every other copy of the models, straight after
+		// queueing - some may already be loading, the rest are queued
+		{
+			const unsigned int modelCount = batch / copies;
+			std::vector<MeshLoadHandle> requests;
+			std::vector<char> made(batch, 0);
+			MeshLoaderStats stats = {};
+			unsigned int wasted = 0, emptyFutures = 0, reachedFactory = 0;
+			double seconds = Measure(options.minSeconds, [&]()
+			{
+				requests.clear();
+				std::fill(made.begin(), made.end(), 0);
+				MeshLoader loader([&](MeshData& data, const MeshLoadRequest& request)
+				{
+					for (unsigned int i = 0; i < batch; i++)
+					{
+						if (requests[i].get() == &request)
+							made[i] = 1;
+					}
+					return MakeBenchMesh(data);
+				}, 0);
+				for (const std::string& path : paths)
+					requests.push_back(loader.Load(path, 0, importOptions));
+				for (unsigned int i = modelCount; i < batch; i += modelCount * 2)
+				{
+					for (unsigned int model = 0; model < modelCount; model++)
+						loader.Cancel(requests[i + model]);
+				}
+				loader.Flush();
+				stats = loader.GetStats();
+			});
+
+			for (unsigned int i = 0; i < batch; i++)
+			{
+				if (requests[i]->GetState() != MESH_LOAD_CANCELLED)
+					continue;
+				if (requests[i]->GetLoadSeconds() > 0.0)
+					wasted++;
+				if (!requests[i]->GetFuture().get())
+					emptyFutures++;
+				if (made[i])
+					reachedFactory++;
+			}
+
+			double fullSeconds = Measure(options.minSeconds, [&]()
+			{
+				MeshLoader loader(factory, 0);
+				for (const std::string& path : paths)
+					loader.Load(path, 0, importOptions);
+				loader.Flush();
+			});
+
+			printf("  cancel: %u of %u cancelled, %u completed - %u empty futures, %u reached the factory, %u loaded for nothing\n",
+				stats.cancelled, batch, stats.completed, emptyFutures, reachedFactory, wasted);
+			printf("    %.3f ms against %.3f ms for the whole batch (%.0f%%)\n", seconds * 1e3, fullSeconds * 1e3,
+				seconds / fullSeconds * 100.0);
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	BenchOptions options;
+	options.maxCount = 1000000;
+	options.minSeconds = 0.25;
+	options.seed = 1;
+	options.frameCount = 100;
+	options.modelDirectory = "Models";
+	std::vector<std::string> benchmarks;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-max") == 0 && i + 1 < argc)
+			options.maxCount = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-seconds") == 0 && i + 1 < argc)
+			options.minSeconds = atof(argv[++i]);
+		else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+			options.seed = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+			options.frameCount = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-json") == 0 && i + 1 < argc)
+			options.jsonPath = argv[++i];
+		else if (strcmp(argv[i], "-models") == 0 && i + 1 < argc)
+			options.modelDirectory = argv[++i];
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+			benchmarks.push_back(argv[i]);
+	}
+
+	if (benchmarks.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	for (auto& name : benchmarks)
+	{
+		if (name == "transforms")
+			BenchmarkTransforms(options);
+		else if (name == "dirty")
+			BenchmarkDirty(options);
+		else if (name == "hierarchy")
+			BenchmarkHierarchy(options);
+		else if (name == "ecs")
+			BenchmarkEcs(options);
+		else if (name == "churn")
+			BenchmarkChurn(options);
+		else if (name == "culling")
+			BenchmarkCulling(options);
+		else if (name == "bvh")
+			BenchmarkBvh(options);
+		else if (name == "grid")
+			BenchmarkGrid(options);
+		else if (name == "occlusion")
+			BenchmarkOcclusion(options);
+		else if (name == "picking")
+			BenchmarkPicking(options);
+		else if (name == "coherence")
+			BenchmarkCoherence(options);
+		else if (name == "lod")
+			BenchmarkLod(options);
+		else if (name == "scene")
+			BenchmarkScene(options);
+		else if (name == "queue")
+			BenchmarkQueue(options);
+		else if (name == "instancing")
+			BenchmarkInstancing(options);
+		else if (name == "obj")
+			BenchmarkObj(options);
+		else if (name == "vcache")
+			BenchmarkVertexCache(options);
+		else if (name == "loader")
+			BenchmarkLoader(options);
+		else
+		{
+			printf("Unknown benchmark: %s\n", name.c_str());
+			PrintUsage();
+			return 1;
+		}
+	}
+	return 0;
+}
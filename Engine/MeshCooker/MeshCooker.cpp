@@ -0,0 +1,264 @@
+// ----------------------------------------------------------------------------
+//  MeshCooker - converts OBJ files into cooked ".cmesh" files
+//
+//  Usage:
+//    MeshCooker [options] input.obj [input2.obj ...]
+//
+//  Options:
+//    -o <dir>        Write output files into <dir> (default: next to the input)
+//    -weld <eps>     Weld vertices that are within <eps> of each other
+//    -nocache        Skip the vertex cache optimization
+//    -nooverdraw     Skip the overdraw/vertex fetch optimization
+//    -stats          Also measure overdraw before and after, and time
+//                    meshlet culling if there are meshlets
+//    -lods <n>       Number of detail levels to build (default 4, 1 = none)
+//    -lodratio <r>   Triangles kept from one level to the next (default 0.5)
+//    -loderror <e>   Stop adding levels past this error, relative to the
+//                    bounding radius (default 0.05)
+//    -meshlets       Split level 0 into meshlets for CPU culling
+//    -threads <n>    Files cooked in parallel (default: one per core)
+//
+//  The cooker only uses the CPU-side mesh pipeline, so it also
+//  builds on Linux:
+//    g++ -O2 -std=c++14 -I../DirectX11_Starter -I<DirectXMath> MeshCooker.cpp
+//        ../DirectX11_Starter/{MappedFile,ObjParser,MeshBuilder,
+//        VertexCacheOptimizer,OverdrawOptimizer,MeshSimplifier,
+//        MeshletBuilder,Frustum,VertexCompressor,CookedMesh}.cpp -pthread
+// ----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MeshBuilder.h"
+#include "CookedMesh.h"
+
+namespace
+{
+	void PrintUsage()
+	{
+		printf("Usage: MeshCooker [-o dir] [-weld eps] [-nocache] [-nooverdraw] [-stats]\n");
+		printf("                  [-lods n] [-lodratio r] [-loderror e] [-meshlets] [-threads n] input.obj ...\n");
+	}
+
+	// input.obj -> [dir/]input.cmesh
+	std::string OutputName(const std::string& input, const std::string& directory)
+	{
+		std::string name = input;
+		size_t dot = name.find_last_of('.');
+		size_t slash = name.find_last_of("/\\");
+		if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+			name = name.substr(0, dot);
+		name += ".cmesh";
+
+		if (directory.empty())
+			return name;
+
+		std::string file = slash == std::string::npos ? name : name.substr(slash + 1);
+		return directory + "/" + file;
+	}
+
+	// Appends printf-style text to a report
+	void Report(std::string& report, const char* format, ...)
+	{
+		char line[1024];
+		va_list args;
+		va_start(args, format);
+		vsnprintf(line, sizeof(line), format, args);
+		va_end(args);
+		report += line;
+	}
+
+	// --------------------------------------------------------
+	// Headless meshlet culling benchmark - looks at the mesh from
+	// the six axes and eight cube corners, 3 radii away, and runs
+	// the same culling the renderer does
+	// --------------------------------------------------------
+	void BenchmarkCulling(const MeshData& data, std::string& report)
+	{
+		const float directions[][3] =
+		{
+			{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+			{ 1, 1, 1 }, { 1, 1, -1 }, { 1, -1, 1 }, { 1, -1, -1 },
+			{ -1, 1, 1 }, { -1, 1, -1 }, { -1, -1, 1 }, { -1, -1, -1 }
+		};
+		const int repeats = 200;
+
+		MeshBounds bounds = MeshBuilder::ComputeBounds(&data.vertices[0], data.vertices.size());
+		float distance = std::max(bounds.radius, 0.001f) * 3.0f;
+
+		std::vector<IndexRange> visible;
+		unsigned long long survivors = 0, coneCulled = 0, frustumCulled = 0, ranges = 0;
+		double seconds = 0.0;
+		for (auto& direction : directions)
+		{
+			float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+			DirectX::XMFLOAT3 forward(direction[0] / length, direction[1] / length, direction[2] / length);
+			DirectX::XMFLOAT3 eye(bounds.center.x - forward.x * distance, bounds.center.y - forward.y * distance, bounds.center.z - forward.z * distance);
+			DirectX::XMFLOAT3 up = fabsf(forward.y) < 0.99f ? DirectX::XMFLOAT3(0, 1, 0) : DirectX::XMFLOAT3(1, 0, 0);
+			Frustum frustum = Frustum::FromPerspective(eye, forward, up, 0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, distance * 4.0f);
+
+			MeshletCullStats stats = {};
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int r = 0; r < repeats; r++)
+				survivors += MeshletBuilder::Cull(&data.meshlets[0], data.meshlets.size(), frustum, eye, visible, &stats);
+			seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			coneCulled += stats.coneCulled;
+			frustumCulled += stats.frustumCulled;
+			ranges += visible.size();
+		}
+
+		double views = sizeof(directions) / sizeof(directions[0]);
+		double tested = (double)data.meshlets.size() * views * repeats;
+		Report(report, "  culling: %.1f%% visible, %.1f%% cone culled, %.1f%% frustum culled, %.1f draws/view, %.1f ns/meshlet\n",
+			100.0 * survivors / tested,
+			100.0 * coneCulled / (data.meshlets.size() * views),
+			100.0 * frustumCulled / (data.meshlets.size() * views),
+			ranges / views,
+			seconds * 1e9 / tested);
+	}
+
+	// --------------------------------------------------------
+	// Cooks one file - safe to call from several threads at
+	// once since everything it touches is local
+	// - parseThreads is this file's share of the cores, since
+	//   the other workers are cooking files at the same time
+	// --------------------------------------------------------
+	bool CookFile(const std::string& input, const std::string& output, const MeshImportOptions& options,
+		unsigned int parseThreads, std::string& report)
+	{
+		MeshData data;
+		if (!MeshBuilder::LoadObj(input.c_str(), data, parseThreads))
+		{
+			Report(report, "%s: could not read OBJ file\n", input.c_str());
+			return false;
+		}
+
+		MeshImportStats stats = MeshBuilder::Process(data, options);
+
+		if (!CookedMesh::Write(output.c_str(), data))
+		{
+			Report(report, "%s: could not write %s\n", input.c_str(), output.c_str());
+			return false;
+		}
+
+		Report(report, "%s -> %s\n", input.c_str(), output.c_str());
+		Report(report, "  vertices %u -> %u, triangles %u\n",
+			stats.weld.inputVertices, stats.weld.outputVertices, data.lods.empty() ? (unsigned int)data.indices.size() / 3 : data.lods[0].indexCount / 3);
+		Report(report, "  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+			stats.cacheBefore.acmr, stats.cacheAfter.acmr, stats.cacheBefore.atvr, stats.cacheAfter.atvr);
+		if (options.measureOverdraw)
+			Report(report, "  overdraw %.3f -> %.3f\n", stats.overdrawBefore.overdraw, stats.overdrawAfter.overdraw);
+		for (size_t i = 1; i < data.lods.size(); i++)
+			Report(report, "  LOD %u: %u triangles, error %.4f\n", (unsigned int)i, data.lods[i].indexCount / 3, data.lods[i].error);
+		if (!data.meshlets.empty())
+		{
+			size_t vertices = 0, triangles = 0;
+			for (auto& meshlet : data.meshlets)
+			{
+				vertices += meshlet.vertexCount;
+				triangles += meshlet.indexCount / 3;
+			}
+			Report(report, "  %u meshlets, %.1f vertices and %.1f triangles on average\n", (unsigned int)data.meshlets.size(),
+				(double)vertices / data.meshlets.size(), (double)triangles / data.meshlets.size());
+			if (options.measureOverdraw)
+				BenchmarkCulling(data, report);
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	MeshImportOptions options;
+	options.lodCount = 4;
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	std::string directory;
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			directory = argv[++i];
+		else if (strcmp(argv[i], "-weld") == 0 && i + 1 < argc)
+			options.weldEpsilon = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-nocache") == 0)
+			options.optimizeVertexCache = false;
+		else if (strcmp(argv[i], "-nooverdraw") == 0)
+			options.optimizeOverdraw = false;
+		else if (strcmp(argv[i], "-stats") == 0)
+			options.measureOverdraw = true;
+		else if (strcmp(argv[i], "-lods") == 0 && i + 1 < argc)
+			options.lodCount = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-lodratio") == 0 && i + 1 < argc)
+			options.lodRatio = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-loderror") == 0 && i + 1 < argc)
+			options.lodMaxError = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-meshlets") == 0)
+			options.buildMeshlets = true;
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threadCount = (unsigned int)atoi(argv[++i]);
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+			inputs.push_back(argv[i]);
+	}
+
+	if (inputs.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	// Cook files in parallel - each worker grabs the next file
+	// until there are none left (simplification dominates, and
+	// each mesh is independent of the others)
+	if (threadCount == 0)
+		threadCount = 1;
+	if (threadCount > inputs.size())
+		threadCount = (unsigned int)inputs.size();
+
+	// Split the cores between the workers, so a single big file
+	// still parses on all of them but many files don't oversubscribe
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	unsigned int parseThreads = std::max(1u, cores / threadCount);
+
+	std::vector<std::string> reports(inputs.size());
+	std::vector<char> succeeded(inputs.size(), 0);
+	std::atomic<size_t> next(0);
+
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < inputs.size(); i = next++)
+			succeeded[i] = CookFile(inputs[i], OutputName(inputs[i], directory), options, parseThreads, reports[i]);
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned int i = 1; i < threadCount; i++)
+		workers.push_back(std::thread(worker));
+	worker();
+	for (auto& thread : workers)
+		thread.join();
+
+	// Report in command line order, whatever order they finished in
+	int failures = 0;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		printf("%s", reports[i].c_str());
+		if (!succeeded[i])
+			failures++;
+	}
+
+	return failures == 0 ? 0 : 1;
+}